@@ -202,6 +202,10 @@ SOURCE=.\buckets\apr_buckets_simple.c
 
 SOURCE=.\buckets\apr_buckets_socket.c
 # End Source File
+# Begin Source File
+
+SOURCE=.\buckets\apr_buckets_splice.c
+# End Source File
 # End Group
 # Begin Group "crypto"
 
@@ -672,6 +676,10 @@ SOURCE=.\tables\apr_tables.c
 # End Source File
 # Begin Source File
 
+SOURCE=.\tables\apr_timerq.c
+# End Source File
+# Begin Source File
+
 SOURCE=.\tables\apr_skiplist.c
 # End Source File
 # End Group
@@ -1091,6 +1099,10 @@ SOURCE=.\include\apr_time.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\include\apr_timerq.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\include\apr_user.h
 # End Source File
 # Begin Source File
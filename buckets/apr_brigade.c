@@ -21,6 +21,8 @@
 #include "apr_tables.h"
 #include "apr_buckets.h"
 #include "apr_errno.h"
+#include "apr_portable.h"
+#include "apr_private.h"
 #define APR_WANT_MEMFUNC
 #define APR_WANT_STRFUNC
 #include "apr_want.h"
@@ -28,6 +30,12 @@
 #if APR_HAVE_SYS_UIO_H
 #include <sys/uio.h>
 #endif
+#if APR_HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+#if APR_HAVE_ERRNO_H
+#include <errno.h>
+#endif
 
 static apr_status_t brigade_cleanup(void *data)
 {
@@ -690,6 +698,196 @@ skip:
     return APR_INCOMPLETE;
 }
 
+struct apr_brigade_matcher_t {
+    const apr_strmatch_pattern *pattern;
+    apr_off_t offset;       /* offset of the next data */
+    char *held;             /* the tail of the data which may start a match */
+    apr_size_t nheld;
+};
+
+APR_DECLARE(apr_status_t) apr_brigade_matcher_create(
+                                         apr_brigade_matcher_t **matcher,
+                                         const apr_strmatch_pattern *pattern,
+                                         apr_pool_t *p)
+{
+    apr_brigade_matcher_t *m;
+
+    if (!pattern->length) {
+        return APR_EINVAL;
+    }
+
+    m = apr_pcalloc(p, sizeof(*m));
+    m->pattern = pattern;
+    /* room for the held tail, plus as much to search it with */
+    m->held = apr_palloc(p, 2 * (pattern->length - 1) + 1);
+
+    *matcher = m;
+    return APR_SUCCESS;
+}
+
+/*
+ * Search the data of a bucket, starting with the matches beginning in the
+ * held tail of the previous data: the held tail and the first bytes of
+ * the data are searched together, then the data alone. Returns the number
+ * of bytes of the data consumed, up to the end of the match if any.
+ */
+static apr_size_t matcher_search(apr_brigade_matcher_t *m,
+                                 const char *str, apr_size_t len,
+                                 int *found)
+{
+    const apr_size_t tail = m->pattern->length - 1;
+    const char *pos;
+    apr_size_t used;
+
+    if (m->nheld) {
+        apr_size_t n = len < tail ? len : tail;
+
+        memcpy(m->held + m->nheld, str, n);
+        pos = apr_strmatch(m->pattern, m->held, m->nheld + n);
+        if (pos && (apr_size_t)(pos - m->held) < m->nheld) {
+            used = (pos - m->held) + tail + 1 - m->nheld;
+            m->offset += (apr_off_t)used;
+            m->nheld = 0;
+            *found = 1;
+            return used;
+        }
+    }
+
+    pos = apr_strmatch(m->pattern, str, len);
+    if (pos) {
+        used = (pos - str) + tail + 1;
+        m->offset += (apr_off_t)used;
+        m->nheld = 0;
+        *found = 1;
+        return used;
+    }
+
+    /* Hold the new tail, taking from the previous one if the data is
+     * shorter.
+     */
+    if (len >= tail) {
+        memcpy(m->held, str + len - tail, tail);
+        m->nheld = tail;
+    }
+    else {
+        apr_size_t keep = tail - len;
+        if (keep < m->nheld) {
+            memmove(m->held, m->held + m->nheld - keep, keep);
+        }
+        else {
+            keep = m->nheld;
+        }
+        memcpy(m->held + keep, str, len);
+        m->nheld = keep + len;
+    }
+    m->offset += (apr_off_t)len;
+    *found = 0;
+    return len;
+}
+
+APR_DECLARE(apr_status_t) apr_brigade_match(apr_brigade_matcher_t *matcher,
+                                            apr_bucket_brigade *bb,
+                                            apr_read_type_e block,
+                                            apr_off_t *offset,
+                                            apr_off_t *consumed)
+{
+    apr_bucket *e;
+
+    *consumed = 0;
+
+    for (e = APR_BRIGADE_FIRST(bb);
+         e != APR_BRIGADE_SENTINEL(bb);
+         e = APR_BUCKET_NEXT(e)) {
+        const char *str;
+        apr_size_t len, used;
+        apr_status_t rv;
+        int found;
+
+        if (APR_BUCKET_IS_METADATA(e)) {
+            continue;
+        }
+
+        rv = apr_bucket_read(e, &str, &len, block);
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+        if (!len) {
+            continue;
+        }
+
+        used = matcher_search(matcher, str, len, &found);
+        *consumed += (apr_off_t)used;
+        if (found) {
+            *offset = matcher->offset - (apr_off_t)matcher->pattern->length;
+            return APR_SUCCESS;
+        }
+    }
+
+    return APR_INCOMPLETE;
+}
+
+APR_DECLARE(apr_status_t) apr_brigade_encode(apr_bucket_brigade *bb,
+                                             apr_encode_ctx_t *ctx,
+                                             apr_read_type_e block)
+{
+    apr_bucket *e, *next;
+    apr_status_t rv;
+
+    for (e = APR_BRIGADE_FIRST(bb);
+         e != APR_BRIGADE_SENTINEL(bb);
+         e = next) {
+        const char *str;
+        char *buf;
+        apr_size_t len, dlen;
+
+        if (APR_BUCKET_IS_EOS(e)) {
+            apr_encode_final(ctx, NULL, &dlen);
+            buf = apr_bucket_alloc(dlen ? dlen : 1, bb->bucket_alloc);
+            rv = apr_encode_final(ctx, buf, &dlen);
+            if (dlen) {
+                APR_BUCKET_INSERT_BEFORE(e, apr_bucket_heap_create(buf, dlen,
+                                         apr_bucket_free, bb->bucket_alloc));
+            }
+            else {
+                apr_bucket_free(buf);
+            }
+            return rv;
+        }
+        if (APR_BUCKET_IS_METADATA(e)) {
+            next = APR_BUCKET_NEXT(e);
+            continue;
+        }
+
+        /* a read may split the bucket, so get the next one after it */
+        rv = apr_bucket_read(e, &str, &len, block);
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+        next = APR_BUCKET_NEXT(e);
+
+        rv = apr_encode_update(ctx, NULL, str, len, &dlen);
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+
+        /* the data must be given even if nothing is output yet */
+        buf = apr_bucket_alloc(dlen ? dlen : 1, bb->bucket_alloc);
+        rv = apr_encode_update(ctx, buf, str, len, &dlen);
+        if (dlen) {
+            APR_BUCKET_INSERT_BEFORE(e, apr_bucket_heap_create(buf, dlen,
+                                     apr_bucket_free, bb->bucket_alloc));
+        }
+        else {
+            apr_bucket_free(buf);
+        }
+        apr_bucket_delete(e);
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+    }
+
+    return APR_SUCCESS;
+}
 
 APR_DECLARE(apr_status_t) apr_brigade_to_iovec(apr_bucket_brigade *b,
                                                struct iovec *vec, int *nvec)
@@ -726,6 +924,269 @@ APR_DECLARE(apr_status_t) apr_brigade_to_iovec(apr_bucket_brigade *b,
     return APR_SUCCESS;
 }
 
+/* Files smaller than this are read rather than sent with sendfile(). */
+#define BRIGADE_SEND_MIN_SENDFILE 256
+
+/* Stop reading buckets for a single write at this amount of data. */
+#define BRIGADE_SEND_MAX_BYTES (16 * APR_BUCKET_BUFF_SIZE)
+
+/* Remove the first len bytes of data from the brigade, along with the
+ * metadata buckets in between, splitting the last bucket if needed.
+ */
+static void brigade_consume(apr_bucket_brigade *bb, apr_size_t len)
+{
+    while (!APR_BRIGADE_EMPTY(bb)) {
+        apr_bucket *e = APR_BRIGADE_FIRST(bb);
+
+        if (APR_BUCKET_IS_SPLICE(e)) {
+            /* The data spliced have left the pipe already, so shorten the
+             * bucket rather than letting its destruction discard them.
+             */
+            apr_size_t n = e->length < len ? e->length : len;
+
+            e->length -= n;
+            len -= n;
+            if (e->length) {
+                break;
+            }
+            apr_bucket_delete(e);
+            continue;
+        }
+        if (e->length > len) {
+            if (len) {
+                apr_bucket_split(e, len);
+                apr_bucket_delete(e);
+            }
+            break;
+        }
+        len -= e->length;
+        apr_bucket_delete(e);
+    }
+}
+
+#ifdef HAVE_SPLICE
+/* Move up to *len bytes from the pipe to the socket. If the data are known
+ * to be in the pipe already, EAGAIN can only come from the socket which is
+ * then waited for according to its timeout.
+ */
+static apr_status_t brigade_splice(apr_socket_t *sock, apr_file_t *pipe,
+                                   apr_interval_time_t timeout, int in_pipe,
+                                   apr_size_t *len)
+{
+    apr_os_sock_t sd;
+    apr_os_file_t fd;
+    apr_status_t rv;
+    ssize_t rc;
+
+    apr_os_sock_get(&sd, sock);
+    apr_os_file_get(&fd, pipe);
+
+    for (;;) {
+        rc = splice(fd, NULL, sd, NULL, *len,
+                    SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (rc >= 0) {
+            *len = rc;
+            return APR_SUCCESS;
+        }
+        rv = errno;
+        if (rv == EINTR) {
+            continue;
+        }
+        if (APR_STATUS_IS_EAGAIN(rv) && in_pipe && timeout > 0) {
+            rv = apr_socket_wait(sock, APR_WAIT_WRITE);
+            if (rv == APR_SUCCESS) {
+                continue;
+            }
+        }
+        *len = 0;
+        return rv;
+    }
+}
+#endif
+
+APR_DECLARE(apr_status_t) apr_brigade_send(apr_socket_t *sock,
+                                           apr_bucket_brigade *bb,
+                                           apr_int32_t flags,
+                                           apr_off_t *sent)
+{
+    struct iovec vec[APR_MAX_IOVEC_SIZE];
+    apr_interval_time_t timeout;
+    apr_status_t rv = APR_SUCCESS;
+    apr_off_t total = 0;
+
+    apr_socket_timeout_get(sock, &timeout);
+
+    while (!APR_BRIGADE_EMPTY(bb)) {
+        apr_bucket *e, *file = NULL, *splice = NULL;
+#ifdef HAVE_SPLICE
+        apr_file_t *pipe = NULL;
+#endif
+        apr_size_t len, nbytes = 0;
+        const char *data;
+        int nvec = 0, nhdr = 0;
+
+        /* Gather the data up to the end of the brigade, the second file
+         * to sendfile(), or the limits of a single write.
+         */
+        for (e = APR_BRIGADE_FIRST(bb);
+             e != APR_BRIGADE_SENTINEL(bb);
+             e = APR_BUCKET_NEXT(e)) {
+            if (APR_BUCKET_IS_METADATA(e)) {
+                continue;
+            }
+#ifdef HAVE_SPLICE
+            if ((APR_BUCKET_IS_SPLICE(e) || APR_BUCKET_IS_PIPE(e))
+                    && !(flags & APR_BRIGADE_SEND_NO_SPLICE)) {
+                apr_file_t *p = APR_BUCKET_IS_SPLICE(e)
+                                ? ((apr_bucket_splice *)e->data)->pipe
+                                : e->data;
+
+                if (!(apr_file_flags_get(p) & APR_FOPEN_BUFFERED)) {
+                    /* Spliced alone */
+                    if (!nvec && !file) {
+                        splice = e;
+                        pipe = p;
+                    }
+                    break;
+                }
+            }
+#endif
+#if APR_HAS_SENDFILE
+            if (APR_BUCKET_IS_FILE(e)
+                    && !(flags & APR_BRIGADE_SEND_NO_SENDFILE)
+                    && e->length >= BRIGADE_SEND_MIN_SENDFILE
+                    && (apr_file_flags_get(((apr_bucket_file *)e->data)->fd)
+                        & APR_FOPEN_SENDFILE_ENABLED)) {
+                if (file) {
+                    break;
+                }
+                /* What's gathered so far is the headers, the trailers
+                 * follow.
+                 */
+                file = e;
+                nhdr = nvec;
+                continue;
+            }
+#endif
+            if (nvec == APR_MAX_IOVEC_SIZE
+                    || nbytes >= BRIGADE_SEND_MAX_BYTES) {
+                break;
+            }
+
+            rv = apr_bucket_read(e, &data, &len, APR_NONBLOCK_READ);
+            if (APR_STATUS_IS_EAGAIN(rv)) {
+                if (nvec || file) {
+                    /* Send what we have before blocking */
+                    break;
+                }
+                rv = apr_bucket_read(e, &data, &len, APR_BLOCK_READ);
+            }
+            if (rv != APR_SUCCESS) {
+                goto done;
+            }
+            if (len) {
+                vec[nvec].iov_base = (void *)data;
+                vec[nvec].iov_len = len;
+                nbytes += len;
+                nvec++;
+            }
+        }
+
+#ifdef HAVE_SPLICE
+        if (splice) {
+            int in_pipe = APR_BUCKET_IS_SPLICE(splice);
+
+            nbytes = in_pipe ? splice->length : BRIGADE_SEND_MAX_BYTES;
+            len = nbytes;
+            rv = brigade_splice(sock, pipe, timeout, in_pipe, &len);
+            if (rv == APR_SUCCESS && !in_pipe) {
+                if (len == 0) {
+                    /* End of the pipe */
+                    apr_file_close(pipe);
+                    apr_bucket_delete(splice);
+                }
+                total += len;
+                continue;
+            }
+            if (len) {
+                brigade_consume(bb, len);
+                total += len;
+            }
+            if (rv == APR_SUCCESS) {
+                if (len < nbytes && timeout == 0) {
+                    rv = APR_EAGAIN;
+                    break;
+                }
+                continue;
+            }
+            if (rv == EINVAL) {
+                /* Not supported by the socket or the file */
+                flags |= APR_BRIGADE_SEND_NO_SPLICE;
+                continue;
+            }
+            if (in_pipe || !APR_STATUS_IS_EAGAIN(rv) || timeout == 0) {
+                /* Including EAGAIN for a non-blocking socket */
+                break;
+            }
+            /* The pipe is empty or the socket is full, block on the pipe
+             * and the socket will be waited for by the next write.
+             */
+            rv = apr_bucket_read(splice, &data, &len, APR_BLOCK_READ);
+            if (rv != APR_SUCCESS) {
+                break;
+            }
+            continue;
+        }
+#endif
+
+        if (!nvec && !file) {
+            /* Nothing but metadata left */
+            apr_brigade_cleanup(bb);
+            break;
+        }
+
+#if APR_HAS_SENDFILE
+        if (file) {
+            apr_bucket_file *f = file->data;
+            apr_off_t offset = file->start;
+            apr_hdtr_t hdtr;
+
+            hdtr.headers = vec;
+            hdtr.numheaders = nhdr;
+            hdtr.trailers = vec + nhdr;
+            hdtr.numtrailers = nvec - nhdr;
+            nbytes += file->length;
+
+            len = file->length;
+            rv = apr_socket_sendfile(sock, f->fd, &hdtr, &offset, &len, 0);
+        }
+        else
+#endif
+        {
+            rv = apr_socket_sendv(sock, vec, nvec, &len);
+        }
+
+        if (len) {
+            brigade_consume(bb, len);
+            total += len;
+        }
+        if (rv != APR_SUCCESS) {
+            break;
+        }
+        if (len < nbytes && timeout == 0) {
+            /* Partial write on a non-blocking socket */
+            rv = APR_EAGAIN;
+            break;
+        }
+    }
+
+done:
+    if (sent) {
+        *sent = total;
+    }
+    return rv;
+}
+
 APR_DECLARE(apr_status_t) apr_brigade_vputstrs(apr_bucket_brigade *b,
                                                apr_brigade_flush flush,
                                                void *ctx,
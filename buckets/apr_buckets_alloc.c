@@ -15,6 +15,7 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "apr_buckets.h"
 #include "apr_allocator.h"
@@ -32,16 +33,58 @@ typedef struct node_header_t {
 #define SIZEOF_NODE_HEADER_T  APR_ALIGN_DEFAULT(sizeof(node_header_t))
 #define SMALL_NODE_SIZE       (APR_BUCKET_ALLOC_SIZE + SIZEOF_NODE_HEADER_T)
 
+/* The free lists: the first one for the small nodes, the next ones for
+ * the blocks of (index + 1) pages, and the last one (never filled) for
+ * the bigger blocks.
+ */
+#define NUM_LISTS             APR_BUCKET_ALLOC_STATS_SLOTS
+#define LARGE_LIST            (NUM_LISTS - 1)
+
+/* Default maximum memory kept by all the free lists of blocks */
+#define DEFAULT_MAX_FREE      (128 * 1024)
+
+typedef struct node_list_t {
+    node_header_t *freelist;
+    apr_size_t free_nodes;
+    apr_uint64_t hits;
+    apr_uint64_t misses;
+    apr_uint64_t overflows;
+} node_list_t;
+
 /** A list of free memory from which new buckets or private bucket
  *  structures can be allocated.
  */
 struct apr_bucket_alloc_t {
     apr_pool_t *pool;
     apr_allocator_t *allocator;
-    node_header_t *freelist;
     apr_memnode_t *blocks;
+    apr_size_t page_size;
+    apr_size_t max_free;
+    apr_size_t free_size;   /* memory kept by the free lists of blocks */
+    node_list_t lists[NUM_LISTS];
 };
 
+/* Gives the cached blocks back to the allocator */
+static void free_lists_cleanup(apr_bucket_alloc_t *list)
+{
+    apr_memnode_t *memnodes = NULL;
+    node_header_t *node;
+    int i;
+
+    for (i = 1; i < LARGE_LIST; i++) {
+        while ((node = list->lists[i].freelist) != NULL) {
+            list->lists[i].freelist = node->next;
+            node->memnode->next = memnodes;
+            memnodes = node->memnode;
+        }
+        list->lists[i].free_nodes = 0;
+    }
+    list->free_size = 0;
+    if (memnodes) {
+        apr_allocator_free(list->allocator, memnodes);
+    }
+}
+
 static apr_status_t alloc_cleanup(void *data)
 {
     apr_bucket_alloc_t *list = data;
@@ -55,6 +98,7 @@ static apr_status_t alloc_cleanup(void *data)
     }
 #endif
 
+    free_lists_cleanup(list);
     apr_allocator_free(list->allocator, list->blocks);
 
 #if APR_POOL_DEBUG
@@ -107,10 +151,11 @@ APR_DECLARE_NONSTD(apr_bucket_alloc_t *) apr_bucket_alloc_create_ex(
         return NULL;
     }
     list = (apr_bucket_alloc_t *)block->first_avail;
-    list->pool = NULL;
+    memset(list, 0, sizeof(*list));
     list->allocator = allocator;
-    list->freelist = NULL;
     list->blocks = block;
+    list->page_size = apr_allocator_page_size();
+    list->max_free = DEFAULT_MAX_FREE;
     block->first_avail += APR_ALIGN_DEFAULT(sizeof(*list));
     APR_VALGRIND_NOACCESS(block->first_avail,
                           block->endp - block->first_avail);
@@ -123,6 +168,7 @@ APR_DECLARE_NONSTD(void) apr_bucket_alloc_destroy(apr_bucket_alloc_t *list)
         apr_pool_cleanup_kill(list->pool, list, alloc_cleanup);
     }
 
+    free_lists_cleanup(list);
     apr_allocator_free(list->allocator, list->blocks);
 
 #if APR_POOL_DEBUG
@@ -162,13 +208,16 @@ APR_DECLARE_NONSTD(void *) apr_bucket_alloc(apr_size_t in_size,
 
     size = in_size + SIZEOF_NODE_HEADER_T;
     if (size <= SMALL_NODE_SIZE) {
-        if (list->freelist) {
-            node = list->freelist;
-            list->freelist = node->next;
+        node_list_t *l = &list->lists[0];
+        if (l->freelist) {
+            node = l->freelist;
+            l->freelist = node->next;
+            l->hits++;
             APR_VALGRIND_UNDEFINED((char *)node + SIZEOF_NODE_HEADER_T,
                                    SMALL_NODE_SIZE - SIZEOF_NODE_HEADER_T);
         }
         else {
+            l->misses++;
             endp = active->first_avail + SMALL_NODE_SIZE;
             if (endp >= active->endp) {
                 list->blocks = apr_allocator_alloc(list->allocator, ALLOC_AMT);
@@ -191,7 +240,29 @@ APR_DECLARE_NONSTD(void *) apr_bucket_alloc(apr_size_t in_size,
         }
     }
     else {
-        apr_memnode_t *memnode = apr_allocator_alloc(list->allocator, size);
+        apr_memnode_t *memnode;
+        apr_size_t index;
+        node_list_t *l;
+
+        /* Blocks of the same number of pages are interchangeable */
+        index = apr_allocator_align(list->allocator, size) / list->page_size;
+        index = (index > 1 && index <= LARGE_LIST) ? index - 1 : LARGE_LIST;
+        l = &list->lists[index];
+        if (l->freelist) {
+            node = l->freelist;
+            l->freelist = node->next;
+            l->free_nodes--;
+            l->hits++;
+            list->free_size -= node->memnode->endp - (char *)node->memnode;
+            node->size = size;
+            APR_VALGRIND_UNDEFINED((char *)node + SIZEOF_NODE_HEADER_T,
+                                   node->memnode->endp - (char *)node
+                                   - SIZEOF_NODE_HEADER_T);
+            return ((char *)node) + SIZEOF_NODE_HEADER_T;
+        }
+        l->misses++;
+
+        memnode = apr_allocator_alloc(list->allocator, size);
         if (!memnode) {
             return NULL;
         }
@@ -210,7 +281,7 @@ APR_DECLARE_NONSTD(void *) apr_bucket_alloc(apr_size_t in_size,
 static void check_not_already_free(node_header_t *node)
 {
     apr_bucket_alloc_t *list = node->alloc;
-    node_header_t *curr = list->freelist;
+    node_header_t *curr = list->lists[0].freelist;
 
     while (curr) {
         if (node == curr) {
@@ -230,11 +301,81 @@ APR_DECLARE_NONSTD(void) apr_bucket_free(void *mem)
 
     if (node->size == SMALL_NODE_SIZE) {
         check_not_already_free(node);
-        node->next = list->freelist;
-        list->freelist = node;
+        node->next = list->lists[0].freelist;
+        list->lists[0].freelist = node;
         APR_VALGRIND_NOACCESS(mem, SMALL_NODE_SIZE - SIZEOF_NODE_HEADER_T);
     }
     else {
-        apr_allocator_free(list->allocator, node->memnode);
+        apr_memnode_t *memnode = node->memnode;
+        apr_size_t node_size = memnode->endp - (char *)memnode;
+        apr_size_t index = node_size / list->page_size;
+
+        /* Keep the block for the next allocation of the same size, up to
+         * max_free for all the lists.
+         */
+        if (index > 1 && index <= LARGE_LIST
+                && list->free_size + node_size <= list->max_free) {
+            node_list_t *l = &list->lists[index - 1];
+            node->next = l->freelist;
+            l->freelist = node;
+            l->free_nodes++;
+            list->free_size += node_size;
+            APR_VALGRIND_NOACCESS(mem, memnode->endp - (char *)mem);
+        }
+        else {
+            if (index > 1 && index <= LARGE_LIST) {
+                list->lists[index - 1].overflows++;
+            }
+            apr_allocator_free(list->allocator, memnode);
+        }
+    }
+}
+
+APR_DECLARE_NONSTD(void) apr_bucket_alloc_max_free_set(apr_bucket_alloc_t *list,
+                                                       apr_size_t size)
+{
+    node_list_t *l;
+    node_header_t *node;
+    int i;
+
+    list->max_free = size;
+
+    /* Trim the lists to the new threshold, the bigger blocks first */
+    for (i = LARGE_LIST - 1; i > 0 && list->free_size > size; i--) {
+        l = &list->lists[i];
+        while (l->free_nodes && list->free_size > size) {
+            node = l->freelist;
+            l->freelist = node->next;
+            l->free_nodes--;
+            list->free_size -= node->memnode->endp - (char *)node->memnode;
+            apr_allocator_free(list->allocator, node->memnode);
+        }
+    }
+}
+
+APR_DECLARE_NONSTD(void) apr_bucket_alloc_stats_get(apr_bucket_alloc_t *list,
+                                                    apr_bucket_alloc_stats_t *stats)
+{
+    node_header_t *node;
+    int i;
+
+    memset(stats, 0, sizeof(*stats));
+    stats->max_free = list->max_free;
+
+    for (i = 0; i < NUM_LISTS; i++) {
+        node_list_t *l = &list->lists[i];
+        if (i == 0) {
+            stats->node_size[i] = SMALL_NODE_SIZE;
+            for (node = l->freelist; node; node = node->next) {
+                stats->free_nodes[i]++;
+            }
+        }
+        else if (i < LARGE_LIST) {
+            stats->node_size[i] = (i + 1) * list->page_size;
+            stats->free_nodes[i] = l->free_nodes;
+        }
+        stats->hits[i] = l->hits;
+        stats->misses[i] = l->misses;
+        stats->overflows[i] = l->overflows;
     }
 }
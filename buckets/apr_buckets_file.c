@@ -18,6 +18,11 @@
 #include "apr_general.h"
 #include "apr_file_io.h"
 #include "apr_buckets.h"
+#include "apr_portable.h"
+
+#if APR_HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
 
 #if APR_HAS_MMAP
 #include "apr_mmap.h"
@@ -72,6 +77,50 @@ static int file_make_mmap(apr_bucket *e, apr_size_t filelength,
 }
 #endif
 
+/* Grows the read size of sequential reads, and gives the kernel hints */
+static apr_size_t file_adaptive_size(apr_bucket_file *a,
+                                     apr_bucket_alloc_t *list, apr_file_t *f,
+                                     apr_off_t fileoffset,
+                                     apr_size_t filelength)
+{
+    apr_size_t size;
+#if defined(POSIX_FADV_SEQUENTIAL) && defined(POSIX_FADV_WILLNEED)
+    apr_os_file_t fd;
+
+    apr_os_file_get(&fd, f);
+#endif
+
+    if (!a->cur_read_size || fileoffset != a->read_end) {
+        /* (Re)starting a sequential run */
+        a->cur_read_size = a->read_size;
+#if defined(POSIX_FADV_SEQUENTIAL) && defined(POSIX_FADV_WILLNEED)
+        posix_fadvise(fd, fileoffset, filelength, POSIX_FADV_SEQUENTIAL);
+#endif
+    }
+    else if (a->cur_read_size < a->max_read_size) {
+        size = apr_bucket_alloc_aligned_floor(list, a->cur_read_size * 2);
+        a->cur_read_size = (size < a->max_read_size) ? size
+                                                     : a->max_read_size;
+    }
+    size = a->cur_read_size;
+
+#if defined(POSIX_FADV_SEQUENTIAL) && defined(POSIX_FADV_WILLNEED)
+    /* Read ahead what the next read will want */
+    if (filelength > size) {
+        apr_size_t next = a->cur_read_size * 2;
+        if (next > a->max_read_size) {
+            next = a->max_read_size;
+        }
+        if (next > filelength - size) {
+            next = filelength - size;
+        }
+        posix_fadvise(fd, fileoffset + size, next, POSIX_FADV_WILLNEED);
+    }
+#endif
+
+    return size;
+}
+
 static apr_status_t file_bucket_read(apr_bucket *e, const char **str,
                                      apr_size_t *len, apr_read_type_e block)
 {
@@ -82,6 +131,7 @@ static apr_status_t file_bucket_read(apr_bucket *e, const char **str,
     apr_status_t rv;
     apr_size_t filelength = e->length;  /* bytes remaining in file past offset */
     apr_off_t fileoffset = e->start;
+    apr_size_t read_size = a->read_size;
 #if APR_HAS_THREADS && !APR_HAS_XTHREAD_FILES
     apr_int32_t flags;
 #endif
@@ -108,8 +158,13 @@ static apr_status_t file_bucket_read(apr_bucket *e, const char **str,
     }
 #endif
 
+    if (a->max_read_size) {
+        read_size = file_adaptive_size(a, e->list, f, fileoffset,
+                                       filelength);
+    }
+
     *str = NULL;  /* in case we die prematurely */
-    *len = (filelength > a->read_size) ? a->read_size : filelength;
+    *len = (filelength > read_size) ? read_size : filelength;
     buf = apr_bucket_alloc(*len, e->list);
 
     /* Handle offset ... */
@@ -124,6 +179,7 @@ static apr_status_t file_bucket_read(apr_bucket *e, const char **str,
         return rv;
     }
     filelength -= *len;
+    a->read_end = fileoffset + *len;
     /*
      * Change the current bucket to refer to what we read,
      * even if we read nothing because we hit EOF.
@@ -164,6 +220,9 @@ APR_DECLARE(apr_bucket *) apr_bucket_file_make(apr_bucket *b, apr_file_t *fd,
     f->can_mmap = 1;
 #endif
     f->read_size = APR_BUCKET_BUFF_SIZE;
+    f->max_read_size = 0;
+    f->cur_read_size = 0;
+    f->read_end = offset;
 
     b = apr_bucket_shared_make(b, f, offset, len);
     b->type = &apr_bucket_type_file;
@@ -212,6 +271,26 @@ APR_DECLARE(apr_status_t) apr_bucket_file_set_buf_size(apr_bucket *e,
     return APR_SUCCESS;
 }
 
+APR_DECLARE(apr_status_t) apr_bucket_file_set_adaptive(apr_bucket *e,
+                                                       apr_size_t max_size)
+{
+    apr_bucket_file *a = e->data;
+
+    if (max_size == 0) {
+        a->max_read_size = 0;
+    }
+    else if (max_size <= a->read_size) {
+        a->max_read_size = a->read_size;
+    }
+    else {
+        apr_size_t floor = apr_bucket_alloc_aligned_floor(e->list, max_size);
+        a->max_read_size = (max_size < floor) ? max_size : floor;
+    }
+    a->cur_read_size = 0;
+
+    return APR_SUCCESS;
+}
+
 static apr_status_t file_bucket_setaside(apr_bucket *b, apr_pool_t *reqpool)
 {
     apr_bucket_file *a = b->data;
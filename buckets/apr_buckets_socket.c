@@ -16,13 +16,21 @@
 
 #include "apr_buckets.h"
 
+/* Maximum number of buffers filled by a single read */
+#define SOCKET_READ_MAX_VEC 64
+
 static apr_status_t socket_bucket_read(apr_bucket *a, const char **str,
                                        apr_size_t *len, apr_read_type_e block)
 {
     apr_socket_t *p = a->data;
+    struct iovec vec[SOCKET_READ_MAX_VEC];
+    apr_off_t budget = a->start;
+    apr_bucket *b;
+    apr_size_t n;
     char *buf;
     apr_status_t rv;
     apr_interval_time_t timeout;
+    int nvec, i;
 
     if (block == APR_NONBLOCK_READ) {
         apr_socket_timeout_get(p, &timeout);
@@ -33,7 +41,26 @@ static apr_status_t socket_bucket_read(apr_bucket *a, const char **str,
     *len = APR_BUCKET_BUFF_SIZE;
     buf = apr_bucket_alloc(*len, a->list); /* XXX: check for failure? */
 
-    rv = apr_socket_recv(p, buf, len);
+    /* With a read budget (see apr_bucket_socket_set_read_budget()), fill
+     * as many buffers as the budget allows in a single syscall.
+     */
+    nvec = 1;
+    if (budget > APR_BUCKET_BUFF_SIZE) {
+        nvec = (int)((budget + APR_BUCKET_BUFF_SIZE - 1)
+                     / APR_BUCKET_BUFF_SIZE);
+        vec[0].iov_base = buf;
+        vec[0].iov_len = APR_BUCKET_BUFF_SIZE;
+        for (i = 1; i < nvec; i++) {
+            vec[i].iov_base = apr_bucket_alloc(APR_BUCKET_BUFF_SIZE, a->list);
+            vec[i].iov_len = APR_BUCKET_BUFF_SIZE;
+        }
+        vec[nvec - 1].iov_len -= (apr_size_t)(nvec * APR_BUCKET_BUFF_SIZE
+                                              - budget);
+        rv = apr_socket_recvv(p, vec, nvec, len);
+    }
+    else {
+        rv = apr_socket_recv(p, buf, len);
+    }
 
     if (block == APR_NONBLOCK_READ) {
         apr_socket_timeout_set(p, timeout);
@@ -41,6 +68,9 @@ static apr_status_t socket_bucket_read(apr_bucket *a, const char **str,
 
     if (rv != APR_SUCCESS && rv != APR_EOF) {
         apr_bucket_free(buf);
+        for (i = 1; i < nvec; i++) {
+            apr_bucket_free(vec[i].iov_base);
+        }
         return rv;
     }
     /*
@@ -60,15 +90,42 @@ static apr_status_t socket_bucket_read(apr_bucket *a, const char **str,
      */
     if (*len > 0) {
         apr_bucket_heap *h;
-        /* Change the current bucket to refer to what we read */
+        /* Change the current bucket to refer to what we read, and chain
+         * a heap bucket for each other buffer filled.
+         */
+        n = *len;
+        if (*len > APR_BUCKET_BUFF_SIZE) {
+            *len = APR_BUCKET_BUFF_SIZE;
+        }
         a = apr_bucket_heap_make(a, buf, *len, apr_bucket_free);
         h = a->data;
         h->alloc_len = APR_BUCKET_BUFF_SIZE; /* note the real buffer size */
         *str = buf;
-        APR_BUCKET_INSERT_AFTER(a, apr_bucket_socket_create(p, a->list));
+        n -= *len;
+        b = a;
+        for (i = 1; i < nvec; i++) {
+            if (n == 0) {
+                apr_bucket_free(vec[i].iov_base);
+                continue;
+            }
+            APR_BUCKET_INSERT_AFTER(b, apr_bucket_heap_create(
+                                        vec[i].iov_base,
+                                        n < APR_BUCKET_BUFF_SIZE
+                                        ? n : APR_BUCKET_BUFF_SIZE,
+                                        apr_bucket_free, a->list));
+            b = APR_BUCKET_NEXT(b);
+            h = b->data;
+            h->alloc_len = APR_BUCKET_BUFF_SIZE;
+            n -= b->length;
+        }
+        APR_BUCKET_INSERT_AFTER(b, apr_bucket_socket_create(p, a->list));
+        APR_BUCKET_NEXT(b)->start = budget;
     }
     else {
         apr_bucket_free(buf);
+        for (i = 1; i < nvec; i++) {
+            apr_bucket_free(vec[i].iov_base);
+        }
         a = apr_bucket_immortal_make(a, "", 0);
         *str = a->data;
     }
@@ -104,6 +161,27 @@ APR_DECLARE(apr_bucket *) apr_bucket_socket_create(apr_socket_t *p,
     return apr_bucket_socket_make(b, p);
 }
 
+APR_DECLARE(apr_status_t) apr_bucket_socket_set_read_budget(apr_bucket *b,
+                                                          apr_size_t budget)
+{
+    if (!APR_BUCKET_IS_SOCKET(b)) {
+        return APR_EINVAL;
+    }
+
+    /* The start offset is meaningless for a socket, it holds the budget */
+    if (budget <= APR_BUCKET_BUFF_SIZE) {
+        b->start = -1;
+    }
+    else if (budget > SOCKET_READ_MAX_VEC * APR_BUCKET_BUFF_SIZE) {
+        b->start = SOCKET_READ_MAX_VEC * APR_BUCKET_BUFF_SIZE;
+    }
+    else {
+        b->start = budget;
+    }
+
+    return APR_SUCCESS;
+}
+
 APR_DECLARE_DATA const apr_bucket_type_t apr_bucket_type_socket = {
     "SOCKET", 5, APR_BUCKET_DATA,
     apr_bucket_destroy_noop,
@@ -0,0 +1,209 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr_buckets.h"
+#include "apr_portable.h"
+#include "apr_private.h"
+
+#if APR_HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+#if APR_HAVE_ERRNO_H
+#include <errno.h>
+#endif
+
+static apr_status_t splice_bucket_read(apr_bucket *a, const char **str,
+                                       apr_size_t *len, apr_read_type_e block)
+{
+    apr_bucket_splice *s = a->data;
+    apr_size_t n = a->length;
+    apr_status_t rv;
+    char *buf;
+
+    /* The data are in the pipe already, so this does not block */
+    buf = apr_bucket_alloc(n, a->list);
+    rv = apr_file_read_full(s->pipe, buf, n, NULL);
+    if (rv != APR_SUCCESS) {
+        apr_bucket_free(buf);
+        return rv;
+    }
+
+    apr_bucket_free(s);
+    apr_bucket_heap_make(a, buf, n, apr_bucket_free);
+    *str = buf;
+    *len = n;
+    return APR_SUCCESS;
+}
+
+static void splice_bucket_destroy(void *data)
+{
+    apr_bucket_splice *s = data;
+    apr_size_t n = s->bucket->length;
+    char buf[APR_BUCKET_BUFF_SIZE];
+
+    /* The data of a bucket destroyed unread are still in the pipe, discard
+     * them for the next SPLICE buckets to read their own.
+     */
+    while (n) {
+        apr_size_t k = n < sizeof(buf) ? n : sizeof(buf);
+        if (apr_file_read_full(s->pipe, buf, k, NULL) != APR_SUCCESS) {
+            break;
+        }
+        n -= k;
+    }
+
+    apr_bucket_free(s);
+}
+
+APR_DECLARE(apr_bucket *) apr_bucket_splice_make(apr_bucket *b,
+                                                 apr_file_t *p,
+                                                 apr_size_t len)
+{
+    apr_bucket_splice *s;
+
+    s = apr_bucket_alloc(sizeof(*s), b->list);
+    /*
+     * Like for PIPE buckets, the pipe is not owned by the bucket, it's
+     * the caller's to close it when done.
+     */
+    s->pipe = p;
+    s->bucket = b;
+
+    b->type        = &apr_bucket_type_splice;
+    b->length      = len;
+    b->start       = 0;
+    b->data        = s;
+
+    return b;
+}
+
+APR_DECLARE(apr_bucket *) apr_bucket_splice_create(apr_file_t *p,
+                                                   apr_size_t len,
+                                                   apr_bucket_alloc_t *list)
+{
+    apr_bucket *b = apr_bucket_alloc(sizeof(*b), list);
+
+    APR_BUCKET_INIT(b);
+    b->free = apr_bucket_free;
+    b->list = list;
+    return apr_bucket_splice_make(b, p, len);
+}
+
+static void brigade_append_splice(apr_bucket_brigade *bb, apr_file_t *p,
+                                  apr_size_t len)
+{
+    apr_bucket *e;
+
+    if (!APR_BRIGADE_EMPTY(bb)) {
+        e = APR_BRIGADE_LAST(bb);
+        if (APR_BUCKET_IS_SPLICE(e)
+                && ((apr_bucket_splice *)e->data)->pipe == p) {
+            e->length += len;
+            return;
+        }
+    }
+    e = apr_bucket_splice_create(p, len, bb->bucket_alloc);
+    APR_BRIGADE_INSERT_TAIL(bb, e);
+}
+
+APR_DECLARE(apr_status_t) apr_brigade_splice_socket(apr_bucket_brigade *bb,
+                                                    apr_socket_t *sock,
+                                                    apr_file_t *pipe_in,
+                                                    apr_file_t *pipe_out,
+                                                    apr_size_t max,
+                                                    apr_size_t *len)
+{
+    apr_status_t rv;
+    apr_size_t n;
+    char *buf;
+
+    *len = 0;
+
+#ifdef HAVE_SPLICE
+    if (!(apr_file_flags_get(pipe_out) & APR_FOPEN_BUFFERED)) {
+        apr_interval_time_t timeout;
+        apr_os_sock_t sd;
+        apr_os_file_t fd;
+        int waited = 0;
+        ssize_t rc;
+
+        apr_os_sock_get(&sd, sock);
+        apr_os_file_get(&fd, pipe_out);
+        apr_socket_timeout_get(sock, &timeout);
+
+        /* The pipe is never blocked on, the socket is (per its timeout) */
+        for (;;) {
+            rc = splice(sd, NULL, fd, NULL, max,
+                        SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            if (rc >= 0) {
+                break;
+            }
+            rv = errno;
+            if (rv == EINTR) {
+                continue;
+            }
+            if (APR_STATUS_IS_EAGAIN(rv) && timeout > 0 && !waited) {
+                /* Either the socket has no data yet or the pipe is full,
+                 * wait for the former (once, in case of the latter).
+                 */
+                rv = apr_socket_wait(sock, APR_WAIT_READ);
+                if (rv != APR_SUCCESS) {
+                    return rv;
+                }
+                waited = 1;
+                continue;
+            }
+            break;
+        }
+        if (rc > 0) {
+            brigade_append_splice(bb, pipe_in, rc);
+            *len = rc;
+            return APR_SUCCESS;
+        }
+        if (rc == 0) {
+            return APR_EOF;
+        }
+        if (rv != EINVAL) {
+            return rv;
+        }
+        /* Not supported by this socket, copy the data then */
+    }
+#endif
+
+    if (max > APR_BUCKET_BUFF_SIZE) {
+        max = APR_BUCKET_BUFF_SIZE;
+    }
+    buf = apr_bucket_alloc(max, bb->bucket_alloc);
+    n = max;
+    rv = apr_socket_recv(sock, buf, &n);
+    if (n == 0) {
+        apr_bucket_free(buf);
+        return rv == APR_SUCCESS ? APR_EOF : rv;
+    }
+    APR_BRIGADE_INSERT_TAIL(bb, apr_bucket_heap_create(buf, n, apr_bucket_free,
+                                                       bb->bucket_alloc));
+    *len = n;
+    return APR_SUCCESS;
+}
+
+APR_DECLARE_DATA const apr_bucket_type_t apr_bucket_type_splice = {
+    "SPLICE", 5, APR_BUCKET_DATA,
+    splice_bucket_destroy,
+    splice_bucket_read,
+    apr_bucket_setaside_noop,
+    apr_bucket_split_notimpl,
+    apr_bucket_copy_notimpl
+};
@@ -65,6 +65,7 @@
 #include "apr_thread_proc.h"
 #include "apr_thread_rwlock.h"
 #include "apr_time.h"
+#include "apr_timerq.h"
 #include "apr_uri.h"
 #include "apr_user.h"
 #include "apr_uuid.h"
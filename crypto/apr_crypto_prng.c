@@ -67,6 +67,9 @@
 
 #define CPRNG_BUF_SIZE_MIN (CPRNG_KEY_SIZE * (8 - 1))
 #define CPRNG_BUF_SIZE_DEF (CPRNG_KEY_SIZE * (24 - 1))
+/* Per-thread CPRNGs are meant for the many small requests (nonces, UUIDs,
+ * session IDs...), so they buffer more to amortize the cipher (re)init. */
+#define CPRNG_BUF_SIZE_THREAD (CPRNG_KEY_SIZE * (128 - 1))
 
 APR_TYPEDEF_STRUCT(apr_crypto_t,
     apr_pool_t *pool;
@@ -85,6 +88,9 @@ struct apr_crypto_prng_t {
     apr_size_t len, pos;
     int flags;
     apr_crypto_cipher_e cipher;
+#if APR_HAS_THREADS
+    apr_uint32_t thread_gen;
+#endif
 };
 
 static apr_crypto_prng_t *cprng_global = NULL;
@@ -95,6 +101,16 @@ static apr_thread_mutex_t *cprng_ring_mutex;
 
 static apr_threadkey_t *cprng_thread_key = NULL;
 
+/* Incremented by each per-thread apr_crypto_prng_init(), so that the
+ * CPRNGs of a previous init are not used anymore (see cprng_thread_get()).
+ */
+static apr_uint32_t cprng_thread_gen = 0;
+
+#if APR_HAS_THREAD_LOCAL
+/* Shortcut to the CPRNG in cprng_thread_key for the current thread. */
+static APR_THREAD_LOCAL apr_crypto_prng_t *cprng_thread = NULL;
+#endif
+
 #define cprng_lock(g) \
     if ((g)->mutex) \
         apr_thread_mutex_lock((g)->mutex)
@@ -113,6 +129,11 @@ static apr_threadkey_t *cprng_thread_key = NULL;
 
 static void cprng_thread_destroy(void *cprng)
 {
+#if APR_HAS_THREAD_LOCAL
+    if (cprng_thread == cprng) {
+        cprng_thread = NULL;
+    }
+#endif
     apr_threadkey_private_set(NULL, cprng_thread_key);
     if (cprng) {
         apr_crypto_prng_destroy(cprng);
@@ -154,6 +175,7 @@ APR_DECLARE(apr_status_t) apr_crypto_prng_init(apr_pool_t *pool, apr_crypto_t *c
         if (rv != APR_SUCCESS) {
             return rv;
         }
+        cprng_thread_gen++;
 #endif
     }
 
@@ -207,16 +229,22 @@ APR_DECLARE(apr_status_t) apr_crypto_random_bytes(void *buf, apr_size_t len)
 }
 
 #if APR_HAS_THREADS
-APR_DECLARE(apr_status_t) apr_crypto_random_thread_bytes(void *buf,
-                                                         apr_size_t len)
+static apr_status_t cprng_bytes(apr_crypto_prng_t *cprng,
+                                void *buf, apr_size_t len);
+
+static apr_status_t cprng_thread_get(apr_crypto_prng_t **pcprng)
 {
     apr_status_t rv;
     apr_crypto_prng_t *cprng;
     void *private = NULL;
 
-    if (!cprng_thread_key || !cprng_global) {
-        return APR_EINIT;
+#if APR_HAS_THREAD_LOCAL
+    cprng = cprng_thread;
+    if (cprng && cprng->thread_gen == cprng_thread_gen) {
+        *pcprng = cprng;
+        return APR_SUCCESS;
     }
+#endif
 
     rv = apr_threadkey_private_get(&private, cprng_thread_key);
     if (rv != APR_SUCCESS) {
@@ -225,11 +253,12 @@ APR_DECLARE(apr_status_t) apr_crypto_random_thread_bytes(void *buf,
 
     cprng = private;
     if (!cprng) {
-        rv = apr_crypto_prng_create(&cprng, cprng_global->crypto, cprng_global->cipher, 0,
-                APR_CRYPTO_PRNG_PER_THREAD, NULL, NULL);
+        rv = apr_crypto_prng_create(&cprng, cprng_global->crypto, cprng_global->cipher,
+                CPRNG_BUF_SIZE_THREAD, APR_CRYPTO_PRNG_PER_THREAD, NULL, NULL);
         if (rv != APR_SUCCESS) {
             return rv;
         }
+        cprng->thread_gen = cprng_thread_gen;
 
         rv = apr_threadkey_private_set(cprng, cprng_thread_key);
         if (rv != APR_SUCCESS) {
@@ -238,7 +267,32 @@ APR_DECLARE(apr_status_t) apr_crypto_random_thread_bytes(void *buf,
         }
     }
 
-    return apr_crypto_prng_bytes(cprng, buf, len);
+#if APR_HAS_THREAD_LOCAL
+    cprng_thread = cprng;
+#endif
+    *pcprng = cprng;
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_crypto_random_thread_bytes(void *buf,
+                                                         apr_size_t len)
+{
+    apr_status_t rv;
+    apr_crypto_prng_t *cprng;
+
+    if (!cprng_thread_key || !cprng_global) {
+        return APR_EINIT;
+    }
+
+    rv = cprng_thread_get(&cprng);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+
+    /* Owned by this thread only, no locking needed: small requests are
+     * served from the buffer until it's consumed and refilled in one go.
+     */
+    return cprng_bytes(cprng, buf, len);
 }
 #endif
 
@@ -639,6 +693,22 @@ APR_DECLARE(apr_status_t) apr_crypto_prng_after_fork(apr_crypto_prng_t *cprng,
     cprng_unlock(cprng);
 
     if (cprng == cprng_global) {
+#if APR_HAS_THREADS
+        /* The per-thread CPRNGs are not maintained, but the calling thread's
+         * one is the only one the child can use, rekey it too.
+         */
+        if (cprng_thread_key) {
+            void *private = NULL;
+            if (apr_threadkey_private_get(&private, cprng_thread_key)
+                    == APR_SUCCESS && private) {
+                apr_status_t rt = apr_crypto_prng_after_fork(private, flags);
+                if (rt != APR_SUCCESS && rv == APR_SUCCESS) {
+                    rv = rt;
+                }
+            }
+        }
+#endif
+
         /* Forward to all maintained CPRNGs. */
         cprng_ring_lock();
         for (cprng = APR_RING_FIRST(cprng_ring);
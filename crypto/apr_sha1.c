@@ -81,6 +81,94 @@
 
 #define SHA_BLOCKSIZE           64
 
+/* big-endian 32-bit word at p, whatever its alignment */
+#define SHA_GET32(p) \
+    (((apr_uint32_t)(p)[0] << 24) | ((apr_uint32_t)(p)[1] << 16) | \
+     ((apr_uint32_t)(p)[2] << 8) | (apr_uint32_t)(p)[3])
+
+static const apr_uint32_t sha_iv[5] = {
+    0x67452301L, 0xefcdab89L, 0x98badcfeL, 0x10325476L, 0xc3d2e1f0L
+};
+
+/* hash nblocks consecutive blocks of data into digest */
+typedef void (*sha_blocks_fn_t)(apr_uint32_t digest[5],
+                                const unsigned char *data,
+                                apr_size_t nblocks);
+
+/*
+ * The SHA extensions of x86 (SHA-NI) and ARMv8 hash a block in a few
+ * tens of instructions.  They are not part of the baseline instruction
+ * sets, so the CPU is probed once at runtime before using them, unless
+ * the compiler already targets them (aarch64 with +crypto).
+ */
+#if defined(__x86_64__) || defined(__i386__) \
+    || defined(_M_X64) || defined(_M_IX86)
+#if defined(__clang__) || (defined(__GNUC__) \
+    && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)))
+#include <cpuid.h>
+#include <immintrin.h>
+#define SHA_SHANI 1
+#define SHA_SHANI_TARGET __attribute__((target("sha,sse4.1")))
+#elif defined(_MSC_VER) && _MSC_VER >= 1900
+#include <intrin.h>
+#include <immintrin.h>
+#define SHA_SHANI 1
+#define SHA_SHANI_TARGET
+#endif
+#elif defined(__aarch64__)
+#if defined(__ARM_FEATURE_SHA2) || defined(__ARM_FEATURE_CRYPTO)
+#include <arm_neon.h>
+#define SHA_ARMV8 1
+#define SHA_ARMV8_TARGET
+#elif defined(__linux__) && defined(__GNUC__) && !defined(__clang__) \
+    && __GNUC__ >= 8
+#include <arm_neon.h>
+#include <sys/auxv.h>
+#ifndef HWCAP_SHA1
+#define HWCAP_SHA1 (1 << 5)
+#endif
+#define SHA_ARMV8 1
+#define SHA_ARMV8_TARGET __attribute__((target("+crypto")))
+#define SHA_ARMV8_HWCAP 1
+#endif
+#endif
+#ifndef SHA_SHANI
+#define SHA_SHANI 0
+#endif
+#ifndef SHA_ARMV8
+#define SHA_ARMV8 0
+#endif
+
+/*
+ * Without them, apr_sha1_multi() still hashes four messages at once with
+ * SSE2 or NEON, one per 32-bit lane.
+ */
+#if defined(__SSE2__) || defined(_M_X64) \
+    || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SHA_X4 1
+typedef __m128i sha_vec_t;
+#define VADD(a,b)   _mm_add_epi32(a, b)
+#define VXOR(a,b)   _mm_xor_si128(a, b)
+#define VAND(a,b)   _mm_and_si128(a, b)
+#define VOR(a,b)    _mm_or_si128(a, b)
+#define VROT32(x,n) _mm_or_si128(_mm_slli_epi32(x, n), \
+                                 _mm_srli_epi32(x, 32 - (n)))
+#define VCONST(k)   _mm_set1_epi32((int)(k))
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define SHA_X4 1
+typedef uint32x4_t sha_vec_t;
+#define VADD(a,b)   vaddq_u32(a, b)
+#define VXOR(a,b)   veorq_u32(a, b)
+#define VAND(a,b)   vandq_u32(a, b)
+#define VOR(a,b)    vorrq_u32(a, b)
+#define VROT32(x,n) vsliq_n_u32(vshrq_n_u32(x, 32 - (n)), x, n)
+#define VCONST(k)   vdupq_n_u32((uint32_t)(k))
+#else
+#define SHA_X4 0
+#endif
+
 #if APR_CHARSET_EBCDIC
 static apr_xlate_t *ebcdic2ascii_xlate;
 
@@ -104,13 +192,13 @@ APR_DECLARE(apr_status_t) apr_SHA1InitEBCDIC(apr_xlate_t *x)
 #endif
 
 /* do SHA transformation */
-static void sha_transform(apr_sha1_ctx_t *sha_info)
+static void sha_transform(apr_uint32_t digest[5], const unsigned char *data)
 {
     int i;
     apr_uint32_t temp, A, B, C, D, E, W[80];
 
     for (i = 0; i < 16; ++i) {
-        W[i] = sha_info->data[i];
+        W[i] = SHA_GET32(data + 4 * i);
     }
     for (i = 16; i < 80; ++i) {
         W[i] = W[i-3] ^ W[i-8] ^ W[i-14] ^ W[i-16];
@@ -118,11 +206,11 @@ static void sha_transform(apr_sha1_ctx_t *sha_info)
         W[i] = ROT32(W[i], 1);
 #endif /* USE_MODIFIED_SHA */
     }
-    A = sha_info->digest[0];
-    B = sha_info->digest[1];
-    C = sha_info->digest[2];
-    D = sha_info->digest[3];
-    E = sha_info->digest[4];
+    A = digest[0];
+    B = digest[1];
+    C = digest[2];
+    D = digest[3];
+    E = digest[4];
 #ifdef UNROLL_LOOPS
     FUNC(1, 0);  FUNC(1, 1);  FUNC(1, 2);  FUNC(1, 3);  FUNC(1, 4);
     FUNC(1, 5);  FUNC(1, 6);  FUNC(1, 7);  FUNC(1, 8);  FUNC(1, 9);
@@ -157,59 +245,440 @@ static void sha_transform(apr_sha1_ctx_t *sha_info)
         FUNC(4,i);
     }
 #endif /* !UNROLL_LOOPS */
-    sha_info->digest[0] += A;
-    sha_info->digest[1] += B;
-    sha_info->digest[2] += C;
-    sha_info->digest[3] += D;
-    sha_info->digest[4] += E;
+    digest[0] += A;
+    digest[1] += B;
+    digest[2] += C;
+    digest[3] += D;
+    digest[4] += E;
 }
 
-union endianTest {
-    long Long;
-    char Char[sizeof(long)];
-};
+static void sha_blocks_generic(apr_uint32_t digest[5],
+                               const unsigned char *data, apr_size_t nblocks)
+{
+    for (; nblocks; --nblocks, data += SHA_BLOCKSIZE) {
+        sha_transform(digest, data);
+    }
+}
+
+#if SHA_SHANI
+
+static int sha_have_shani(void)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    int r[4];
+
+    __cpuid(r, 0);
+    if (r[0] < 7) {
+        return 0;
+    }
+    __cpuid(r, 1);
+    if (!(r[2] & (1 << 9)) || !(r[2] & (1 << 19))) { /* SSSE3, SSE4.1 */
+        return 0;
+    }
+    __cpuidex(r, 7, 0);
+    return (r[1] & (1 << 29)) != 0; /* SHA */
+#else
+    unsigned int a, b, c, d;
+
+    if (__get_cpuid_max(0, NULL) < 7) {
+        return 0;
+    }
+    __cpuid(1, a, b, c, d);
+    if (!(c & (1 << 9)) || !(c & (1 << 19))) { /* SSSE3, SSE4.1 */
+        return 0;
+    }
+    __cpuid_count(7, 0, a, b, c, d);
+    return (b & (1 << 29)) != 0; /* SHA */
+#endif
+}
+
+/* four rounds, with the message schedule of the next ones interleaved */
+#define SHANI_ROUNDS(e, enext, m, m1, m2, m3, f) \
+    e = _mm_sha1nexte_epu32(e, m); \
+    enext = abcd; \
+    m1 = _mm_sha1msg2_epu32(m1, m); \
+    abcd = _mm_sha1rnds4_epu32(abcd, e, f); \
+    m3 = _mm_sha1msg1_epu32(m3, m); \
+    m2 = _mm_xor_si128(m2, m)
+
+static SHA_SHANI_TARGET void sha_blocks_shani(apr_uint32_t digest[5],
+                                              const unsigned char *data,
+                                              apr_size_t nblocks)
+{
+    const __m128i bswap = _mm_set_epi64x(0x0001020304050607LL,
+                                         0x08090a0b0c0d0e0fLL);
+    __m128i abcd, abcd_save, e0, e1, e_save, m0, m1, m2, m3;
+
+    abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)digest), 0x1b);
+    e0 = _mm_set_epi32((int)digest[4], 0, 0, 0);
+
+    for (; nblocks; --nblocks, data += SHA_BLOCKSIZE) {
+        abcd_save = abcd;
+        e_save = e0;
+
+        m0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)data), bswap);
+        e0 = _mm_add_epi32(e0, m0);
+        e1 = abcd;
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+
+        m1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 16)),
+                              bswap);
+        e1 = _mm_sha1nexte_epu32(e1, m1);
+        e0 = abcd;
+        abcd = _mm_sha1rnds4_epu32(abcd, e1, 0);
+        m0 = _mm_sha1msg1_epu32(m0, m1);
+
+        m2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 32)),
+                              bswap);
+        e0 = _mm_sha1nexte_epu32(e0, m2);
+        e1 = abcd;
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+        m1 = _mm_sha1msg1_epu32(m1, m2);
+        m0 = _mm_xor_si128(m0, m2);
+
+        m3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 48)),
+                              bswap);
+        SHANI_ROUNDS(e1, e0, m3, m0, m1, m2, 0);
+        SHANI_ROUNDS(e0, e1, m0, m1, m2, m3, 0);
+        SHANI_ROUNDS(e1, e0, m1, m2, m3, m0, 1);
+        SHANI_ROUNDS(e0, e1, m2, m3, m0, m1, 1);
+        SHANI_ROUNDS(e1, e0, m3, m0, m1, m2, 1);
+        SHANI_ROUNDS(e0, e1, m0, m1, m2, m3, 1);
+        SHANI_ROUNDS(e1, e0, m1, m2, m3, m0, 1);
+        SHANI_ROUNDS(e0, e1, m2, m3, m0, m1, 2);
+        SHANI_ROUNDS(e1, e0, m3, m0, m1, m2, 2);
+        SHANI_ROUNDS(e0, e1, m0, m1, m2, m3, 2);
+        SHANI_ROUNDS(e1, e0, m1, m2, m3, m0, 2);
+        SHANI_ROUNDS(e0, e1, m2, m3, m0, m1, 2);
+        SHANI_ROUNDS(e1, e0, m3, m0, m1, m2, 3);
+        SHANI_ROUNDS(e0, e1, m0, m1, m2, m3, 3);
+        SHANI_ROUNDS(e1, e0, m1, m2, m3, m0, 3);
+        SHANI_ROUNDS(e0, e1, m2, m3, m0, m1, 3);
+        SHANI_ROUNDS(e1, e0, m3, m0, m1, m2, 3);
+
+        e0 = _mm_sha1nexte_epu32(e0, e_save);
+        abcd = _mm_add_epi32(abcd, abcd_save);
+    }
+
+    _mm_storeu_si128((__m128i *)digest, _mm_shuffle_epi32(abcd, 0x1b));
+    digest[4] = (apr_uint32_t)_mm_extract_epi32(e0, 3);
+}
+
+#endif /* SHA_SHANI */
+
+#if SHA_ARMV8
+
+/* the next four words of the message schedule */
+#define ARMV8_SCHEDULE(m, m1, m2, m3) \
+    m = vsha1su1q_u32(vsha1su0q_u32(m, m1, m2), m3)
+
+/* four rounds */
+#define ARMV8_ROUNDS(op, m, k) \
+    e1 = vsha1h_u32(vgetq_lane_u32(abcd, 0)); \
+    abcd = op(abcd, e0, vaddq_u32(m, k)); \
+    e0 = e1
+
+static SHA_ARMV8_TARGET void sha_blocks_armv8(apr_uint32_t digest[5],
+                                              const unsigned char *data,
+                                              apr_size_t nblocks)
+{
+    const uint32x4_t k1 = vdupq_n_u32(CONST1), k2 = vdupq_n_u32(CONST2),
+                     k3 = vdupq_n_u32(CONST3), k4 = vdupq_n_u32(CONST4);
+    uint32x4_t abcd, abcd_save, m0, m1, m2, m3;
+    uint32_t e0, e1, e_save;
+
+    abcd = vld1q_u32(digest);
+    e0 = digest[4];
+
+    for (; nblocks; --nblocks, data += SHA_BLOCKSIZE) {
+        abcd_save = abcd;
+        e_save = e0;
+
+        m0 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data)));
+        m1 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 16)));
+        m2 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 32)));
+        m3 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 48)));
+
+        ARMV8_ROUNDS(vsha1cq_u32, m0, k1);
+        ARMV8_ROUNDS(vsha1cq_u32, m1, k1);
+        ARMV8_ROUNDS(vsha1cq_u32, m2, k1);
+        ARMV8_ROUNDS(vsha1cq_u32, m3, k1);
+        ARMV8_SCHEDULE(m0, m1, m2, m3);
+        ARMV8_ROUNDS(vsha1cq_u32, m0, k1);
+
+        ARMV8_SCHEDULE(m1, m2, m3, m0);
+        ARMV8_ROUNDS(vsha1pq_u32, m1, k2);
+        ARMV8_SCHEDULE(m2, m3, m0, m1);
+        ARMV8_ROUNDS(vsha1pq_u32, m2, k2);
+        ARMV8_SCHEDULE(m3, m0, m1, m2);
+        ARMV8_ROUNDS(vsha1pq_u32, m3, k2);
+        ARMV8_SCHEDULE(m0, m1, m2, m3);
+        ARMV8_ROUNDS(vsha1pq_u32, m0, k2);
+        ARMV8_SCHEDULE(m1, m2, m3, m0);
+        ARMV8_ROUNDS(vsha1pq_u32, m1, k2);
+
+        ARMV8_SCHEDULE(m2, m3, m0, m1);
+        ARMV8_ROUNDS(vsha1mq_u32, m2, k3);
+        ARMV8_SCHEDULE(m3, m0, m1, m2);
+        ARMV8_ROUNDS(vsha1mq_u32, m3, k3);
+        ARMV8_SCHEDULE(m0, m1, m2, m3);
+        ARMV8_ROUNDS(vsha1mq_u32, m0, k3);
+        ARMV8_SCHEDULE(m1, m2, m3, m0);
+        ARMV8_ROUNDS(vsha1mq_u32, m1, k3);
+        ARMV8_SCHEDULE(m2, m3, m0, m1);
+        ARMV8_ROUNDS(vsha1mq_u32, m2, k3);
+
+        ARMV8_SCHEDULE(m3, m0, m1, m2);
+        ARMV8_ROUNDS(vsha1pq_u32, m3, k4);
+        ARMV8_SCHEDULE(m0, m1, m2, m3);
+        ARMV8_ROUNDS(vsha1pq_u32, m0, k4);
+        ARMV8_SCHEDULE(m1, m2, m3, m0);
+        ARMV8_ROUNDS(vsha1pq_u32, m1, k4);
+        ARMV8_SCHEDULE(m2, m3, m0, m1);
+        ARMV8_ROUNDS(vsha1pq_u32, m2, k4);
+        ARMV8_SCHEDULE(m3, m0, m1, m2);
+        ARMV8_ROUNDS(vsha1pq_u32, m3, k4);
+
+        abcd = vaddq_u32(abcd, abcd_save);
+        e0 += e_save;
+    }
+
+    vst1q_u32(digest, abcd);
+    digest[4] = e0;
+}
+
+#endif /* SHA_ARMV8 */
+
+static sha_blocks_fn_t sha_blocks_fn;
+
+static sha_blocks_fn_t sha_blocks_get(void)
+{
+    sha_blocks_fn_t fn = sha_blocks_fn;
+
+    if (!fn) {
+        fn = sha_blocks_generic;
+#if SHA_SHANI
+        if (sha_have_shani()) {
+            fn = sha_blocks_shani;
+        }
+#elif SHA_ARMV8
+#ifdef SHA_ARMV8_HWCAP
+        if (getauxval(AT_HWCAP) & HWCAP_SHA1)
+#endif
+        {
+            fn = sha_blocks_armv8;
+        }
+#endif
+        /* concurrent first calls all store the same value */
+        sha_blocks_fn = fn;
+    }
+    return fn;
+}
+
+static void sha_put32(unsigned char *p, apr_uint32_t k)
+{
+    p[0] = (unsigned char) ((k >> 24) & 0xff);
+    p[1] = (unsigned char) ((k >> 16) & 0xff);
+    p[2] = (unsigned char) ((k >> 8) & 0xff);
+    p[3] = (unsigned char) (k & 0xff);
+}
+
+static void sha_output(unsigned char digest[APR_SHA1_DIGESTSIZE],
+                       const apr_uint32_t state[5])
+{
+    int i;
 
-static char isLittleEndian(void)
+    for (i = 0; i < 5; i++) {
+        sha_put32(digest + 4 * i, state[i]);
+    }
+}
+
+/* pad the trailing partial block of a message of len bytes, returning the
+ * number of padding blocks (one or two) */
+static apr_size_t sha_pad(unsigned char pad[2 * SHA_BLOCKSIZE],
+                          const unsigned char *data, apr_size_t len)
 {
-    static union endianTest u;
-    u.Long = 1;
-    return (u.Char[0] == 1);
+    apr_size_t rem = len % SHA_BLOCKSIZE;
+    apr_size_t end = rem < SHA_BLOCKSIZE - 8 ? SHA_BLOCKSIZE
+                                             : 2 * SHA_BLOCKSIZE;
+    apr_uint64_t bits = (apr_uint64_t) len << 3;
+
+    if (rem) {
+        memcpy(pad, data + len - rem, rem);
+    }
+    pad[rem] = 0x80;
+    memset(pad + rem + 1, 0, end - 8 - rem - 1);
+    sha_put32(pad + end - 8, (apr_uint32_t) (bits >> 32));
+    sha_put32(pad + end - 4, (apr_uint32_t) bits);
+    return end / SHA_BLOCKSIZE;
 }
 
-/* change endianness of data */
+#if SHA_X4
+
+/* the states of four digests, one per lane */
+typedef union {
+    sha_vec_t v[5];
+    apr_uint32_t w[5][4];
+} sha_state_x4_t;
+
+#define VF1(x,y,z)  VXOR(z, VAND(x, VXOR(y, z)))
+#define VF2(x,y,z)  VXOR(x, VXOR(y, z))
+#define VF3(x,y,z)  VOR(VAND(x, y), VAND(z, VOR(x, y)))
+#define VF4(x,y,z)  VXOR(x, VXOR(y, z))
+
+#define VFUNC(n,i) \
+    if (i >= 16) { \
+        W[i & 15] = VROT32(VXOR(VXOR(W[(i - 3) & 15], W[(i - 8) & 15]), \
+                                VXOR(W[(i - 14) & 15], W[i & 15])), 1); \
+    } \
+    temp = VADD(VADD(VROT32(A, 5), VF##n(B, C, D)), \
+                VADD(VADD(E, W[i & 15]), VCONST(CONST##n))); \
+    E = D; D = C; C = VROT32(B, 30); B = A; A = temp
+
+/* do SHA transformation of one block in each lane */
+static void sha_transform_x4(sha_state_x4_t *state,
+                             const unsigned char *data[4])
+{
+    union {
+        sha_vec_t v[16];
+        apr_uint32_t w[16][4];
+    } in;
+    sha_vec_t temp, A, B, C, D, E, *W = in.v;
+    int i, j;
+
+    for (i = 0; i < 16; ++i) {
+        for (j = 0; j < 4; ++j) {
+            in.w[i][j] = SHA_GET32(data[j] + 4 * i);
+        }
+    }
+    A = state->v[0];
+    B = state->v[1];
+    C = state->v[2];
+    D = state->v[3];
+    E = state->v[4];
+    for (i = 0; i < 20; ++i) {
+        VFUNC(1,i);
+    }
+    for (i = 20; i < 40; ++i) {
+        VFUNC(2,i);
+    }
+    for (i = 40; i < 60; ++i) {
+        VFUNC(3,i);
+    }
+    for (i = 60; i < 80; ++i) {
+        VFUNC(4,i);
+    }
+    state->v[0] = VADD(state->v[0], A);
+    state->v[1] = VADD(state->v[1], B);
+    state->v[2] = VADD(state->v[2], C);
+    state->v[3] = VADD(state->v[3], D);
+    state->v[4] = VADD(state->v[4], E);
+}
 
-/* count is the number of bytes to do an endian flip */
-static void maybe_byte_reverse(apr_uint32_t *buffer, int count)
+/* a message hashed in a lane of sha_transform_x4() */
+typedef struct {
+    const unsigned char *data;
+    apr_size_t nfull;           /* number of full blocks of data */
+    apr_size_t nblocks;         /* with the padding, zero if idle */
+    apr_size_t block;           /* next block to hash */
+    apr_size_t msg;             /* index of the message */
+    unsigned char pad[2 * SHA_BLOCKSIZE];
+} sha_lane_t;
+
+static void sha_lane_start(sha_lane_t *lane, sha_state_x4_t *state, int j,
+                           apr_size_t msg, const unsigned char *data,
+                           apr_size_t len)
 {
     int i;
-    apr_byte_t ct[4], *cp;
-
-    if (isLittleEndian()) { /* do the swap only if it is little endian */
-        count /= sizeof(apr_uint32_t);
-        cp = (apr_byte_t *) buffer;
-        for (i = 0; i < count; ++i) {
-            ct[0] = cp[0];
-            ct[1] = cp[1];
-            ct[2] = cp[2];
-            ct[3] = cp[3];
-            cp[0] = ct[3];
-            cp[1] = ct[2];
-            cp[2] = ct[1];
-            cp[3] = ct[0];
-            cp += sizeof(apr_uint32_t);
+
+    lane->data = data;
+    lane->nfull = len / SHA_BLOCKSIZE;
+    lane->nblocks = lane->nfull + sha_pad(lane->pad, data, len);
+    lane->block = 0;
+    lane->msg = msg;
+    for (i = 0; i < 5; i++) {
+        state->w[i][j] = sha_iv[i];
+    }
+}
+
+static const unsigned char *sha_lane_next(sha_lane_t *lane)
+{
+    apr_size_t block = lane->block++;
+
+    if (block < lane->nfull) {
+        return lane->data + block * SHA_BLOCKSIZE;
+    }
+    return lane->pad + (block - lane->nfull) * SHA_BLOCKSIZE;
+}
+
+static void sha_multi_x4(unsigned char (*digests)[APR_SHA1_DIGESTSIZE],
+                         const unsigned char * const *inputs,
+                         const apr_size_t *lens, apr_size_t n)
+{
+    static const unsigned char idle[SHA_BLOCKSIZE];
+    sha_state_x4_t state;
+    sha_lane_t lanes[4];
+    const unsigned char *data[4];
+    apr_uint32_t digest[5];
+    apr_size_t next = 0;
+    int i, j, active = 0;
+
+    for (j = 0; j < 4; j++) {
+        lanes[j].nblocks = 0;
+        if (next < n) {
+            sha_lane_start(&lanes[j], &state, j, next, inputs[next],
+                           lens[next]);
+            next++;
+            active++;
+        }
+    }
+
+    /* refill the lanes with the next messages as they finish */
+    while (active > 1) {
+        for (j = 0; j < 4; j++) {
+            data[j] = lanes[j].nblocks ? sha_lane_next(&lanes[j]) : idle;
+        }
+        sha_transform_x4(&state, data);
+        for (j = 0; j < 4; j++) {
+            if (lanes[j].nblocks && lanes[j].block == lanes[j].nblocks) {
+                for (i = 0; i < 5; i++) {
+                    digest[i] = state.w[i][j];
+                }
+                sha_output(digests[lanes[j].msg], digest);
+                if (next < n) {
+                    sha_lane_start(&lanes[j], &state, j, next, inputs[next],
+                                   lens[next]);
+                    next++;
+                }
+                else {
+                    lanes[j].nblocks = 0;
+                    active--;
+                }
+            }
+        }
+    }
+
+    /* the last message alone */
+    for (j = 0; j < 4; j++) {
+        if (lanes[j].nblocks) {
+            for (i = 0; i < 5; i++) {
+                digest[i] = state.w[i][j];
+            }
+            while (lanes[j].block < lanes[j].nblocks) {
+                sha_transform(digest, sha_lane_next(&lanes[j]));
+            }
+            sha_output(digests[lanes[j].msg], digest);
         }
     }
 }
 
+#endif /* SHA_X4 */
+
 /* initialize the SHA digest */
 
 APR_DECLARE(void) apr_sha1_init(apr_sha1_ctx_t *sha_info)
 {
-    sha_info->digest[0] = 0x67452301L;
-    sha_info->digest[1] = 0xefcdab89L;
-    sha_info->digest[2] = 0x98badcfeL;
-    sha_info->digest[3] = 0x10325476L;
-    sha_info->digest[4] = 0xc3d2e1f0L;
+    memcpy(sha_info->digest, sha_iv, sizeof(sha_iv));
     sha_info->count_lo = 0L;
     sha_info->count_hi = 0L;
     sha_info->local = 0;
@@ -221,6 +690,7 @@ APR_DECLARE(void) apr_sha1_update_binary(apr_sha1_ctx_t *sha_info,
                                      const unsigned char *buffer,
                                      unsigned int count)
 {
+    sha_blocks_fn_t sha_blocks = sha_blocks_get();
     unsigned int i;
 
     if ((sha_info->count_lo + ((apr_uint32_t) count << 3)) < sha_info->count_lo) {
@@ -238,19 +708,18 @@ APR_DECLARE(void) apr_sha1_update_binary(apr_sha1_ctx_t *sha_info,
         buffer += i;
         sha_info->local += i;
         if (sha_info->local == SHA_BLOCKSIZE) {
-            maybe_byte_reverse(sha_info->data, SHA_BLOCKSIZE);
-            sha_transform(sha_info);
+            sha_blocks(sha_info->digest, (apr_byte_t *) sha_info->data, 1);
         }
         else {
             return;
         }
     }
-    while (count >= SHA_BLOCKSIZE) {
-        memcpy(sha_info->data, buffer, SHA_BLOCKSIZE);
-        buffer += SHA_BLOCKSIZE;
-        count -= SHA_BLOCKSIZE;
-        maybe_byte_reverse(sha_info->data, SHA_BLOCKSIZE);
-        sha_transform(sha_info);
+    if (count >= SHA_BLOCKSIZE) {
+        /* straight from the buffer */
+        i = count / SHA_BLOCKSIZE;
+        sha_blocks(sha_info->digest, buffer, i);
+        buffer += i * SHA_BLOCKSIZE;
+        count -= i * SHA_BLOCKSIZE;
     }
     memcpy(sha_info->data, buffer, count);
     sha_info->local = count;
@@ -260,6 +729,7 @@ APR_DECLARE(void) apr_sha1_update(apr_sha1_ctx_t *sha_info, const char *buf,
                               unsigned int count)
 {
 #if APR_CHARSET_EBCDIC
+    sha_blocks_fn_t sha_blocks = sha_blocks_get();
     int i;
     const apr_byte_t *buffer = (const apr_byte_t *) buf;
     apr_size_t inbytes_left, outbytes_left;
@@ -283,8 +753,7 @@ APR_DECLARE(void) apr_sha1_update(apr_sha1_ctx_t *sha_info, const char *buf,
         buffer += i;
         sha_info->local += i;
         if (sha_info->local == SHA_BLOCKSIZE) {
-            maybe_byte_reverse(sha_info->data, SHA_BLOCKSIZE);
-            sha_transform(sha_info);
+            sha_blocks(sha_info->digest, (apr_byte_t *) sha_info->data, 1);
         }
         else {
             return;
@@ -296,8 +765,7 @@ APR_DECLARE(void) apr_sha1_update(apr_sha1_ctx_t *sha_info, const char *buf,
                               (apr_byte_t *) sha_info->data, &outbytes_left);
         buffer += SHA_BLOCKSIZE;
         count -= SHA_BLOCKSIZE;
-        maybe_byte_reverse(sha_info->data, SHA_BLOCKSIZE);
-        sha_transform(sha_info);
+        sha_blocks(sha_info->digest, (apr_byte_t *) sha_info->data, 1);
     }
     inbytes_left = outbytes_left = count;
     apr_xlate_conv_buffer(ebcdic2ascii_xlate, buffer, &inbytes_left,
@@ -313,37 +781,57 @@ APR_DECLARE(void) apr_sha1_update(apr_sha1_ctx_t *sha_info, const char *buf,
 APR_DECLARE(void) apr_sha1_final(unsigned char digest[APR_SHA1_DIGESTSIZE],
                              apr_sha1_ctx_t *sha_info)
 {
-    int count, i, j;
-    apr_uint32_t lo_bit_count, hi_bit_count, k;
+    sha_blocks_fn_t sha_blocks = sha_blocks_get();
+    apr_byte_t *data = (apr_byte_t *) sha_info->data;
+    int count;
+    apr_uint32_t lo_bit_count, hi_bit_count;
 
     lo_bit_count = sha_info->count_lo;
     hi_bit_count = sha_info->count_hi;
     count = (int) ((lo_bit_count >> 3) & 0x3f);
-    ((apr_byte_t *) sha_info->data)[count++] = 0x80;
+    data[count++] = 0x80;
     if (count > SHA_BLOCKSIZE - 8) {
-        memset(((apr_byte_t *) sha_info->data) + count, 0, SHA_BLOCKSIZE - count);
-        maybe_byte_reverse(sha_info->data, SHA_BLOCKSIZE);
-        sha_transform(sha_info);
-        memset((apr_byte_t *) sha_info->data, 0, SHA_BLOCKSIZE - 8);
+        memset(data + count, 0, SHA_BLOCKSIZE - count);
+        sha_blocks(sha_info->digest, data, 1);
+        memset(data, 0, SHA_BLOCKSIZE - 8);
     }
     else {
-        memset(((apr_byte_t *) sha_info->data) + count, 0,
-               SHA_BLOCKSIZE - 8 - count);
+        memset(data + count, 0, SHA_BLOCKSIZE - 8 - count);
     }
-    maybe_byte_reverse(sha_info->data, SHA_BLOCKSIZE);
-    sha_info->data[14] = hi_bit_count;
-    sha_info->data[15] = lo_bit_count;
-    sha_transform(sha_info);
+    sha_put32(data + SHA_BLOCKSIZE - 8, hi_bit_count);
+    sha_put32(data + SHA_BLOCKSIZE - 4, lo_bit_count);
+    sha_blocks(sha_info->digest, data, 1);
 
-    for (i = 0, j = 0; j < APR_SHA1_DIGESTSIZE; i++) {
-        k = sha_info->digest[i];
-        digest[j++] = (unsigned char) ((k >> 24) & 0xff);
-        digest[j++] = (unsigned char) ((k >> 16) & 0xff);
-        digest[j++] = (unsigned char) ((k >> 8) & 0xff);
-        digest[j++] = (unsigned char) (k & 0xff);
-    }
+    sha_output(digest, sha_info->digest);
 }
 
+APR_DECLARE(void) apr_sha1_multi(unsigned char (*digests)[APR_SHA1_DIGESTSIZE],
+                                 const unsigned char * const *inputs,
+                                 const apr_size_t *lens, apr_size_t n)
+{
+    sha_blocks_fn_t sha_blocks = sha_blocks_get();
+    unsigned char pad[2 * SHA_BLOCKSIZE];
+    apr_uint32_t state[5];
+    apr_size_t i, nfull, npad;
+
+#if SHA_X4
+    /* the SHA extensions are faster one message at a time */
+    if (sha_blocks == sha_blocks_generic && n > 1) {
+        sha_multi_x4(digests, inputs, lens, n);
+        return;
+    }
+#endif
+    for (i = 0; i < n; i++) {
+        memcpy(state, sha_iv, sizeof(sha_iv));
+        nfull = lens[i] / SHA_BLOCKSIZE;
+        npad = sha_pad(pad, inputs[i], lens[i]);
+        if (nfull) {
+            sha_blocks(state, inputs[i], nfull);
+        }
+        sha_blocks(state, pad, npad);
+        sha_output(digests[i], state);
+    }
+}
 
 APR_DECLARE(void) apr_sha1_base64(const char *clear, int len, char *out)
 {
@@ -360,7 +848,7 @@ APR_DECLARE(void) apr_sha1_base64(const char *clear, int len, char *out)
 
     /* SHA1 hash is always 20 chars */
     l = apr_base64_encode_binary(out + APR_SHA1PW_IDLEN, digest, sizeof(digest));
-    out[l + APR_SHA1PW_IDLEN] = '\0';
+    out[l - 1 + APR_SHA1PW_IDLEN] = '\0'; /* l counts the NUL */
 
     /*
      * output of base64 encoded SHA1 is always 28 chars + APR_SHA1PW_IDLEN
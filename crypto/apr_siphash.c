@@ -20,6 +20,15 @@
  */
 
 #include "apr_siphash.h"
+#include "apr_hash.h"
+#include "apr_atomic.h"
+#include "apr_general.h"
+#include "apr_time.h"
+#include "apr_thread_proc.h"
+
+#if APR_HAVE_STRING_H
+#include <string.h>
+#endif
 
 #define ROTL64(x, n) (((x) << (n)) | ((x) >> (64 - (n))))
 
@@ -45,7 +54,7 @@ do { \
     (p)[7] = (unsigned char)((v) >> 56); \
 } while (0)
 
-#define SIPROUND() \
+#define SIPROUND_V(v0, v1, v2, v3) \
 do { \
     v0 += v1; v1=ROTL64(v1,13); v1 ^= v0; v0=ROTL64(v0,32); \
     v2 += v3; v3=ROTL64(v3,16); v3 ^= v2; \
@@ -53,6 +62,8 @@ do { \
     v2 += v1; v1=ROTL64(v1,17); v1 ^= v2; v2=ROTL64(v2,32); \
 } while(0)
 
+#define SIPROUND() SIPROUND_V(v0, v1, v2, v3)
+
 #define SIPHASH(r, s, n, k) \
 do { \
     const unsigned char *ptr, *end; \
@@ -95,6 +106,135 @@ do { \
     r = v0 ^ v1 ^ v2 ^ v3; \
 } while (0)
 
+/*
+ * The batches hash the messages two at a time, interleaving their rounds
+ * so that the CPU can execute them in parallel, from the initial state
+ * (iv) computed once from the key.
+ */
+#define SIPHASH_IV(iv, k) \
+do { \
+    apr_uint64_t k0 = U8TO64_LE((k) + 0), k1 = U8TO64_LE((k) + 8); \
+    \
+    (iv)[0] = k0 ^ (apr_uint64_t)0x736f6d6570736575ULL; \
+    (iv)[1] = k1 ^ (apr_uint64_t)0x646f72616e646f6dULL; \
+    (iv)[2] = k0 ^ (apr_uint64_t)0x6c7967656e657261ULL; \
+    (iv)[3] = k1 ^ (apr_uint64_t)0x7465646279746573ULL; \
+} while (0)
+
+/* the last word of a message of n bytes, from its remaining bytes at p */
+#define SIPHASH_LAST(m, p, n) \
+do { \
+    m = (apr_uint64_t)((n) & 0xff) << 56; \
+    switch ((n) & 0x7) { \
+        case 7: m |= (apr_uint64_t)(p)[6] << 48; \
+        case 6: m |= (apr_uint64_t)(p)[5] << 40; \
+        case 5: m |= (apr_uint64_t)(p)[4] << 32; \
+        case 4: m |= (apr_uint64_t)(p)[3] << 24; \
+        case 3: m |= (apr_uint64_t)(p)[2] << 16; \
+        case 2: m |= (apr_uint64_t)(p)[1] << 8; \
+        case 1: m |= (apr_uint64_t)(p)[0]; \
+        case 0: break; \
+    } \
+} while (0)
+
+#define SIPHASH_WORD(v0, v1, v2, v3, m, c) \
+do { \
+    v3 ^= m; \
+    for (i = 0; i < (c); ++i) { \
+        SIPROUND_V(v0, v1, v2, v3); \
+    } \
+    v0 ^= m; \
+} while (0)
+
+#define SIPHASH_ONE(r, s, n, iv, c, d) \
+do { \
+    const unsigned char *ptr = (s), *end = ptr + ((n) & ~(apr_size_t)7); \
+    apr_uint64_t v0 = (iv)[0], v1 = (iv)[1], v2 = (iv)[2], v3 = (iv)[3]; \
+    apr_uint64_t m; \
+    \
+    for (; ptr < end; ptr += 8) { \
+        m = U8TO64_LE(ptr); \
+        SIPHASH_WORD(v0, v1, v2, v3, m, c); \
+    } \
+    SIPHASH_LAST(m, ptr, n); \
+    SIPHASH_WORD(v0, v1, v2, v3, m, c); \
+    \
+    v2 ^= 0xff; \
+    for (i = 0; i < (d); ++i) { \
+        SIPROUND(); \
+    } \
+    \
+    r = v0 ^ v1 ^ v2 ^ v3; \
+} while (0)
+
+#define SIPHASH_TWO(ra, sa, na, rb, sb, nb, iv, c, d) \
+do { \
+    const unsigned char *pa = (sa), *ea = pa + ((na) & ~(apr_size_t)7); \
+    const unsigned char *pb = (sb), *eb = pb + ((nb) & ~(apr_size_t)7); \
+    apr_uint64_t a0 = (iv)[0], a1 = (iv)[1], a2 = (iv)[2], a3 = (iv)[3]; \
+    apr_uint64_t b0 = (iv)[0], b1 = (iv)[1], b2 = (iv)[2], b3 = (iv)[3]; \
+    apr_uint64_t ma, mb; \
+    \
+    for (; pa < ea && pb < eb; pa += 8, pb += 8) { \
+        ma = U8TO64_LE(pa); \
+        mb = U8TO64_LE(pb); \
+        a3 ^= ma; \
+        b3 ^= mb; \
+        for (i = 0; i < (c); ++i) { \
+            SIPROUND_V(a0, a1, a2, a3); \
+            SIPROUND_V(b0, b1, b2, b3); \
+        } \
+        a0 ^= ma; \
+        b0 ^= mb; \
+    } \
+    for (; pa < ea; pa += 8) { \
+        ma = U8TO64_LE(pa); \
+        SIPHASH_WORD(a0, a1, a2, a3, ma, c); \
+    } \
+    for (; pb < eb; pb += 8) { \
+        mb = U8TO64_LE(pb); \
+        SIPHASH_WORD(b0, b1, b2, b3, mb, c); \
+    } \
+    SIPHASH_LAST(ma, pa, na); \
+    SIPHASH_LAST(mb, pb, nb); \
+    a3 ^= ma; \
+    b3 ^= mb; \
+    for (i = 0; i < (c); ++i) { \
+        SIPROUND_V(a0, a1, a2, a3); \
+        SIPROUND_V(b0, b1, b2, b3); \
+    } \
+    a0 ^= ma; \
+    b0 ^= mb; \
+    \
+    a2 ^= 0xff; \
+    b2 ^= 0xff; \
+    for (i = 0; i < (d); ++i) { \
+        SIPROUND_V(a0, a1, a2, a3); \
+        SIPROUND_V(b0, b1, b2, b3); \
+    } \
+    \
+    ra = a0 ^ a1 ^ a2 ^ a3; \
+    rb = b0 ^ b1 ^ b2 ^ b3; \
+} while (0)
+
+#define SIPHASH_BATCH(out, srcs, lens, n, k, c, d) \
+do { \
+    apr_uint64_t iv[4]; \
+    apr_size_t j; \
+    unsigned int i; \
+    \
+    SIPHASH_IV(iv, k); \
+    for (j = 0; j + 1 < (n); j += 2) { \
+        SIPHASH_TWO((out)[j], (const unsigned char *)(srcs)[j], (lens)[j], \
+                    (out)[j + 1], (const unsigned char *)(srcs)[j + 1], \
+                    (lens)[j + 1], iv, c, d); \
+    } \
+    if (j < (n)) { \
+        SIPHASH_ONE((out)[j], (const unsigned char *)(srcs)[j], (lens)[j], \
+                    iv, c, d); \
+    } \
+} while (0)
+
 APR_DECLARE(apr_uint64_t) apr_siphash(const void *src, apr_size_t len,
                               const unsigned char key[APR_SIPHASH_KSIZE],
                                       unsigned int c, unsigned int d)
@@ -128,6 +268,34 @@ APR_DECLARE(void) apr_siphash_auth(unsigned char out[APR_SIPHASH_DSIZE],
     U64TO8_LE(out, h);
 }
 
+APR_DECLARE(apr_uint64_t) apr_siphash13(const void *src, apr_size_t len,
+                               const unsigned char key[APR_SIPHASH_KSIZE])
+{
+    apr_uint64_t h;
+
+#undef  cROUNDS
+#define cROUNDS \
+        SIPROUND();
+
+#undef  dROUNDS
+#define dROUNDS \
+        SIPROUND(); \
+        SIPROUND(); \
+        SIPROUND();
+
+    SIPHASH(h, src, len, key);
+    return h;
+}
+
+APR_DECLARE(void) apr_siphash13_auth(unsigned char out[APR_SIPHASH_DSIZE],
+                                     const void *src, apr_size_t len,
+                               const unsigned char key[APR_SIPHASH_KSIZE])
+{
+    apr_uint64_t h;
+    h = apr_siphash13(src, len, key);
+    U64TO8_LE(out, h);
+}
+
 APR_DECLARE(apr_uint64_t) apr_siphash24(const void *src, apr_size_t len,
                                const unsigned char key[APR_SIPHASH_KSIZE])
 {
@@ -194,3 +362,78 @@ APR_DECLARE(void) apr_siphash48_auth(unsigned char out[APR_SIPHASH_DSIZE],
     U64TO8_LE(out, h);
 }
 
+
+APR_DECLARE(void) apr_siphash_batch(apr_uint64_t *out,
+                                    const void * const *srcs,
+                                    const apr_size_t *lens, apr_size_t n,
+                              const unsigned char key[APR_SIPHASH_KSIZE],
+                                    unsigned int c, unsigned int d)
+{
+    SIPHASH_BATCH(out, srcs, lens, n, key, c, d);
+}
+
+APR_DECLARE(void) apr_siphash13_batch(apr_uint64_t *out,
+                                      const void * const *srcs,
+                                      const apr_size_t *lens, apr_size_t n,
+                               const unsigned char key[APR_SIPHASH_KSIZE])
+{
+    SIPHASH_BATCH(out, srcs, lens, n, key, 1, 3);
+}
+
+APR_DECLARE(void) apr_siphash24_batch(apr_uint64_t *out,
+                                      const void * const *srcs,
+                                      const apr_size_t *lens, apr_size_t n,
+                               const unsigned char key[APR_SIPHASH_KSIZE])
+{
+    SIPHASH_BATCH(out, srcs, lens, n, key, 2, 4);
+}
+
+/* The initial state of apr_siphash13_hashfunc(), from a key chosen once */
+static apr_uint64_t hashfunc_iv[4];
+static volatile apr_uint32_t hashfunc_ready; /* 0: no key, 1: choosing, 2 */
+
+static void hashfunc_init(void)
+{
+    unsigned char key[APR_SIPHASH_KSIZE];
+
+    if (apr_atomic_cas32(&hashfunc_ready, 1, 0) == 0) {
+#if APR_HAS_RANDOM
+        if (apr_generate_random_bytes(key, sizeof(key)) != APR_SUCCESS)
+#endif
+        {
+            apr_uint64_t k0, k1;
+
+            k0 = (apr_uint64_t)apr_time_now() ^ (apr_uintptr_t)key;
+            k1 = (k0 * 0x9e3779b97f4a7c15ULL) ^ (apr_uintptr_t)hashfunc_iv;
+            U64TO8_LE(key, k0);
+            U64TO8_LE(key + 8, k1);
+        }
+        SIPHASH_IV(hashfunc_iv, key);
+        apr_atomic_set32(&hashfunc_ready, 2);
+    }
+    else {
+        /* wait for the thread choosing it */
+        while (apr_atomic_read32(&hashfunc_ready) != 2) {
+#if APR_HAS_THREADS
+            apr_thread_yield();
+#endif
+        }
+    }
+}
+
+APR_DECLARE_NONSTD(unsigned int) apr_siphash13_hashfunc(const char *key,
+                                                        apr_ssize_t *klen)
+{
+    apr_uint64_t h;
+    unsigned int i;
+
+    if (apr_atomic_read32(&hashfunc_ready) != 2) {
+        hashfunc_init();
+    }
+    if (*klen == APR_HASH_KEY_STRING) {
+        *klen = strlen(key);
+    }
+    SIPHASH_ONE(h, (const unsigned char *)key, (apr_size_t)*klen,
+                hashfunc_iv, 1, 3);
+    return (unsigned int)(h ^ (h >> 32));
+}
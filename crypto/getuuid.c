@@ -17,12 +17,17 @@
 /*
  * This attempts to generate V1 UUIDs according to the Internet Draft
  * located at http://www.webdav.org/specs/draft-leach-uuids-guids-01.txt
+ *
+ * apr_uuid_get_ex() generates V4 and V7 UUIDs according to RFC 9562.
  */
 #include "apr.h"
 #include "apr_uuid.h"
 #include "apr_md5.h"
 #include "apr_general.h"
 #include "apr_portable.h"
+#include "apr_thread_proc.h"
+#include "apr_atomic.h"
+#include "apr_time.h"
 
 
 #if APR_HAVE_UNISTD_H
@@ -206,3 +211,217 @@ APR_DECLARE(void) apr_uuid_get(apr_uuid_t *uuid)
     /* node, byte[6] */
     memcpy(&d[10], uuid_state_node, NODE_LENGTH);
 }
+
+#if APR_HAS_RANDOM
+
+/* Random bytes are taken from a buffer refilled by batches, so that
+ * apr_generate_random_bytes() is not called for each UUID.
+ */
+#define UUID_RANDOM_SIZE 256
+
+/* The V7 UUIDs embed a 42 bits counter (rand_a and the high bits of
+ * rand_b, i.e. "Fixed Bit-Length Dedicated Counter" in RFC 9562) which
+ * is seeded with 41 random bits for each new millisecond, leaving room
+ * for at least 2^41 increments before the timestamp has to be bumped.
+ */
+#define UUID_COUNTER_BITS 42
+#define UUID_COUNTER_MAX ((APR_UINT64_C(1) << UUID_COUNTER_BITS) - 1)
+
+typedef struct {
+    apr_uint64_t last_ms;
+    apr_uint64_t counter;
+    apr_size_t avail;
+    unsigned char random[UUID_RANDOM_SIZE];
+} uuid_state_t;
+
+#if !APR_HAS_THREADS || APR_HAS_THREAD_LOCAL
+/* No locking needed with a state per thread. */
+#if APR_HAS_THREADS
+static APR_THREAD_LOCAL uuid_state_t uuid_state;
+#else
+static uuid_state_t uuid_state;
+#endif
+#define uuid_state_lock()   (&uuid_state)
+#define uuid_state_unlock()
+#define uuid_state_reset()  memset(&uuid_state, 0, sizeof(uuid_state))
+#else
+static uuid_state_t uuid_state;
+static volatile apr_uint32_t uuid_state_locked = 0;
+
+static uuid_state_t *uuid_state_lock(void)
+{
+    while (apr_atomic_cas32(&uuid_state_locked, 1, 0)) {
+        apr_thread_yield();
+    }
+    return &uuid_state;
+}
+
+#define uuid_state_unlock() apr_atomic_set32(&uuid_state_locked, 0)
+
+/* In a forked child, the lock may have been held by a thread of the parent
+ * which does not exist anymore, so don't wait for it.
+ */
+static void uuid_state_reset(void)
+{
+    memset(&uuid_state, 0, sizeof(uuid_state));
+    apr_atomic_set32(&uuid_state_locked, 0);
+}
+#endif
+
+static apr_status_t uuid_random(uuid_state_t *st, unsigned char *buf,
+                                apr_size_t len)
+{
+    if (st->avail < len) {
+        apr_status_t rv = apr_generate_random_bytes(st->random,
+                                                    UUID_RANDOM_SIZE);
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+        st->avail = UUID_RANDOM_SIZE;
+    }
+    memcpy(buf, st->random + UUID_RANDOM_SIZE - st->avail, len);
+    st->avail -= len;
+    return APR_SUCCESS;
+}
+
+static apr_status_t uuid_v4(uuid_state_t *st, unsigned char *d)
+{
+    apr_status_t rv = uuid_random(st, d, 16);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+    d[6] = (d[6] & 0x0F) | 0x40;
+    d[8] = (d[8] & 0x3F) | 0x80;
+    return APR_SUCCESS;
+}
+
+static apr_status_t uuid_v7(uuid_state_t *st, unsigned char *d,
+                            apr_uint64_t now_ms)
+{
+    apr_uint64_t ms, counter;
+    apr_status_t rv;
+
+    if (now_ms > st->last_ms) {
+        unsigned char seed[6];
+        rv = uuid_random(st, seed, sizeof(seed));
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+        st->counter = (((apr_uint64_t)seed[0] << 40) |
+                       ((apr_uint64_t)seed[1] << 32) |
+                       ((apr_uint64_t)seed[2] << 24) |
+                       ((apr_uint64_t)seed[3] << 16) |
+                       ((apr_uint64_t)seed[4] << 8) |
+                       (apr_uint64_t)seed[5]) >> (48 - UUID_COUNTER_BITS + 1);
+        st->last_ms = now_ms;
+    }
+    else if (st->counter < UUID_COUNTER_MAX) {
+        /* Same millisecond, or the clock went backward */
+        st->counter++;
+    }
+    else {
+        /* Counter exhausted, borrow the next millisecond */
+        st->counter = 0;
+        st->last_ms++;
+    }
+
+    /* the low 32 bits of rand_b are random */
+    rv = uuid_random(st, d + 12, 4);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+
+    ms = st->last_ms;
+    counter = st->counter;
+    /* unix_ts_ms, uint48 */
+    d[0] = (unsigned char)(ms >> 40);
+    d[1] = (unsigned char)(ms >> 32);
+    d[2] = (unsigned char)(ms >> 24);
+    d[3] = (unsigned char)(ms >> 16);
+    d[4] = (unsigned char)(ms >> 8);
+    d[5] = (unsigned char)ms;
+    /* ver and rand_a, the high 12 bits of the counter */
+    d[6] = (unsigned char)(((counter >> 38) & 0x0F) | 0x70);
+    d[7] = (unsigned char)(counter >> 30);
+    /* var and the high 30 bits of rand_b, the low bits of the counter */
+    d[8] = (unsigned char)(((counter >> 24) & 0x3F) | 0x80);
+    d[9] = (unsigned char)(counter >> 16);
+    d[10] = (unsigned char)(counter >> 8);
+    d[11] = (unsigned char)counter;
+
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_uuid_get_ex(apr_uuid_t *uuid, int version)
+{
+    return apr_uuid_get_bulk(uuid, 1, version);
+}
+
+APR_DECLARE(apr_status_t) apr_uuid_get_bulk(apr_uuid_t *uuids, apr_size_t n,
+                                            int version)
+{
+    apr_status_t rv = APR_SUCCESS;
+    uuid_state_t *st;
+    apr_uint64_t now_ms;
+    apr_size_t i;
+
+    switch (version) {
+    case APR_UUID_V4:
+        if (n * 16 > UUID_RANDOM_SIZE) {
+            /* Big enough to not go through the buffer */
+            rv = apr_generate_random_bytes(uuids[0].data, n * 16);
+            if (rv != APR_SUCCESS) {
+                return rv;
+            }
+            for (i = 0; i < n; i++) {
+                unsigned char *d = uuids[i].data;
+                d[6] = (d[6] & 0x0F) | 0x40;
+                d[8] = (d[8] & 0x3F) | 0x80;
+            }
+            return APR_SUCCESS;
+        }
+        st = uuid_state_lock();
+        for (i = 0; i < n && rv == APR_SUCCESS; i++) {
+            rv = uuid_v4(st, uuids[i].data);
+        }
+        uuid_state_unlock();
+        return rv;
+
+    case APR_UUID_V7:
+        now_ms = (apr_uint64_t)apr_time_as_msec(apr_time_now());
+        st = uuid_state_lock();
+        for (i = 0; i < n && rv == APR_SUCCESS; i++) {
+            rv = uuid_v7(st, uuids[i].data, now_ms);
+        }
+        uuid_state_unlock();
+        return rv;
+
+    default:
+        return APR_ENOTIMPL;
+    }
+}
+
+APR_DECLARE(void) apr_uuid_after_fork(void)
+{
+    /* Only the calling thread exists in the child, forget its state */
+    uuid_state_reset();
+}
+
+#else /* !APR_HAS_RANDOM */
+
+APR_DECLARE(apr_status_t) apr_uuid_get_ex(apr_uuid_t *uuid, int version)
+{
+    return APR_ENOTIMPL;
+}
+
+APR_DECLARE(apr_status_t) apr_uuid_get_bulk(apr_uuid_t *uuids, apr_size_t n,
+                                            int version)
+{
+    return APR_ENOTIMPL;
+}
+
+APR_DECLARE(void) apr_uuid_after_fork(void)
+{
+}
+
+#endif /* APR_HAS_RANDOM */
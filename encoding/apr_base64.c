@@ -21,6 +21,7 @@
  */
 
 #include "apr_base64.h"
+#include "apr_encode.h"
 #if APR_CHARSET_EBCDIC
 #include "apr_xlate.h"
 #endif                /* APR_CHARSET_EBCDIC */
@@ -214,8 +215,10 @@ APR_DECLARE(char *) apr_pbase64_decode(apr_pool_t *p, const char *bufcoded)
     return decoded;
 }
 
+#if APR_CHARSET_EBCDIC
 static const char basis_64[] =
     "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+#endif /*APR_CHARSET_EBCDIC*/
 
 APR_DECLARE(int) apr_base64_encode_len(int len)
 {
@@ -268,36 +271,19 @@ APR_DECLARE(int) apr_base64_encode(char *encoded, const char *string, int len)
 APR_DECLARE(int) apr_base64_encode_binary(char *encoded,
                                       const unsigned char *string, int len)
 {
-    int i;
-    char *p;
+    apr_size_t dlen = 0;
+    apr_status_t rv;
 
     APR__ASSERT(len >= 0 && len <= APR_BASE64_ENCODE_MAX);
 
-    p = encoded;
-    for (i = 0; i < len - 2; i += 3) {
-        *p++ = basis_64[(string[i] >> 2) & 0x3F];
-        *p++ = basis_64[((string[i] & 0x3) << 4) |
-            ((int) (string[i + 1] & 0xF0) >> 4)];
-        *p++ = basis_64[((string[i + 1] & 0xF) << 2) |
-            ((int) (string[i + 2] & 0xC0) >> 6)];
-        *p++ = basis_64[string[i + 2] & 0x3F];
-    }
-    if (i < len) {
-        *p++ = basis_64[(string[i] >> 2) & 0x3F];
-        if (i == (len - 1)) {
-            *p++ = basis_64[((string[i] & 0x3) << 4)];
-            *p++ = '=';
-        }
-        else {
-            *p++ = basis_64[((string[i] & 0x3) << 4) |
-                ((int) (string[i + 1] & 0xF0) >> 4)];
-            *p++ = basis_64[((string[i + 1] & 0xF) << 2)];
-        }
-        *p++ = '=';
-    }
+    /* same alphabet and padding, with the vectorized encoder if any, which
+     * fails only for the NULL strings not allowed here
+     */
+    rv = apr_encode_base64_binary(encoded, string, len, APR_ENCODE_NONE,
+                                  &dlen);
+    APR__ASSERT(rv == APR_SUCCESS);
 
-    *p++ = '\0';
-    return (unsigned int)(p - encoded);
+    return (int)dlen + 1;
 }
 
 APR_DECLARE(char *) apr_pbase64_encode(apr_pool_t *p, const char *string)
@@ -208,6 +208,296 @@ static const char base32hex[] =
 static const char base16[] = "0123456789ABCDEF";
 static const char base16lower[] = "0123456789abcdef";
 
+/*
+ * With SSE2 or NEON, base64 is encoded and decoded by blocks of 12 bytes
+ * and 16 characters (48 bytes and 64 characters with NEON), the remaining
+ * bytes or the characters following an invalid one being left to the
+ * table-driven loops.  The alphabets are computed rather than looked up,
+ * which is only valid for ASCII.
+ */
+#if !APR_CHARSET_EBCDIC
+#if defined(__SSE2__) || defined(_M_X64) \
+    || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define ENCODE_SSE2 1
+#define ENCODE_NEON 0
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define ENCODE_SSE2 0
+#define ENCODE_NEON 1
+#endif
+#endif /* !APR_CHARSET_EBCDIC */
+#ifndef ENCODE_SSE2
+#define ENCODE_SSE2 0
+#define ENCODE_NEON 0
+#endif
+
+#if ENCODE_SSE2
+
+/* Encode the first bytes of src, returning how many were encoded (a multiple
+ * of 12, with at least 4 bytes left to read after the last block).
+ */
+static apr_size_t base64_encode_simd(char *dest, const unsigned char *src,
+                                     apr_size_t count, const char *base)
+{
+    const __m128i mask_c0 = _mm_set1_epi32(0x0000003F);
+    const __m128i mask_c1a = _mm_set1_epi32(0x00003000);
+    const __m128i mask_c1b = _mm_set1_epi32(0x00000F00);
+    const __m128i mask_c2a = _mm_set1_epi32(0x003C0000);
+    const __m128i mask_c2b = _mm_set1_epi32(0x00030000);
+    const __m128i mask_c3 = _mm_set1_epi32(0x3F000000);
+    const __m128i is_25 = _mm_set1_epi8(25);
+    const __m128i is_51 = _mm_set1_epi8(51);
+    const __m128i is_62 = _mm_set1_epi8(62);
+    const __m128i is_63 = _mm_set1_epi8(63);
+    const __m128i off_upper = _mm_set1_epi8('A');
+    const __m128i off_lower = _mm_set1_epi8('a' - 26 - 'A');
+    const __m128i off_digit = _mm_set1_epi8('0' - 52 - ('a' - 26));
+    const __m128i off_62 = _mm_set1_epi8((char)(base[62] - 62 - ('0' - 52)));
+    const __m128i off_63 = _mm_set1_epi8((char)(base[63] - 63 - ('0' - 52)));
+    apr_size_t i = 0;
+
+    while (count - i >= 16) {
+        __m128i v, x, idx, off;
+
+        /* one triplet per 32 bits lane, as b0 | b1 << 8 | b2 << 16 */
+        v = _mm_loadu_si128((const __m128i *)(src + i));
+        x = _mm_unpacklo_epi64(_mm_unpacklo_epi32(v, _mm_srli_si128(v, 3)),
+                               _mm_unpacklo_epi32(_mm_srli_si128(v, 6),
+                                                  _mm_srli_si128(v, 9)));
+
+        /* the four sextets of each triplet, one per byte */
+        idx = _mm_and_si128(_mm_srli_epi32(x, 2), mask_c0);
+        idx = _mm_or_si128(idx, _mm_and_si128(_mm_slli_epi32(x, 12),
+                                              mask_c1a));
+        idx = _mm_or_si128(idx, _mm_and_si128(_mm_srli_epi32(x, 4),
+                                              mask_c1b));
+        idx = _mm_or_si128(idx, _mm_and_si128(_mm_slli_epi32(x, 10),
+                                              mask_c2a));
+        idx = _mm_or_si128(idx, _mm_and_si128(_mm_srli_epi32(x, 6),
+                                              mask_c2b));
+        idx = _mm_or_si128(idx, _mm_and_si128(_mm_slli_epi32(x, 8),
+                                              mask_c3));
+
+        /* the offset from the sextet to its character, by range */
+        off = _mm_add_epi8(off_upper,
+                           _mm_and_si128(_mm_cmpgt_epi8(idx, is_25),
+                                         off_lower));
+        off = _mm_add_epi8(off, _mm_and_si128(_mm_cmpgt_epi8(idx, is_51),
+                                              off_digit));
+        off = _mm_add_epi8(off, _mm_and_si128(_mm_cmpeq_epi8(idx, is_62),
+                                              off_62));
+        off = _mm_add_epi8(off, _mm_and_si128(_mm_cmpeq_epi8(idx, is_63),
+                                              off_63));
+
+        _mm_storeu_si128((__m128i *)dest, _mm_add_epi8(idx, off));
+        dest += 16;
+        i += 12;
+    }
+
+    return i;
+}
+
+/* Return the sextets of the 16 characters of c, and in valid whether each
+ * character is in either base64 or base64url alphabet.
+ */
+static APR_INLINE __m128i base64_sextets(__m128i c, __m128i *valid)
+{
+    const __m128i upper = _mm_and_si128(
+            _mm_cmpgt_epi8(c, _mm_set1_epi8('A' - 1)),
+            _mm_cmplt_epi8(c, _mm_set1_epi8('Z' + 1)));
+    const __m128i lower = _mm_and_si128(
+            _mm_cmpgt_epi8(c, _mm_set1_epi8('a' - 1)),
+            _mm_cmplt_epi8(c, _mm_set1_epi8('z' + 1)));
+    const __m128i digit = _mm_and_si128(
+            _mm_cmpgt_epi8(c, _mm_set1_epi8('0' - 1)),
+            _mm_cmplt_epi8(c, _mm_set1_epi8('9' + 1)));
+    const __m128i c62 = _mm_or_si128(_mm_cmpeq_epi8(c, _mm_set1_epi8('+')),
+                                     _mm_cmpeq_epi8(c, _mm_set1_epi8('-')));
+    const __m128i c63 = _mm_or_si128(_mm_cmpeq_epi8(c, _mm_set1_epi8('/')),
+                                     _mm_cmpeq_epi8(c, _mm_set1_epi8('_')));
+    __m128i s;
+
+    *valid = _mm_or_si128(_mm_or_si128(upper, lower),
+                          _mm_or_si128(_mm_or_si128(digit, c62), c63));
+
+    s = _mm_and_si128(upper, _mm_sub_epi8(c, _mm_set1_epi8('A')));
+    s = _mm_or_si128(s, _mm_and_si128(lower,
+                        _mm_sub_epi8(c, _mm_set1_epi8('a' - 26))));
+    s = _mm_or_si128(s, _mm_and_si128(digit,
+                        _mm_sub_epi8(c, _mm_set1_epi8('0' - 52))));
+    s = _mm_or_si128(s, _mm_and_si128(c62, _mm_set1_epi8(62)));
+    s = _mm_or_si128(s, _mm_and_si128(c63, _mm_set1_epi8(63)));
+    return s;
+}
+
+/* Decode (if dest is not NULL) the first characters of src up to the first
+ * block containing an invalid character, returning how many were decoded (a
+ * multiple of 16).
+ */
+static apr_size_t base64_decode_simd(unsigned char *dest,
+                                     const unsigned char *src,
+                                     apr_size_t count)
+{
+    const __m128i mask_o0a = _mm_set1_epi32(0x000000FC);
+    const __m128i mask_o0b = _mm_set1_epi32(0x00000003);
+    const __m128i mask_o1a = _mm_set1_epi32(0x0000F000);
+    const __m128i mask_o1b = _mm_set1_epi32(0x00000F00);
+    const __m128i mask_o2a = _mm_set1_epi32(0x00C00000);
+    const __m128i mask_o2b = _mm_set1_epi32(0x003F0000);
+    const __m128i mask_lo = _mm_set_epi32(0, 0x00FFFFFF, 0, 0x00FFFFFF);
+    const __m128i mask_hi = _mm_set_epi32(0x0000FFFF, (int)0xFF000000,
+                                          0x0000FFFF, (int)0xFF000000);
+    apr_size_t i = 0;
+
+    while (count - i >= 16) {
+        __m128i s, valid, x, q;
+        int last;
+
+        s = base64_sextets(_mm_loadu_si128((const __m128i *)(src + i)),
+                           &valid);
+        if (_mm_movemask_epi8(valid) != 0xFFFF) {
+            break;
+        }
+        i += 16;
+        if (!dest) {
+            continue;
+        }
+
+        /* the three bytes of each quadruplet in the low 24 bits lane */
+        x = _mm_and_si128(_mm_slli_epi32(s, 2), mask_o0a);
+        x = _mm_or_si128(x, _mm_and_si128(_mm_srli_epi32(s, 12), mask_o0b));
+        x = _mm_or_si128(x, _mm_and_si128(_mm_slli_epi32(s, 4), mask_o1a));
+        x = _mm_or_si128(x, _mm_and_si128(_mm_srli_epi32(s, 10), mask_o1b));
+        x = _mm_or_si128(x, _mm_and_si128(_mm_slli_epi32(s, 6), mask_o2a));
+        x = _mm_or_si128(x, _mm_and_si128(_mm_srli_epi32(s, 8), mask_o2b));
+
+        /* packed to 6 bytes per 64 bits lane, then to 12 bytes */
+        q = _mm_or_si128(_mm_and_si128(x, mask_lo),
+                         _mm_and_si128(_mm_srli_epi64(x, 8), mask_hi));
+        q = _mm_or_si128(_mm_move_epi64(q),
+                         _mm_slli_si128(_mm_srli_si128(q, 8), 6));
+
+        _mm_storel_epi64((__m128i *)dest, q);
+        last = _mm_cvtsi128_si32(_mm_srli_si128(q, 8));
+        memcpy(dest + 8, &last, 4);
+        dest += 12;
+    }
+
+    return i;
+}
+
+#elif ENCODE_NEON
+
+/* Encode the first bytes of src, returning how many were encoded (a multiple
+ * of 48).
+ */
+static apr_size_t base64_encode_simd(char *dest, const unsigned char *src,
+                                     apr_size_t count, const char *base)
+{
+    const uint8x16_t mask = vdupq_n_u8(0x3F);
+    uint8x16x4_t table;
+    apr_size_t i = 0;
+
+    table.val[0] = vld1q_u8((const uint8_t *)base);
+    table.val[1] = vld1q_u8((const uint8_t *)base + 16);
+    table.val[2] = vld1q_u8((const uint8_t *)base + 32);
+    table.val[3] = vld1q_u8((const uint8_t *)base + 48);
+
+    while (count - i >= 48) {
+        uint8x16x3_t in = vld3q_u8(src + i);
+        uint8x16x4_t out;
+
+        out.val[0] = vshrq_n_u8(in.val[0], 2);
+        out.val[1] = vandq_u8(vorrq_u8(vshlq_n_u8(in.val[0], 4),
+                                       vshrq_n_u8(in.val[1], 4)), mask);
+        out.val[2] = vandq_u8(vorrq_u8(vshlq_n_u8(in.val[1], 2),
+                                       vshrq_n_u8(in.val[2], 6)), mask);
+        out.val[3] = vandq_u8(in.val[2], mask);
+
+        out.val[0] = vqtbl4q_u8(table, out.val[0]);
+        out.val[1] = vqtbl4q_u8(table, out.val[1]);
+        out.val[2] = vqtbl4q_u8(table, out.val[2]);
+        out.val[3] = vqtbl4q_u8(table, out.val[3]);
+
+        vst4q_u8((uint8_t *)dest, out);
+        dest += 64;
+        i += 48;
+    }
+
+    return i;
+}
+
+/* Return the sextets of the 16 characters of c, and in valid whether each
+ * character is in either base64 or base64url alphabet.
+ */
+static APR_INLINE uint8x16_t base64_sextets(uint8x16_t c, uint8x16_t *valid)
+{
+    const uint8x16_t upper = vandq_u8(vcgeq_u8(c, vdupq_n_u8('A')),
+                                      vcleq_u8(c, vdupq_n_u8('Z')));
+    const uint8x16_t lower = vandq_u8(vcgeq_u8(c, vdupq_n_u8('a')),
+                                      vcleq_u8(c, vdupq_n_u8('z')));
+    const uint8x16_t digit = vandq_u8(vcgeq_u8(c, vdupq_n_u8('0')),
+                                      vcleq_u8(c, vdupq_n_u8('9')));
+    const uint8x16_t c62 = vorrq_u8(vceqq_u8(c, vdupq_n_u8('+')),
+                                    vceqq_u8(c, vdupq_n_u8('-')));
+    const uint8x16_t c63 = vorrq_u8(vceqq_u8(c, vdupq_n_u8('/')),
+                                    vceqq_u8(c, vdupq_n_u8('_')));
+    uint8x16_t s;
+
+    *valid = vandq_u8(*valid, vorrq_u8(vorrq_u8(upper, lower),
+                                       vorrq_u8(vorrq_u8(digit, c62), c63)));
+
+    s = vandq_u8(upper, vsubq_u8(c, vdupq_n_u8('A')));
+    s = vorrq_u8(s, vandq_u8(lower, vsubq_u8(c, vdupq_n_u8('a' - 26))));
+    s = vorrq_u8(s, vandq_u8(digit, vaddq_u8(c, vdupq_n_u8(52 - '0'))));
+    s = vorrq_u8(s, vandq_u8(c62, vdupq_n_u8(62)));
+    s = vorrq_u8(s, vandq_u8(c63, vdupq_n_u8(63)));
+    return s;
+}
+
+/* Decode (if dest is not NULL) the first characters of src up to the first
+ * block containing an invalid character, returning how many were decoded (a
+ * multiple of 64).
+ */
+static apr_size_t base64_decode_simd(unsigned char *dest,
+                                     const unsigned char *src,
+                                     apr_size_t count)
+{
+    apr_size_t i = 0;
+
+    while (count - i >= 64) {
+        uint8x16x4_t in = vld4q_u8(src + i);
+        uint8x16_t valid = vdupq_n_u8(0xFF);
+        uint8x16x3_t out;
+
+        in.val[0] = base64_sextets(in.val[0], &valid);
+        in.val[1] = base64_sextets(in.val[1], &valid);
+        in.val[2] = base64_sextets(in.val[2], &valid);
+        in.val[3] = base64_sextets(in.val[3], &valid);
+        if (vminvq_u8(valid) != 0xFF) {
+            break;
+        }
+        i += 64;
+        if (!dest) {
+            continue;
+        }
+
+        out.val[0] = vorrq_u8(vshlq_n_u8(in.val[0], 2),
+                              vshrq_n_u8(in.val[1], 4));
+        out.val[1] = vorrq_u8(vshlq_n_u8(in.val[1], 4),
+                              vshrq_n_u8(in.val[2], 2));
+        out.val[2] = vorrq_u8(vshlq_n_u8(in.val[2], 6), in.val[3]);
+
+        vst3q_u8(dest, out);
+        dest += 48;
+    }
+
+    return i;
+}
+
+#endif /* ENCODE_NEON */
+
 APR_DECLARE(apr_status_t) apr_encode_base64(char *dest, const char *src,
                               apr_ssize_t slen, int flags, apr_size_t * len)
 {
@@ -233,6 +523,11 @@ APR_DECLARE(apr_status_t) apr_encode_base64(char *dest, const char *src,
             base = base64url;
         }
 
+#if ENCODE_SSE2 || ENCODE_NEON
+        i = base64_encode_simd(bufout, (const unsigned char *)src, count,
+                               base);
+        bufout += i / 3 * 4;
+#endif
         if (count > 2) {
             for (; i < count - 2; i += 3) {
                 *bufout++ = base[(TO_ASCII(src[i]) >> 2) & 0x3F];
@@ -299,6 +594,10 @@ APR_DECLARE(apr_status_t) apr_encode_base64_binary(char *dest, const unsigned ch
             base = base64url;
         }
 
+#if ENCODE_SSE2 || ENCODE_NEON
+        i = base64_encode_simd(bufout, src, count, base);
+        bufout += i / 3 * 4;
+#endif
         if (count > 2) {
             for (; i < count - 2; i += 3) {
                 *bufout++ = base[(src[i] >> 2) & 0x3F];
@@ -408,8 +707,14 @@ APR_DECLARE(apr_status_t) apr_decode_base64(char *dest, const char *src,
 
     if (src) {
         const unsigned char *bufin;
+        apr_size_t done = 0;
 
         bufin = (const unsigned char *)src;
+#if ENCODE_SSE2 || ENCODE_NEON
+        done = base64_decode_simd((unsigned char *)dest, bufin, count);
+        bufin += done;
+        count -= done;
+#endif
         while (count) {
             if (pr2six[*bufin] >= 64) {
                 if (!(flags & APR_ENCODE_RELAXED)) {
@@ -433,8 +738,9 @@ APR_DECLARE(apr_status_t) apr_decode_base64(char *dest, const char *src,
         if (dest) {
             unsigned char *bufout;
 
-            bufout = (unsigned char *)dest;
-            bufin = (const unsigned char *)src;
+            bufout = (unsigned char *)dest + done / 4 * 3;
+            bufin = (const unsigned char *)src + done;
+            count -= done;
 
             while (count >= 4) {
                 *(bufout++) = TO_NATIVE(pr2six[bufin[0]] << 2 |
@@ -500,8 +806,14 @@ APR_DECLARE(apr_status_t) apr_decode_base64_binary(unsigned char *dest,
 
     if (src) {
         const unsigned char *bufin;
+        apr_size_t done = 0;
 
         bufin = (const unsigned char *)src;
+#if ENCODE_SSE2 || ENCODE_NEON
+        done = base64_decode_simd((unsigned char *)dest, bufin, count);
+        bufin += done;
+        count -= done;
+#endif
         while (count) {
             if (pr2six[*bufin] >= 64) {
                 if (!(flags & APR_ENCODE_RELAXED)) {
@@ -525,8 +837,9 @@ APR_DECLARE(apr_status_t) apr_decode_base64_binary(unsigned char *dest,
         if (dest) {
             unsigned char *bufout;
 
-            bufout = (unsigned char *)dest;
-            bufin = (const unsigned char *)src;
+            bufout = (unsigned char *)dest + done / 4 * 3;
+            bufin = (const unsigned char *)src + done;
+            count -= done;
 
             while (count >= 4) {
                 *(bufout++) = (pr2six[bufin[0]] << 2 |
@@ -1575,3 +1888,276 @@ APR_DECLARE(const unsigned char *)apr_pdecode_base16_binary(apr_pool_t * p,
 
     return NULL;
 }
+
+/*
+ * Streaming encoding and decoding.
+ *
+ * The characters carry 6, 5 or 4 bits for base64, base32 and base16, which
+ * are shifted in and out of an accumulator to or from the bytes, so the
+ * input can be split anywhere.  The whole blocks of base64 go through the
+ * vectorized kernels when aligned on a group.
+ */
+struct apr_encode_ctx_t {
+    /* the alphabet when encoding */
+    const char *base;
+    /* the reverse alphabet when decoding */
+    const unsigned char *pr2;
+    /* the bits not output yet, in the low nbits */
+    apr_uint32_t acc;
+    int nbits;
+    /* the bits per character, and characters per group */
+    int bits;
+    int group;
+    int flags;
+    /* the characters output (encoding) or decoded (decoding) */
+    apr_size_t count;
+    /* decoding: the padding characters met, or -1 once stopped */
+    int padding;
+    apr_status_t status;
+};
+
+static apr_encode_ctx_t *encode_ctx_make(apr_pool_t *p, const char *base,
+                                         const unsigned char *pr2, int bits,
+                                         int group, int flags)
+{
+    apr_encode_ctx_t *ctx = apr_pcalloc(p, sizeof(*ctx));
+
+    ctx->base = base;
+    ctx->pr2 = pr2;
+    ctx->bits = bits;
+    ctx->group = group;
+    ctx->flags = flags;
+    ctx->status = APR_SUCCESS;
+
+    return ctx;
+}
+
+APR_DECLARE(apr_status_t) apr_encode_base64_init(apr_encode_ctx_t **ctx,
+                              int flags, apr_pool_t *p)
+{
+    *ctx = encode_ctx_make(p, (flags & APR_ENCODE_BASE64URL) ? base64url
+                                                             : base64,
+                           NULL, 6, 4, flags);
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_encode_base32_init(apr_encode_ctx_t **ctx,
+                              int flags, apr_pool_t *p)
+{
+    *ctx = encode_ctx_make(p, (flags & APR_ENCODE_BASE32HEX) ? base32hex
+                                                             : base32,
+                           NULL, 5, 8, flags);
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_encode_base16_init(apr_encode_ctx_t **ctx,
+                              int flags, apr_pool_t *p)
+{
+    *ctx = encode_ctx_make(p, (flags & APR_ENCODE_LOWER) ? base16lower
+                                                         : base16,
+                           NULL, 4, 2, flags);
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_decode_base64_init(apr_encode_ctx_t **ctx,
+                              int flags, apr_pool_t *p)
+{
+    *ctx = encode_ctx_make(p, NULL, pr2six, 6, 4, flags);
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_decode_base32_init(apr_encode_ctx_t **ctx,
+                              int flags, apr_pool_t *p)
+{
+    *ctx = encode_ctx_make(p, NULL, (flags & APR_ENCODE_BASE32HEX)
+                                    ? pr2fivehex : pr2five,
+                           5, 8, flags);
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_decode_base16_init(apr_encode_ctx_t **ctx,
+                              int flags, apr_pool_t *p)
+{
+    *ctx = encode_ctx_make(p, NULL, pr2two, 4, 2, flags);
+    return APR_SUCCESS;
+}
+
+static apr_size_t encode_update(apr_encode_ctx_t *ctx, char *dest,
+                                const unsigned char *src, apr_size_t slen)
+{
+    const apr_uint32_t mask = (1u << ctx->bits) - 1;
+    const int colon = (ctx->bits == 4 && (ctx->flags & APR_ENCODE_COLON));
+    char *bufout = dest;
+    apr_size_t i = 0;
+
+    while (i < slen) {
+#if ENCODE_SSE2 || ENCODE_NEON
+        if (ctx->bits == 6 && !ctx->nbits) {
+            apr_size_t n = base64_encode_simd(bufout, src + i, slen - i,
+                                              ctx->base);
+            bufout += n / 3 * 4;
+            ctx->count += n / 3 * 4;
+            i += n;
+            if (i == slen) {
+                break;
+            }
+        }
+#endif
+        if (colon && ctx->count) {
+            *bufout++ = ':';
+        }
+        ctx->acc = (ctx->acc << 8) | src[i++];
+        ctx->nbits += 8;
+        while (ctx->nbits >= ctx->bits) {
+            ctx->nbits -= ctx->bits;
+            *bufout++ = ctx->base[(ctx->acc >> ctx->nbits) & mask];
+            ctx->count++;
+        }
+    }
+
+    return bufout - dest;
+}
+
+static apr_size_t decode_update(apr_encode_ctx_t *ctx, unsigned char *dest,
+                                const unsigned char *src, apr_size_t slen)
+{
+    const int colon = (ctx->bits == 4 && (ctx->flags & APR_ENCODE_COLON));
+    const int maxpad = (ctx->bits == 6) ? 2 : (ctx->bits == 5) ? 6 : 0;
+    unsigned char *bufout = dest;
+    apr_size_t i = 0;
+
+    while (i < slen && ctx->padding >= 0) {
+        unsigned int c = src[i], v = ctx->pr2[c];
+
+#if ENCODE_SSE2 || ENCODE_NEON
+        if (ctx->bits == 6 && !ctx->nbits && !ctx->padding
+                && v < 64 && !(ctx->count % 4)) {
+            apr_size_t n = base64_decode_simd(bufout, src + i, slen - i);
+            if (n) {
+                bufout += n / 4 * 3;
+                ctx->count += n;
+                i += n;
+                continue;
+            }
+        }
+#endif
+        i++;
+        if (!ctx->padding && v < (1u << ctx->bits)) {
+            ctx->acc = (ctx->acc << ctx->bits) | v;
+            ctx->nbits += ctx->bits;
+            if (ctx->nbits >= 8) {
+                ctx->nbits -= 8;
+                *bufout++ = (unsigned char)(ctx->acc >> ctx->nbits);
+            }
+            ctx->count++;
+        }
+        else if (!ctx->padding && colon && v == 32 /* ':' */
+                 && !(ctx->count % 2)) {
+            /* separator */
+        }
+        else if (v == 128 /* '=' */ && ctx->padding < maxpad
+                 && !(ctx->flags & APR_ENCODE_RELAXED)) {
+            ctx->padding++;
+        }
+        else {
+            if (!(ctx->flags & APR_ENCODE_RELAXED)) {
+                ctx->status = APR_BADCH;
+            }
+            ctx->padding = -1;
+        }
+    }
+
+    return bufout - dest;
+}
+
+APR_DECLARE(apr_status_t) apr_encode_update(apr_encode_ctx_t *ctx,
+                              void *dest, const void *src, apr_size_t slen,
+                              apr_size_t *len)
+{
+    apr_size_t dlen;
+
+    if (!ctx || (slen && !src)) {
+        return APR_EINVAL;
+    }
+
+    if (!dest) {
+        if (ctx->pr2) {
+            dlen = slen / 8 * ctx->bits
+                   + (ctx->nbits + slen % 8 * ctx->bits) / 8;
+        }
+        else {
+            if (slen > (APR_SIZE_MAX - 16) / 8) {
+                return APR_ENOSPC;
+            }
+            dlen = (ctx->nbits + slen * 8) / ctx->bits;
+            if (ctx->flags & APR_ENCODE_COLON) {
+                dlen += slen;
+            }
+        }
+    }
+    else if (ctx->pr2) {
+        dlen = decode_update(ctx, dest, src, slen);
+    }
+    else {
+        dlen = encode_update(ctx, dest, src, slen);
+    }
+
+    if (len) {
+        *len = dlen;
+    }
+    return ctx->status;
+}
+
+APR_DECLARE(apr_status_t) apr_encode_final(apr_encode_ctx_t *ctx,
+                              void *dest, apr_size_t *len)
+{
+    apr_status_t status;
+    apr_size_t dlen = 0;
+
+    if (!ctx) {
+        return APR_EINVAL;
+    }
+
+    status = ctx->status;
+    if (ctx->pr2) {
+        /* a lone character, or an incomplete byte for base32 */
+        apr_size_t rem = ctx->count % ctx->group;
+        if (status == APR_SUCCESS
+                && (rem == 1 || (ctx->bits == 5 && (rem == 3 || rem == 6)))) {
+            status = APR_EINCOMPLETE;
+        }
+    }
+    else if (!dest) {
+        dlen = ctx->group;
+    }
+    else {
+        char *bufout = dest;
+
+        if (ctx->nbits) {
+            *bufout++ = ctx->base[(ctx->acc << (ctx->bits - ctx->nbits))
+                                  & ((1u << ctx->bits) - 1)];
+            ctx->count++;
+        }
+        if (ctx->bits != 4 && !(ctx->flags & APR_ENCODE_NOPADDING)) {
+            while (ctx->count % ctx->group) {
+                *bufout++ = '=';
+                ctx->count++;
+            }
+        }
+        dlen = bufout - (char *)dest;
+    }
+
+    if (dest || ctx->pr2) {
+        /* ready for the next stream */
+        ctx->acc = 0;
+        ctx->nbits = 0;
+        ctx->count = 0;
+        ctx->padding = 0;
+        ctx->status = APR_SUCCESS;
+    }
+
+    if (len) {
+        *len = dlen;
+    }
+    return status;
+}
@@ -30,6 +30,7 @@
 #include "apr_encode_private.h"
 #include "apr_lib.h"
 #include "apr_strings.h"
+#include "apr_private.h"
 
 /* we assume the folks using this ensure 0 <= c < 256... which means
  * you need a cast to (unsigned char) first, you can't just plug a
@@ -38,6 +39,228 @@
  */
 #define TEST_CHAR(c, f)        (test_char_table[(apr_uint16_t)(c)] & (f))
 
+/*
+ * With SSE2 or NEON, the runs of characters which need no escaping are
+ * scanned 16 bytes at once and copied as is, the scalar loops handling the
+ * first character needing some work.  When the length of the string is
+ * unknown, a block is loaded only if it does not cross a page boundary (thus
+ * can't fault), which may read beyond the terminating NUL, so this is
+ * disabled for the address sanitizer and valgrind builds.
+ */
+#if defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define ESCAPE_NO_OVERREAD 1
+#endif
+#endif
+#if defined(__SANITIZE_ADDRESS__)
+#define ESCAPE_NO_OVERREAD 1
+#endif
+#if HAVE_VALGRIND
+#define ESCAPE_NO_OVERREAD 1
+#endif
+
+#if APR_CHARSET_EBCDIC || defined(ESCAPE_NO_OVERREAD)
+#define ESCAPE_SSE2 0
+#define ESCAPE_NEON 0
+#elif defined(__SSE2__) || defined(_M_X64) \
+    || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define ESCAPE_SSE2 1
+#define ESCAPE_NEON 0
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define ESCAPE_SSE2 0
+#define ESCAPE_NEON 1
+#else
+#define ESCAPE_SSE2 0
+#define ESCAPE_NEON 0
+#endif
+
+#if ESCAPE_SSE2 || ESCAPE_NEON
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#define ESCAPE_BLOCK 16
+/* The smallest page size of the supported platforms */
+#define ESCAPE_PAGE_SIZE 4096
+#define ESCAPE_BLOCK_SAFE(s) \
+    (((apr_uintptr_t)(s) & (ESCAPE_PAGE_SIZE - 1)) \
+     <= ESCAPE_PAGE_SIZE - ESCAPE_BLOCK)
+
+/* The characters left as is by the escapes, NUL never being one of them */
+typedef enum {
+    ESCAPE_SCAN_URL,            /* not '%' */
+    ESCAPE_SCAN_URL_PLUS,       /* not '%' nor '+' */
+    ESCAPE_SCAN_URLENCODED,     /* alphanumeric or ".-*_" */
+    ESCAPE_SCAN_XML,            /* not "<>&\"" */
+    ESCAPE_SCAN_XML_ASCII,      /* ASCII, not "<>&\"" */
+    ESCAPE_SCAN_ECHO,           /* printable ASCII, not "\"\\" */
+    ESCAPE_SCAN_JSON            /* ASCII, not control nor "\"\\" */
+} escape_scan_e;
+
+static APR_INLINE int escape_ctz(apr_uint64_t x)
+{
+#if defined(__GNUC__)
+    return __builtin_ctzll(x);
+#elif defined(_MSC_VER) && defined(_WIN64)
+    unsigned long i;
+    _BitScanForward64(&i, x);
+    return (int)i;
+#else
+    int i = 0;
+    while (!(x & 1)) {
+        x >>= 1;
+        i++;
+    }
+    return i;
+#endif
+}
+
+#if ESCAPE_SSE2
+
+#define ESCAPE_EQ(c, ch) _mm_cmpeq_epi8(c, _mm_set1_epi8(ch))
+#define ESCAPE_IN(c, lo, hi) \
+    _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8((lo) - 1)), \
+                  _mm_cmplt_epi8(c, _mm_set1_epi8((hi) + 1)))
+
+/* Return the characters of the block at s which are not left as is by the
+ * scan, as one bit per position.
+ */
+static APR_INLINE apr_uint64_t escape_block(const unsigned char *s,
+                                            escape_scan_e scan)
+{
+    const __m128i c = _mm_loadu_si128((const __m128i *)s);
+    const __m128i zero = _mm_setzero_si128();
+    __m128i m;
+
+    switch (scan) {
+    case ESCAPE_SCAN_URL:
+        m = _mm_or_si128(ESCAPE_EQ(c, '%'), _mm_cmpeq_epi8(c, zero));
+        break;
+    case ESCAPE_SCAN_URL_PLUS:
+        m = _mm_or_si128(_mm_or_si128(ESCAPE_EQ(c, '%'), ESCAPE_EQ(c, '+')),
+                         _mm_cmpeq_epi8(c, zero));
+        break;
+    case ESCAPE_SCAN_URLENCODED:
+        m = _mm_or_si128(_mm_or_si128(ESCAPE_IN(c, '0', '9'),
+                                      ESCAPE_IN(c, 'A', 'Z')),
+                         ESCAPE_IN(c, 'a', 'z'));
+        m = _mm_or_si128(m, _mm_or_si128(ESCAPE_EQ(c, '.'),
+                                         ESCAPE_EQ(c, '-')));
+        m = _mm_or_si128(m, _mm_or_si128(ESCAPE_EQ(c, '*'),
+                                         ESCAPE_EQ(c, '_')));
+        return ~_mm_movemask_epi8(m) & 0xFFFF;
+    case ESCAPE_SCAN_XML:
+    case ESCAPE_SCAN_XML_ASCII:
+        m = _mm_or_si128(_mm_or_si128(ESCAPE_EQ(c, '<'), ESCAPE_EQ(c, '>')),
+                         _mm_or_si128(ESCAPE_EQ(c, '&'), ESCAPE_EQ(c, '"')));
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(c, zero));
+        if (scan == ESCAPE_SCAN_XML_ASCII) {
+            m = _mm_or_si128(m, _mm_cmplt_epi8(c, zero));
+        }
+        break;
+    case ESCAPE_SCAN_ECHO:
+    case ESCAPE_SCAN_JSON:
+    default:
+        /* signed, so the non-ASCII characters are below ' ' too */
+        m = _mm_or_si128(_mm_cmplt_epi8(c, _mm_set1_epi8(' ')),
+                         _mm_or_si128(ESCAPE_EQ(c, '"'),
+                                      ESCAPE_EQ(c, '\\')));
+        if (scan == ESCAPE_SCAN_ECHO) {
+            m = _mm_or_si128(m, ESCAPE_EQ(c, 0x7F));
+        }
+        break;
+    }
+
+    return _mm_movemask_epi8(m);
+}
+
+#define ESCAPE_BLOCK_OFFSET(bits) escape_ctz(bits)
+
+#else /* ESCAPE_NEON */
+
+#define ESCAPE_EQ(c, ch) vceqq_u8(c, vdupq_n_u8(ch))
+#define ESCAPE_IN(c, lo, hi) \
+    vandq_u8(vcgeq_u8(c, vdupq_n_u8(lo)), vcleq_u8(c, vdupq_n_u8(hi)))
+
+/* Return the characters of the block at s which are not left as is by the
+ * scan, as every 4 bits per position.
+ */
+static APR_INLINE apr_uint64_t escape_block(const unsigned char *s,
+                                            escape_scan_e scan)
+{
+    const uint8x16_t c = vld1q_u8(s);
+    uint8x16_t m;
+
+    switch (scan) {
+    case ESCAPE_SCAN_URL:
+        m = vorrq_u8(ESCAPE_EQ(c, '%'), ESCAPE_EQ(c, 0));
+        break;
+    case ESCAPE_SCAN_URL_PLUS:
+        m = vorrq_u8(vorrq_u8(ESCAPE_EQ(c, '%'), ESCAPE_EQ(c, '+')),
+                     ESCAPE_EQ(c, 0));
+        break;
+    case ESCAPE_SCAN_URLENCODED:
+        m = vorrq_u8(vorrq_u8(ESCAPE_IN(c, '0', '9'), ESCAPE_IN(c, 'A', 'Z')),
+                     ESCAPE_IN(c, 'a', 'z'));
+        m = vorrq_u8(m, vorrq_u8(ESCAPE_EQ(c, '.'), ESCAPE_EQ(c, '-')));
+        m = vorrq_u8(m, vorrq_u8(ESCAPE_EQ(c, '*'), ESCAPE_EQ(c, '_')));
+        m = vmvnq_u8(m);
+        break;
+    case ESCAPE_SCAN_XML:
+    case ESCAPE_SCAN_XML_ASCII:
+        m = vorrq_u8(vorrq_u8(ESCAPE_EQ(c, '<'), ESCAPE_EQ(c, '>')),
+                     vorrq_u8(ESCAPE_EQ(c, '&'), ESCAPE_EQ(c, '"')));
+        m = vorrq_u8(m, ESCAPE_EQ(c, 0));
+        if (scan == ESCAPE_SCAN_XML_ASCII) {
+            m = vorrq_u8(m, vcgeq_u8(c, vdupq_n_u8(0x80)));
+        }
+        break;
+    case ESCAPE_SCAN_ECHO:
+    case ESCAPE_SCAN_JSON:
+    default:
+        m = vorrq_u8(vorrq_u8(vcltq_u8(c, vdupq_n_u8(' ')),
+                              vcgeq_u8(c, vdupq_n_u8(0x80))),
+                     vorrq_u8(ESCAPE_EQ(c, '"'), ESCAPE_EQ(c, '\\')));
+        if (scan == ESCAPE_SCAN_ECHO) {
+            m = vorrq_u8(m, ESCAPE_EQ(c, 0x7F));
+        }
+        break;
+    }
+
+    return vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(
+                vreinterpretq_u16_u8(m), 4)), 0) & 0x1111111111111111ULL;
+}
+
+#define ESCAPE_BLOCK_OFFSET(bits) (escape_ctz(bits) >> 2)
+
+#endif /* ESCAPE_NEON */
+
+/* Return the number of leading characters of s (up to slen unless negative)
+ * which are left as is by the scan.
+ */
+static APR_INLINE apr_size_t escape_scan(const unsigned char *s,
+                                         apr_ssize_t slen,
+                                         escape_scan_e scan)
+{
+    apr_size_t n = 0;
+    apr_uint64_t bits;
+
+    while (slen < 0 ? ESCAPE_BLOCK_SAFE(s + n)
+                    : (apr_size_t)slen - n >= ESCAPE_BLOCK) {
+        bits = escape_block(s + n, scan);
+        if (bits) {
+            return n + ESCAPE_BLOCK_OFFSET(bits);
+        }
+        n += ESCAPE_BLOCK;
+    }
+
+    return n;
+}
+
+#endif /* ESCAPE_SSE2 || ESCAPE_NEON */
+
 APR_DECLARE(apr_status_t) apr_escape_shell(char *escaped, const char *str,
         apr_ssize_t slen, apr_size_t *len)
 {
@@ -145,6 +368,10 @@ APR_DECLARE(apr_status_t) apr_unescape_url(char *escaped, const char *url,
     const char *s = (const char *) url;
     char *d = (char *) escaped;
     register int badesc, badpath;
+#if ESCAPE_SSE2 || ESCAPE_NEON
+    const escape_scan_e scan = plus ? ESCAPE_SCAN_URL_PLUS : ESCAPE_SCAN_URL;
+    apr_size_t n;
+#endif
 
     if (!url) {
         return APR_NOTFOUND;
@@ -155,6 +382,17 @@ APR_DECLARE(apr_status_t) apr_unescape_url(char *escaped, const char *url,
     if (s) {
         if (d) {
             for (; *s && slen; ++s, d++, slen--) {
+#if ESCAPE_SSE2 || ESCAPE_NEON
+                /* copy all but the last unchanged character, handled below */
+                n = escape_scan((const unsigned char *)s, slen, scan);
+                if (n > 1) {
+                    memmove(d, s, --n);
+                    d += n;
+                    s += n;
+                    slen -= n;
+                    size += n;
+                }
+#endif
                 if (plus && *s == '+') {
                     *d = ' ';
                     found = 1;
@@ -197,6 +435,14 @@ APR_DECLARE(apr_status_t) apr_unescape_url(char *escaped, const char *url,
         }
         else {
             for (; *s && slen; ++s, slen--) {
+#if ESCAPE_SSE2 || ESCAPE_NEON
+                n = escape_scan((const unsigned char *)s, slen, scan);
+                if (n > 1) {
+                    s += --n;
+                    slen -= n;
+                    size += n;
+                }
+#endif
                 if (plus && *s == '+') {
                     found = 1;
                 }
@@ -457,10 +703,24 @@ APR_DECLARE(apr_status_t) apr_escape_urlencoded(char *escaped, const char *str,
     const unsigned char *s = (const unsigned char *) str;
     unsigned char *d = (unsigned char *) escaped;
     unsigned c;
+#if ESCAPE_SSE2 || ESCAPE_NEON
+    apr_size_t n;
+#endif
 
     if (s) {
         if (d) {
             while ((c = *s) && slen) {
+#if ESCAPE_SSE2 || ESCAPE_NEON
+                n = escape_scan(s, slen, ESCAPE_SCAN_URLENCODED);
+                if (n) {
+                    memcpy(d, s, n);
+                    d += n;
+                    s += n;
+                    slen -= n;
+                    size += n;
+                    continue;
+                }
+#endif
                 if (TEST_CHAR(c, T_ESCAPE_URLENCODED)) {
                     d = c2x(c, '%', d);
                     size += 2;
@@ -481,6 +741,15 @@ APR_DECLARE(apr_status_t) apr_escape_urlencoded(char *escaped, const char *str,
         }
         else {
             while ((c = *s) && slen) {
+#if ESCAPE_SSE2 || ESCAPE_NEON
+                n = escape_scan(s, slen, ESCAPE_SCAN_URLENCODED);
+                if (n) {
+                    s += n;
+                    slen -= n;
+                    size += n;
+                    continue;
+                }
+#endif
                 if (TEST_CHAR(c, T_ESCAPE_URLENCODED)) {
                     size += 2;
                     found = 1;
@@ -531,10 +800,26 @@ APR_DECLARE(apr_status_t) apr_escape_entity(char *escaped, const char *str,
     const unsigned char *s = (const unsigned char *) str;
     unsigned char *d = (unsigned char *) escaped;
     unsigned c;
+#if ESCAPE_SSE2 || ESCAPE_NEON
+    const escape_scan_e scan = toasc ? ESCAPE_SCAN_XML_ASCII
+                                     : ESCAPE_SCAN_XML;
+    apr_size_t n;
+#endif
 
     if (s) {
         if (d) {
             while ((c = *s) && slen) {
+#if ESCAPE_SSE2 || ESCAPE_NEON
+                n = escape_scan(s, slen, scan);
+                if (n) {
+                    memcpy(d, s, n);
+                    d += n;
+                    s += n;
+                    slen -= n;
+                    size += n;
+                    continue;
+                }
+#endif
                 if (TEST_CHAR(c, T_ESCAPE_XML)) {
                     switch (c) {
                     case '>': {
@@ -587,6 +872,15 @@ APR_DECLARE(apr_status_t) apr_escape_entity(char *escaped, const char *str,
         }
         else {
             while ((c = *s) && slen) {
+#if ESCAPE_SSE2 || ESCAPE_NEON
+                n = escape_scan(s, slen, scan);
+                if (n) {
+                    s += n;
+                    slen -= n;
+                    size += n;
+                    continue;
+                }
+#endif
                 if (TEST_CHAR(c, T_ESCAPE_XML)) {
                     switch (c) {
                     case '>': {
@@ -837,10 +1131,24 @@ APR_DECLARE(apr_status_t) apr_escape_echo(char *escaped, const char *str,
     const unsigned char *s = (const unsigned char *) str;
     unsigned char *d = (unsigned char *) escaped;
     unsigned c;
+#if ESCAPE_SSE2 || ESCAPE_NEON
+    apr_size_t n;
+#endif
 
     if (s) {
         if (d) {
             while ((c = *s) && slen) {
+#if ESCAPE_SSE2 || ESCAPE_NEON
+                n = escape_scan(s, slen, ESCAPE_SCAN_ECHO);
+                if (n) {
+                    memcpy(d, s, n);
+                    d += n;
+                    s += n;
+                    slen -= n;
+                    size += n;
+                    continue;
+                }
+#endif
                 if (TEST_CHAR(c, T_ESCAPE_ECHO)) {
                     *d++ = '\\';
                     size++;
@@ -914,6 +1222,15 @@ APR_DECLARE(apr_status_t) apr_escape_echo(char *escaped, const char *str,
         }
         else {
             while ((c = *s) && slen) {
+#if ESCAPE_SSE2 || ESCAPE_NEON
+                n = escape_scan(s, slen, ESCAPE_SCAN_ECHO);
+                if (n) {
+                    s += n;
+                    slen -= n;
+                    size += n;
+                    continue;
+                }
+#endif
                 if (TEST_CHAR(c, T_ESCAPE_ECHO)) {
                     size++;
                     switch (c) {
@@ -1221,6 +1538,9 @@ APR_DECLARE(apr_status_t) apr_escape_json(char *escaped, const char *str,
     const unsigned char *s = (const unsigned char *) str;
     unsigned char *d = (unsigned char *) escaped;
     unsigned c;
+#if ESCAPE_SSE2 || ESCAPE_NEON
+    apr_size_t n;
+#endif
     const char invalid[3] = { 0xEF, 0xBF, 0xBD };
 
     if (s) {
@@ -1230,6 +1550,17 @@ APR_DECLARE(apr_status_t) apr_escape_json(char *escaped, const char *str,
                 size += 1;
             }
             while ((c = *s) && slen) {
+#if ESCAPE_SSE2 || ESCAPE_NEON
+                n = escape_scan(s, slen, ESCAPE_SCAN_JSON);
+                if (n) {
+                    memcpy(d, s, n);
+                    d += n;
+                    s += n;
+                    slen -= n;
+                    size += n;
+                    continue;
+                }
+#endif
                 if (TEST_CHAR(c, T_ESCAPE_JSON)) {
                     switch (c) {
                     case '\b':
@@ -1361,6 +1692,15 @@ APR_DECLARE(apr_status_t) apr_escape_json(char *escaped, const char *str,
                 size += 1;
             }
             while ((c = *s) && slen) {
+#if ESCAPE_SSE2 || ESCAPE_NEON
+                n = escape_scan(s, slen, ESCAPE_SCAN_JSON);
+                if (n) {
+                    s += n;
+                    slen -= n;
+                    size += n;
+                    continue;
+                }
+#endif
                 if (TEST_CHAR(c, T_ESCAPE_JSON)) {
                     switch (c) {
                     case '\b':
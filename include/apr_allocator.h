@@ -129,6 +129,45 @@ APR_DECLARE(apr_status_t) apr_allocator_min_order_set(unsigned int order);
 APR_DECLARE(apr_size_t) apr_allocator_align(apr_allocator_t *allocator,
                                             apr_size_t size);
 
+/** Number of free lists reported by apr_allocator_stats_get() */
+#define APR_ALLOCATOR_STATS_SLOTS 21
+
+/** Memory usage of an allocator, see apr_allocator_stats_get() */
+typedef struct apr_allocator_stats_t {
+    /** Memory currently obtained from the system */
+    apr_size_t total;
+    /** High-water mark of total */
+    apr_size_t peak;
+    /** Memory used by the pools (or other users) */
+    apr_size_t in_use;
+    /** Memory in the free lists */
+    apr_size_t free;
+    /** Memory in the thread caches, see apr_allocator_thread_cache_set() */
+    apr_size_t cached;
+    /** The threshold set by apr_allocator_max_free_set(), 0 == unlimited */
+    apr_size_t max_free;
+    /** Memory which can still be freed before the blocks start to be
+     * given back to the system (when max_free is set) */
+    apr_size_t current_free;
+    /** Number of blocks in each free list: slot i contains the blocks of
+     * (i + 1) apr_allocator_page_size(), and the last slot the bigger
+     * ones */
+    apr_size_t free_nodes[APR_ALLOCATOR_STATS_SLOTS];
+} apr_allocator_stats_t;
+
+/**
+ * Retrieve the memory usage of an allocator.
+ * @param allocator The allocator
+ * @param stats Where to store the statistics
+ * @remark The counters are maintained only when blocks are obtained from
+ *         or given back to the system, the free lists are walked on
+ *         demand.  The cached size is an estimate.
+ * @remark Useful to tune apr_allocator_max_free_set().
+ */
+APR_DECLARE(void) apr_allocator_stats_get(apr_allocator_t *allocator,
+                                          apr_allocator_stats_t *stats)
+                  __attribute__((nonnull(1,2)));
+
 #include "apr_pools.h"
 
 /**
@@ -163,6 +202,67 @@ APR_DECLARE(void) apr_allocator_max_free_set(apr_allocator_t *allocator,
                                              apr_size_t size)
                   __attribute__((nonnull(1)));
 
+/**
+ * Set the size of the per-thread caches of the allocator.
+ * @param allocator The allocator to set the cache size on
+ * @param size The maximum size of the memory cached by each thread.
+ *             0 == no caching (the default).
+ * @return APR_SUCCESS, or APR_ENOTIMPL if threads or thread local storage
+ *         are not supported.
+ * @remark When enabled, the blocks freed by an APR thread (created by
+ *         apr_thread_create() or apr_thread_current_create()) are kept in
+ *         a cache local to the thread, and allocations from this thread
+ *         are served from there first, without taking the allocator mutex.
+ *         The cache is refilled from, or spilled to, the allocator in
+ *         batches, and given back to the allocator when the thread exits.
+ * @remark The cached blocks are not accounted for by
+ *         apr_allocator_max_free_set().
+ * @remark Should be done before the allocator is shared by threads.
+ */
+APR_DECLARE(apr_status_t) apr_allocator_thread_cache_set(
+                                          apr_allocator_t *allocator,
+                                          apr_size_t size)
+                          __attribute__((nonnull(1)));
+
+/**
+ * Back the memory of the allocator by huge pages.
+ * @param allocator The allocator to set the attribute on
+ * @param on Non-zero to use huge pages, zero to not use them (the default).
+ * @return APR_SUCCESS, APR_EBUSY if the allocator was already used, or
+ *         APR_ENOTIMPL if huge pages are not supported by the platform.
+ * @remark The blocks are then carved from (huge page aligned) arenas,
+ *         using the reserved huge pages if any, or else the transparent
+ *         huge pages when enabled by the system.  The arenas are released
+ *         when the allocator is destroyed only, so the threshold set by
+ *         apr_allocator_max_free_set() is ignored.
+ * @remark The arenas are 2MB, so the reserved huge pages are used only if
+ *         their size (Hugepagesize in /proc/meminfo) is 2MB or a divisor
+ *         of it, the transparent huge pages are used otherwise.
+ * @remark Must be done before any pool uses the allocator.
+ */
+APR_DECLARE(apr_status_t) apr_allocator_hugepages_set(
+                                          apr_allocator_t *allocator,
+                                          int on)
+                          __attribute__((nonnull(1)));
+
+/**
+ * Bind the memory of the allocator to a NUMA node.
+ * @param allocator The allocator to set the attribute on
+ * @param node The preferred NUMA node, or -1 for none (the default).
+ * @return APR_SUCCESS, APR_EINVAL if @a node is out of range, APR_EBUSY
+ *         if the allocator was already used, or APR_ENOTIMPL if NUMA
+ *         binding is not supported by the platform.
+ * @remark The node is preferred, the memory is allocated on other nodes
+ *         if it's exhausted.
+ * @remark Like with apr_allocator_hugepages_set(), the blocks are then
+ *         carved from arenas released when the allocator is destroyed.
+ * @remark Must be done before any pool uses the allocator.
+ */
+APR_DECLARE(apr_status_t) apr_allocator_numa_node_set(
+                                          apr_allocator_t *allocator,
+                                          int node)
+                          __attribute__((nonnull(1)));
+
 #include "apr_thread_mutex.h"
 
 #if APR_HAS_THREADS
@@ -32,6 +32,8 @@
 #include "apr_mmap.h"
 #include "apr_errno.h"
 #include "apr_ring.h"
+#include "apr_strmatch.h"
+#include "apr_encode.h"
 #include "apr.h"
 #if APR_HAVE_SYS_UIO_H
 #include <sys/uio.h>	/* for struct iovec */
@@ -485,6 +487,12 @@ typedef apr_status_t (*apr_brigade_flush)(apr_bucket_brigade *bb, void *ctx);
  * @return true or false
  */
 #define APR_BUCKET_IS_SOCKET(e)      ((e)->type == &apr_bucket_type_socket)
+/**
+ * Determine if a bucket is a SPLICE bucket
+ * @param e The bucket to inspect
+ * @return true or false
+ */
+#define APR_BUCKET_IS_SPLICE(e)      ((e)->type == &apr_bucket_type_splice)
 /**
  * Determine if a bucket is a HEAP bucket
  * @param e The bucket to inspect
@@ -632,6 +640,25 @@ struct apr_bucket_file {
     apr_pool_t *readpool;
     /** File read block size */
     apr_size_t read_size;
+    /** Maximum read block size in adaptive mode, or zero */
+    apr_size_t max_read_size;
+    /** Current read block size in adaptive mode */
+    apr_size_t cur_read_size;
+    /** Offset following the last read, to detect sequential access */
+    apr_off_t read_end;
+};
+
+/** @see apr_bucket_splice */
+typedef struct apr_bucket_splice apr_bucket_splice;
+/**
+ * A bucket referring to data held in a kernel pipe
+ */
+struct apr_bucket_splice {
+    /** The read end of the pipe holding the data */
+    apr_file_t *pipe;
+    /** The bucket, whose data still in the pipe are discarded when it
+     *  is destroyed */
+    apr_bucket *bucket;
 };
 
 /** @see apr_bucket_structs */
@@ -827,6 +854,79 @@ APR_DECLARE(apr_status_t) apr_brigade_split_boundary(apr_bucket_brigade *bbOut,
                                                      apr_off_t maxbytes)
                           __attribute__((nonnull(1,2)));
 
+/** Opaque structure used to search a pattern through successive brigades */
+typedef struct apr_brigade_matcher_t apr_brigade_matcher_t;
+
+/**
+ * Create a matcher searching a pattern through the data of successive
+ * brigades, as if they were flattened.
+ * @param matcher The pointer in which to return the matcher
+ * @param pattern The precompiled pattern, which must not be empty
+ * @param p The pool from which to allocate the matcher
+ * @return APR_EINVAL if the pattern is empty
+ */
+APR_DECLARE(apr_status_t) apr_brigade_matcher_create(
+                                         apr_brigade_matcher_t **matcher,
+                                         const apr_strmatch_pattern *pattern,
+                                         apr_pool_t *p)
+                          __attribute__((nonnull(1,2,3)));
+
+/**
+ * Search for the pattern of a matcher in a brigade, in continuation of the
+ * data searched by the previous calls.
+ *
+ * The brigade is not modified, its data is read bucket by bucket without
+ * being copied, and the end of any partial match is kept in the matcher
+ * to be continued by the data of the next call.
+ *
+ * If the pattern is found, APR_SUCCESS is returned, the offset of the
+ * match is the number of bytes searched by the matcher before it, and the
+ * data up to the end of the match is consumed. The next call should then
+ * search the data following the match, for instance the rest of the
+ * brigade after apr_brigade_partition() at the consumed length.
+ *
+ * If the pattern is not found, all the data of the brigade is consumed
+ * and APR_INCOMPLETE is returned.
+ *
+ * If an error is encountered, the APR error code will be returned and
+ * the data read before it is consumed.
+ *
+ * @param matcher The matcher
+ * @param bb The bucket brigade to search
+ * @param block The blocking mode to be used to read the buckets
+ * @param offset The location in which to return the offset of the match
+ * @param consumed The location in which to return the number of bytes of
+ *        the brigade consumed
+ */
+APR_DECLARE(apr_status_t) apr_brigade_match(apr_brigade_matcher_t *matcher,
+                                            apr_bucket_brigade *bb,
+                                            apr_read_type_e block,
+                                            apr_off_t *offset,
+                                            apr_off_t *consumed)
+                          __attribute__((nonnull(1,2,4,5)));
+
+/**
+ * Encode or decode the data of a brigade in place, bucket by bucket.
+ *
+ * Each data bucket is read and replaced by a heap bucket of its encoding
+ * or decoding, if not empty. Metadata buckets are kept as is, but the
+ * encoding or decoding is terminated before an EOS bucket, where the
+ * function stops. Otherwise the context keeps its state for the next call
+ * on the following brigade.
+ *
+ * If an error is encountered, the APR error code will be returned and the
+ * buckets before the one in error are transformed already.
+ *
+ * @param bb The bucket brigade to transform
+ * @param ctx The streaming context, created by one of the
+ *        apr_encode_*_init() or apr_decode_*_init() functions
+ * @param block The blocking mode to be used to read the buckets
+ */
+APR_DECLARE(apr_status_t) apr_brigade_encode(apr_bucket_brigade *bb,
+                                             apr_encode_ctx_t *ctx,
+                                             apr_read_type_e block)
+                          __attribute__((nonnull(1,2)));
+
 /**
  * Create an iovec of the elements in a bucket_brigade... return number
  * of elements used.  This is useful for writing to a file or to the
@@ -840,6 +940,77 @@ APR_DECLARE(apr_status_t) apr_brigade_to_iovec(apr_bucket_brigade *b,
                                                struct iovec *vec, int *nvec)
                           __attribute__((nonnull(1,2,3)));
 
+/** Do not use sendfile for the file buckets in apr_brigade_send() */
+#define APR_BRIGADE_SEND_NO_SENDFILE 0x01
+/** Do not use splice for the SPLICE and PIPE buckets in apr_brigade_send() */
+#define APR_BRIGADE_SEND_NO_SPLICE   0x02
+
+/**
+ * Send the data of a brigade to a socket, removing the buckets sent.
+ *
+ * The brigade is walked once, gathering the data of consecutive buckets
+ * into iovecs for apr_socket_sendv() (up to #APR_MAX_IOVEC_SIZE of them),
+ * and file buckets opened with #APR_FOPEN_SENDFILE_ENABLED are sent with
+ * apr_socket_sendfile(), the data around them as headers and trailers so
+ * that the whole is corked on platforms supporting it. Buckets whose data
+ * are not available yet (pipes, sockets...) are read in non-blocking mode
+ * first, and what was gathered so far is sent before blocking on them.
+ *
+ * Where splice(2) is available, SPLICE buckets and PIPE buckets (whose
+ * pipe is not buffered) are moved to the socket by the kernel, without
+ * being read.
+ *
+ * Metadata buckets are removed along with the data buckets sent. When a
+ * write is partial, the bucket partially sent is split so that the
+ * brigade contains exactly the data still to be sent.
+ *
+ * @param sock The socket to send to
+ * @param bb The bucket brigade to send
+ * @param flags #APR_BRIGADE_SEND_NO_SENDFILE and/or
+ *        #APR_BRIGADE_SEND_NO_SPLICE, or zero
+ * @param sent Set to the number of bytes sent, if not NULL
+ * @return APR_SUCCESS if the brigade was entirely sent (and is empty),
+ *         APR_EAGAIN if the socket is non-blocking and could not take
+ *         everything, or any other error from reading the buckets or
+ *         writing the socket (the brigade then holds what was not sent).
+ */
+APR_DECLARE(apr_status_t) apr_brigade_send(apr_socket_t *sock,
+                                           apr_bucket_brigade *bb,
+                                           apr_int32_t flags,
+                                           apr_off_t *sent)
+                          __attribute__((nonnull(1,2)));
+
+/**
+ * Receive data from a socket into a brigade, moving them to a kernel pipe
+ * where splice(2) is available rather than copying them to user space.
+ *
+ * The data are appended to the brigade as a SPLICE bucket referring to
+ * the pipe (or merged into the last bucket if it's a SPLICE bucket of the
+ * same pipe), which can be sent by apr_brigade_send() without a copy, or
+ * read like any bucket when they need to be inspected. When splice(2) is
+ * not available (or not supported by the socket), the data are read in a
+ * heap bucket instead.
+ *
+ * @param bb The bucket brigade to append to
+ * @param sock The socket to receive from, read according to its timeout
+ * @param pipe_in The read end of the kernel pipe, used by the bucket
+ * @param pipe_out The write end of the kernel pipe
+ * @param max The maximum amount of data to receive (the pipe may hold
+ *        less, 64KB by default on Linux)
+ * @param len Set to the amount of data received
+ * @return APR_SUCCESS, APR_EOF at the end of the stream, APR_EAGAIN if
+ *         the socket is non-blocking and has no data or if the pipe is
+ *         full (the SPLICE buckets have to be consumed first), or any
+ *         other error from the socket.
+ */
+APR_DECLARE(apr_status_t) apr_brigade_splice_socket(apr_bucket_brigade *bb,
+                                                    apr_socket_t *sock,
+                                                    apr_file_t *pipe_in,
+                                                    apr_file_t *pipe_out,
+                                                    apr_size_t max,
+                                                    apr_size_t *len)
+                          __attribute__((nonnull(1,2,3,4,6)));
+
 /**
  * This function writes a list of strings into a bucket brigade.
  * @param b The bucket brigade to add to
@@ -1058,6 +1229,57 @@ APR_DECLARE_NONSTD(void *) apr_bucket_alloc(apr_size_t size,
 APR_DECLARE_NONSTD(void) apr_bucket_free(void *block)
                          __attribute__((nonnull(1)));
 
+/**
+ * Set the maximum amount of memory kept by the free lists of a bucket
+ * allocator, all together.
+ * @param list The bucket allocator
+ * @param size The threshold, 0 to give all the blocks back to the
+ *             apr_allocator_t when freed (the default is 128KB).
+ * @remark Besides the small nodes used for the bucket structures, the
+ * freed blocks of up to 16 pages (64KB with 4KB pages), like the buffers of
+ * heap buckets, are kept in free lists by number of pages and reused by
+ * the next allocations of the same size, without going through the
+ * apr_allocator_t (and its mutex, if any). The bigger blocks always go
+ * back to the apr_allocator_t. This memory is not accounted by the
+ * apr_allocator_max_free_set() of the apr_allocator_t.
+ */
+APR_DECLARE_NONSTD(void) apr_bucket_alloc_max_free_set(apr_bucket_alloc_t *list,
+                                                       apr_size_t size)
+                         __attribute__((nonnull(1)));
+
+/** Number of free lists reported by apr_bucket_alloc_stats_get() */
+#define APR_BUCKET_ALLOC_STATS_SLOTS 17
+
+/** Usage of the free lists of a bucket allocator, see
+ *  apr_bucket_alloc_stats_get() */
+typedef struct apr_bucket_alloc_stats_t {
+    /** The threshold set by apr_bucket_alloc_max_free_set() */
+    apr_size_t max_free;
+    /** Size of the nodes in each free list: slot 0 contains the small
+     * nodes, slot i the blocks of (i + 1) apr_allocator_page_size(), and
+     * the last slot accounts for the bigger blocks (never kept) */
+    apr_size_t node_size[APR_BUCKET_ALLOC_STATS_SLOTS];
+    /** Number of nodes in each free list */
+    apr_size_t free_nodes[APR_BUCKET_ALLOC_STATS_SLOTS];
+    /** Number of allocations served by each free list */
+    apr_uint64_t hits[APR_BUCKET_ALLOC_STATS_SLOTS];
+    /** Number of allocations which needed new memory */
+    apr_uint64_t misses[APR_BUCKET_ALLOC_STATS_SLOTS];
+    /** Number of blocks given back to the apr_allocator_t because the free
+     * lists were full */
+    apr_uint64_t overflows[APR_BUCKET_ALLOC_STATS_SLOTS];
+} apr_bucket_alloc_stats_t;
+
+/**
+ * Retrieve the usage of the free lists of a bucket allocator.
+ * @param list The bucket allocator
+ * @param stats Where to store the statistics
+ * @remark Useful to tune apr_bucket_alloc_max_free_set().
+ */
+APR_DECLARE_NONSTD(void) apr_bucket_alloc_stats_get(apr_bucket_alloc_t *list,
+                                                    apr_bucket_alloc_stats_t *stats)
+                         __attribute__((nonnull(1,2)));
+
 
 /*  *****  Bucket Functions  *****  */
 /**
@@ -1303,6 +1525,12 @@ APR_DECLARE_DATA extern const apr_bucket_type_t apr_bucket_type_transient;
  * The SOCKET bucket type.  This bucket represents a socket to another machine
  */
 APR_DECLARE_DATA extern const apr_bucket_type_t apr_bucket_type_socket;
+/**
+ * The SPLICE bucket type.  This bucket represents data held in a kernel
+ * pipe, which can be moved to a socket without being copied to user space,
+ * and which are discarded from the pipe if the bucket is destroyed unread
+ */
+APR_DECLARE_DATA extern const apr_bucket_type_t apr_bucket_type_splice;
 
 
 /*  *****  Simple buckets  *****  */
@@ -1601,6 +1829,24 @@ APR_DECLARE(apr_bucket *) apr_bucket_socket_make(apr_bucket *b,
                                                  apr_socket_t *thissock)
                           __attribute__((nonnull(1,2)));
 
+/**
+ * Set the maximum amount of data read by a SOCKET bucket at once (default
+ * is @a APR_BUCKET_BUFF_SIZE)
+ * @param b The bucket
+ * @param budget The maximum number of bytes read from the socket by a
+ *               single apr_bucket_read()
+ * @return APR_SUCCESS normally, or APR_EINVAL if @a b is not a SOCKET
+ *         bucket
+ * @remark A budget above @a APR_BUCKET_BUFF_SIZE makes the read fill up to
+ * that many bytes of @a APR_BUCKET_BUFF_SIZE buffers with a single
+ * apr_socket_recvv(), and chain as many HEAP buckets (the first one being
+ * returned by the read). The budget is capped to 64 buffers, and is
+ * inherited by the SOCKET bucket holding the rest of the socket.
+ */
+APR_DECLARE(apr_status_t) apr_bucket_socket_set_read_budget(apr_bucket *b,
+                                                          apr_size_t budget)
+                          __attribute__((nonnull(1)));
+
 /**
  * Create a bucket referring to a pipe.
  * @param thispipe The pipe to put in the bucket
@@ -1621,6 +1867,36 @@ APR_DECLARE(apr_bucket *) apr_bucket_pipe_make(apr_bucket *b,
                                                apr_file_t *thispipe)
                           __attribute__((nonnull(1,2)));
 
+/**
+ * Create a bucket referring to data held in a kernel pipe.
+ * @param thispipe The read end of the pipe
+ * @param len The amount of data in the pipe for this bucket
+ * @param list The freelist from which this bucket should be allocated
+ * @return The new bucket, or NULL if allocation failed
+ * @remark The data are read from the pipe (and the bucket morphed into a
+ *         heap bucket) only if they need to be inspected, so the SPLICE
+ *         buckets referring to the same pipe must be consumed in order.
+ *         A SPLICE bucket can't be split (it's read first then), and the
+ *         data of a SPLICE bucket destroyed unread are discarded from the
+ *         pipe, which must then still be open.
+ */
+APR_DECLARE(apr_bucket *) apr_bucket_splice_create(apr_file_t *thispipe,
+                                                   apr_size_t len,
+                                                   apr_bucket_alloc_t *list)
+                          __attribute__((nonnull(1,3)));
+
+/**
+ * Make the bucket passed in a bucket refer to data held in a kernel pipe
+ * @param b The bucket to make into a SPLICE bucket
+ * @param thispipe The read end of the pipe
+ * @param len The amount of data in the pipe for this bucket
+ * @return The new bucket, or NULL if allocation failed
+ */
+APR_DECLARE(apr_bucket *) apr_bucket_splice_make(apr_bucket *b,
+                                                 apr_file_t *thispipe,
+                                                 apr_size_t len)
+                          __attribute__((nonnull(1,2)));
+
 /**
  * Create a bucket referring to a file.
  * @param fd The file to put in the bucket
@@ -1682,6 +1958,26 @@ APR_DECLARE(apr_status_t) apr_bucket_file_enable_mmap(apr_bucket *b,
 APR_DECLARE(apr_status_t) apr_bucket_file_set_buf_size(apr_bucket *b,
                                                        apr_size_t size);
 
+/**
+ * Enable or disable adaptive read sizes for a FILE bucket (default is
+ * disabled)
+ * @param b The bucket
+ * @param max_size Maximum size of the allocated buffers, or zero to
+ *                 disable adaptive reads
+ * @return APR_SUCCESS normally, or an error code if the operation fails
+ * @remark In adaptive mode, the read size starts from the buffer size
+ * (@see apr_bucket_file_set_buf_size) and doubles with each sequential
+ * read, up to @a max_size. It falls back to the buffer size when the file
+ * is read elsewhere. Where available, the kernel is also advised of the
+ * sequential access and asked to read ahead the next block. The sizes are
+ * rounded to the bucket allocator's nodes, so that freed buffers are
+ * recycled by the next reads.
+ * @remark Relevant/used only when memory-mapping is disabled (@see
+ * apr_bucket_file_enable_mmap)
+ */
+APR_DECLARE(apr_status_t) apr_bucket_file_set_adaptive(apr_bucket *b,
+                                                       apr_size_t max_size);
+
 /** @} */
 #ifdef __cplusplus
 }
@@ -1058,6 +1058,9 @@ APR_DECLARE(apr_status_t) apr_crypto_random_bytes(void *buf, apr_size_t len);
  * @return APR_EINIT if \ref apr_crypto_prng_init() was not called or
  *                   called without \ref APR_CRYPTO_PRNG_PER_THREAD,
  *         any system error (APR_ENOMEM, ...).
+ * @remark The CPRNG of the thread is not locked and buffers more random
+ *         bytes than the global one, which suits the many small requests
+ *         (nonces, UUIDs, session IDs...) better.
  */
 APR_DECLARE(apr_status_t) apr_crypto_random_thread_bytes(void *buf,
         apr_size_t len);
@@ -1100,7 +1103,8 @@ APR_DECLARE(apr_status_t) apr_crypto_prng_destroy(apr_crypto_prng_t *cprng);
 /**
  * @brief Rekey a CPRNG.
  *
- * @param cprng The CPRNG, or NULL for all the created CPRNGs (but per-thread).
+ * @param cprng The CPRNG, or NULL for all the created CPRNGs (but the
+ *              per-thread ones of other threads than the calling one).
  * @return Any system error (APR_ENOMEM, ...).
  */
 APR_DECLARE(apr_status_t) apr_crypto_prng_rekey(apr_crypto_prng_t *cprng);
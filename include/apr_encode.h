@@ -642,6 +642,117 @@ APR_DECLARE(const unsigned char *)apr_pdecode_base16_binary(apr_pool_t * p,
         const char *src, apr_ssize_t slen, int flags, apr_size_t * len)
         __attribute__((nonnull(1)));
 
+/**
+ * Opaque structure used for the streaming encodings and decodings.
+ */
+typedef struct apr_encode_ctx_t apr_encode_ctx_t;
+
+/**
+ * Create a context to convert data to base64 by pieces.
+ * @param ctx The pointer in which to return the context.
+ * @param flags The flags of apr_encode_base64_binary().
+ * @param p Pool to allocate the context from.
+ * @return APR_SUCCESS.
+ * @remark The data is given to apr_encode_update() in pieces of any length,
+ *  and the encoding is terminated with apr_encode_final(), the output being
+ *  the same as apr_encode_base64_binary() for the whole data.
+ */
+APR_DECLARE(apr_status_t) apr_encode_base64_init(apr_encode_ctx_t **ctx,
+        int flags, apr_pool_t *p) __attribute__((nonnull(1, 3)));
+
+/**
+ * Create a context to convert data to base32 by pieces.
+ * @param ctx The pointer in which to return the context.
+ * @param flags The flags of apr_encode_base32_binary().
+ * @param p Pool to allocate the context from.
+ * @return APR_SUCCESS.
+ * @remark See apr_encode_base64_init().
+ */
+APR_DECLARE(apr_status_t) apr_encode_base32_init(apr_encode_ctx_t **ctx,
+        int flags, apr_pool_t *p) __attribute__((nonnull(1, 3)));
+
+/**
+ * Create a context to convert data to base16 by pieces.
+ * @param ctx The pointer in which to return the context.
+ * @param flags The flags of apr_encode_base16_binary().
+ * @param p Pool to allocate the context from.
+ * @return APR_SUCCESS.
+ * @remark See apr_encode_base64_init().
+ */
+APR_DECLARE(apr_status_t) apr_encode_base16_init(apr_encode_ctx_t **ctx,
+        int flags, apr_pool_t *p) __attribute__((nonnull(1, 3)));
+
+/**
+ * Create a context to convert base64 or base64url to data by pieces.
+ * @param ctx The pointer in which to return the context.
+ * @param flags The flags of apr_decode_base64_binary().
+ * @param p Pool to allocate the context from.
+ * @return APR_SUCCESS.
+ * @remark The encoded string is given to apr_encode_update() in pieces of
+ *  any length, and the decoding is terminated with apr_encode_final(), the
+ *  output being the same as apr_decode_base64_binary() for the whole string.
+ */
+APR_DECLARE(apr_status_t) apr_decode_base64_init(apr_encode_ctx_t **ctx,
+        int flags, apr_pool_t *p) __attribute__((nonnull(1, 3)));
+
+/**
+ * Create a context to convert base32 to data by pieces.
+ * @param ctx The pointer in which to return the context.
+ * @param flags The flags of apr_decode_base32_binary().
+ * @param p Pool to allocate the context from.
+ * @return APR_SUCCESS.
+ * @remark See apr_decode_base64_init().
+ */
+APR_DECLARE(apr_status_t) apr_decode_base32_init(apr_encode_ctx_t **ctx,
+        int flags, apr_pool_t *p) __attribute__((nonnull(1, 3)));
+
+/**
+ * Create a context to convert base16 (hex) to data by pieces.
+ * @param ctx The pointer in which to return the context.
+ * @param flags The flags of apr_decode_base16_binary().
+ * @param p Pool to allocate the context from.
+ * @return APR_SUCCESS.
+ * @remark See apr_decode_base64_init().
+ */
+APR_DECLARE(apr_status_t) apr_decode_base16_init(apr_encode_ctx_t **ctx,
+        int flags, apr_pool_t *p) __attribute__((nonnull(1, 3)));
+
+/**
+ * Encode or decode the next piece of data with a streaming context.
+ * @param ctx The context, created by one of the apr_encode_*_init() or
+ *  apr_decode_*_init() functions.
+ * @param dest The destination buffer, can be NULL to output in \c len the
+ *  maximum length written for \c slen bytes.
+ * @param src The piece of data, or of the encoded string when decoding.
+ * @param slen The length of the piece.
+ * @param len If not NULL, outputs the maximum length written if \c dest is
+ *  NULL, or the actual length written. No trailing NUL is written.
+ * @return APR_SUCCESS, APR_EINVAL if \c ctx is NULL, APR_ENOSPC if the
+ *  encoding would overflow, or APR_BADCH if some invalid character was met
+ *  while decoding without APR_ENCODE_RELAXED (the following pieces being
+ *  ignored then, until apr_encode_final() is called).
+ * @remark Up to a group of characters or bytes is held by the context
+ *  until the next piece, or until apr_encode_final().
+ */
+APR_DECLARE(apr_status_t) apr_encode_update(apr_encode_ctx_t *ctx,
+        void *dest, const void *src, apr_size_t slen, apr_size_t *len);
+
+/**
+ * Terminate the encoding or decoding of a streaming context, which is then
+ * ready for a new stream.
+ * @param ctx The context.
+ * @param dest The destination buffer, can be NULL to output in \c len the
+ *  maximum length written when encoding. Decodings write nothing here and
+ *  are terminated whether \c dest is NULL or not.
+ * @param len If not NULL, outputs the maximum length written if \c dest is
+ *  NULL, or the actual length written. No trailing NUL is written.
+ * @return APR_SUCCESS, APR_EINVAL if \c ctx is NULL, APR_BADCH if some
+ *  invalid character was met while decoding, or APR_EINCOMPLETE if the
+ *  encoded string ended in the middle of a byte.
+ */
+APR_DECLARE(apr_status_t) apr_encode_final(apr_encode_ctx_t *ctx,
+        void *dest, apr_size_t *len);
+
 /** @} */
 #ifdef __cplusplus
 }
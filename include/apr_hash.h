@@ -86,6 +86,58 @@ APR_DECLARE(apr_hash_t *) apr_hash_make(apr_pool_t *pool);
 APR_DECLARE(apr_hash_t *) apr_hash_make_custom(apr_pool_t *pool,
                                                apr_hashfunc_t hash_func);
 
+/**
+ * Flag for apr_hash_make_ex(): store the entries in a contiguous array
+ * (open addressing) rather than in chained lists.
+ * @remark Lookups compare the fingerprints of several entries at once and
+ *         touch the keys of the matching ones only, which is faster for
+ *         read-mostly tables, while the memory of deleted entries is
+ *         reclaimed when the table grows or is rehashed only.
+ * @remark Adding entries while iterating may rehash the table, the
+ *         iteration then continues over the entries it had not seen yet
+ *         (if not deleted since), so none is seen twice or missed, while
+ *         the ones added may or may not be seen.
+ */
+#define APR_HASH_OPEN_ADDRESSING 0x01
+
+/**
+ * Flag for apr_hash_make_ex(): hash the keys with a seeded function which
+ * processes them a word at a time (derived from wyhash), rather than the
+ * byte at a time `times 33' default one.
+ * @remark Faster for all but the shortest keys, and with a better
+ *         distribution.  The seed is chosen per table but not secret, use
+ *         APR_HASH_SIPHASH for keys controlled by an untrusted party.
+ * @remark Ignored if a custom hash function is given.
+ */
+#define APR_HASH_FAST_HASH 0x02
+
+/**
+ * Flag for apr_hash_make_ex(): hash the keys with SipHash-2-4 keyed by
+ * random bytes chosen per table, see apr_siphash24().
+ * @remark Slower than the other hash functions but resistant to collision
+ *         (denial of service) attacks, for keys controlled by an untrusted
+ *         party.  The key is obtained from apr_generate_random_bytes(), if
+ *         available, when the table is created.
+ * @remark Ignored if a custom hash function is given, takes precedence
+ *         over APR_HASH_FAST_HASH.
+ */
+#define APR_HASH_SIPHASH 0x04
+
+/**
+ * Create a hash table with the given hash function and implementation.
+ * @param pool The pool to allocate the hash table out of
+ * @param hash_func A custom hash function, or NULL for the default one.
+ * @param flags Zero or an OR of APR_HASH_OPEN_ADDRESSING and one of
+ *        APR_HASH_FAST_HASH or APR_HASH_SIPHASH.
+ * @return The hash table just created
+ * @remark The tables created by apr_hash_copy(), apr_hash_overlay() and
+ *         apr_hash_merge() use the same implementation and hash function
+ *         as the given (base) table.
+ */
+APR_DECLARE(apr_hash_t *) apr_hash_make_ex(apr_pool_t *pool,
+                                           apr_hashfunc_t hash_func,
+                                           apr_uint32_t flags);
+
 /**
  * Make a copy of a hash table
  * @param pool The pool from which to allocate the new hash table
@@ -665,6 +665,29 @@ APR_DECLARE(apr_status_t) apr_socket_sendfile(apr_socket_t *sock,
 APR_DECLARE(apr_status_t) apr_socket_recv(apr_socket_t *sock,
                                    char *buf, apr_size_t *len);
 
+/**
+ * Read data from a network into multiple buffers.
+ * @param sock The socket to read the data from.
+ * @param vec The array of iovec structs to fill, in order
+ * @param nvec The number of iovec structs in the array
+ * @param len Receives the number of bytes actually read
+ * @remark
+ * <PRE>
+ * This functions acts like apr_socket_recv() into the concatenation of
+ * the buffers, with a single system call where readv() is available (or
+ * only the first buffer is filled otherwise).
+ * The number of bytes actually received is stored in argument 4.
+ *
+ * It is possible for both bytes to be received and an APR_EOF or
+ * other error to be returned.
+ *
+ * APR_EINTR is never returned.
+ * </PRE>
+ */
+APR_DECLARE(apr_status_t) apr_socket_recvv(apr_socket_t *sock,
+                                           const struct iovec *vec,
+                                           apr_int32_t nvec, apr_size_t *len);
+
 /**
  * Wait for a socket to be ready for input or output
  * @param sock the socket to wait on
@@ -198,6 +198,33 @@ APR_DECLARE(apr_status_t) apr_pool_create_ex(apr_pool_t **newpool,
                                              apr_allocator_t *allocator)
                           __attribute__((nonnull(1)));
 
+/**
+ * Recycle the small blocks released by apr_pfree(), see apr_pool_create_ex2().
+ */
+#define APR_POOL_FSLAB  0x01
+
+/**
+ * Create a new pool, with flags.
+ * @param newpool The pool we have just created.
+ * @param parent @see apr_pool_create_ex.
+ * @param abort_fn @see apr_pool_create_ex.
+ * @param allocator @see apr_pool_create_ex.
+ * @param flags A bitmask of APR_POOL_F* flags:
+ *        APR_POOL_FSLAB: Small blocks (up to 256 bytes) given back by
+ *        apr_pfree() are kept in per size-class free lists, and reused by
+ *        the subsequent allocations of the same size class, from the same
+ *        pool.  This bounds the memory of long-lived pools which allocate
+ *        and release many small objects.
+ * @remark APR_POOL_FSLAB has no effect when APR_POOL_DEBUG is enabled or
+ *         when running under valgrind.
+ */
+APR_DECLARE(apr_status_t) apr_pool_create_ex2(apr_pool_t **newpool,
+                                              apr_pool_t *parent,
+                                              apr_abortfunc_t abort_fn,
+                                              apr_allocator_t *allocator,
+                                              apr_uint32_t flags)
+                          __attribute__((nonnull(1)));
+
 /**
  * Create a new unmanaged pool.
  * @param newpool The pool we have just created.
@@ -454,6 +481,20 @@ APR_DECLARE(void *) apr_pcalloc_debug(apr_pool_t *p, apr_size_t size,
     apr_pcalloc_debug(p, size, APR_POOL__FILE_LINE__)
 #endif
 
+/**
+ * Give a block of memory back to the pool.
+ * @param p The pool the memory was allocated from
+ * @param mem The memory to release
+ * @param size The size the memory was allocated with
+ * @remark The memory is reused by the next allocations of the same size
+ *         class, from the same pool, if the pool was created with the
+ *         APR_POOL_FSLAB flag.  Otherwise this is a no-op and the memory
+ *         is released when the pool is cleared or destroyed, as usual.
+ * @remark The caller must not use @a mem afterwards.
+ */
+APR_DECLARE(void) apr_pfree(apr_pool_t *p, void *mem, apr_size_t size)
+                  __attribute__((nonnull(1)));
+
 
 /*
  * Pool Properties
@@ -516,6 +557,64 @@ APR_DECLARE(void) apr_pool_tag(apr_pool_t *pool, const char *tag)
 APR_DECLARE(const char *) apr_pool_get_tag(apr_pool_t *pool)
                   __attribute__((nonnull(1)));
 
+/*
+ * Statistics
+ */
+
+/** Memory usage of a pool, see apr_pool_stats_get() */
+typedef struct apr_pool_stats_t {
+    /** Number of memory blocks held by the pool */
+    apr_size_t nodes;
+    /** Total size of these blocks */
+    apr_size_t size;
+    /** Memory allocated from these blocks, including the pool itself */
+    apr_size_t used;
+    /** High-water mark of size since the pool was created */
+    apr_size_t peak;
+    /** Number of (direct) subpools */
+    apr_size_t children;
+} apr_pool_stats_t;
+
+/**
+ * Retrieve the memory usage of a pool, excluding its subpools.
+ * @param pool The pool
+ * @param stats Where to store the statistics
+ * @remark The counters are always maintained (not only with APR_POOL_DEBUG)
+ *         at no cost for apr_palloc(), and gathered on demand.
+ * @remark With APR_POOL_DEBUG, each allocation has its own block and
+ *         the peak is not tracked (reported as the current size).
+ */
+APR_DECLARE(void) apr_pool_stats_get(apr_pool_t *pool,
+                                     apr_pool_stats_t *stats)
+                  __attribute__((nonnull(1,2)));
+
+/**
+ * Callback for apr_pool_stats_walk()
+ * @param pool The pool
+ * @param depth The depth of the pool from where the walk started
+ * @param stats The memory usage of the pool
+ * @param baton The baton given to apr_pool_stats_walk()
+ * @return Zero to continue the walk, non-zero to stop it.
+ */
+typedef int (apr_pool_stats_walk_fn_t)(apr_pool_t *pool, int depth,
+                                       const apr_pool_stats_t *stats,
+                                       void *baton);
+
+/**
+ * Walk a pool and its subpools (depth first), reporting their memory
+ * usage.
+ * @param pool The pool to start from
+ * @param walk_fn The callback called for each pool
+ * @param baton Passed to @a walk_fn
+ * @return Zero, or the non-zero value returned by @a walk_fn to stop.
+ * @remark No pool of the hierarchy may be created, cleared or destroyed
+ *         concurrently, @a walk_fn must not do it either.
+ */
+APR_DECLARE(int) apr_pool_stats_walk(apr_pool_t *pool,
+                                     apr_pool_stats_walk_fn_t *walk_fn,
+                                     void *baton)
+                 __attribute__((nonnull(1,2)));
+
 /*
  * User data management
  */
@@ -610,6 +709,33 @@ APR_DECLARE(void) apr_pool_cleanup_register(
                             apr_status_t (*child_cleanup)(void *))
                   __attribute__((nonnull(3,4)));
 
+/** A registered cleanup, see apr_pool_cleanup_register_ex() */
+typedef struct apr_pool_cleanup_t apr_pool_cleanup_t;
+
+/**
+ * Register a function to be called when a pool is cleared or destroyed,
+ * and return a handle to kill or run it in constant time.
+ * @param p The pool to register the cleanup with
+ * @param data The data to pass to the cleanup function.
+ * @param plain_cleanup The function to call when the pool is cleared
+ *                      or destroyed
+ * @param child_cleanup The function to call when a child process is about
+ *                      to exec - this function is called in the child, obviously!
+ * @return The handle of the cleanup, for apr_pool_cleanup_kill_ex() and
+ *         apr_pool_cleanup_run_ex().
+ * @remark Unlike apr_pool_cleanup_kill() and apr_pool_cleanup_run() which
+ *         search the cleanup by @a data and @a plain_cleanup, the handle
+ *         functions don't depend on the number of cleanups registered.
+ * @remark The handle is valid until the cleanup is killed or run, including
+ *         when the pool is cleared or destroyed.  The handles are recycled
+ *         by later registrations, so an invalid handle must not be used.
+ */
+APR_DECLARE(apr_pool_cleanup_t *) apr_pool_cleanup_register_ex(
+                            apr_pool_t *p, const void *data,
+                            apr_status_t (*plain_cleanup)(void *),
+                            apr_status_t (*child_cleanup)(void *))
+                  __attribute__((nonnull(3,4)));
+
 /**
  * Register a function to be called when a pool is cleared or destroyed.
  *
@@ -643,6 +769,14 @@ APR_DECLARE(void) apr_pool_cleanup_kill(apr_pool_t *p, const void *data,
                                         apr_status_t (*cleanup)(void *))
                   __attribute__((nonnull(3)));
 
+/**
+ * Remove a cleanup registered by apr_pool_cleanup_register_ex().
+ * @param p The pool to remove the cleanup from
+ * @param cleanup The handle of the cleanup
+ */
+APR_DECLARE(void) apr_pool_cleanup_kill_ex(apr_pool_t *p,
+                                           apr_pool_cleanup_t *cleanup);
+
 /**
  * Replace the child cleanup function of a previously registered cleanup.
  *
@@ -676,6 +810,20 @@ APR_DECLARE(apr_status_t) apr_pool_cleanup_run(apr_pool_t *p, void *data,
                                                apr_status_t (*cleanup)(void *))
                           __attribute__((nonnull(3)));
 
+/**
+ * Run a cleanup registered by apr_pool_cleanup_register_ex() immediately
+ * and unregister it.
+ * @param p The pool to remove the cleanup from
+ * @param cleanup The handle of the cleanup
+ * @return The value returned by the cleanup function, or APR_SUCCESS
+ *         without calling it if the cleanup was already killed or run.
+ * @remark The handle is no longer valid once the cleanup was killed or run,
+ *         see apr_pool_cleanup_register_ex().
+ */
+APR_DECLARE(apr_status_t) apr_pool_cleanup_run_ex(apr_pool_t *p,
+                                                  apr_pool_cleanup_t *cleanup)
+                          __attribute__((nonnull(2)));
+
 /**
  * An empty cleanup function.
  *
@@ -70,7 +70,8 @@ struct apr_sha1_ctx_t {
  * and ldap installations.
  * @param clear The plaintext password
  * @param len The length of the plaintext password
- * @param out The encrypted/encoded password
+ * @param out The encrypted/encoded password, of at least
+ *            APR_SHA1PW_IDLEN + 29 bytes (including the trailing \0)
  * @note SHA1 support is useful for migration purposes, but is less
  *     secure than Apache's password format, since Apache's (MD5)
  *     password format uses a random eight character salt to generate
@@ -114,6 +115,21 @@ APR_DECLARE(void) apr_sha1_update_binary(apr_sha1_ctx_t *context,
 APR_DECLARE(void) apr_sha1_final(unsigned char digest[APR_SHA1_DIGESTSIZE],
                                apr_sha1_ctx_t *context);
 
+/**
+ * Compute the SHA digests of several independent messages
+ * @param digests The output buffers in which to store the digests, one
+ *        per message
+ * @param inputs The messages
+ * @param lens The lengths of the messages
+ * @param n The number of messages
+ * @remark When the CPU has no SHA instructions, the messages are hashed
+ * four at a time in the lanes of SSE2 or NEON registers, which pays off
+ * for batches of short messages like password verifications.
+ */
+APR_DECLARE(void) apr_sha1_multi(unsigned char (*digests)[APR_SHA1_DIGESTSIZE],
+                                 const unsigned char * const *inputs,
+                                 const apr_size_t *lens, apr_size_t n);
+
 #ifdef __cplusplus
 }
 #endif
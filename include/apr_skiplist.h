@@ -152,6 +152,23 @@ APR_DECLARE(void *) apr_skiplist_find_compare(apr_skiplist *sl,
  */
 APR_DECLARE(void *) apr_skiplist_find(apr_skiplist *sl, void *data, apr_skiplistnode **iter);
 
+/**
+ * Return the next matching element in the skip list using the current
+ * comparison function, searching from a previously returned node.
+ * @param sl The skip list
+ * @param data The value to search for
+ * @param finger A node of the skip list (as returned by an insertion, a
+ * search or an iteration), or NULL
+ * @param iter A pointer to the returned skip list node representing the element
+ * found
+ * @remark If the finger's element is before @a data, the search starts from
+ * there in O(log d) time, with d the distance between the two, otherwise it
+ * falls back to apr_skiplist_find().
+ */
+APR_DECLARE(void *) apr_skiplist_find_finger(apr_skiplist *sl, void *data,
+                                             apr_skiplistnode *finger,
+                                             apr_skiplistnode **iter);
+
 /**
  * Return the last matching element in the skip list using the specified
  * comparison function.
@@ -220,6 +237,23 @@ APR_DECLARE(apr_skiplistnode *) apr_skiplist_insert_compare(apr_skiplist *sl,
  */
 APR_DECLARE(apr_skiplistnode *) apr_skiplist_insert(apr_skiplist* sl, void *data);
 
+/**
+ * Insert an element into the skip list using the existing comparison function
+ * if it does not already exist, searching its place from a previously
+ * returned node.
+ * @param sl The skip list
+ * @param data The element to insert
+ * @param finger A node of the skip list (as returned by an insertion, a
+ * search or an iteration), or NULL
+ * @remark If the finger's element is before @a data, the search starts from
+ * there in O(log d) time, with d the distance between the two, otherwise it
+ * falls back to apr_skiplist_insert().  Passing the last inserted node thus
+ * makes (almost) monotonic insertions amortized O(1).
+ */
+APR_DECLARE(apr_skiplistnode *) apr_skiplist_insert_finger(apr_skiplist *sl,
+                                                void *data,
+                                                apr_skiplistnode *finger);
+
 /**
  * Add an element into the skip list using the specified comparison function
  * allowing for duplicates.
@@ -240,6 +274,24 @@ APR_DECLARE(apr_skiplistnode *) apr_skiplist_add_compare(apr_skiplist *sl,
  */
 APR_DECLARE(apr_skiplistnode *) apr_skiplist_add(apr_skiplist* sl, void *data);
 
+/**
+ * Add an element into the skip list using the existing comparison function
+ * allowing for duplicates, searching its place from a previously returned
+ * node.
+ * @param sl The skip list
+ * @param data The element to insert
+ * @param finger A node of the skip list (as returned by an insertion, a
+ * search or an iteration), or NULL
+ * @remark If the finger's element is before or equal to @a data, the search
+ * starts from there in O(log d) time, with d the distance between the two,
+ * otherwise it falls back to apr_skiplist_add().  Passing the last added
+ * node thus makes (almost) monotonic insertions, like timers', amortized
+ * O(1).
+ */
+APR_DECLARE(apr_skiplistnode *) apr_skiplist_add_finger(apr_skiplist *sl,
+                                                void *data,
+                                                apr_skiplistnode *finger);
+
 /**
  * Add an element into the skip list using the specified comparison function
  * removing the existing duplicates.
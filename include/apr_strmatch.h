@@ -70,9 +70,50 @@ APR_DECLARE(const char *) apr_strmatch(const apr_strmatch_pattern *pattern,
  * @param s The pattern string
  * @param case_sensitive Whether the matching should be case-sensitive
  * @return a pointer to the compiled pattern, or NULL if compilation fails
+ * @remark With SSE2 or NEON, the string is first scanned for the first and
+ * last characters of the pattern, 16 positions at a time.
  */
 APR_DECLARE(const apr_strmatch_pattern *) apr_strmatch_precompile(apr_pool_t *p, const char *s, int case_sensitive);
 
+/** @see apr_strmatch_multi_precompile */
+typedef struct apr_strmatch_multi_pattern apr_strmatch_multi_pattern;
+
+/**
+ * Precompile a set of patterns for matching any of them in a single pass,
+ * using the Aho-Corasick algorithm
+ * @param p The pool from which to allocate the patterns
+ * @param patterns The pattern strings
+ * @param npatterns The number of patterns
+ * @param case_sensitive Whether the matching should be case-sensitive
+ * @return a pointer to the compiled patterns, or NULL if compilation fails
+ * @remark The compiled automaton has a table of transitions for each
+ * character of the patterns, of the size of the number of distinct
+ * characters used by the patterns, so about 4 * (total length of the
+ * patterns) * (number of distinct characters) bytes.
+ */
+APR_DECLARE(const apr_strmatch_multi_pattern *) apr_strmatch_multi_precompile(
+                                              apr_pool_t *p,
+                                              const char * const *patterns,
+                                              int npatterns,
+                                              int case_sensitive);
+
+/**
+ * Search for any of the precompiled patterns within a string
+ * @param multi The patterns
+ * @param s The string in which to search for the patterns
+ * @param slen The length of s (excluding null terminator)
+ * @param id If not NULL, the location in which to return the index of
+ *        the matching pattern
+ * @return A pointer to the first instance of a pattern in s, or NULL if
+ *         not found
+ * @remark The first instance is the one that ends first, or the longest
+ * one of those ending at the same position.  Further instances can be
+ * found by searching again after the start of the returned one.
+ */
+APR_DECLARE(const char *) apr_strmatch_multi(
+                                    const apr_strmatch_multi_pattern *multi,
+                                    const char *s, apr_size_t slen, int *id);
+
 /** @} */
 #ifdef __cplusplus
 }
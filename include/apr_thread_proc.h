@@ -286,6 +286,26 @@ APR_DECLARE(apr_status_t) apr_threadattr_guardsize_set(apr_threadattr_t *attr,
 APR_DECLARE(apr_status_t) apr_threadattr_max_free_set(apr_threadattr_t *attr,
                                                       apr_size_t size);
 
+/**
+ * Back the memory of the thread pool allocator by huge pages.
+ * @param attr The threadattr to affect
+ * @param on Non-zero if huge pages should be used.
+ * @remark Ignored by apr_thread_create() if the platform does not support
+ *         huge pages, see apr_allocator_hugepages_set().
+ */
+APR_DECLARE(apr_status_t) apr_threadattr_hugepages_set(apr_threadattr_t *attr,
+                                                       int on);
+
+/**
+ * Bind the memory of the thread pool allocator to a NUMA node.
+ * @param attr The threadattr to affect
+ * @param node The preferred NUMA node, or -1 for none.
+ * @remark Ignored by apr_thread_create() if the platform does not support
+ *         NUMA binding, see apr_allocator_numa_node_set().
+ */
+APR_DECLARE(apr_status_t) apr_threadattr_numa_node_set(apr_threadattr_t *attr,
+                                                       int node);
+
 /**
  * Create a new thread of execution
  * @param new_thread The newly created thread handle.
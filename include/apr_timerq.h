@@ -0,0 +1,154 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef APR_TIMERQ_H
+#define APR_TIMERQ_H
+/**
+ * @file apr_timerq.h
+ * @brief APR timer queue implementation
+ */
+
+#include "apr.h"
+#include "apr_pools.h"
+#include "apr_time.h"
+#include "apr_errno.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @defgroup apr_timerq Timer queue
+ * A priority queue of timers, ordered by expiry time.
+ *
+ * Timers are kept in a hierarchical timing wheel, so adding and
+ * cancelling a timer are O(1) operations whatever the number of
+ * pending timers. Timers expiring beyond the span of the wheel
+ * are kept in a binary min-heap until they come in range.
+ *
+ * A timer queue can be used to drive the timeouts of an event loop
+ * built on apr_pollcb_poll(), for instance:
+ * <PRE>
+ *     for (;;) {
+ *         rv = apr_pollcb_poll(pollcb, apr_timerq_timeout(tq, apr_time_now()),
+ *                              process_event, ctx);
+ *         now = apr_time_now();
+ *         while (apr_timerq_pop(tq, now, &data) == APR_SUCCESS) {
+ *             process_timeout(data);
+ *         }
+ *     }
+ * </PRE>
+ * @ingroup APR
+ * @{
+ */
+
+/** Opaque structure used to represent the timer queue */
+typedef struct apr_timerq_t apr_timerq_t;
+
+/** Opaque structure used to represent a timer in the timer queue */
+typedef struct apr_timerq_timer_t apr_timerq_timer_t;
+
+/**
+ * Create a timer queue.
+ * @param tq The pointer in which to return the newly created timer queue
+ * @param resolution The granularity of the timing wheel, or zero to keep
+ *        all the timers in a binary min-heap
+ * @param p The pool from which to allocate the timer queue and its timers
+ * @return APR_EINVAL if the resolution is negative
+ * @remark With a timing wheel, a timer expires on the first tick of the
+ * resolution that is not before its expiry time, hence never early but
+ * possibly up to @a resolution late. A binary min-heap expires timers
+ * exactly, at an O(log n) cost for adding and cancelling them.
+ * @remark The timer queue is not thread safe, the caller must serialize
+ * the accesses.
+ */
+APR_DECLARE(apr_status_t) apr_timerq_create(apr_timerq_t **tq,
+                                            apr_interval_time_t resolution,
+                                            apr_pool_t *p);
+
+/**
+ * Add a timer to the timer queue.
+ * @param tq The timer queue
+ * @param when The expiry time of the timer
+ * @param data The data to return when the timer expires
+ * @param timer If not NULL, the location in which to return the timer,
+ *        usable with apr_timerq_set() and apr_timerq_cancel()
+ * @remark The timer is recycled by the timer queue once it expired or was
+ * cancelled, so the returned timer must not be used after that.
+ */
+APR_DECLARE(apr_status_t) apr_timerq_add(apr_timerq_t *tq, apr_time_t when,
+                                         void *data,
+                                         apr_timerq_timer_t **timer);
+
+/**
+ * Change the expiry time of a pending timer.
+ * @param tq The timer queue
+ * @param timer The timer, as returned by apr_timerq_add()
+ * @param when The new expiry time of the timer
+ * @return APR_EINVAL if the timer is not pending
+ */
+APR_DECLARE(apr_status_t) apr_timerq_set(apr_timerq_t *tq,
+                                         apr_timerq_timer_t *timer,
+                                         apr_time_t when);
+
+/**
+ * Cancel a pending timer.
+ * @param tq The timer queue
+ * @param timer The timer, as returned by apr_timerq_add()
+ * @return APR_EINVAL if the timer is not pending
+ */
+APR_DECLARE(apr_status_t) apr_timerq_cancel(apr_timerq_t *tq,
+                                            apr_timerq_timer_t *timer);
+
+/**
+ * Remove the first expired timer from the timer queue.
+ * @param tq The timer queue
+ * @param now The current time
+ * @param data The location in which to return the data of the timer
+ * @return APR_NOTFOUND if no timer expired at @a now
+ * @remark The expired timers are returned in the order of their expiry
+ * time.
+ */
+APR_DECLARE(apr_status_t) apr_timerq_pop(apr_timerq_t *tq, apr_time_t now,
+                                         void **data);
+
+/**
+ * Return the time to wait for the next timer to expire.
+ * @param tq The timer queue
+ * @param now The current time
+ * @return The timeout, zero if some timer expired already, or -1 if the
+ * timer queue is empty
+ * @remark The timeout may be shorter than the actual expiry time of the
+ * next timer when it is far in the timing wheel, in which case
+ * apr_timerq_pop() will return APR_NOTFOUND and a new timeout should be
+ * computed.
+ */
+APR_DECLARE(apr_interval_time_t) apr_timerq_timeout(apr_timerq_t *tq,
+                                                    apr_time_t now);
+
+/**
+ * Return the number of pending timers in the timer queue, in O(1).
+ * @param tq The timer queue
+ */
+APR_DECLARE(apr_size_t) apr_timerq_count(const apr_timerq_t *tq);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ! APR_TIMERQ_H */
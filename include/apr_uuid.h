@@ -52,6 +52,47 @@ typedef struct {
  */
 APR_DECLARE(void) apr_uuid_get(apr_uuid_t *uuid);
 
+/** Random UUID (RFC 9562 version 4) */
+#define APR_UUID_V4 4
+/** Unix time ordered UUID (RFC 9562 version 7) */
+#define APR_UUID_V7 7
+
+/**
+ * Generate and return a (new) UUID of the given version
+ * @param uuid The resulting UUID
+ * @param version The UUID version, APR_UUID_V4 or APR_UUID_V7
+ * @return APR_SUCCESS, APR_ENOTIMPL if the version is not supported or
+ *         no random source is available, or the error from
+ *         apr_generate_random_bytes()
+ * @remark Version 7 UUIDs start with the milliseconds since the Unix
+ * epoch, followed by a counter which increments within the same
+ * millisecond, so the UUIDs generated by a thread sort in the order
+ * of their generation (which suits database indexes better than
+ * version 1 or 4 UUIDs). The random bits are drawn from a per-thread
+ * buffer, refilled from apr_generate_random_bytes() in batches.
+ */
+APR_DECLARE(apr_status_t) apr_uuid_get_ex(apr_uuid_t *uuid, int version);
+
+/**
+ * Generate several (new) UUIDs of the given version at once
+ * @param uuids The resulting UUIDs
+ * @param n The number of UUIDs to generate
+ * @param version The UUID version, APR_UUID_V4 or APR_UUID_V7
+ * @return See apr_uuid_get_ex()
+ * @remark The clock is read once for all the version 7 UUIDs, which
+ * are then ordered by their counter.
+ */
+APR_DECLARE(apr_status_t) apr_uuid_get_bulk(apr_uuid_t *uuids, apr_size_t n,
+                                            int version);
+
+/**
+ * Forget the state used by apr_uuid_get_ex() after forking.
+ * @remark Call this in the child after forking, so that it does not
+ * generate the same UUIDs as its parent. Note that apr_proc_fork() calls
+ * this for you, so only applications using fork() directly need to.
+ */
+APR_DECLARE(void) apr_uuid_after_fork(void);
+
 /**
  * Format a UUID into a string, following the standard format
  * @param buffer The buffer to place the formatted UUID string into. It must
@@ -66,6 +66,8 @@ struct apr_threadattr_t {
     apr_pool_t *pool;
     pthread_attr_t attr;
     apr_size_t max_free;
+    int hugepages;
+    int numa_node;
 };
 
 struct apr_threadkey_t {
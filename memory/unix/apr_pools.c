@@ -25,6 +25,7 @@
 #include "apr_allocator.h"
 #include "apr_lib.h"
 #include "apr_thread_mutex.h"
+#include "apr_thread_proc.h"
 #include "apr_hash.h"
 #include "apr_time.h"
 #include "apr_support.h"
@@ -44,10 +45,41 @@
 #define APR_ALLOCATOR_USES_MMAP   1
 #endif
 
-#if APR_ALLOCATOR_USES_MMAP
+/* Huge pages and NUMA node binding need nodes carved from (aligned)
+ * mmap()ed arenas.
+ */
+#if HAVE_MMAP && HAVE_MAP_ANON && HAVE_SYS_MMAN_H \
+    && !APR_ALLOCATOR_GUARD_PAGES
+#define APR_ALLOCATOR_ARENAS 1
+#else
+#define APR_ALLOCATOR_ARENAS 0
+#endif
+
+#if APR_ALLOCATOR_USES_MMAP || APR_ALLOCATOR_ARENAS
 #include <sys/mman.h>
 #endif
 
+#if APR_ALLOCATOR_ARENAS && HAVE_DECL_MAP_HUGETLB
+#include <stdio.h>      /* for reading /proc/meminfo */
+#endif
+
+#if APR_ALLOCATOR_ARENAS && HAVE_DECL_SYS_MBIND && HAVE_SYS_SYSCALL_H
+#include <sys/syscall.h>
+#define APR_ALLOCATOR_NUMA 1
+#ifndef MPOL_PREFERRED
+#define MPOL_PREFERRED 1
+#endif
+#else
+#define APR_ALLOCATOR_NUMA 0
+#endif
+
+#if APR_ALLOCATOR_ARENAS && (HAVE_DECL_MAP_HUGETLB \
+                             || (HAVE_MADVISE && HAVE_DECL_MADV_HUGEPAGE))
+#define APR_ALLOCATOR_HUGEPAGES 1
+#else
+#define APR_ALLOCATOR_HUGEPAGES 0
+#endif
+
 #if HAVE_VALGRIND
 #define REDZONE APR_ALIGN_DEFAULT(8)
 int apr_running_on_valgrind = 0;
@@ -57,6 +89,12 @@ int apr_running_on_valgrind = 0;
 #error pool-concurrency-check does not make sense without threads
 #endif
 
+#if APR_HAS_THREADS && APR_HAS_THREAD_LOCAL
+#define APR_ALLOCATOR_THREAD_CACHE 1
+#else
+#define APR_ALLOCATOR_THREAD_CACHE 0
+#endif
+
 
 /*
  * Magic numbers
@@ -69,6 +107,9 @@ int apr_running_on_valgrind = 0;
  */
 #define MAX_INDEX   20
 #define MAX_ORDER   9
+#if MAX_INDEX + 1 != APR_ALLOCATOR_STATS_SLOTS
+#error "APR_ALLOCATOR_STATS_SLOTS does not match the allocator's free lists"
+#endif
 static unsigned int min_order = 1;
 #define MIN_ALLOC   (BOUNDARY_SIZE << min_order)
 
@@ -95,6 +136,28 @@ static unsigned int boundary_size;
 #define GUARDPAGE_SIZE 0
 #endif /* APR_ALLOCATOR_GUARD_PAGES */
 
+#if APR_ALLOCATOR_ARENAS
+/*
+ * Size (and alignment) of the arenas, that of the huge pages on most
+ * architectures.  Nodes bigger than this get their own arena.  The
+ * reserved huge pages are used only if their size divides this one (see
+ * apr_allocator_hugepages_set()), otherwise the arenas are still aligned
+ * for the transparent huge pages.
+ */
+#define ARENA_SIZE      (2 * 1024 * 1024)
+
+/* Highest NUMA node supported by apr_allocator_numa_node_set() */
+#define MAX_NUMA_NODE   1023
+#endif /* APR_ALLOCATOR_ARENAS */
+
+/*
+ * Size classes of the blocks recycled by apr_pfree() in APR_POOL_FSLAB
+ * pools, in APR_ALIGN_DEFAULT (8 bytes) steps up to SLAB_MAX_SIZE.
+ */
+#define SLAB_MAX_SIZE       256
+#define SLAB_NUM_CLASSES    (SLAB_MAX_SIZE >> 3)
+#define SLAB_INDEX(size)    (((size) >> 3) - 1)
+
 /*
  * Timing constants for killing subprocesses
  * There is a total 3-second delay between sending a SIGINT
@@ -112,6 +175,94 @@ static unsigned int boundary_size;
  * indices, but quantities of BOUNDARY_SIZE big memory blocks.
  */
 
+#if APR_ALLOCATOR_THREAD_CACHE
+/*
+ * Maximum number of nodes moved at once from the allocator to a
+ * thread cache when the latter runs out of nodes of some size.
+ */
+#define CACHE_REFILL_MAX 8
+
+typedef struct allocator_cache_t allocator_cache_t;
+
+/*
+ * Per-thread cache of free nodes, see apr_allocator_thread_cache_set().
+ * The cache is linked both in the list of the caches of the allocator
+ * and in the (thread local) list of the caches of the thread.  It is freed
+ * by a cleanup registered on the apr_thread_t's pool, which gives the
+ * cached nodes back to the allocator.  When the allocator is destroyed
+ * first, the cache is unlinked and left to its thread which recycles it
+ * for the next allocator it caches.
+ *
+ * The allocators' lists, and the link of a cache to its allocator, are
+ * protected by caches_mutex rather than by the allocator mutex, which may
+ * be gone already when the allocator is destroyed.
+ */
+struct allocator_cache_t {
+    /** the allocator, set by the thread only */
+    apr_allocator_t    *allocator;
+    /** whether in the allocator's list, cleared if it's destroyed first */
+    volatile apr_uint32_t linked;
+    /** the allocator's list of caches */
+    allocator_cache_t  *next;
+    allocator_cache_t **ref;
+    /** the thread's list of caches */
+    allocator_cache_t  *thread_next;
+    apr_thread_t       *thread;
+    /** Total size (in BOUNDARY_SIZE multiples) of the cached nodes */
+    apr_size_t          current_index;
+    /** Lists of cached nodes, by index (oversized nodes are not cached) */
+    apr_memnode_t      *free[MAX_INDEX];
+};
+
+static APR_THREAD_LOCAL allocator_cache_t *thread_caches = NULL;
+
+/* Created with the global pool, NULL before and after (single threaded) */
+static apr_thread_mutex_t *caches_mutex = NULL;
+
+static APR_INLINE void caches_lock(void)
+{
+    if (caches_mutex)
+        apr_thread_mutex_lock(caches_mutex);
+}
+
+static APR_INLINE void caches_unlock(void)
+{
+    if (caches_mutex)
+        apr_thread_mutex_unlock(caches_mutex);
+}
+
+static apr_status_t caches_mutex_cleanup(void *data)
+{
+    caches_mutex = NULL;
+    return APR_SUCCESS;
+}
+
+static apr_status_t caches_mutex_create(apr_pool_t *pool)
+{
+    apr_status_t rv;
+
+    rv = apr_thread_mutex_create(&caches_mutex, APR_THREAD_MUTEX_DEFAULT,
+                                 pool);
+    if (rv == APR_SUCCESS) {
+        /* Runs before the mutex is destroyed (LIFO) */
+        apr_pool_cleanup_register(pool, NULL, caches_mutex_cleanup,
+                                  apr_pool_cleanup_null);
+    }
+    return rv;
+}
+#endif /* APR_ALLOCATOR_THREAD_CACHE */
+
+#if APR_ALLOCATOR_ARENAS
+typedef struct allocator_arena_t allocator_arena_t;
+
+/* An mmap()ed region carved into nodes, unmapped with the allocator. */
+struct allocator_arena_t {
+    allocator_arena_t *next;
+    char              *base;
+    apr_size_t         size;
+};
+#endif /* APR_ALLOCATOR_ARENAS */
+
 struct apr_allocator_t {
     /** largest used index into free[], always < MAX_INDEX */
     apr_size_t        max_index;
@@ -126,6 +277,13 @@ struct apr_allocator_t {
      * before blocks are given back. Range: 0..max_free_index
      */
     apr_size_t        current_free_index;
+    /** Total size (in BOUNDARY_SIZE multiples) of the nodes currently
+     * obtained from the system, and its high-water mark. Updated without
+     * the mutex, see allocator_total_add().
+     * @see apr_allocator_stats_get().
+     */
+    volatile apr_uint64_t total_index;
+    volatile apr_uint64_t peak_index;
 #if APR_HAS_THREADS
     apr_thread_mutex_t *mutex;
 #endif /* APR_HAS_THREADS */
@@ -142,6 +300,31 @@ struct apr_allocator_t {
      * slot 20: nodes larger than 81920
      */
     apr_memnode_t      *free[MAX_INDEX + 1];
+#if APR_ALLOCATOR_THREAD_CACHE
+    /** Maximum size (in BOUNDARY_SIZE multiples) of each thread cache,
+     * zero when caching is disabled.
+     * @see apr_allocator_thread_cache_set().
+     */
+    apr_size_t          max_cache_index;
+    /** The thread caches currently holding nodes of this allocator */
+    allocator_cache_t  *caches;
+#endif /* APR_ALLOCATOR_THREAD_CACHE */
+#if APR_ALLOCATOR_ARENAS
+    /** Whether some node was ever created, the arenas attributes can't
+     * be changed afterwards.
+     */
+    apr_byte_t          used;
+    /** Whether nodes are carved from arenas (below attributes set) */
+    apr_byte_t          use_arenas;
+    apr_byte_t          hugepages;
+    /** Whether the arenas can be mapped from the reserved huge pages */
+    apr_byte_t          hugetlb;
+    int                 numa_node;
+    allocator_arena_t  *arenas;
+    /** The free space of the current arena */
+    char               *arena_avail;
+    char               *arena_endp;
+#endif /* APR_ALLOCATOR_ARENAS */
 };
 
 #define SIZEOF_ALLOCATOR_T  APR_ALIGN_DEFAULT(sizeof(apr_allocator_t))
@@ -169,6 +352,62 @@ void allocator_unlock(apr_allocator_t *allocator)
 #endif /* APR_HAS_THREADS */
 }
 
+/* The statistics of an allocator with a mutex are updated atomically, so
+ * that allocating from the system does not need to lock it. Without a
+ * mutex, the atomics may not be initialized yet (or anymore).
+ */
+static APR_INLINE
+void allocator_total_add(apr_allocator_t *allocator, apr_size_t index)
+{
+    apr_uint64_t total;
+
+#if APR_HAS_THREADS
+    if (allocator->mutex) {
+        apr_uint64_t peak, prev;
+
+        total = apr_atomic_add64(&allocator->total_index, index) + index;
+        peak = apr_atomic_read64(&allocator->peak_index);
+        while (total > peak) {
+            prev = apr_atomic_cas64(&allocator->peak_index, total, peak);
+            if (prev == peak)
+                break;
+            peak = prev;
+        }
+        return;
+    }
+#endif /* APR_HAS_THREADS */
+
+    total = allocator->total_index += index;
+    if (total > allocator->peak_index)
+        allocator->peak_index = total;
+}
+
+static APR_INLINE
+void allocator_total_sub(apr_allocator_t *allocator, apr_size_t index)
+{
+#if APR_HAS_THREADS
+    if (allocator->mutex) {
+        apr_atomic_sub64(&allocator->total_index, index);
+        return;
+    }
+#endif /* APR_HAS_THREADS */
+
+    allocator->total_index -= index;
+}
+
+static APR_INLINE
+apr_uint64_t allocator_total_read(apr_allocator_t *allocator,
+                                  volatile apr_uint64_t *index)
+{
+#if APR_HAS_THREADS
+    if (allocator->mutex) {
+        return apr_atomic_read64(index);
+    }
+#endif /* APR_HAS_THREADS */
+
+    return *index;
+}
+
 APR_DECLARE(apr_status_t) apr_allocator_create(apr_allocator_t **allocator)
 {
     apr_allocator_t *new_allocator;
@@ -180,30 +419,77 @@ APR_DECLARE(apr_status_t) apr_allocator_create(apr_allocator_t **allocator)
 
     memset(new_allocator, 0, SIZEOF_ALLOCATOR_T);
     new_allocator->max_free_index = APR_ALLOCATOR_MAX_FREE_UNLIMITED;
+#if APR_ALLOCATOR_ARENAS
+    new_allocator->numa_node = -1;
+#endif
 
     *allocator = new_allocator;
 
     return APR_SUCCESS;
 }
 
+static APR_INLINE
+void allocator_node_free(apr_allocator_t *allocator, apr_memnode_t *node)
+{
+#if APR_ALLOCATOR_ARENAS
+    /* Unmapped with the arenas */
+    if (allocator->use_arenas)
+        return;
+#endif
+#if APR_ALLOCATOR_USES_MMAP
+    munmap((char *)node - GUARDPAGE_SIZE,
+           2 * GUARDPAGE_SIZE + ((node->index+1) << BOUNDARY_INDEX));
+#else
+    free(node);
+#endif
+}
+
 APR_DECLARE(void) apr_allocator_destroy(apr_allocator_t *allocator)
 {
     apr_size_t index;
     apr_memnode_t *node, **ref;
+#if APR_ALLOCATOR_THREAD_CACHE
+    allocator_cache_t *cache;
+
+    /* Free the nodes still held by the thread caches and unlink them, the
+     * caches themselves are recycled or freed by their thread.
+     */
+    caches_lock();
+    while ((cache = allocator->caches) != NULL) {
+        allocator->caches = cache->next;
+        for (index = 0; index < MAX_INDEX; index++) {
+            ref = &cache->free[index];
+            while ((node = *ref) != NULL) {
+                *ref = node->next;
+                allocator_node_free(allocator, node);
+            }
+        }
+        cache->current_index = 0;
+        cache->next = NULL;
+        cache->ref = NULL;
+        apr_atomic_set32(&cache->linked, 0);
+    }
+    caches_unlock();
+#endif /* APR_ALLOCATOR_THREAD_CACHE */
 
     for (index = 0; index <= MAX_INDEX; index++) {
         ref = &allocator->free[index];
         while ((node = *ref) != NULL) {
             *ref = node->next;
-#if APR_ALLOCATOR_USES_MMAP
-            munmap((char *)node - GUARDPAGE_SIZE,
-                   2 * GUARDPAGE_SIZE + ((node->index+1) << BOUNDARY_INDEX));
-#else
-            free(node);
-#endif
+            allocator_node_free(allocator, node);
         }
     }
 
+#if APR_ALLOCATOR_ARENAS
+    while (allocator->arenas) {
+        allocator_arena_t *arena = allocator->arenas;
+
+        allocator->arenas = arena->next;
+        munmap(arena->base, arena->size);
+        free(arena);
+    }
+#endif /* APR_ALLOCATOR_ARENAS */
+
     free(allocator);
 }
 
@@ -250,31 +536,527 @@ APR_DECLARE(void) apr_allocator_max_free_set(apr_allocator_t *allocator,
     allocator_unlock(allocator);
 }
 
+APR_DECLARE(apr_status_t) apr_allocator_thread_cache_set(
+                                      apr_allocator_t *allocator,
+                                      apr_size_t in_size)
+{
+#if APR_ALLOCATOR_THREAD_CACHE
+    apr_size_t size = in_size;
+
+    allocator_lock(allocator);
+    allocator->max_cache_index = APR_ALIGN(size, BOUNDARY_SIZE)
+                                 >> BOUNDARY_INDEX;
+    allocator_unlock(allocator);
+
+    return APR_SUCCESS;
+#else
+    (void)allocator;
+    (void)in_size;
+    return APR_ENOTIMPL;
+#endif /* APR_ALLOCATOR_THREAD_CACHE */
+}
+
+#if APR_ALLOCATOR_HUGEPAGES && HAVE_DECL_MAP_HUGETLB
+/* The size of the reserved huge pages (MAP_HUGETLB), or 0 if unknown */
+static apr_size_t hugetlb_page_size(void)
+{
+    apr_size_t size = 0;
+    unsigned long kb;
+    char line[128];
+    FILE *f;
+
+    if ((f = fopen("/proc/meminfo", "r")) == NULL)
+        return 0;
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "Hugepagesize: %lu kB", &kb) == 1) {
+            size = (apr_size_t)kb * 1024;
+            break;
+        }
+    }
+    fclose(f);
+
+    return size;
+}
+#endif
+
+APR_DECLARE(apr_status_t) apr_allocator_hugepages_set(
+                                      apr_allocator_t *allocator,
+                                      int on)
+{
+#if APR_ALLOCATOR_HUGEPAGES
+    if (allocator->used)
+        return APR_EBUSY;
+
+#if HAVE_DECL_MAP_HUGETLB
+    /* The arenas are mapped and unmapped by ARENA_SIZE multiples, which
+     * must then be multiples of the reserved huge pages size too.
+     */
+    if (on) {
+        apr_size_t size = hugetlb_page_size();
+        allocator->hugetlb = (size && ARENA_SIZE % size == 0);
+    }
+    else {
+        allocator->hugetlb = 0;
+    }
+#endif
+    allocator->hugepages = (on != 0);
+    allocator->use_arenas = (allocator->hugepages
+                             || allocator->numa_node >= 0);
+
+    return APR_SUCCESS;
+#else
+    (void)allocator;
+    (void)on;
+    return APR_ENOTIMPL;
+#endif /* APR_ALLOCATOR_HUGEPAGES */
+}
+
+APR_DECLARE(apr_status_t) apr_allocator_numa_node_set(
+                                      apr_allocator_t *allocator,
+                                      int node)
+{
+#if APR_ALLOCATOR_NUMA
+    if (node > MAX_NUMA_NODE)
+        return APR_EINVAL;
+    if (allocator->used)
+        return APR_EBUSY;
+
+    allocator->numa_node = node < 0 ? -1 : node;
+    allocator->use_arenas = (allocator->hugepages
+                             || allocator->numa_node >= 0);
+
+    return APR_SUCCESS;
+#else
+    (void)allocator;
+    (void)node;
+    return APR_ENOTIMPL;
+#endif /* APR_ALLOCATOR_NUMA */
+}
+
 static APR_INLINE
 apr_size_t allocator_align(apr_size_t in_size)
 {
     apr_size_t size = in_size;
 
-    /* Round up the block size to the next boundary, but always
-     * allocate at least a certain size (MIN_ALLOC).
+    /* Round up the block size to the next boundary, but always
+     * allocate at least a certain size (MIN_ALLOC).
+     */
+    size = APR_ALIGN(size + APR_MEMNODE_T_SIZE, BOUNDARY_SIZE);
+    if (size < in_size) {
+        return 0;
+    }
+    if (size < MIN_ALLOC) {
+        size = MIN_ALLOC;
+    }
+
+    return size;
+}
+
+APR_DECLARE(apr_size_t) apr_allocator_align(apr_allocator_t *allocator,
+                                            apr_size_t size)
+{
+    (void)allocator;
+    return allocator_align(size);
+}
+
+APR_DECLARE(void) apr_allocator_stats_get(apr_allocator_t *allocator,
+                                          apr_allocator_stats_t *stats)
+{
+    apr_memnode_t *node;
+    apr_size_t index, free_index = 0;
+#if APR_ALLOCATOR_THREAD_CACHE
+    allocator_cache_t *cache;
+    apr_size_t cache_index = 0;
+#endif
+
+    memset(stats, 0, sizeof(*stats));
+
+    allocator_lock(allocator);
+
+    for (index = 0; index <= MAX_INDEX; index++) {
+        for (node = allocator->free[index]; node; node = node->next) {
+            stats->free_nodes[index]++;
+            free_index += node->index + 1;
+        }
+    }
+    stats->total = (apr_size_t)allocator_total_read(allocator,
+                                                    &allocator->total_index)
+                   << BOUNDARY_INDEX;
+    stats->peak = (apr_size_t)allocator_total_read(allocator,
+                                                   &allocator->peak_index)
+                  << BOUNDARY_INDEX;
+    stats->max_free = allocator->max_free_index << BOUNDARY_INDEX;
+    stats->current_free = allocator->current_free_index << BOUNDARY_INDEX;
+
+    allocator_unlock(allocator);
+
+#if APR_ALLOCATOR_THREAD_CACHE
+    /* Racy with the threads owning the caches, but good enough for
+     * an estimate.
+     */
+    caches_lock();
+    for (cache = allocator->caches; cache; cache = cache->next) {
+        cache_index += cache->current_index;
+    }
+    caches_unlock();
+    stats->cached = cache_index << BOUNDARY_INDEX;
+#endif
+
+    stats->free = free_index << BOUNDARY_INDEX;
+    if (stats->total > stats->free + stats->cached)
+        stats->in_use = stats->total - stats->free - stats->cached;
+}
+
+#if APR_ALLOCATOR_ARENAS
+/*
+ * Arenas
+ */
+
+/* Map a new arena of the given size (a multiple of ARENA_SIZE), aligned
+ * on ARENA_SIZE and with the allocator's attributes.
+ */
+static char *arena_map(apr_allocator_t *allocator, apr_size_t size)
+{
+    char *mem = MAP_FAILED, *base;
+    apr_size_t head;
+
+#if HAVE_DECL_MAP_HUGETLB
+    /* Try the reserved huge pages first, if any and fitting */
+    if (allocator->hugetlb) {
+        mem = mmap(NULL, size, PROT_READ|PROT_WRITE,
+                   MAP_PRIVATE|MAP_ANON|MAP_HUGETLB, -1, 0);
+    }
+#endif
+    if (mem == MAP_FAILED) {
+        /* Map more than needed and trim to align the arena, so that it
+         * can be backed by (transparent) huge pages.
+         */
+        mem = mmap(NULL, size + ARENA_SIZE, PROT_READ|PROT_WRITE,
+                   MAP_PRIVATE|MAP_ANON, -1, 0);
+        if (mem == MAP_FAILED)
+            return NULL;
+
+        base = (char *)APR_ALIGN((apr_uintptr_t)mem, ARENA_SIZE);
+        head = base - mem;
+        if (head)
+            munmap(mem, head);
+        munmap(base + size, ARENA_SIZE - head);
+        mem = base;
+
+#if HAVE_MADVISE && HAVE_DECL_MADV_HUGEPAGE
+        if (allocator->hugepages)
+            madvise(mem, size, MADV_HUGEPAGE);
+#endif
+    }
+
+#if APR_ALLOCATOR_NUMA
+    /* Best effort, the pages are allocated elsewhere if the node is
+     * out of memory.
+     */
+    if (allocator->numa_node >= 0) {
+        unsigned long mask[(MAX_NUMA_NODE + 1) / (8 * sizeof(unsigned long))];
+        unsigned long bits = 8 * sizeof(unsigned long);
+        unsigned long node = (unsigned long)allocator->numa_node;
+
+        memset(mask, 0, sizeof(mask));
+        mask[node / bits] |= 1UL << (node % bits);
+        (void)syscall(SYS_mbind, mem, size, MPOL_PREFERRED, mask,
+                      (node / bits + 1) * bits + 1, 0);
+    }
+#endif
+
+    return mem;
+}
+
+/* Carve a new node of the given size from the current arena, or from a
+ * new one.  The node is not initialized.
+ */
+static apr_memnode_t *allocator_arena_alloc(apr_allocator_t *allocator,
+                                            apr_size_t size)
+{
+    allocator_arena_t *arena;
+    apr_memnode_t *node;
+    apr_size_t rest, index;
+
+    allocator_lock(allocator);
+
+    if (size > (apr_size_t)(allocator->arena_endp - allocator->arena_avail)) {
+        if ((arena = malloc(sizeof(*arena))) == NULL) {
+            allocator_unlock(allocator);
+            return NULL;
+        }
+        arena->size = APR_ALIGN(size, ARENA_SIZE);
+        if ((arena->base = arena_map(allocator, arena->size)) == NULL) {
+            allocator_unlock(allocator);
+            free(arena);
+            return NULL;
+        }
+        arena->next = allocator->arenas;
+        allocator->arenas = arena;
+
+        /* Don't waste the rest of the current arena, give it to the
+         * free lists as a single node.
+         */
+        rest = allocator->arena_endp - allocator->arena_avail;
+        if (rest >= MIN_ALLOC) {
+            node = (apr_memnode_t *)allocator->arena_avail;
+            index = (rest >> BOUNDARY_INDEX) - 1;
+            node->index = (apr_uint32_t)index;
+            node->endp = (char *)node + rest;
+            if (index < MAX_INDEX) {
+                if (index > allocator->max_index)
+                    allocator->max_index = index;
+            }
+            else {
+                index = MAX_INDEX;
+            }
+            node->next = allocator->free[index];
+            allocator->free[index] = node;
+            allocator_total_add(allocator, node->index + 1);
+        }
+
+        allocator->arena_avail = arena->base;
+        allocator->arena_endp = arena->base + arena->size;
+    }
+
+    node = (apr_memnode_t *)allocator->arena_avail;
+    allocator->arena_avail += size;
+
+    allocator_unlock(allocator);
+
+    return node;
+}
+#endif /* APR_ALLOCATOR_ARENAS */
+
+#if APR_ALLOCATOR_THREAD_CACHE
+/*
+ * Thread cache
+ */
+
+static void allocator_free_nodes(apr_allocator_t *allocator,
+                                 apr_memnode_t *node);
+
+/* Move the biggest nodes out of the cache (to the *spill list) until
+ * its size is at most max_index.
+ */
+static void allocator_cache_spill(allocator_cache_t *cache,
+                                  apr_memnode_t **spill,
+                                  apr_size_t max_index)
+{
+    apr_memnode_t *node;
+    apr_size_t index = MAX_INDEX;
+
+    while (cache->current_index > max_index && index--) {
+        while (cache->current_index > max_index
+               && (node = cache->free[index]) != NULL) {
+            cache->free[index] = node->next;
+            cache->current_index -= index + 1;
+            node->next = *spill;
+            *spill = node;
+        }
+    }
+}
+
+static apr_status_t allocator_cache_cleanup(void *data)
+{
+    allocator_cache_t *cache = data, **ref;
+    apr_memnode_t *spill = NULL;
+
+    /* The thread may be gone already (apr_thread_join()), otherwise
+     * forget about this cache.
+     */
+    if (cache->thread == apr_thread_current()) {
+        for (ref = &thread_caches; *ref; ref = &(*ref)->thread_next) {
+            if (*ref == cache) {
+                *ref = cache->thread_next;
+                break;
+            }
+        }
+    }
+
+    /* Give the cached nodes back to the allocator, if still alive (it
+     * can't be destroyed until the cache is unlinked).
+     */
+    caches_lock();
+    if (cache->linked) {
+        if ((*cache->ref = cache->next) != NULL)
+            cache->next->ref = cache->ref;
+
+        allocator_cache_spill(cache, &spill, 0);
+        if (spill)
+            allocator_free_nodes(cache->allocator, spill);
+    }
+    caches_unlock();
+
+    free(cache);
+
+    return APR_SUCCESS;
+}
+
+/* Get the calling thread's cache for the allocator, creating it if
+ * needed.  Returns NULL if the thread can't have one.
+ */
+static allocator_cache_t *allocator_cache_get(apr_allocator_t *allocator)
+{
+    allocator_cache_t *cache, *orphan = NULL;
+    apr_thread_t *thread;
+    apr_pool_t *pool;
+
+    for (cache = thread_caches; cache; cache = cache->thread_next) {
+        if (!apr_atomic_read32(&cache->linked)) {
+            if (orphan == NULL)
+                orphan = cache;
+        }
+        else if (cache->allocator == allocator) {
+            return cache;
+        }
+    }
+
+    /* The cache is bound to the lifetime of the apr_thread_t (through
+     * its pool), so only APR threads can have one.  The thread pool's
+     * own allocator is not cached since registering the cleanup would
+     * recurse into it.
+     */
+    if ((thread = apr_thread_current()) == NULL)
+        return NULL;
+    pool = apr_thread_pool_get(thread);
+    if (apr_pool_allocator_get(pool) == allocator)
+        return NULL;
+
+    /* Recycle the (empty) cache of a destroyed allocator if any, so that
+     * the thread's list is bounded by the allocators alive.
+     */
+    if ((cache = orphan) == NULL) {
+        if ((cache = calloc(1, sizeof(*cache))) == NULL)
+            return NULL;
+
+        cache->thread = thread;
+        cache->thread_next = thread_caches;
+        thread_caches = cache;
+
+        apr_pool_cleanup_register(pool, cache, allocator_cache_cleanup,
+                                  apr_pool_cleanup_null);
+    }
+    cache->allocator = allocator;
+
+    caches_lock();
+
+    if ((cache->next = allocator->caches) != NULL)
+        cache->next->ref = &cache->next;
+    allocator->caches = cache;
+    cache->ref = &allocator->caches;
+    apr_atomic_set32(&cache->linked, 1);
+
+    caches_unlock();
+
+    return cache;
+}
+
+/* Take a node of the given index from the thread cache, refilling it
+ * from the allocator in batches.  Returns NULL if none is available.
+ */
+static apr_memnode_t *allocator_cache_alloc(apr_allocator_t *allocator,
+                                            apr_size_t index)
+{
+    allocator_cache_t *cache;
+    apr_memnode_t *node, *last;
+    apr_size_t max_index, count;
+
+    if ((cache = allocator_cache_get(allocator)) == NULL)
+        return NULL;
+
+    if ((node = cache->free[index]) != NULL) {
+        cache->free[index] = node->next;
+        cache->current_index -= index + 1;
+        return node;
+    }
+
+    allocator_lock(allocator);
+
+    if (index > allocator->max_index
+        || (node = allocator->free[index]) == NULL) {
+        allocator_unlock(allocator);
+        return NULL;
+    }
+
+    /* Take up to CACHE_REFILL_MAX nodes of this size, the first one
+     * for the caller and the others for the cache, but don't fill more
+     * than half of the cache.
      */
-    size = APR_ALIGN(size + APR_MEMNODE_T_SIZE, BOUNDARY_SIZE);
-    if (size < in_size) {
-        return 0;
+    last = node;
+    count = 1;
+    while (last->next && count < CACHE_REFILL_MAX
+           && cache->current_index + count * (index + 1)
+              <= allocator->max_cache_index / 2) {
+        last = last->next;
+        count++;
     }
-    if (size < MIN_ALLOC) {
-        size = MIN_ALLOC;
+
+    if ((allocator->free[index] = last->next) == NULL
+        && index >= allocator->max_index) {
+        max_index = index;
+        while (allocator->free[max_index] == NULL && max_index)
+            max_index--;
+
+        allocator->max_index = max_index;
     }
 
-    return size;
+    allocator->current_free_index += count * (index + 1);
+    if (allocator->current_free_index > allocator->max_free_index)
+        allocator->current_free_index = allocator->max_free_index;
+
+    allocator_unlock(allocator);
+
+    last->next = NULL;
+    cache->free[index] = node->next;
+    cache->current_index += (count - 1) * (index + 1);
+
+    return node;
 }
 
-APR_DECLARE(apr_size_t) apr_allocator_align(apr_allocator_t *allocator,
-                                            apr_size_t size)
+/* Put the given nodes in the thread cache, making room by spilling the
+ * biggest cached nodes when it's full.  Returns the nodes which should
+ * go to the allocator, or NULL if none.
+ */
+static apr_memnode_t *allocator_cache_free(apr_allocator_t *allocator,
+                                           apr_memnode_t *node)
 {
-    (void)allocator;
-    return allocator_align(size);
+    allocator_cache_t *cache;
+    apr_memnode_t *next, *spill = NULL;
+    apr_size_t index, max_index = allocator->max_cache_index;
+
+    if ((cache = allocator_cache_get(allocator)) == NULL)
+        return node;
+
+    do {
+        next = node->next;
+        index = node->index;
+
+        if (index >= MAX_INDEX || index + 1 > max_index) {
+            node->next = spill;
+            spill = node;
+            continue;
+        }
+
+        if (cache->current_index + index + 1 > max_index) {
+            apr_size_t room = max_index - (index + 1);
+
+            allocator_cache_spill(cache, &spill,
+                                  room < max_index / 2 ? room
+                                                       : max_index / 2);
+        }
+
+        APR_VALGRIND_NOACCESS((char *)node + APR_MEMNODE_T_SIZE,
+                              (node->index+1) << BOUNDARY_INDEX);
+
+        node->next = cache->free[index];
+        cache->free[index] = node;
+        cache->current_index += index + 1;
+    } while ((node = next) != NULL);
+
+    return spill;
 }
+#endif /* APR_ALLOCATOR_THREAD_CACHE */
 
 static APR_INLINE
 apr_memnode_t *allocator_alloc(apr_allocator_t *allocator, apr_size_t in_size)
@@ -300,6 +1082,15 @@ apr_memnode_t *allocator_alloc(apr_allocator_t *allocator, apr_size_t in_size)
         return NULL;
     }
 
+#if APR_ALLOCATOR_THREAD_CACHE
+    /* Try the thread cache first, it needs no locking.
+     */
+    if (allocator->max_cache_index && index < MAX_INDEX
+        && (node = allocator_cache_alloc(allocator, index)) != NULL) {
+        goto have_node;
+    }
+#endif /* APR_ALLOCATOR_THREAD_CACHE */
+
     /* First see if there are any nodes in the area we know
      * our node will fit into.
      */
@@ -389,6 +1180,14 @@ apr_memnode_t *allocator_alloc(apr_allocator_t *allocator, apr_size_t in_size)
     /* If we haven't got a suitable node, malloc a new one
      * and initialize it.
      */
+#if APR_ALLOCATOR_ARENAS
+    allocator->used = 1;
+    if (allocator->use_arenas) {
+        if ((node = allocator_arena_alloc(allocator, size)) == NULL)
+            return NULL;
+    }
+    else
+#endif
 #if APR_ALLOCATOR_GUARD_PAGES
     if ((node = mmap(NULL, size + 2 * GUARDPAGE_SIZE, PROT_NONE,
                      MAP_PRIVATE|MAP_ANON, -1, 0)) == MAP_FAILED)
@@ -410,6 +1209,8 @@ apr_memnode_t *allocator_alloc(apr_allocator_t *allocator, apr_size_t in_size)
     node->index = (apr_uint32_t)index;
     node->endp = (char *)node + size;
 
+    allocator_total_add(allocator, index + 1);
+
 have_node:
     node->next = NULL;
     node->first_avail = (char *)node + APR_MEMNODE_T_SIZE;
@@ -419,8 +1220,8 @@ have_node:
     return node;
 }
 
-static APR_INLINE
-void allocator_free(apr_allocator_t *allocator, apr_memnode_t *node)
+static void allocator_free_nodes(apr_allocator_t *allocator,
+                                 apr_memnode_t *node)
 {
     apr_memnode_t *next, *freelist = NULL;
     apr_size_t index, max_index;
@@ -443,9 +1244,14 @@ void allocator_free(apr_allocator_t *allocator, apr_memnode_t *node)
                               (node->index+1) << BOUNDARY_INDEX);
 
         if (max_free_index != APR_ALLOCATOR_MAX_FREE_UNLIMITED
-            && index + 1 > current_free_index) {
+            && index + 1 > current_free_index
+#if APR_ALLOCATOR_ARENAS
+            && !allocator->use_arenas
+#endif
+            ) {
             node->next = freelist;
             freelist = node;
+            allocator_total_sub(allocator, index + 1);
         }
         else if (index < MAX_INDEX) {
             /* Add the node to the appropriate 'size' bucket.  Adjust
@@ -482,15 +1288,23 @@ void allocator_free(apr_allocator_t *allocator, apr_memnode_t *node)
     while (freelist != NULL) {
         node = freelist;
         freelist = node->next;
-#if APR_ALLOCATOR_USES_MMAP
-        munmap((char *)node - GUARDPAGE_SIZE,
-               2 * GUARDPAGE_SIZE + ((node->index+1) << BOUNDARY_INDEX));
-#else
-        free(node);
-#endif
+        allocator_node_free(allocator, node);
     }
 }
 
+static APR_INLINE
+void allocator_free(apr_allocator_t *allocator, apr_memnode_t *node)
+{
+#if APR_ALLOCATOR_THREAD_CACHE
+    if (allocator->max_cache_index
+        && (node = allocator_cache_free(allocator, node)) == NULL) {
+        return;
+    }
+#endif /* APR_ALLOCATOR_THREAD_CACHE */
+
+    allocator_free_nodes(allocator, node);
+}
+
 APR_DECLARE(apr_memnode_t *) apr_allocator_alloc(apr_allocator_t *allocator,
                                                  apr_size_t size)
 {
@@ -536,7 +1350,7 @@ APR_DECLARE(apr_status_t) apr_allocator_min_order_set(unsigned int order)
  * Structures
  */
 
-typedef struct cleanup_t cleanup_t;
+typedef struct apr_pool_cleanup_t cleanup_t;
 
 /** A list of processes */
 struct process_chain {
@@ -586,6 +1400,9 @@ struct apr_pool_t {
     apr_memnode_t        *active;
     apr_memnode_t        *self; /* The node containing the pool itself */
     char                 *self_first_avail;
+    void                **slab_free; /* APR_POOL_FSLAB free lists, or NULL */
+    apr_size_t            stat_size; /* Size of the nodes, and its peak */
+    apr_size_t            stat_peak;
 
 #else /* APR_POOL_DEBUG */
     apr_pool_t           *joined; /* the caller has guaranteed that this pool
@@ -718,6 +1535,11 @@ APR_DECLARE(apr_status_t) apr_pool_initialize(void)
         apr_allocator_mutex_set(global_allocator, mutex);
     }
 #endif /* APR_HAS_THREADS */
+#if APR_ALLOCATOR_THREAD_CACHE
+    if ((rv = caches_mutex_create(global_pool)) != APR_SUCCESS) {
+        return rv;
+    }
+#endif
 
     apr_allocator_owner_set(global_allocator, global_pool);
 
@@ -823,6 +1645,14 @@ static APR_INLINE void pool_concurrency_set_destroyed(apr_pool_t *pool) { }
  * Memory allocation
  */
 
+/* Account a node newly obtained from the allocator by the pool */
+static APR_INLINE void pool_stat_grow(apr_pool_t *pool, apr_memnode_t *node)
+{
+    pool->stat_size += node->endp - (char *)node;
+    if (pool->stat_size > pool->stat_peak)
+        pool->stat_peak = pool->stat_size;
+}
+
 APR_DECLARE(void *) apr_palloc(apr_pool_t *pool, apr_size_t in_size)
 {
     apr_memnode_t *active, *node;
@@ -842,6 +1672,16 @@ APR_DECLARE(void *) apr_palloc(apr_pool_t *pool, apr_size_t in_size)
 
         return NULL;
     }
+    /* Recycle a block released by apr_pfree(), if any. */
+    if (pool->slab_free && size && size <= SLAB_MAX_SIZE) {
+        void **slot = &pool->slab_free[SLAB_INDEX(size)];
+
+        if ((mem = *slot) != NULL) {
+            *slot = *(void **)mem;
+            goto have_mem;
+        }
+    }
+
     active = pool->active;
 
     /* If the active node has enough bytes left, use it. */
@@ -863,6 +1703,7 @@ APR_DECLARE(void *) apr_palloc(apr_pool_t *pool, apr_size_t in_size)
 
             return NULL;
         }
+        pool_stat_grow(pool, node);
     }
 
     node->free_index = 0;
@@ -964,11 +1805,16 @@ APR_DECLARE(void) apr_pool_clear(apr_pool_t *pool)
     /* Clear the user data. */
     pool->user_data = NULL;
 
+    /* Forget about the released blocks. */
+    if (pool->slab_free)
+        memset(pool->slab_free, 0, SLAB_NUM_CLASSES * sizeof(void *));
+
     /* Find the node attached to the pool structure, reset it, make
      * it the active node and free the rest of the nodes.
      */
     active = pool->active = pool->self;
     active->first_avail = pool->self_first_avail;
+    pool->stat_size = active->endp - (char *)active;
 
     APR_IF_VALGRIND(VALGRIND_MEMPOOL_TRIM(pool, pool, 1));
 
@@ -1033,6 +1879,10 @@ APR_DECLARE(void) apr_pool_destroy(apr_pool_t *pool)
          * be invalid now.
          */
         apr_allocator_mutex_set(allocator, NULL);
+#if APR_ALLOCATOR_THREAD_CACHE
+        /* Nor cache the nodes about to be destroyed with the allocator */
+        allocator->max_cache_index = 0;
+#endif
     }
 #endif /* APR_HAS_THREADS */
 
@@ -1114,6 +1964,8 @@ APR_DECLARE(apr_status_t) apr_pool_create_ex(apr_pool_t **newpool,
     pool->subprocesses = NULL;
     pool->user_data = NULL;
     pool->tag = NULL;
+    pool->slab_free = NULL;
+    pool->stat_size = pool->stat_peak = node->endp - (char *)node;
 
 #ifdef NETWARE
     pool->owner_proc = (apr_os_proc_t)getnlmhandle();
@@ -1142,6 +1994,56 @@ APR_DECLARE(apr_status_t) apr_pool_create_ex(apr_pool_t **newpool,
     return APR_SUCCESS;
 }
 
+APR_DECLARE(apr_status_t) apr_pool_create_ex2(apr_pool_t **newpool,
+                                              apr_pool_t *parent,
+                                              apr_abortfunc_t abort_fn,
+                                              apr_allocator_t *allocator,
+                                              apr_uint32_t flags)
+{
+    apr_pool_t *pool;
+    apr_status_t rv;
+
+    rv = apr_pool_create_ex(newpool, parent, abort_fn, allocator);
+    if (rv != APR_SUCCESS)
+        return rv;
+
+    pool = *newpool;
+
+#if HAVE_VALGRIND
+    /* Leave the redzones alone */
+    if (apr_running_on_valgrind)
+        flags &= ~APR_POOL_FSLAB;
+#endif
+
+    if (flags & APR_POOL_FSLAB) {
+        /* The free lists live in the pool's own node, right after the
+         * pool struct, so that they survive apr_pool_clear().
+         */
+        pool->slab_free = apr_pcalloc(pool, SLAB_NUM_CLASSES
+                                            * sizeof(void *));
+        pool->self_first_avail = pool->self->first_avail;
+    }
+
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(void) apr_pfree(apr_pool_t *pool, void *mem, apr_size_t in_size)
+{
+    apr_size_t size;
+
+    if (!pool->slab_free || !mem)
+        return;
+
+    size = APR_ALIGN_DEFAULT(in_size);
+    if (!size || size > SLAB_MAX_SIZE)
+        return;
+
+    pool_concurrency_set_used(pool);
+    *(void **)mem = pool->slab_free[SLAB_INDEX(size)];
+    pool->slab_free[SLAB_INDEX(size)] = mem;
+    pool_concurrency_set_idle(pool);
+}
+
 APR_DECLARE(apr_status_t) apr_pool_create_unmanaged_ex(apr_pool_t **newpool,
                                                   apr_abortfunc_t abort_fn,
                                                   apr_allocator_t *allocator)
@@ -1195,6 +2097,8 @@ APR_DECLARE(apr_status_t) apr_pool_create_unmanaged_ex(apr_pool_t **newpool,
     pool->subprocesses = NULL;
     pool->user_data = NULL;
     pool->tag = NULL;
+    pool->slab_free = NULL;
+    pool->stat_size = pool->stat_peak = node->endp - (char *)node;
     pool->parent = NULL;
     pool->sibling = NULL;
     pool->ref = NULL;
@@ -1421,6 +2325,7 @@ APR_DECLARE(char *) apr_pvsprintf(apr_pool_t *pool, const char *fmt, va_list ap)
 
     active = pool->active;
     node = ps.node;
+    pool_stat_grow(pool, node);
 
     node->free_index = 0;
 
@@ -1463,6 +2368,33 @@ error:
     return NULL;
 }
 
+APR_DECLARE(void) apr_pool_stats_get(apr_pool_t *pool,
+                                     apr_pool_stats_t *stats)
+{
+    apr_memnode_t *node;
+    apr_pool_t *child;
+
+    memset(stats, 0, sizeof(*stats));
+
+    pool_concurrency_set_used(pool);
+
+    node = pool->self;
+    do {
+        stats->nodes++;
+        stats->used += node->first_avail - ((char *)node + APR_MEMNODE_T_SIZE);
+        node = node->next;
+    } while (node != pool->self);
+
+    stats->size = pool->stat_size;
+    stats->peak = pool->stat_peak;
+
+    pool_concurrency_set_idle(pool);
+
+    for (child = pool->child; child; child = child->sibling) {
+        stats->children++;
+    }
+}
+
 
 #else /* APR_POOL_DEBUG */
 /*
@@ -1716,6 +2648,12 @@ APR_DECLARE(apr_status_t) apr_pool_initialize(void)
         return rv;
     }
 
+#if APR_ALLOCATOR_THREAD_CACHE
+    if ((rv = caches_mutex_create(global_pool)) != APR_SUCCESS) {
+        return rv;
+    }
+#endif
+
 #if (APR_POOL_DEBUG & APR_POOL_DEBUG_VERBOSE_ALL)
     rv = apr_env_get(&logpath, "APR_POOL_DEBUG_LOG", global_pool);
 
@@ -1973,6 +2911,12 @@ static void pool_destroy_debug(apr_pool_t *pool, const char *file_line)
     /* Destroy the allocator if the pool owns it */
     if (pool->allocator != NULL
         && apr_allocator_owner_get(pool->allocator) == pool) {
+#if APR_HAS_THREADS
+        /* Make sure to remove the lock, since it is highly likely to
+         * be invalid now.
+         */
+        apr_allocator_mutex_set(pool->allocator, NULL);
+#endif /* APR_HAS_THREADS */
         apr_allocator_destroy(pool->allocator);
     }
 
@@ -2337,6 +3281,27 @@ APR_DECLARE(apr_size_t) apr_pool_num_bytes(apr_pool_t *pool, int recurse)
     return size;
 }
 
+APR_DECLARE(void) apr_pool_stats_get(apr_pool_t *pool,
+                                     apr_pool_stats_t *stats)
+{
+    debug_node_t *node;
+    apr_pool_t *child;
+
+    memset(stats, 0, sizeof(*stats));
+
+    for (node = pool->nodes; node; node = node->next) {
+        stats->nodes += node->index;
+    }
+    pool_num_bytes(pool, &stats->size);
+
+    /* Every allocation has its own block, which is not recycled */
+    stats->used = stats->peak = stats->size;
+
+    for (child = pool->child; child; child = child->sibling) {
+        stats->children++;
+    }
+}
+
 APR_DECLARE(void) apr_pool_lock(apr_pool_t *pool, int flag)
 {
 }
@@ -2446,6 +3411,32 @@ APR_DECLARE(const char *) apr_pool_get_tag(apr_pool_t *pool)
     return pool->tag;
 }
 
+static int pool_stats_walk(apr_pool_t *pool, int depth,
+                           apr_pool_stats_walk_fn_t *walk_fn, void *baton)
+{
+    apr_pool_stats_t stats;
+    apr_pool_t *child;
+    int rv;
+
+    apr_pool_stats_get(pool, &stats);
+    if ((rv = walk_fn(pool, depth, &stats, baton)) != 0)
+        return rv;
+
+    for (child = pool->child; child; child = child->sibling) {
+        if ((rv = pool_stats_walk(child, depth + 1, walk_fn, baton)) != 0)
+            return rv;
+    }
+
+    return 0;
+}
+
+APR_DECLARE(int) apr_pool_stats_walk(apr_pool_t *pool,
+                                     apr_pool_stats_walk_fn_t *walk_fn,
+                                     void *baton)
+{
+    return pool_stats_walk(pool, 0, walk_fn, baton);
+}
+
 /*
  * User data management
  */
@@ -2517,14 +3508,57 @@ APR_DECLARE(apr_status_t) apr_pool_userdata_get(void **data, const char *key,
  * Cleanup
  */
 
-struct cleanup_t {
-    struct cleanup_t *next;
+struct apr_pool_cleanup_t {
+    struct apr_pool_cleanup_t *next;
+    /* The pointer pointing to this cleanup in its list, for O(1) removal,
+     * or NULL when not registered (killed or run).
+     */
+    struct apr_pool_cleanup_t **ref;
     const void *data;
     apr_status_t (*plain_cleanup_fn)(void *data);
     apr_status_t (*child_cleanup_fn)(void *data);
 };
 
-APR_DECLARE(void) apr_pool_cleanup_register(apr_pool_t *p, const void *data,
+static APR_INLINE cleanup_t *cleanup_alloc(apr_pool_t *p)
+{
+    cleanup_t *c;
+
+    if (p->free_cleanups) {
+        /* reuse a cleanup structure */
+        c = p->free_cleanups;
+        p->free_cleanups = c->next;
+    } else {
+        c = apr_palloc(p, sizeof(cleanup_t));
+    }
+
+    return c;
+}
+
+static APR_INLINE void cleanup_link(cleanup_t **head, cleanup_t *c)
+{
+    if ((c->next = *head) != NULL)
+        c->next->ref = &c->next;
+    c->ref = head;
+    *head = c;
+}
+
+static APR_INLINE void cleanup_unlink(cleanup_t *c)
+{
+    if ((*c->ref = c->next) != NULL)
+        c->next->ref = c->ref;
+    c->ref = NULL;
+}
+
+/* Unlink the cleanup and move it to the freelist */
+static APR_INLINE void cleanup_free(apr_pool_t *p, cleanup_t *c)
+{
+    cleanup_unlink(c);
+    c->next = p->free_cleanups;
+    p->free_cleanups = c;
+}
+
+APR_DECLARE(apr_pool_cleanup_t *) apr_pool_cleanup_register_ex(
+                      apr_pool_t *p, const void *data,
                       apr_status_t (*plain_cleanup_fn)(void *data),
                       apr_status_t (*child_cleanup_fn)(void *data))
 {
@@ -2535,18 +3569,11 @@ APR_DECLARE(void) apr_pool_cleanup_register(apr_pool_t *p, const void *data,
 #endif /* APR_POOL_DEBUG */
 
     if (p != NULL) {
-        if (p->free_cleanups) {
-            /* reuse a cleanup structure */
-            c = p->free_cleanups;
-            p->free_cleanups = c->next;
-        } else {
-            c = apr_palloc(p, sizeof(cleanup_t));
-        }
+        c = cleanup_alloc(p);
         c->data = data;
         c->plain_cleanup_fn = plain_cleanup_fn;
         c->child_cleanup_fn = child_cleanup_fn;
-        c->next = p->cleanups;
-        p->cleanups = c;
+        cleanup_link(&p->cleanups, c);
     }
 
 #if APR_POOL_DEBUG
@@ -2554,6 +3581,16 @@ APR_DECLARE(void) apr_pool_cleanup_register(apr_pool_t *p, const void *data,
         abort();
     }
 #endif /* APR_POOL_DEBUG */
+
+    return c;
+}
+
+APR_DECLARE(void) apr_pool_cleanup_register(apr_pool_t *p, const void *data,
+                      apr_status_t (*plain_cleanup_fn)(void *data),
+                      apr_status_t (*child_cleanup_fn)(void *data))
+{
+    (void)apr_pool_cleanup_register_ex(p, data, plain_cleanup_fn,
+                                       child_cleanup_fn);
 }
 
 APR_DECLARE(void) apr_pool_pre_cleanup_register(apr_pool_t *p, const void *data,
@@ -2566,17 +3603,10 @@ APR_DECLARE(void) apr_pool_pre_cleanup_register(apr_pool_t *p, const void *data,
 #endif /* APR_POOL_DEBUG */
 
     if (p != NULL) {
-        if (p->free_cleanups) {
-            /* reuse a cleanup structure */
-            c = p->free_cleanups;
-            p->free_cleanups = c->next;
-        } else {
-            c = apr_palloc(p, sizeof(cleanup_t));
-        }
+        c = cleanup_alloc(p);
         c->data = data;
         c->plain_cleanup_fn = plain_cleanup_fn;
-        c->next = p->pre_cleanups;
-        p->pre_cleanups = c;
+        cleanup_link(&p->pre_cleanups, c);
     }
 
 #if APR_POOL_DEBUG
@@ -2586,20 +3616,9 @@ APR_DECLARE(void) apr_pool_pre_cleanup_register(apr_pool_t *p, const void *data,
 #endif /* APR_POOL_DEBUG */
 }
 
-APR_DECLARE(void) apr_pool_cleanup_kill(apr_pool_t *p, const void *data,
-                      apr_status_t (*cleanup_fn)(void *))
+static cleanup_t *cleanup_find(cleanup_t *c, const void *data,
+                               apr_status_t (*cleanup_fn)(void *))
 {
-    cleanup_t *c, **lastp;
-
-#if APR_POOL_DEBUG
-    apr_pool_check_integrity(p);
-#endif /* APR_POOL_DEBUG */
-
-    if (p == NULL)
-        return;
-
-    c = p->cleanups;
-    lastp = &p->cleanups;
     while (c) {
 #if APR_POOL_DEBUG
         /* Some cheap loop detection to catch a corrupt list: */
@@ -2610,43 +3629,46 @@ APR_DECLARE(void) apr_pool_cleanup_kill(apr_pool_t *p, const void *data,
         }
 #endif
 
-        if (c->data == data && c->plain_cleanup_fn == cleanup_fn) {
-            *lastp = c->next;
-            /* move to freelist */
-            c->next = p->free_cleanups;
-            p->free_cleanups = c;
-            break;
-        }
+        if (c->data == data && c->plain_cleanup_fn == cleanup_fn)
+            return c;
 
-        lastp = &c->next;
         c = c->next;
     }
 
-    /* Remove any pre-cleanup as well */
-    c = p->pre_cleanups;
-    lastp = &p->pre_cleanups;
-    while (c) {
+    return NULL;
+}
+
+APR_DECLARE(void) apr_pool_cleanup_kill(apr_pool_t *p, const void *data,
+                      apr_status_t (*cleanup_fn)(void *))
+{
+    cleanup_t *c;
+
 #if APR_POOL_DEBUG
-        /* Some cheap loop detection to catch a corrupt list: */
-        if (c == c->next
-            || (c->next && c == c->next->next)
-            || (c->next && c->next->next && c == c->next->next->next)) {
-            abort();
-        }
-#endif
+    apr_pool_check_integrity(p);
+#endif /* APR_POOL_DEBUG */
 
-        if (c->data == data && c->plain_cleanup_fn == cleanup_fn) {
-            *lastp = c->next;
-            /* move to freelist */
-            c->next = p->free_cleanups;
-            p->free_cleanups = c;
-            break;
-        }
+    if (p == NULL)
+        return;
 
-        lastp = &c->next;
-        c = c->next;
-    }
+    if ((c = cleanup_find(p->cleanups, data, cleanup_fn)) != NULL)
+        cleanup_free(p, c);
+
+    /* Remove any pre-cleanup as well */
+    if ((c = cleanup_find(p->pre_cleanups, data, cleanup_fn)) != NULL)
+        cleanup_free(p, c);
+}
+
+APR_DECLARE(void) apr_pool_cleanup_kill_ex(apr_pool_t *p,
+                                           apr_pool_cleanup_t *cleanup)
+{
+#if APR_POOL_DEBUG
+    apr_pool_check_integrity(p);
+#endif /* APR_POOL_DEBUG */
 
+    if (p == NULL || cleanup == NULL || cleanup->ref == NULL)
+        return;
+
+    cleanup_free(p, cleanup);
 }
 
 APR_DECLARE(void) apr_pool_child_cleanup_set(apr_pool_t *p, const void *data,
@@ -2662,15 +3684,8 @@ APR_DECLARE(void) apr_pool_child_cleanup_set(apr_pool_t *p, const void *data,
     if (p == NULL)
         return;
 
-    c = p->cleanups;
-    while (c) {
-        if (c->data == data && c->plain_cleanup_fn == plain_cleanup_fn) {
-            c->child_cleanup_fn = child_cleanup_fn;
-            break;
-        }
-
-        c = c->next;
-    }
+    if ((c = cleanup_find(p->cleanups, data, plain_cleanup_fn)) != NULL)
+        c->child_cleanup_fn = child_cleanup_fn;
 }
 
 APR_DECLARE(apr_status_t) apr_pool_cleanup_run(apr_pool_t *p, void *data,
@@ -2680,14 +3695,34 @@ APR_DECLARE(apr_status_t) apr_pool_cleanup_run(apr_pool_t *p, void *data,
     return (*cleanup_fn)(data);
 }
 
+APR_DECLARE(apr_status_t) apr_pool_cleanup_run_ex(apr_pool_t *p,
+                                              apr_pool_cleanup_t *cleanup)
+{
+    void *data;
+    apr_status_t (*cleanup_fn)(void *);
+
+    /* Already killed or run, don't call it again */
+    if (cleanup->ref == NULL)
+        return APR_SUCCESS;
+
+    data = (void *)cleanup->data;
+    cleanup_fn = cleanup->plain_cleanup_fn;
+    apr_pool_cleanup_kill_ex(p, cleanup);
+    return (*cleanup_fn)(data);
+}
+
+/* Each cleanup is unlinked before being called, so that it can safely
+ * kill or register other cleanups.
+ */
 static void run_cleanups(cleanup_t **cref)
 {
-    cleanup_t *c = *cref;
+    cleanup_t *c;
 
-    while (c) {
-        *cref = c->next;
+    while ((c = *cref) != NULL) {
+        if ((*cref = c->next) != NULL)
+            c->next->ref = cref;
+        c->ref = NULL;
         (*c->plain_cleanup_fn)((void *)c->data);
-        c = *cref;
     }
 }
 
@@ -2695,12 +3730,13 @@ static void run_cleanups(cleanup_t **cref)
 
 static void run_child_cleanups(cleanup_t **cref)
 {
-    cleanup_t *c = *cref;
+    cleanup_t *c;
 
-    while (c) {
-        *cref = c->next;
+    while ((c = *cref) != NULL) {
+        if ((*cref = c->next) != NULL)
+            c->next->ref = cref;
+        c->ref = NULL;
         (*c->child_cleanup_fn)((void *)c->data);
-        c = *cref;
     }
 }
 
@@ -2966,6 +4002,20 @@ APR_DECLARE(void) apr_pool_destroy(apr_pool_t *pool)
     apr_pool_destroy_debug(pool, "undefined");
 }
 
+APR_DECLARE(apr_status_t) apr_pool_create_ex2(apr_pool_t **newpool,
+                                              apr_pool_t *parent,
+                                              apr_abortfunc_t abort_fn,
+                                              apr_allocator_t *allocator,
+                                              apr_uint32_t flags)
+{
+    return apr_pool_create_ex_debug(newpool, parent, abort_fn, allocator,
+                                    "undefined");
+}
+
+APR_DECLARE(void) apr_pfree(apr_pool_t *pool, void *mem, apr_size_t size)
+{
+}
+
 #undef apr_pool_create_ex
 APR_DECLARE(apr_status_t) apr_pool_create_ex(apr_pool_t **newpool,
                                              apr_pool_t *parent,
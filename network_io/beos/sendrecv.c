@@ -132,6 +132,14 @@ APR_DECLARE(apr_status_t) apr_socket_sendv(apr_socket_t * sock,
     return apr_socket_send(sock, vec[0].iov_base, len);
 }
 
+APR_DECLARE(apr_status_t) apr_socket_recvv(apr_socket_t * sock,
+                                           const struct iovec *vec,
+                                           apr_int32_t nvec, apr_size_t *len)
+{
+    *len = vec[0].iov_len;
+    return apr_socket_recv(sock, vec[0].iov_base, len);
+}
+
 APR_DECLARE(apr_status_t) apr_socket_sendto(apr_socket_t *sock,
                                             apr_sockaddr_t *where,
                                             apr_int32_t flags, const char *buf,
@@ -156,6 +156,16 @@ APR_DECLARE(apr_status_t) apr_socket_sendv(apr_socket_t *sock,
 
 
 
+APR_DECLARE(apr_status_t) apr_socket_recvv(apr_socket_t *sock,
+                                           const struct iovec *vec,
+                                           apr_int32_t nvec, apr_size_t *len)
+{
+    *len = vec[0].iov_len;
+    return apr_socket_recv(sock, vec[0].iov_base, len);
+}
+
+
+
 APR_DECLARE(apr_status_t) apr_socket_wait(apr_socket_t *sock, apr_wait_type_t direction)
 {
     int pollsocket = sock->socketdes;
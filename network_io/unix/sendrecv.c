@@ -245,6 +245,63 @@ do_select:
 #endif
 }
 
+apr_status_t apr_socket_recvv(apr_socket_t *sock, const struct iovec *vec,
+                              apr_int32_t nvec, apr_size_t *len)
+{
+#ifdef HAVE_READV
+    apr_ssize_t rv;
+    apr_status_t arv;
+    apr_int32_t i;
+
+    if (sock->options & APR_INCOMPLETE_READ) {
+        sock->options &= ~APR_INCOMPLETE_READ;
+        goto do_select;
+    }
+
+    do {
+        rv = readv(sock->socketdes, vec, nvec);
+    } while (rv == -1 && errno == EINTR);
+
+    while ((rv == -1) && (errno == EAGAIN || errno == EWOULDBLOCK)
+                      && (sock->timeout > 0)) {
+do_select:
+        arv = apr_wait_for_io_or_timeout(NULL, sock, 1);
+        if (arv != APR_SUCCESS) {
+            *len = 0;
+            return arv;
+        }
+        else {
+            do {
+                rv = readv(sock->socketdes, vec, nvec);
+            } while (rv == -1 && errno == EINTR);
+        }
+    }
+    if (rv == -1) {
+        *len = 0;
+        return errno;
+    }
+    if (sock->timeout > 0) {
+        apr_size_t rv_len = rv;
+        for (i = 0; i < nvec; ++i) {
+            apr_size_t iov_len = vec[i].iov_len;
+            if (rv_len < iov_len) {
+                sock->options |= APR_INCOMPLETE_READ;
+                break;
+            }
+            rv_len -= iov_len;
+        }
+    }
+    (*len) = rv;
+    if (rv == 0) {
+        return APR_EOF;
+    }
+    return APR_SUCCESS;
+#else
+    *len = vec[0].iov_len;
+    return apr_socket_recv(sock, vec[0].iov_base, len);
+#endif
+}
+
 apr_status_t apr_socket_wait(apr_socket_t *sock, apr_wait_type_t direction)
 {
     return apr_wait_for_io_or_timeout(NULL, sock, direction == APR_WAIT_READ);
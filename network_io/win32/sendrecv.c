@@ -127,6 +127,54 @@ APR_DECLARE(apr_status_t) apr_socket_sendv(apr_socket_t *sock,
 }
 
 
+APR_DECLARE(apr_status_t) apr_socket_recvv(apr_socket_t *sock,
+                                           const struct iovec *vec,
+                                           apr_int32_t in_vec, apr_size_t *nbytes)
+{
+    apr_status_t rc = APR_SUCCESS;
+    apr_ssize_t rv;
+    apr_size_t total_len;
+    apr_int32_t i;
+    DWORD dwBytes = 0;
+    DWORD flags = 0;
+    WSABUF *pWsaBuf;
+
+    total_len = 0;
+    for (i = 0; i < in_vec; i++) {
+        apr_size_t iov_len = vec[i].iov_len;
+        if (iov_len > (apr_size_t)MAXDWORD - total_len) {
+            /* WSARecv() returns NumberOfBytesRecvd as DWORD, so the total
+               size should be less than that. */
+            return APR_EINVAL;
+        }
+        total_len += iov_len;
+    }
+
+    pWsaBuf = (in_vec <= WSABUF_ON_STACK) ? _alloca(sizeof(WSABUF) * (in_vec))
+                                          : malloc(sizeof(WSABUF) * (in_vec));
+    if (!pWsaBuf)
+        return APR_ENOMEM;
+
+    for (i = 0; i < in_vec; i++) {
+        pWsaBuf[i].buf = vec[i].iov_base;
+        pWsaBuf[i].len = (ULONG) vec[i].iov_len;
+    }
+    rv = WSARecv(sock->socketdes, pWsaBuf, in_vec, &dwBytes, &flags,
+                 NULL, NULL);
+    if (rv == SOCKET_ERROR) {
+        rc = apr_get_netos_error();
+    }
+    if (in_vec > WSABUF_ON_STACK)
+        free(pWsaBuf);
+
+    *nbytes = dwBytes;
+    if (rc == APR_SUCCESS && dwBytes == 0) {
+        rc = APR_EOF;
+    }
+    return rc;
+}
+
+
 APR_DECLARE(apr_status_t) apr_socket_sendto(apr_socket_t *sock,
                                             apr_sockaddr_t *where,
                                             apr_int32_t flags, const char *buf,
@@ -26,6 +26,117 @@
 #endif
 #include "apr_want.h"
 #include "apr_cstr.h"
+#include "apr_private.h"
+
+/*
+ * The case-insensitive comparisons process 16 bytes at once with SSE2 or
+ * NEON when available.  Since the length of the strings is unknown, a block
+ * is loaded only if it does not cross a page boundary (thus can't fault),
+ * which may read beyond the terminating NUL, so this is disabled for the
+ * address sanitizer and valgrind builds.
+ */
+#if defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define CSTR_NO_OVERREAD 1
+#endif
+#endif
+#if defined(__SANITIZE_ADDRESS__)
+#define CSTR_NO_OVERREAD 1
+#endif
+#if HAVE_VALGRIND
+#define CSTR_NO_OVERREAD 1
+#endif
+
+#if APR_CHARSET_EBCDIC || defined(CSTR_NO_OVERREAD)
+#define CSTR_SSE2 0
+#define CSTR_NEON 0
+#elif defined(__SSE2__) || defined(_M_X64) \
+    || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CSTR_SSE2 1
+#define CSTR_NEON 0
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define CSTR_SSE2 0
+#define CSTR_NEON 1
+#else
+#define CSTR_SSE2 0
+#define CSTR_NEON 0
+#endif
+
+#if CSTR_SSE2 || CSTR_NEON
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#define CSTR_BLOCK 16
+/* The smallest page size of the supported platforms */
+#define CSTR_PAGE_SIZE 4096
+#define CSTR_BLOCK_SAFE(u) \
+    (((apr_uintptr_t)(u) & (CSTR_PAGE_SIZE - 1)) <= CSTR_PAGE_SIZE - CSTR_BLOCK)
+
+static APR_INLINE int cstr_ctz(apr_uint64_t x)
+{
+#if defined(__GNUC__)
+    return __builtin_ctzll(x);
+#elif defined(_MSC_VER) && defined(_WIN64)
+    unsigned long i;
+    _BitScanForward64(&i, x);
+    return (int)i;
+#else
+    int i = 0;
+    while (!(x & 1)) {
+        x >>= 1;
+        i++;
+    }
+    return i;
+#endif
+}
+
+/* Return the offset of the first bytes of u1 and u2 which differ
+ * case-insensitively (ASCII only) or are NUL in u1, or CSTR_BLOCK if none.
+ */
+static APR_INLINE int casecmp_block(const unsigned char *u1,
+                                    const unsigned char *u2)
+{
+#if CSTR_SSE2
+    /* 'A'..'Z' are moved to the lowest signed values to be folded with a
+     * single signed comparison.
+     */
+    const __m128i bias = _mm_set1_epi8((char)(0x80 - 'A'));
+    const __m128i upper = _mm_set1_epi8((char)(0x80 - 'A' + 'Z' + 1));
+    const __m128i flip = _mm_set1_epi8(0x20);
+    __m128i a = _mm_loadu_si128((const __m128i *)u1);
+    __m128i b = _mm_loadu_si128((const __m128i *)u2);
+    __m128i fa, fb;
+    unsigned int bits;
+
+    fa = _mm_or_si128(a, _mm_and_si128(flip,
+                          _mm_cmplt_epi8(_mm_add_epi8(a, bias), upper)));
+    fb = _mm_or_si128(b, _mm_and_si128(flip,
+                          _mm_cmplt_epi8(_mm_add_epi8(b, bias), upper)));
+    bits = ~_mm_movemask_epi8(_mm_cmpeq_epi8(fa, fb)) & 0xFFFF;
+    bits |= _mm_movemask_epi8(_mm_cmpeq_epi8(a, _mm_setzero_si128()));
+    return bits ? cstr_ctz(bits) : CSTR_BLOCK;
+#else /* CSTR_NEON */
+    const uint8x16_t first = vdupq_n_u8('A');
+    const uint8x16_t range = vdupq_n_u8('Z' - 'A' + 1);
+    const uint8x16_t flip = vdupq_n_u8(0x20);
+    uint8x16_t a = vld1q_u8(u1);
+    uint8x16_t b = vld1q_u8(u2);
+    uint8x16_t fa, fb, stop;
+    apr_uint64_t bits;
+
+    fa = vorrq_u8(a, vandq_u8(flip, vcltq_u8(vsubq_u8(a, first), range)));
+    fb = vorrq_u8(b, vandq_u8(flip, vcltq_u8(vsubq_u8(b, first), range)));
+    stop = vorrq_u8(vmvnq_u8(vceqq_u8(fa, fb)), vceqzq_u8(a));
+    /* 4 bits per byte */
+    bits = vget_lane_u64(vreinterpret_u64_u8(
+                             vshrn_n_u16(vreinterpretq_u16_u8(stop), 4)), 0);
+    return bits ? cstr_ctz(bits) >> 2 : CSTR_BLOCK;
+#endif
+}
+#endif /* CSTR_SSE2 || CSTR_NEON */
 
 APR_DECLARE(void) apr_cstr_split_append(apr_array_header_t *array,
                                         const char *input,
@@ -285,11 +396,23 @@ APR_DECLARE(int) apr_cstr_casecmp(const char *s1, const char *s2)
     const unsigned char *u1 = (const unsigned char *)s1;
     const unsigned char *u2 = (const unsigned char *)s2;
     for (;;) {
-        const int c2 = ucharmap[*u2++];
-        const int cmp = (int)ucharmap[*u1++] - c2;
-        /* Not necessary to test for !c1, this is caught by cmp */
-        if (cmp || !c2)
-            return cmp;
+#if CSTR_SSE2 || CSTR_NEON
+        if (CSTR_BLOCK_SAFE(u1) && CSTR_BLOCK_SAFE(u2)) {
+            const int i = casecmp_block(u1, u2);
+            if (i < CSTR_BLOCK)
+                return (int)ucharmap[u1[i]] - ucharmap[u2[i]];
+            u1 += CSTR_BLOCK;
+            u2 += CSTR_BLOCK;
+        }
+        else
+#endif
+        {
+            const int c2 = ucharmap[*u2++];
+            const int cmp = (int)ucharmap[*u1++] - c2;
+            /* Not necessary to test for !c1, this is caught by cmp */
+            if (cmp || !c2)
+                return cmp;
+        }
     }
 }
 
@@ -298,6 +421,25 @@ APR_DECLARE(int) apr_cstr_casecmpn(const char *s1, const char *s2,
 {
     const unsigned char *u1 = (const unsigned char *)s1;
     const unsigned char *u2 = (const unsigned char *)s2;
+#if CSTR_SSE2 || CSTR_NEON
+    while (n >= CSTR_BLOCK) {
+        if (CSTR_BLOCK_SAFE(u1) && CSTR_BLOCK_SAFE(u2)) {
+            const int i = casecmp_block(u1, u2);
+            if (i < CSTR_BLOCK)
+                return (int)ucharmap[u1[i]] - ucharmap[u2[i]];
+            u1 += CSTR_BLOCK;
+            u2 += CSTR_BLOCK;
+            n -= CSTR_BLOCK;
+        }
+        else {
+            const int c2 = ucharmap[*u2++];
+            const int cmp = (int)ucharmap[*u1++] - c2;
+            if (cmp || !c2)
+                return cmp;
+            n--;
+        }
+    }
+#endif
     while (n--) {
         const int c2 = ucharmap[*u2++];
         const int cmp = (int)ucharmap[*u1++] - c2;
@@ -19,6 +19,33 @@
 #define APR_WANT_STRFUNC
 #include "apr_want.h"
 
+/*
+ * With SSE2 or NEON, single patterns are searched 16 positions at once by
+ * comparing the first and last characters of the pattern with blocks of the
+ * string at their respective offsets, and only the candidates matching both
+ * are fully compared.  The remaining positions (less than a block) are
+ * searched with Boyer-Moore-Horspool.
+ */
+#if defined(__SSE2__) || defined(_M_X64) \
+    || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define STRMATCH_SSE2 1
+#define STRMATCH_NEON 0
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define STRMATCH_SSE2 0
+#define STRMATCH_NEON 1
+#else
+#define STRMATCH_SSE2 0
+#define STRMATCH_NEON 0
+#endif
+
+#if STRMATCH_SSE2 || STRMATCH_NEON
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#define STRMATCH_BLOCK 16
+#endif
 
 #define NUM_CHARS  256
 
@@ -79,6 +106,119 @@ static const char *match_boyer_moore_horspool_nocase(
     return NULL;
 }
 
+#if STRMATCH_SSE2 || STRMATCH_NEON
+
+static APR_INLINE int strmatch_ctz(apr_uint64_t x)
+{
+#if defined(__GNUC__)
+    return __builtin_ctzll(x);
+#elif defined(_MSC_VER) && defined(_WIN64)
+    unsigned long i;
+    _BitScanForward64(&i, x);
+    return (int)i;
+#else
+    int i = 0;
+    while (!(x & 1)) {
+        x >>= 1;
+        i++;
+    }
+    return i;
+#endif
+}
+
+/* Return the candidate positions of the block at s, where s[0] is f1 or f2
+ * and s[last] is l1 or l2, as one bit per position (every 4 bits with NEON).
+ */
+static APR_INLINE apr_uint64_t match_block(const char *s, apr_size_t last,
+                                           char f1, char f2,
+                                           char l1, char l2, int nocase)
+{
+#if STRMATCH_SSE2
+    __m128i a = _mm_loadu_si128((const __m128i *)s);
+    __m128i b = _mm_loadu_si128((const __m128i *)(s + last));
+    __m128i ea = _mm_cmpeq_epi8(a, _mm_set1_epi8(f1));
+    __m128i eb = _mm_cmpeq_epi8(b, _mm_set1_epi8(l1));
+
+    if (nocase) {
+        ea = _mm_or_si128(ea, _mm_cmpeq_epi8(a, _mm_set1_epi8(f2)));
+        eb = _mm_or_si128(eb, _mm_cmpeq_epi8(b, _mm_set1_epi8(l2)));
+    }
+    return (unsigned int)_mm_movemask_epi8(_mm_and_si128(ea, eb));
+#else /* STRMATCH_NEON */
+    uint8x16_t a = vld1q_u8((const uint8_t *)s);
+    uint8x16_t b = vld1q_u8((const uint8_t *)(s + last));
+    uint8x16_t ea = vceqq_u8(a, vdupq_n_u8((uint8_t)f1));
+    uint8x16_t eb = vceqq_u8(b, vdupq_n_u8((uint8_t)l1));
+
+    if (nocase) {
+        ea = vorrq_u8(ea, vceqq_u8(a, vdupq_n_u8((uint8_t)f2)));
+        eb = vorrq_u8(eb, vceqq_u8(b, vdupq_n_u8((uint8_t)l2)));
+    }
+    return vget_lane_u64(vreinterpret_u64_u8(
+                             vshrn_n_u16(vreinterpretq_u16_u8(
+                                 vandq_u8(ea, eb)), 4)), 0)
+           & APR_UINT64_C(0x1111111111111111);
+#endif
+}
+
+#if STRMATCH_SSE2
+#define MATCH_BLOCK_OFFSET(bits) strmatch_ctz(bits)
+#else
+#define MATCH_BLOCK_OFFSET(bits) (strmatch_ctz(bits) >> 2)
+#endif
+
+static const char *match_simd(const apr_strmatch_pattern *this_pattern,
+                              const char *s, apr_size_t slen)
+{
+    const char *p = this_pattern->pattern;
+    const apr_size_t last = this_pattern->length - 1;
+    const char first_c = p[0], last_c = p[last];
+    apr_size_t i;
+
+    for (i = 0; i + last + STRMATCH_BLOCK <= slen; i += STRMATCH_BLOCK) {
+        apr_uint64_t bits = match_block(s + i, last, first_c, first_c,
+                                        last_c, last_c, 0);
+        while (bits) {
+            const char *c = s + i + MATCH_BLOCK_OFFSET(bits);
+            if (last < 2 || !memcmp(c + 1, p + 1, last - 1)) {
+                return c;
+            }
+            bits &= bits - 1;
+        }
+    }
+    return match_boyer_moore_horspool(this_pattern, s + i, slen - i);
+}
+
+static const char *match_simd_nocase(const apr_strmatch_pattern *this_pattern,
+                                     const char *s, apr_size_t slen)
+{
+    const char *p = this_pattern->pattern;
+    const apr_size_t last = this_pattern->length - 1;
+    const char first_l = apr_tolower(p[0]), first_u = apr_toupper(p[0]);
+    const char last_l = apr_tolower(p[last]), last_u = apr_toupper(p[last]);
+    apr_size_t i, j;
+
+    for (i = 0; i + last + STRMATCH_BLOCK <= slen; i += STRMATCH_BLOCK) {
+        apr_uint64_t bits = match_block(s + i, last, first_l, first_u,
+                                        last_l, last_u, 1);
+        while (bits) {
+            const char *c = s + i + MATCH_BLOCK_OFFSET(bits);
+            for (j = 1; j < last; j++) {
+                if (apr_tolower(c[j]) != apr_tolower(p[j])) {
+                    break;
+                }
+            }
+            if (j >= last) {
+                return c;
+            }
+            bits &= bits - 1;
+        }
+    }
+    return match_boyer_moore_horspool_nocase(this_pattern, s + i, slen - i);
+}
+
+#endif /* STRMATCH_SSE2 || STRMATCH_NEON */
+
 APR_DECLARE(const apr_strmatch_pattern *) apr_strmatch_precompile(
                                               apr_pool_t *p, const char *s,
                                               int case_sensitive)
@@ -101,13 +241,21 @@ APR_DECLARE(const apr_strmatch_pattern *) apr_strmatch_precompile(
         shift[i] = pattern->length;
     }
     if (case_sensitive) {
+#if STRMATCH_SSE2 || STRMATCH_NEON
+        pattern->compare = match_simd;
+#else
         pattern->compare = match_boyer_moore_horspool;
+#endif
         for (i = 0; i < pattern->length - 1; i++) {
             shift[(unsigned char)s[i]] = pattern->length - i - 1;
         }
     }
     else {
+#if STRMATCH_SSE2 || STRMATCH_NEON
+        pattern->compare = match_simd_nocase;
+#else
         pattern->compare = match_boyer_moore_horspool_nocase;
+#endif
         for (i = 0; i < pattern->length - 1; i++) {
             shift[(unsigned char)apr_tolower(s[i])] = pattern->length - i - 1;
         }
@@ -116,3 +264,256 @@ APR_DECLARE(const apr_strmatch_pattern *) apr_strmatch_precompile(
 
     return pattern;
 }
+
+/*
+ * Multiple patterns matching, with an Aho-Corasick automaton compiled to
+ * a DFA.  The characters are first mapped to classes (those not used by
+ * any pattern sharing the same class, and case folded when insensitive),
+ * so that each state has a row of transitions per class only.  Rows are
+ * indexed by state * nclasses directly, and the accepting states are
+ * numbered last, so that the search loop is one lookup and one
+ * comparison per character.
+ *
+ * With SSE2 or NEON, and when no more than STRMATCH_MAX_STARTS characters
+ * can start a pattern, the string is scanned 16 characters at a time for
+ * them while the automaton is at its root.
+ */
+
+#define STRMATCH_MAX_STARTS 4
+
+struct apr_strmatch_multi_pattern {
+    const apr_uint32_t *delta;  /* next row, by row + class */
+    apr_uint32_t accept;        /* first row of the accepting states */
+    apr_uint32_t nclasses;
+    const int *ids;             /* pattern of the accepting states */
+    const apr_size_t *lengths;  /* length of the patterns */
+    int empty_id;               /* an empty pattern, matching anywhere */
+    int nstarts;                /* number of starting characters, if few */
+    char starts[STRMATCH_MAX_STARTS];
+    apr_uint16_t classes[NUM_CHARS];
+};
+
+#if STRMATCH_SSE2 || STRMATCH_NEON
+/* Return the positions of the block at u which may start a pattern */
+static APR_INLINE apr_uint64_t multi_starts_block(
+                                    const apr_strmatch_multi_pattern *multi,
+                                    const unsigned char *u)
+{
+#if STRMATCH_SSE2
+    const char *starts = multi->starts;
+    __m128i a = _mm_loadu_si128((const __m128i *)u);
+    __m128i eq = _mm_or_si128(
+                     _mm_or_si128(_mm_cmpeq_epi8(a, _mm_set1_epi8(starts[0])),
+                                  _mm_cmpeq_epi8(a, _mm_set1_epi8(starts[1]))),
+                     _mm_or_si128(_mm_cmpeq_epi8(a, _mm_set1_epi8(starts[2])),
+                                  _mm_cmpeq_epi8(a, _mm_set1_epi8(starts[3]))));
+    return (unsigned int)_mm_movemask_epi8(eq);
+#else /* STRMATCH_NEON */
+    const uint8_t *starts = (const uint8_t *)multi->starts;
+    uint8x16_t a = vld1q_u8(u);
+    uint8x16_t eq = vorrq_u8(vorrq_u8(vceqq_u8(a, vdupq_n_u8(starts[0])),
+                                      vceqq_u8(a, vdupq_n_u8(starts[1]))),
+                             vorrq_u8(vceqq_u8(a, vdupq_n_u8(starts[2])),
+                                      vceqq_u8(a, vdupq_n_u8(starts[3]))));
+    return vget_lane_u64(vreinterpret_u64_u8(
+                             vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0)
+           & APR_UINT64_C(0x1111111111111111);
+#endif
+}
+#endif /* STRMATCH_SSE2 || STRMATCH_NEON */
+
+APR_DECLARE(const apr_strmatch_multi_pattern *) apr_strmatch_multi_precompile(
+                                              apr_pool_t *p,
+                                              const char * const *patterns,
+                                              int npatterns,
+                                              int case_sensitive)
+{
+    apr_strmatch_multi_pattern *multi;
+    apr_pool_t *ptmp;
+    apr_size_t *lengths;
+    apr_uint32_t *trie, *delta, *renum, *queue, *fail;
+    apr_uint32_t nclasses = 1, nstates = 1, maxstates = 1, naccept = 0;
+    apr_uint32_t head, tail, s, t, c, n;
+    int *term, *out, *ids;
+    int i;
+
+    if (npatterns < 0 || (npatterns && !patterns)) {
+        return NULL;
+    }
+
+    multi = apr_pcalloc(p, sizeof(*multi));
+    multi->empty_id = -1;
+    lengths = apr_palloc(p, sizeof(apr_size_t) * (npatterns + 1));
+    for (i = 0; i < npatterns; i++) {
+        const unsigned char *u = (const unsigned char *)patterns[i];
+        lengths[i] = strlen(patterns[i]);
+        if (!lengths[i] && multi->empty_id < 0) {
+            multi->empty_id = i;
+        }
+        if (lengths[i] >= APR_UINT32_MAX - maxstates) {
+            return NULL;
+        }
+        maxstates += (apr_uint32_t)lengths[i];
+        for (; *u; u++) {
+            c = case_sensitive ? *u : (unsigned char)apr_tolower(*u);
+            if (!multi->classes[c]) {
+                multi->classes[c] = nclasses++;
+            }
+        }
+    }
+    if (!case_sensitive) {
+        for (c = 0; c < NUM_CHARS; c++) {
+            multi->classes[c] = multi->classes[(unsigned char)apr_tolower(c)];
+        }
+    }
+    /* The rows are indexed with 32bit integers, and the DFA (as the trie)
+     * can have up to maxstates * nclasses transitions
+     */
+    if (maxstates > APR_UINT32_MAX / nclasses
+        || maxstates > APR_SIZE_MAX / sizeof(apr_uint32_t) / nclasses) {
+        return NULL;
+    }
+    multi->nclasses = nclasses;
+    multi->lengths = lengths;
+
+    if (apr_pool_create(&ptmp, p) != APR_SUCCESS) {
+        return NULL;
+    }
+
+    /* The trie, where 0 means no transition (nothing goes to the root) */
+    trie = apr_pcalloc(ptmp, sizeof(apr_uint32_t) * maxstates * nclasses);
+    term = apr_palloc(ptmp, sizeof(int) * maxstates);
+    term[0] = -1;
+    for (i = 0; i < npatterns; i++) {
+        const unsigned char *u = (const unsigned char *)patterns[i];
+        for (s = 0; *u; u++) {
+            apr_uint32_t *next = &trie[s * nclasses + multi->classes[*u]];
+            if (!*next) {
+                term[nstates] = -1;
+                *next = nstates++;
+            }
+            s = *next;
+        }
+        if (s && term[s] < 0) {
+            term[s] = i;
+        }
+    }
+
+    /* Breadth first, complete the missing transitions of each state with
+     * the ones of its failure state, which is less deep hence completed
+     * already, and inherit its output if none.
+     */
+    queue = apr_palloc(ptmp, sizeof(apr_uint32_t) * nstates);
+    fail = apr_palloc(ptmp, sizeof(apr_uint32_t) * nstates);
+    out = apr_palloc(ptmp, sizeof(int) * nstates);
+    out[0] = -1;
+    head = tail = 0;
+    for (c = 0; c < nclasses; c++) {
+        if ((t = trie[c])) {
+            fail[t] = 0;
+            out[t] = term[t];
+            queue[tail++] = t;
+        }
+    }
+    while (head < tail) {
+        s = queue[head++];
+        for (c = 0; c < nclasses; c++) {
+            apr_uint32_t *next = &trie[s * nclasses + c];
+            if ((t = *next)) {
+                fail[t] = trie[fail[s] * nclasses + c];
+                out[t] = term[t] >= 0 ? term[t] : out[fail[t]];
+                queue[tail++] = t;
+            }
+            else {
+                *next = trie[fail[s] * nclasses + c];
+            }
+        }
+    }
+
+    /* Renumber the accepting states last, and make rows of the states */
+    renum = apr_palloc(ptmp, sizeof(apr_uint32_t) * nstates);
+    for (s = 0, n = 0; s < nstates; s++) {
+        if (out[s] < 0) {
+            renum[s] = n++;
+        }
+    }
+    multi->accept = n * nclasses;
+    ids = apr_palloc(p, sizeof(int) * (nstates - n + 1));
+    for (s = 0; s < nstates; s++) {
+        if (out[s] >= 0) {
+            ids[naccept] = out[s];
+            renum[s] = n + naccept++;
+        }
+    }
+    delta = apr_palloc(p, sizeof(apr_uint32_t) * nstates * nclasses);
+    for (s = 0; s < nstates; s++) {
+        for (c = 0; c < nclasses; c++) {
+            delta[renum[s] * nclasses + c] =
+                renum[trie[s * nclasses + c]] * nclasses;
+        }
+    }
+    multi->delta = delta;
+    multi->ids = ids;
+
+    /* The characters leaving the root, padded with the first one */
+    for (c = 0; c < NUM_CHARS; c++) {
+        if (delta[multi->classes[c]]) {
+            if (multi->nstarts == STRMATCH_MAX_STARTS) {
+                multi->nstarts = 0;
+                break;
+            }
+            multi->starts[multi->nstarts++] = (char)c;
+        }
+    }
+    for (i = multi->nstarts; i && i < STRMATCH_MAX_STARTS; i++) {
+        multi->starts[i] = multi->starts[0];
+    }
+
+    apr_pool_destroy(ptmp);
+    return multi;
+}
+
+APR_DECLARE(const char *) apr_strmatch_multi(
+                                    const apr_strmatch_multi_pattern *multi,
+                                    const char *s, apr_size_t slen, int *id)
+{
+    const unsigned char *u = (const unsigned char *)s;
+    const unsigned char *end = u + slen;
+    const apr_uint32_t *delta = multi->delta;
+    const apr_uint32_t accept = multi->accept;
+    apr_uint32_t row = 0;
+
+    if (multi->empty_id >= 0) {
+        if (id) {
+            *id = multi->empty_id;
+        }
+        return s;
+    }
+
+    while (u < end) {
+#if STRMATCH_SSE2 || STRMATCH_NEON
+        if (!row && multi->nstarts) {
+            apr_uint64_t bits = 0;
+            while (u + STRMATCH_BLOCK <= end
+                   && !(bits = multi_starts_block(multi, u))) {
+                u += STRMATCH_BLOCK;
+            }
+            if (bits) {
+                u += MATCH_BLOCK_OFFSET(bits);
+            }
+            else if (u >= end) {
+                break;
+            }
+        }
+#endif
+        row = delta[row + multi->classes[*u++]];
+        if (row >= accept) {
+            int i = multi->ids[(row - accept) / multi->nclasses];
+            if (id) {
+                *id = i;
+            }
+            return (const char *)u - multi->lengths[i];
+        }
+    }
+    return NULL;
+}
@@ -18,6 +18,8 @@
 
 #include "apr_general.h"
 #include "apr_pools.h"
+#include "apr_siphash.h"
+#include "apr_strings.h"
 #include "apr_time.h"
 
 #include "apr_hash.h"
@@ -33,6 +35,14 @@
 #include <stdio.h>
 #endif
 
+#if defined(__SSE2__) || defined(_M_X64) \
+    || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define APR_HASH_SSE2 1
+#else
+#define APR_HASH_SSE2 0
+#endif
+
 /*
  * The internal form of a hash table.
  *
@@ -40,6 +50,14 @@
  * are resolved by hanging a linked list of hash entries off each
  * element of the array. Although this is a really simple design it
  * isn't too bad given that pools have a low allocation overhead.
+ *
+ * With APR_HASH_OPEN_ADDRESSING, the entries are rather stored in a
+ * contiguous array of slots, along with an array of control bytes (one per
+ * slot) holding 7 bits of the hash of the key for the used slots, so that
+ * lookups compare a group of control bytes at once (with SSE2 if available)
+ * and the keys only for the matching fingerprints.  Collisions are resolved
+ * by probing the next group of slots, and deleted entries leave tombstones
+ * until the next rehash.
  */
 
 typedef struct apr_hash_entry_t apr_hash_entry_t;
@@ -58,11 +76,19 @@ struct apr_hash_entry_t {
  * We keep a pointer to the next hash entry here to allow the current
  * hash entry to be freed or otherwise mangled between calls to
  * apr_hash_next().
+ *
+ * With open addressing, the arrays iterated are those of the table when
+ * the iteration started: if an insertion rehashes the table, the old ones
+ * are still allocated in its pool and the iteration continues on them,
+ * looking up the entries in the new ones.
  */
 struct apr_hash_index_t {
     apr_hash_t         *ht;
     apr_hash_entry_t   *this, *next;
     unsigned int        index;
+    const unsigned char *ctrl;
+    apr_hash_entry_t   *slots;
+    unsigned int        max;
 };
 
 /*
@@ -79,10 +105,32 @@ struct apr_hash_t {
     unsigned int         count, max, seed;
     apr_hashfunc_t       hash_func;
     apr_hash_entry_t    *free;  /* List of recycled entries */
+    apr_uint32_t         flags; /* APR_HASH_FAST_HASH or APR_HASH_SIPHASH */
+    apr_uint64_t         key[2];  /* Seed of the fast or SipHash function */
+    /* Open addressing (array is NULL then) */
+    unsigned char       *ctrl;  /* max + 1 control bytes + GROUP_WIDTH clones */
+    apr_hash_entry_t    *slots;
+    unsigned int         deleted;  /* tombstones */
 };
 
 #define INITIAL_MAX 15 /* tunable == 2^n - 1 */
 
+/*
+ * Open addressing control bytes: the used slots have the 7 low bits of the
+ * (mixed) hash, the others the high bit set.  The first GROUP_WIDTH bytes
+ * are cloned after the last one so that groups can be loaded at any slot
+ * without wrapping (hence max + 1 >= GROUP_WIDTH).
+ */
+#define CTRL_EMPTY      ((unsigned char)0x80)
+#define CTRL_DELETED    ((unsigned char)0xFE)
+#define CTRL_IS_FULL(c) (((c) & 0x80) == 0)
+#define GROUP_WIDTH     16
+
+/* Maximum load (including tombstones) before rehashing: 7/8 */
+#define OA_MAX_LOAD(max) ((max) - ((max) >> 3))
+
+#define HASH_FUNC_FLAGS (APR_HASH_FAST_HASH | APR_HASH_SIPHASH)
+
 
 /*
  * Hash creation functions.
@@ -93,7 +141,27 @@ static apr_hash_entry_t **alloc_array(apr_hash_t *ht, unsigned int max)
    return apr_pcalloc(ht->pool, sizeof(*ht->array) * (max + 1));
 }
 
+static void alloc_slots(apr_hash_t *ht, unsigned int max)
+{
+    ht->ctrl = apr_palloc(ht->pool, max + 1 + GROUP_WIDTH);
+    memset(ht->ctrl, CTRL_EMPTY, max + 1 + GROUP_WIDTH);
+    ht->slots = apr_palloc(ht->pool, sizeof(*ht->slots) * (max + 1));
+}
+
 APR_DECLARE(apr_hash_t *) apr_hash_make(apr_pool_t *pool)
+{
+    return apr_hash_make_ex(pool, NULL, 0);
+}
+
+APR_DECLARE(apr_hash_t *) apr_hash_make_custom(apr_pool_t *pool,
+                                               apr_hashfunc_t hash_func)
+{
+    return apr_hash_make_ex(pool, hash_func, 0);
+}
+
+APR_DECLARE(apr_hash_t *) apr_hash_make_ex(apr_pool_t *pool,
+                                           apr_hashfunc_t hash_func,
+                                           apr_uint32_t flags)
 {
     apr_hash_t *ht;
     apr_time_t now = apr_time_now();
@@ -102,20 +170,38 @@ APR_DECLARE(apr_hash_t *) apr_hash_make(apr_pool_t *pool)
     ht->pool = pool;
     ht->free = NULL;
     ht->count = 0;
+    ht->deleted = 0;
     ht->max = INITIAL_MAX;
     ht->seed = (unsigned int)((now >> 32) ^ now ^ (apr_uintptr_t)pool ^
                               (apr_uintptr_t)ht ^ (apr_uintptr_t)&now) - 1;
-    ht->array = alloc_array(ht, ht->max);
-    ht->hash_func = NULL;
-
-    return ht;
-}
-
-APR_DECLARE(apr_hash_t *) apr_hash_make_custom(apr_pool_t *pool,
-                                               apr_hashfunc_t hash_func)
-{
-    apr_hash_t *ht = apr_hash_make(pool);
+    ht->flags = hash_func ? 0 : (flags & HASH_FUNC_FLAGS);
+    if (ht->flags & APR_HASH_SIPHASH) {
+        ht->flags = APR_HASH_SIPHASH;
+#if APR_HAS_RANDOM
+        if (apr_generate_random_bytes((unsigned char *)ht->key,
+                                      sizeof(ht->key)) != APR_SUCCESS)
+#endif
+        {
+            ht->key[0] = (apr_uint64_t)now ^ (apr_uintptr_t)ht;
+            ht->key[1] = ((apr_uint64_t)ht->seed << 32) ^ (apr_uintptr_t)pool;
+        }
+    }
+    else if (ht->flags & APR_HASH_FAST_HASH) {
+        ht->key[0] = ((apr_uint64_t)ht->seed << 32) ^ (apr_uint64_t)now
+                     ^ (apr_uintptr_t)pool;
+        ht->key[1] = 0;
+    }
+    if (flags & APR_HASH_OPEN_ADDRESSING) {
+        ht->array = NULL;
+        alloc_slots(ht, ht->max);
+    }
+    else {
+        ht->array = alloc_array(ht, ht->max);
+        ht->ctrl = NULL;
+        ht->slots = NULL;
+    }
     ht->hash_func = hash_func;
+
     return ht;
 }
 
@@ -124,8 +210,42 @@ APR_DECLARE(apr_hash_t *) apr_hash_make_custom(apr_pool_t *pool,
  * Hash iteration functions.
  */
 
+static apr_hash_entry_t *oa_find(apr_hash_t *ht, const void *key,
+                                 apr_ssize_t klen, unsigned int hash);
+
+static void iterator_init(apr_hash_index_t *hi, apr_hash_t *ht)
+{
+    hi->ht = ht;
+    hi->index = 0;
+    hi->this = NULL;
+    hi->next = NULL;
+    hi->ctrl = ht->ctrl;
+    hi->slots = ht->slots;
+    hi->max = ht->max;
+}
+
 APR_DECLARE(apr_hash_index_t *) apr_hash_next(apr_hash_index_t *hi)
 {
+    if (hi->ctrl) {
+        while (hi->index <= hi->max) {
+            unsigned int i = hi->index++;
+            if (!CTRL_IS_FULL(hi->ctrl[i]))
+                continue;
+            hi->this = &hi->slots[i];
+            if (hi->slots != hi->ht->slots) {
+                /* Rehashed since, so each entry is still seen once (with
+                 * its current value) unless deleted.
+                 */
+                hi->this = oa_find(hi->ht, hi->this->key, hi->this->klen,
+                                   hi->this->hash);
+                if (!hi->this)
+                    continue;
+            }
+            return hi;
+        }
+        return NULL;
+    }
+
     hi->this = hi->next;
     while (!hi->this) {
         if (hi->index > hi->ht->max)
@@ -145,10 +265,7 @@ APR_DECLARE(apr_hash_index_t *) apr_hash_first(apr_pool_t *p, apr_hash_t *ht)
     else
         hi = &ht->iterator;
 
-    hi->ht = ht;
-    hi->index = 0;
-    hi->this = NULL;
-    hi->next = NULL;
+    iterator_init(hi, ht);
     return apr_hash_next(hi);
 }
 
@@ -273,6 +390,313 @@ APR_DECLARE_NONSTD(unsigned int) apr_hashfunc_default(const char *char_key,
     return hashfunc_default(char_key, klen, 0);
 }
 
+/*
+ * The fast hash function, derived from wyhash (final version 4) by
+ * Wang Yi <godspeed_china@yeah.net>, released to the public domain:
+ * https://github.com/wangyi-fudan/wyhash
+ *
+ * It reads the key 8 bytes at a time (in native byte order, the result
+ * depends on the platform) and mixes them with 64x64->128 bit
+ * multiplications, processing three independent lanes for long keys.
+ */
+
+static const apr_uint64_t fast_secret[4] = {
+    APR_UINT64_C(0x2d358dccaa6c78a5), APR_UINT64_C(0x8bb84b93962eacc9),
+    APR_UINT64_C(0x4b33a62ed433d4a3), APR_UINT64_C(0x4d5a2da51de1aa47)
+};
+
+static APR_INLINE void fast_mum(apr_uint64_t *a, apr_uint64_t *b)
+{
+#if defined(__SIZEOF_INT128__)
+    __uint128_t r = (__uint128_t)*a * *b;
+    *a = (apr_uint64_t)r;
+    *b = (apr_uint64_t)(r >> 64);
+#else
+    apr_uint64_t ha = *a >> 32, hb = *b >> 32;
+    apr_uint64_t la = (apr_uint32_t)*a, lb = (apr_uint32_t)*b;
+    apr_uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    apr_uint64_t t = rl + (rm0 << 32), c = t < rl, lo;
+    lo = t + (rm1 << 32);
+    c += lo < t;
+    *a = lo;
+    *b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+static APR_INLINE apr_uint64_t fast_mix(apr_uint64_t a, apr_uint64_t b)
+{
+    fast_mum(&a, &b);
+    return a ^ b;
+}
+
+static APR_INLINE apr_uint64_t fast_r8(const unsigned char *p)
+{
+    apr_uint64_t v;
+    memcpy(&v, p, 8);
+    return v;
+}
+
+static APR_INLINE apr_uint64_t fast_r4(const unsigned char *p)
+{
+    apr_uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+static apr_uint64_t hashfunc_fast(const void *key, apr_size_t len,
+                                  apr_uint64_t seed)
+{
+    const unsigned char *p = key;
+    const apr_uint64_t *s = fast_secret;
+    apr_uint64_t a, b;
+
+    seed ^= fast_mix(seed ^ s[0], s[1]);
+    if (len <= 16) {
+        if (len >= 4) {
+            apr_size_t d = (len >> 3) << 2;
+            a = (fast_r4(p) << 32) | fast_r4(p + d);
+            b = (fast_r4(p + len - 4) << 32) | fast_r4(p + len - 4 - d);
+        }
+        else if (len > 0) {
+            a = ((apr_uint64_t)p[0] << 16) | ((apr_uint64_t)p[len >> 1] << 8)
+                | p[len - 1];
+            b = 0;
+        }
+        else {
+            a = b = 0;
+        }
+    }
+    else {
+        apr_size_t i = len;
+        if (i > 48) {
+            apr_uint64_t see1 = seed, see2 = seed;
+            do {
+                seed = fast_mix(fast_r8(p) ^ s[1], fast_r8(p + 8) ^ seed);
+                see1 = fast_mix(fast_r8(p + 16) ^ s[2], fast_r8(p + 24) ^ see1);
+                see2 = fast_mix(fast_r8(p + 32) ^ s[3], fast_r8(p + 40) ^ see2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+            seed ^= see1 ^ see2;
+        }
+        while (i > 16) {
+            seed = fast_mix(fast_r8(p) ^ s[1], fast_r8(p + 8) ^ seed);
+            p += 16;
+            i -= 16;
+        }
+        a = fast_r8(p + i - 16);
+        b = fast_r8(p + i - 8);
+    }
+    a ^= s[1];
+    b ^= seed;
+    fast_mum(&a, &b);
+    return fast_mix(a ^ s[0] ^ len, b ^ s[1]);
+}
+
+/* Hash with the function of the table (but the custom one) */
+static APR_INLINE unsigned int hash_key(const apr_hash_t *ht, const void *key,
+                                        apr_ssize_t *klen)
+{
+    apr_uint64_t h;
+
+    if (!ht->flags) {
+        return hashfunc_default(key, klen, ht->seed);
+    }
+    if (*klen == APR_HASH_KEY_STRING) {
+        *klen = strlen(key);
+    }
+    if (ht->flags & APR_HASH_SIPHASH) {
+        h = apr_siphash24(key, *klen, (const unsigned char *)ht->key);
+    }
+    else {
+        h = hashfunc_fast(key, *klen, ht->key[0]);
+    }
+    return (unsigned int)(h ^ (h >> 32));
+}
+
+/*
+ * Open addressing
+ */
+
+static APR_INLINE unsigned int oa_hash(apr_hash_t *ht, const void *key,
+                                       apr_ssize_t *klen)
+{
+    unsigned int hash;
+
+    if (ht->hash_func)
+        hash = ht->hash_func(key, klen);
+    else
+        hash = hash_key(ht, key, klen);
+
+    /* Both the low bits (fingerprint) and the high bits (position) are
+     * used, so mix them (murmur3's finalizer).
+     */
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6b;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35;
+    hash ^= hash >> 16;
+
+    return hash;
+}
+
+#define OA_H1(hash) ((hash) >> 7)
+#define OA_H2(hash) ((unsigned char)((hash) & 0x7f))
+
+static APR_INLINE unsigned int first_bit(unsigned int mask)
+{
+#if defined(__GNUC__)
+    return __builtin_ctz(mask);
+#else
+    unsigned int n = 0;
+    while (!(mask & 1)) {
+        mask >>= 1;
+        n++;
+    }
+    return n;
+#endif
+}
+
+/* Bitmasks of the group's slots with the given control byte, empty, or
+ * free (empty or deleted).
+ */
+#if APR_HASH_SSE2
+static APR_INLINE unsigned int group_match(const unsigned char *g,
+                                           unsigned char c)
+{
+    __m128i ctrl = _mm_loadu_si128((const __m128i *)g);
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8((char)c)));
+}
+
+static APR_INLINE unsigned int group_match_free(const unsigned char *g)
+{
+    return _mm_movemask_epi8(_mm_loadu_si128((const __m128i *)g));
+}
+#else
+static APR_INLINE unsigned int group_match(const unsigned char *g,
+                                           unsigned char c)
+{
+    unsigned int i, mask = 0;
+
+    for (i = 0; i < GROUP_WIDTH; i++) {
+        if (g[i] == c)
+            mask |= 1u << i;
+    }
+    return mask;
+}
+
+static APR_INLINE unsigned int group_match_free(const unsigned char *g)
+{
+    unsigned int i, mask = 0;
+
+    for (i = 0; i < GROUP_WIDTH; i++) {
+        if (!CTRL_IS_FULL(g[i]))
+            mask |= 1u << i;
+    }
+    return mask;
+}
+#endif
+#define group_match_empty(g) group_match(g, CTRL_EMPTY)
+
+static APR_INLINE void oa_set_ctrl(apr_hash_t *ht, unsigned int i,
+                                   unsigned char c)
+{
+    ht->ctrl[i] = c;
+    if (i < GROUP_WIDTH)
+        ht->ctrl[ht->max + 1 + i] = c;
+}
+
+static apr_hash_entry_t *oa_find(apr_hash_t *ht, const void *key,
+                                 apr_ssize_t klen, unsigned int hash)
+{
+    unsigned int pos = OA_H1(hash) & ht->max, mask, i;
+    apr_hash_entry_t *he;
+
+    for (;;) {
+        const unsigned char *g = ht->ctrl + pos;
+
+        for (mask = group_match(g, OA_H2(hash)); mask; mask &= mask - 1) {
+            i = (pos + first_bit(mask)) & ht->max;
+            he = &ht->slots[i];
+            if (he->hash == hash
+                && he->klen == klen
+                && memcmp(he->key, key, klen) == 0)
+                return he;
+        }
+        /* The table is never full, so there is always an empty slot */
+        if (group_match_empty(g))
+            return NULL;
+
+        pos = (pos + GROUP_WIDTH) & ht->max;
+    }
+}
+
+/* Take a free slot for the given hash, the table must have room. */
+static apr_hash_entry_t *oa_take_slot(apr_hash_t *ht, unsigned int hash)
+{
+    unsigned int pos = OA_H1(hash) & ht->max, mask, i;
+
+    while (!(mask = group_match_free(ht->ctrl + pos))) {
+        pos = (pos + GROUP_WIDTH) & ht->max;
+    }
+    i = (pos + first_bit(mask)) & ht->max;
+    if (ht->ctrl[i] == CTRL_DELETED)
+        ht->deleted--;
+    oa_set_ctrl(ht, i, OA_H2(hash));
+
+    return &ht->slots[i];
+}
+
+/* Rehash into a bigger table, or the same size one if there are mainly
+ * tombstones to reclaim.
+ */
+static void oa_rehash(apr_hash_t *ht)
+{
+    unsigned char *old_ctrl = ht->ctrl;
+    apr_hash_entry_t *old_slots = ht->slots, *he;
+    unsigned int old_max = ht->max, i;
+
+    if (ht->count >= (old_max + 1) / 2)
+        ht->max = old_max * 2 + 1;
+    alloc_slots(ht, ht->max);
+    ht->deleted = 0;
+
+    for (i = 0; i <= old_max; i++) {
+        if (CTRL_IS_FULL(old_ctrl[i])) {
+            he = oa_take_slot(ht, old_slots[i].hash);
+            *he = old_slots[i];
+        }
+    }
+}
+
+/* Add a new entry, the key must not be present already. */
+static apr_hash_entry_t *oa_insert(apr_hash_t *ht, const void *key,
+                                   apr_ssize_t klen, unsigned int hash,
+                                   const void *val)
+{
+    apr_hash_entry_t *he;
+
+    if (ht->count + ht->deleted >= OA_MAX_LOAD(ht->max))
+        oa_rehash(ht);
+
+    he = oa_take_slot(ht, hash);
+    he->next = NULL;
+    he->hash = hash;
+    he->key  = key;
+    he->klen = klen;
+    he->val  = val;
+    ht->count++;
+
+    return he;
+}
+
+static void oa_delete(apr_hash_t *ht, apr_hash_entry_t *he)
+{
+    oa_set_ctrl(ht, (unsigned int)(he - ht->slots), CTRL_DELETED);
+    ht->deleted++;
+    ht->count--;
+}
+
 /*
  * This is where we keep the details of the hash function and control
  * the maximum collision rate.
@@ -293,7 +717,7 @@ static apr_hash_entry_t **find_entry(apr_hash_t *ht,
     if (ht->hash_func)
         hash = ht->hash_func(key, &klen);
     else
-        hash = hashfunc_default(key, &klen, ht->seed);
+        hash = hash_key(ht, key, &klen);
 
     /* scan linked list */
     for (hep = &ht->array[hash & ht->max], he = *hep;
@@ -328,6 +752,15 @@ APR_DECLARE(apr_hash_t *) apr_hash_copy(apr_pool_t *pool,
     apr_hash_entry_t *new_vals;
     unsigned int i, j;
 
+    if (orig->ctrl) {
+        ht = apr_pmemdup(pool, orig, sizeof(apr_hash_t));
+        ht->pool = pool;
+        ht->ctrl = apr_pmemdup(pool, orig->ctrl, orig->max + 1 + GROUP_WIDTH);
+        ht->slots = apr_pmemdup(pool, orig->slots,
+                                sizeof(*ht->slots) * (orig->max + 1));
+        return ht;
+    }
+
     ht = apr_palloc(pool, sizeof(apr_hash_t) +
                     sizeof(*ht->array) * (orig->max + 1) +
                     sizeof(apr_hash_entry_t) * orig->count);
@@ -336,8 +769,14 @@ APR_DECLARE(apr_hash_t *) apr_hash_copy(apr_pool_t *pool,
     ht->count = orig->count;
     ht->max = orig->max;
     ht->seed = orig->seed;
+    ht->flags = orig->flags;
+    ht->key[0] = orig->key[0];
+    ht->key[1] = orig->key[1];
     ht->hash_func = orig->hash_func;
     ht->array = (apr_hash_entry_t **)((char *)ht + sizeof(apr_hash_t));
+    ht->ctrl = NULL;
+    ht->slots = NULL;
+    ht->deleted = 0;
 
     new_vals = (apr_hash_entry_t *)((char *)(ht) + sizeof(apr_hash_t) +
                                     sizeof(*ht->array) * (orig->max + 1));
@@ -364,7 +803,14 @@ APR_DECLARE(void *) apr_hash_get(apr_hash_t *ht,
                                  apr_ssize_t klen)
 {
     apr_hash_entry_t *he;
-    he = *find_entry(ht, key, klen, NULL);
+
+    if (ht->ctrl) {
+        unsigned int hash = oa_hash(ht, key, &klen);
+        he = oa_find(ht, key, klen, hash);
+    }
+    else {
+        he = *find_entry(ht, key, klen, NULL);
+    }
     if (he)
         return (void *)he->val;
     else
@@ -377,6 +823,23 @@ APR_DECLARE(void) apr_hash_set(apr_hash_t *ht,
                                const void *val)
 {
     apr_hash_entry_t **hep;
+
+    if (ht->ctrl) {
+        unsigned int hash = oa_hash(ht, key, &klen);
+        apr_hash_entry_t *he = oa_find(ht, key, klen, hash);
+
+        if (he) {
+            if (!val)
+                oa_delete(ht, he);
+            else
+                he->val = val;
+        }
+        else if (val) {
+            oa_insert(ht, key, klen, hash, val);
+        }
+        return;
+    }
+
     hep = find_entry(ht, key, klen, val);
     if (*hep) {
         if (!val) {
@@ -405,6 +868,18 @@ APR_DECLARE(void *) apr_hash_get_or_set(apr_hash_t *ht,
                                         const void *val)
 {
     apr_hash_entry_t **hep;
+
+    if (ht->ctrl) {
+        unsigned int hash = oa_hash(ht, key, &klen);
+        apr_hash_entry_t *he = oa_find(ht, key, klen, hash);
+
+        if (he)
+            return (void *)he->val;
+        if (val)
+            oa_insert(ht, key, klen, hash, val);
+        return (void *)val;
+    }
+
     hep = find_entry(ht, key, klen, val);
     if (*hep) {
         val = (*hep)->val;
@@ -426,10 +901,76 @@ APR_DECLARE(unsigned int) apr_hash_count(apr_hash_t *ht)
 APR_DECLARE(void) apr_hash_clear(apr_hash_t *ht)
 {
     apr_hash_index_t *hi;
+
+    if (ht->ctrl) {
+        memset(ht->ctrl, CTRL_EMPTY, ht->max + 1 + GROUP_WIDTH);
+        ht->count = 0;
+        ht->deleted = 0;
+        return;
+    }
     for (hi = apr_hash_first(NULL, ht); hi; hi = apr_hash_next(hi))
         apr_hash_set(ht, hi->this->key, hi->this->klen, NULL);
 }
 
+/* Merge through the API, when any of the tables uses open addressing.
+ * The result uses the same implementation as base.
+ */
+static apr_hash_t *merge_generic(apr_pool_t *p,
+                                 const apr_hash_t *overlay,
+                                 const apr_hash_t *base,
+                                 void * (*merger)(apr_pool_t *p,
+                                                  const void *key,
+                                                  apr_ssize_t klen,
+                                                  const void *h1_val,
+                                                  const void *h2_val,
+                                                  const void *data),
+                                 const void *data)
+{
+    apr_hash_t *res;
+    apr_hash_index_t hix, *hi;
+    apr_hash_entry_t *he;
+
+    res = apr_hash_make_ex(p, base->hash_func, base->flags |
+                           (base->ctrl ? APR_HASH_OPEN_ADDRESSING : 0));
+    res->seed = base->seed;
+    res->key[0] = base->key[0];
+    res->key[1] = base->key[1];
+
+    iterator_init(&hix, (apr_hash_t *)base);
+    for (hi = apr_hash_next(&hix); hi; hi = apr_hash_next(hi)) {
+        apr_hash_set(res, hi->this->key, hi->this->klen, hi->this->val);
+    }
+
+    iterator_init(&hix, (apr_hash_t *)overlay);
+    for (hi = apr_hash_next(&hix); hi; hi = apr_hash_next(hi)) {
+        apr_ssize_t klen = hi->this->klen;
+
+        if (res->ctrl) {
+            unsigned int hash = oa_hash(res, hi->this->key, &klen);
+            he = oa_find(res, hi->this->key, klen, hash);
+        }
+        else {
+            he = *find_entry(res, hi->this->key, klen, NULL);
+        }
+        if (he) {
+            /* Like the chained merge, keep the key even if the merger
+             * returns NULL */
+            if (merger) {
+                he->val = (*merger)(p, hi->this->key, klen,
+                                    hi->this->val, he->val, data);
+            }
+            else {
+                he->val = hi->this->val;
+            }
+        }
+        else {
+            apr_hash_set(res, hi->this->key, klen, hi->this->val);
+        }
+    }
+
+    return res;
+}
+
 APR_DECLARE(apr_hash_t*) apr_hash_overlay(apr_pool_t *p,
                                           const apr_hash_t *overlay,
                                           const apr_hash_t *base)
@@ -471,9 +1012,16 @@ APR_DECLARE(apr_hash_t *) apr_hash_merge(apr_pool_t *p,
     }
 #endif
 
+    if (base->ctrl || overlay->ctrl) {
+        return merge_generic(p, overlay, base, merger, data);
+    }
+
     res = apr_palloc(p, sizeof(apr_hash_t));
     res->pool = p;
     res->free = NULL;
+    res->ctrl = NULL;
+    res->slots = NULL;
+    res->deleted = 0;
     res->hash_func = base->hash_func;
     res->count = base->count;
     res->max = (overlay->max > base->max) ? overlay->max : base->max;
@@ -481,6 +1029,9 @@ APR_DECLARE(apr_hash_t *) apr_hash_merge(apr_pool_t *p,
         res->max = res->max * 2 + 1;
     }
     res->seed = base->seed;
+    res->flags = base->flags;
+    res->key[0] = base->key[0];
+    res->key[1] = base->key[1];
     res->array = alloc_array(res, res->max);
     if (base->count + overlay->count) {
         new_vals = apr_palloc(p, sizeof(apr_hash_entry_t) *
@@ -505,7 +1056,7 @@ APR_DECLARE(apr_hash_t *) apr_hash_merge(apr_pool_t *p,
             if (res->hash_func)
                 hash = res->hash_func(iter->key, &iter->klen);
             else
-                hash = hashfunc_default(iter->key, &iter->klen, res->seed);
+                hash = hash_key(res, iter->key, &iter->klen);
             i = hash & res->max;
             for (ent = res->array[i]; ent; ent = ent->next) {
                 if ((ent->klen == iter->klen) &&
@@ -550,10 +1101,7 @@ APR_DECLARE(int) apr_hash_do(apr_hash_do_callback_fn_t *comp,
     apr_hash_index_t *hi;
     int rv, dorv  = 1;
 
-    hix.ht    = (apr_hash_t *)ht;
-    hix.index = 0;
-    hix.this  = NULL;
-    hix.next  = NULL;
+    iterator_init(&hix, (apr_hash_t *)ht);
 
     if ((hi = apr_hash_next(&hix))) {
         /* Scan the entire table */
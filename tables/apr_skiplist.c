@@ -45,7 +45,9 @@ struct apr_skiplist {
     apr_skiplist *index;
     apr_array_header_t *memlist;
     apr_skiplist_q nodes_q,
-                   stack_q;
+                   stack_q,
+                   chunks_q; /* malloc()ed chunks of nodes (w/o pool) */
+    size_t nodes_count;
     apr_pool_t *pool;
 };
 
@@ -186,15 +188,45 @@ static APR_INLINE void skiplist_qclear(apr_skiplist_q *q)
     q->pos = 0;
 }
 
+/* The nodes are allocated by contiguous chunks (growing with the number
+ * of nodes), so that the nodes of an element (one per level) are usually
+ * adjacent, and recycled through nodes_q.
+ */
+#define SKIPLIST_CHUNK_MIN 16
+#define SKIPLIST_CHUNK_MAX 1024
+
 static apr_skiplistnode *skiplist_new_node(apr_skiplist *sl)
 {
     apr_skiplistnode *m = skiplist_qpop(&sl->nodes_q);
     if (!m) {
+        size_t n = sl->nodes_count;
+        if (n < SKIPLIST_CHUNK_MIN) {
+            n = SKIPLIST_CHUNK_MIN;
+        }
+        else if (n > SKIPLIST_CHUNK_MAX) {
+            n = SKIPLIST_CHUNK_MAX;
+        }
         if (sl->pool) {
-            m = apr_palloc(sl->pool, sizeof *m);
+            m = apr_palloc(sl->pool, n * sizeof *m);
         }
         else {
-            m = malloc(sizeof *m);
+            m = malloc(n * sizeof *m);
+            if (m && skiplist_qpush(&sl->chunks_q, m) != APR_SUCCESS) {
+                free(m);
+                m = NULL;
+            }
+        }
+        if (!m) {
+            return NULL;
+        }
+        sl->nodes_count += n;
+        /* Keep the first node, the others are pushed in reverse order to
+         * be popped in address order.
+         */
+        while (--n > 0) {
+            if (skiplist_qpush(&sl->nodes_q, m + n) != APR_SUCCESS) {
+                break;
+            }
         }
     }
     return m;
@@ -211,7 +243,7 @@ static apr_status_t skiplisti_init(apr_skiplist **s, apr_pool_t *p)
     if (p) {
         sl = apr_pcalloc(p, sizeof(apr_skiplist));
         sl->memlist = apr_array_make(p, 20, sizeof(memlist_t));
-        sl->pool = sl->nodes_q.p = sl->stack_q.p = p;
+        sl->pool = sl->nodes_q.p = sl->stack_q.p = sl->chunks_q.p = p;
     }
     else {
         sl = calloc(1, sizeof(apr_skiplist));
@@ -309,14 +341,58 @@ APR_DECLARE(void) apr_skiplist_add_index(apr_skiplist *sl,
     }
 }
 
+/* Climb from the finger node (on the bottom row) to the first row where
+ * the next node is past data (not before for !after), and at least at the
+ * given height, for the search to continue from there.  Since it moves
+ * either up or left to the nearest node of the upper row, this is O(log n)
+ * with n the distance between the finger and data, so amortized O(1) for
+ * (almost) monotonic insertions.
+ */
+static apr_skiplistnode *skiplisti_finger(apr_skiplistnode *m, void *data,
+                                          apr_skiplist_compare comp,
+                                          int after, int height, int *ch)
+{
+    apr_skiplistnode *l;
+    int h = 1;
+
+    for (;;) {
+        if (h >= height) {
+            int compared;
+            if (!m->next) {
+                break;
+            }
+            compared = comp(data, m->next->data);
+            if (compared < 0 || (compared == 0 && !after)) {
+                break;
+            }
+        }
+        for (l = m; !l->up && l->prev; l = l->prev)
+            ;
+        if (!l->up) {
+            /* top row */
+            break;
+        }
+        m = l->up;
+        h++;
+    }
+    *ch = h;
+    return m;
+}
+
 static int skiplisti_find_compare(apr_skiplist *sl, void *data,
                                   apr_skiplistnode **ret,
                                   apr_skiplist_compare comp,
-                                  int last)
+                                  int last, apr_skiplistnode *finger)
 {
     int count = 0;
     apr_skiplistnode *m, *found = NULL;
-    for (m = sl->top; m; count++) {
+
+    m = sl->top;
+    if (finger && m && comp(data, finger->data) > 0) {
+        int ch;
+        m = skiplisti_finger(finger, data, comp, last, 1, &ch);
+    }
+    for (; m; count++) {
         if (m->next) {
             int compared = comp(data, m->next->data);
             if (compared == 0) {
@@ -348,7 +424,7 @@ static int skiplisti_find_compare(apr_skiplist *sl, void *data,
 static void *find_compare(apr_skiplist *sli, void *data,
                           apr_skiplistnode **iter,
                           apr_skiplist_compare comp,
-                          int last)
+                          int last, apr_skiplistnode *finger)
 {
     apr_skiplistnode *m;
     apr_skiplist *sl;
@@ -370,8 +446,9 @@ static void *find_compare(apr_skiplist *sli, void *data,
             return NULL;
         }
         sl = (apr_skiplist *) m->data;
+        finger = NULL;
     }
-    skiplisti_find_compare(sl, data, &m, sl->comparek, last);
+    skiplisti_find_compare(sl, data, &m, sl->comparek, last, finger);
     if (iter) {
         *iter = m;
     }
@@ -382,25 +459,32 @@ APR_DECLARE(void *) apr_skiplist_find_compare(apr_skiplist *sl, void *data,
                                               apr_skiplistnode **iter,
                                               apr_skiplist_compare comp)
 {
-    return find_compare(sl, data, iter, comp, 0);
+    return find_compare(sl, data, iter, comp, 0, NULL);
 }
 
 APR_DECLARE(void *) apr_skiplist_find(apr_skiplist *sl, void *data, apr_skiplistnode **iter)
 {
-    return find_compare(sl, data, iter, sl->compare, 0);
+    return find_compare(sl, data, iter, sl->compare, 0, NULL);
+}
+
+APR_DECLARE(void *) apr_skiplist_find_finger(apr_skiplist *sl, void *data,
+                                             apr_skiplistnode *finger,
+                                             apr_skiplistnode **iter)
+{
+    return find_compare(sl, data, iter, sl->compare, 0, finger);
 }
 
 APR_DECLARE(void *) apr_skiplist_last_compare(apr_skiplist *sl, void *data,
                                               apr_skiplistnode **iter,
                                               apr_skiplist_compare comp)
 {
-    return find_compare(sl, data, iter, comp, 1);
+    return find_compare(sl, data, iter, comp, 1, NULL);
 }
 
 APR_DECLARE(void *) apr_skiplist_last(apr_skiplist *sl, void *data,
                                       apr_skiplistnode **iter)
 {
-    return find_compare(sl, data, iter, sl->compare, 1);
+    return find_compare(sl, data, iter, sl->compare, 1, NULL);
 }
 
 
@@ -450,7 +534,8 @@ static APR_INLINE int skiplist_height(const apr_skiplist *sl)
 
 static apr_skiplistnode *insert_compare(apr_skiplist *sl, void *data,
                                         apr_skiplist_compare comp, int add,
-                                        apr_skiplist_freefunc myfree)
+                                        apr_skiplist_freefunc myfree,
+                                        apr_skiplistnode *finger)
 {
     apr_skiplistnode *m, *p, *tmp, *ret = NULL;
     int ch, top_nh, nh = 1;
@@ -476,6 +561,16 @@ static apr_skiplistnode *insert_compare(apr_skiplist *sl, void *data,
      * for insertion later.
      */
     m = sl->top;
+    if (finger && m && add >= 0) {
+        /* Start from the finger if it's before data (or a dup to add after) */
+        int compared = comp(data, finger->data);
+        if (compared > 0 || (compared == 0 && add)) {
+            m = skiplisti_finger(finger, data, comp, 1, nh, &ch);
+        }
+        else if (compared == 0) {
+            return NULL;
+        }
+    }
     while (m) {
         /*
          * To maintain stability, dups (compared == 0) must be added
@@ -579,7 +674,7 @@ static apr_skiplistnode *insert_compare(apr_skiplist *sl, void *data,
         li = ret;
         for (p = apr_skiplist_getlist(sl->index); p; apr_skiplist_next(sl->index, &p)) {
             apr_skiplist *sli = (apr_skiplist *)p->data;
-            ni = insert_compare(sli, ret->data, sli->compare, 1, NULL);
+            ni = insert_compare(sli, ret->data, sli->compare, 1, NULL, NULL);
             li->nextindex = ni;
             ni->previndex = li;
             li = ni;
@@ -595,7 +690,7 @@ APR_DECLARE(apr_skiplistnode *) apr_skiplist_insert_compare(apr_skiplist *sl, vo
     if (!comp) {
         return NULL;
     }
-    return insert_compare(sl, data, comp, 0, NULL);
+    return insert_compare(sl, data, comp, 0, NULL, NULL);
 }
 
 APR_DECLARE(apr_skiplistnode *) apr_skiplist_insert(apr_skiplist *sl, void *data)
@@ -603,13 +698,23 @@ APR_DECLARE(apr_skiplistnode *) apr_skiplist_insert(apr_skiplist *sl, void *data
     return apr_skiplist_insert_compare(sl, data, sl->compare);
 }
 
+APR_DECLARE(apr_skiplistnode *) apr_skiplist_insert_finger(apr_skiplist *sl,
+                                                void *data,
+                                                apr_skiplistnode *finger)
+{
+    if (!sl->compare) {
+        return NULL;
+    }
+    return insert_compare(sl, data, sl->compare, 0, NULL, finger);
+}
+
 APR_DECLARE(apr_skiplistnode *) apr_skiplist_add_compare(apr_skiplist *sl, void *data,
                                       apr_skiplist_compare comp)
 {
     if (!comp) {
         return NULL;
     }
-    return insert_compare(sl, data, comp, 1, NULL);
+    return insert_compare(sl, data, comp, 1, NULL, NULL);
 }
 
 APR_DECLARE(apr_skiplistnode *) apr_skiplist_add(apr_skiplist *sl, void *data)
@@ -617,6 +722,16 @@ APR_DECLARE(apr_skiplistnode *) apr_skiplist_add(apr_skiplist *sl, void *data)
     return apr_skiplist_add_compare(sl, data, sl->compare);
 }
 
+APR_DECLARE(apr_skiplistnode *) apr_skiplist_add_finger(apr_skiplist *sl,
+                                                void *data,
+                                                apr_skiplistnode *finger)
+{
+    if (!sl->compare) {
+        return NULL;
+    }
+    return insert_compare(sl, data, sl->compare, 1, NULL, finger);
+}
+
 APR_DECLARE(apr_skiplistnode *) apr_skiplist_replace_compare(apr_skiplist *sl,
                                     void *data, apr_skiplist_freefunc myfree,
                                     apr_skiplist_compare comp)
@@ -624,7 +739,7 @@ APR_DECLARE(apr_skiplistnode *) apr_skiplist_replace_compare(apr_skiplist *sl,
     if (!comp) {
         return NULL;
     }
-    return insert_compare(sl, data, comp, -1, myfree);
+    return insert_compare(sl, data, comp, -1, myfree, NULL);
 }
 
 APR_DECLARE(apr_skiplistnode *) apr_skiplist_replace(apr_skiplist *sl,
@@ -733,7 +848,7 @@ APR_DECLARE(int) apr_skiplist_remove_compare(apr_skiplist *sli,
         }
         sl = (apr_skiplist *) m->data;
     }
-    skiplisti_find_compare(sl, data, &m, comp, 0);
+    skiplisti_find_compare(sl, data, &m, comp, 0, NULL);
     if (!m) {
         return 0;
     }
@@ -828,8 +943,9 @@ APR_DECLARE(void) apr_skiplist_destroy(apr_skiplist *sl, apr_skiplist_freefunc m
         ;
     apr_skiplist_remove_all(sl, myfree);
     if (!sl->pool) {
-        while (sl->nodes_q.pos)
-            free(sl->nodes_q.data[--sl->nodes_q.pos]);
+        while (sl->chunks_q.pos)
+            free(sl->chunks_q.data[--sl->chunks_q.pos]);
+        free(sl->chunks_q.data);
         free(sl->nodes_q.data);
         free(sl->stack_q.data);
         free(sl);
@@ -26,6 +26,7 @@
 #include "apr_general.h"
 #include "apr_pools.h"
 #include "apr_tables.h"
+#include "apr_cstr.h"
 #include "apr_strings.h"
 #include "apr_lib.h"
 #if APR_HAVE_STDLIB_H
@@ -299,11 +300,15 @@ APR_DECLARE(char *) apr_array_pstrcat(apr_pool_t *p,
 #define TABLE_INDEX_IS_INITIALIZED(t, i) ((t)->index_initialized & (1u << (i)))
 #define TABLE_SET_INDEX_INITIALIZED(t, i) ((t)->index_initialized |= (1u << (i)))
 
+/* The hash index is built once the table has more entries than this */
+#define TABLE_HINDEX_MIN 16
+#define TABLE_HINDEX_INITIAL_MAX 63 /* tunable == 2^n - 1 */
+
 /* Compute the "checksum" for a key, consisting of the first
  * 4 bytes, normalized for case-insensitivity and packed into
  * an int...this checksum allows us to do a single integer
  * comparison as a fast check to determine whether we can
- * skip a strcasecmp
+ * skip an apr_cstr_casecmp()
  */
 #define COMPUTE_KEY_CHECKSUM(key, checksum)    \
 {                                              \
@@ -355,8 +360,28 @@ struct apr_table_t {
     apr_uint32_t index_initialized;
     int index_first[TABLE_HASH_SIZE];
     int index_last[TABLE_HASH_SIZE];
+    /* Since many keys share their first character (Accept-*, Content-*,
+     * X-*...), large tables also have a hash index of the full keys
+     * (case-insensitive), with open addressing and at most half full:
+     *   - hindex[i].first and hindex[i].last are the offsets within the
+     *     table of the first and last entries with the key hashed at i,
+     *     or -1 for an unused slot
+     *   - hindex[i].hash is the hash of the key
+     * It's built when the table grows above TABLE_HINDEX_MIN entries,
+     * maintained when entries are added, and rebuilt when entries are
+     * moved (like the above index).
+     */
+    struct table_hindex_t *hindex;
+    int hindex_max;
+    int hindex_count;
 };
 
+typedef struct table_hindex_t {
+    apr_uint32_t hash;
+    int first;
+    int last;
+} table_hindex_t;
+
 /* keep state for apr_table_getm() */
 typedef struct
 {
@@ -406,6 +431,7 @@ APR_DECLARE(apr_table_t *) apr_table_make(apr_pool_t *p, int nelts)
     t->creator = __builtin_return_address(0);
 #endif
     t->index_initialized = 0;
+    t->hindex = NULL;
     return t;
 }
 
@@ -428,6 +454,13 @@ APR_DECLARE(apr_table_t *) apr_table_copy(apr_pool_t *p, const apr_table_t *t)
     memcpy(new->index_first, t->index_first, sizeof(int) * TABLE_HASH_SIZE);
     memcpy(new->index_last, t->index_last, sizeof(int) * TABLE_HASH_SIZE);
     new->index_initialized = t->index_initialized;
+    new->hindex = NULL;
+    if (t->hindex) {
+        new->hindex = apr_pmemdup(p, t->hindex,
+                                  sizeof(table_hindex_t) * (t->hindex_max + 1));
+        new->hindex_max = t->hindex_max;
+        new->hindex_count = t->hindex_count;
+    }
     return new;
 }
 
@@ -445,6 +478,154 @@ APR_DECLARE(apr_table_t *) apr_table_clone(apr_pool_t *p, const apr_table_t *t)
     return new;
 }
 
+/* Case-insensitive hash of a key, for the hash index (the case is
+ * normalized like for the checksum)
+ */
+static APR_INLINE apr_uint32_t table_key_hash(const char *key)
+{
+    const unsigned char *k = (const unsigned char *)key;
+    apr_uint32_t hash = 0;
+
+    for (; *k; k++) {
+        hash = hash * 33 + (*k & (unsigned char)CASE_MASK);
+    }
+
+    /* The low bits are used for the position, mix the high ones in
+     * (murmur3's finalizer).
+     */
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6b;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35;
+    hash ^= hash >> 16;
+
+    return hash;
+}
+
+/* Find the slot of key in the hash index, or the unused slot where it
+ * would be
+ */
+static table_hindex_t *table_hindex_find(const apr_table_t *t,
+                                         const char *key,
+                                         apr_uint32_t khash,
+                                         apr_uint32_t checksum)
+{
+    const apr_table_entry_t *elts = (const apr_table_entry_t *)t->a.elts;
+    table_hindex_t *slot;
+    int i = khash & t->hindex_max;
+
+    for (;;) {
+        slot = &t->hindex[i];
+        if (slot->first < 0) {
+            return slot;
+        }
+        if (slot->hash == khash
+            && elts[slot->first].key_checksum == checksum
+            && !apr_cstr_casecmp(elts[slot->first].key, key)) {
+            return slot;
+        }
+        i = (i + 1) & t->hindex_max;
+    }
+}
+
+static void table_hindex_build(apr_table_t *t)
+{
+    apr_table_entry_t *next_elt = (apr_table_entry_t *) t->a.elts;
+    table_hindex_t *slot;
+    apr_uint32_t khash;
+    int max = TABLE_HINDEX_INITIAL_MAX;
+    int i;
+
+    while (max < t->a.nelts * 2) {
+        max = max * 2 + 1;
+    }
+    if (!t->hindex || max > t->hindex_max) {
+        t->hindex = apr_palloc(t->a.pool, sizeof(table_hindex_t) * (max + 1));
+        t->hindex_max = max;
+    }
+    for (i = 0; i <= t->hindex_max; i++) {
+        t->hindex[i].first = -1;
+    }
+    t->hindex_count = 0;
+
+    for (i = 0; i < t->a.nelts; i++, next_elt++) {
+        if (!next_elt->key) {
+            continue;
+        }
+        khash = table_key_hash(next_elt->key);
+        slot = table_hindex_find(t, next_elt->key, khash,
+                                 next_elt->key_checksum);
+        if (slot->first < 0) {
+            slot->hash = khash;
+            slot->first = i;
+            t->hindex_count++;
+        }
+        slot->last = i;
+    }
+}
+
+/* Find the range of the entries which may have the given key, or return
+ * zero if there is none.  With the hash index, *slot is set to the slot of
+ * the key, for table_index_added() to avoid a lookup.
+ */
+static APR_INLINE int table_lookup(const apr_table_t *t, const char *key,
+                                   int hash, apr_uint32_t checksum,
+                                   table_hindex_t **slot,
+                                   int *first, int *last)
+{
+    if (t->hindex) {
+        *slot = table_hindex_find(t, key, table_key_hash(key), checksum);
+        *first = (*slot)->first;
+        *last = (*slot)->last;
+        return *first >= 0;
+    }
+    *slot = NULL;
+    if (!TABLE_INDEX_IS_INITIALIZED(t, hash)) {
+        return 0;
+    }
+    *first = t->index_first[hash];
+    *last = t->index_last[hash];
+    return 1;
+}
+
+/* Index the entry just pushed at the end of the table, slot is either
+ * the one returned by table_lookup() or NULL
+ */
+static void table_index_added(apr_table_t *t, int hash,
+                              table_hindex_t *slot)
+{
+    apr_table_entry_t *elt = (apr_table_entry_t *)t->a.elts + t->a.nelts - 1;
+    int i = t->a.nelts - 1;
+
+    t->index_last[hash] = i;
+    if (!TABLE_INDEX_IS_INITIALIZED(t, hash)) {
+        t->index_first[hash] = i;
+        TABLE_SET_INDEX_INITIALIZED(t, hash);
+    }
+
+    if (!t->hindex) {
+        if (t->a.nelts > TABLE_HINDEX_MIN) {
+            table_hindex_build(t);
+        }
+        return;
+    }
+    if (!slot) {
+        slot = table_hindex_find(t, elt->key, table_key_hash(elt->key),
+                                 elt->key_checksum);
+    }
+    if (slot->first >= 0) {
+        slot->last = i;
+    }
+    else if ((t->hindex_count + 1) * 2 > t->hindex_max) {
+        table_hindex_build(t);
+    }
+    else {
+        slot->hash = table_key_hash(elt->key);
+        slot->first = slot->last = i;
+        t->hindex_count++;
+    }
+}
+
 static void table_reindex(apr_table_t *t)
 {
     int i;
@@ -460,36 +641,48 @@ static void table_reindex(apr_table_t *t)
             TABLE_SET_INDEX_INITIALIZED(t, hash);
         }
     }
+
+    if (t->hindex || t->a.nelts > TABLE_HINDEX_MIN) {
+        table_hindex_build(t);
+    }
 }
 
 APR_DECLARE(void) apr_table_clear(apr_table_t *t)
 {
     t->a.nelts = 0;
     t->index_initialized = 0;
+    if (t->hindex) {
+        table_hindex_build(t);
+    }
 }
 
 APR_DECLARE(const char *) apr_table_get(const apr_table_t *t, const char *key)
 {
     apr_table_entry_t *next_elt;
     apr_table_entry_t *end_elt;
+    table_hindex_t *slot;
     apr_uint32_t checksum;
-    int hash;
+    int first, last;
 
     if (key == NULL) {
 	return NULL;
     }
 
-    hash = TABLE_HASH(key);
-    if (!TABLE_INDEX_IS_INITIALIZED(t, hash)) {
+    COMPUTE_KEY_CHECKSUM(key, checksum);
+    if (!table_lookup(t, key, TABLE_HASH(key), checksum,
+                      &slot, &first, &last)) {
         return NULL;
     }
-    COMPUTE_KEY_CHECKSUM(key, checksum);
-    next_elt = ((apr_table_entry_t *) t->a.elts) + t->index_first[hash];;
-    end_elt = ((apr_table_entry_t *) t->a.elts) + t->index_last[hash];
+    next_elt = ((apr_table_entry_t *) t->a.elts) + first;
+    end_elt = ((apr_table_entry_t *) t->a.elts) + last;
+    if (slot) {
+        /* exact match */
+        return next_elt->val;
+    }
 
     for (; next_elt <= end_elt; next_elt++) {
 	if ((checksum == next_elt->key_checksum) &&
-            !strcasecmp(next_elt->key, key)) {
+            !apr_cstr_casecmp(next_elt->key, key)) {
 	    return next_elt->val;
 	}
     }
@@ -503,23 +696,22 @@ APR_DECLARE(void) apr_table_set(apr_table_t *t, const char *key,
     apr_table_entry_t *next_elt;
     apr_table_entry_t *end_elt;
     apr_table_entry_t *table_end;
+    table_hindex_t *slot;
     apr_uint32_t checksum;
-    int hash;
+    int hash, first, last;
 
     COMPUTE_KEY_CHECKSUM(key, checksum);
     hash = TABLE_HASH(key);
-    if (!TABLE_INDEX_IS_INITIALIZED(t, hash)) {
-        t->index_first[hash] = t->a.nelts;
-        TABLE_SET_INDEX_INITIALIZED(t, hash);
+    if (!table_lookup(t, key, hash, checksum, &slot, &first, &last)) {
         goto add_new_elt;
     }
-    next_elt = ((apr_table_entry_t *) t->a.elts) + t->index_first[hash];;
-    end_elt = ((apr_table_entry_t *) t->a.elts) + t->index_last[hash];
+    next_elt = ((apr_table_entry_t *) t->a.elts) + first;
+    end_elt = ((apr_table_entry_t *) t->a.elts) + last;
     table_end =((apr_table_entry_t *) t->a.elts) + t->a.nelts;
 
     for (; next_elt <= end_elt; next_elt++) {
 	if ((checksum == next_elt->key_checksum) &&
-            !strcasecmp(next_elt->key, key)) {
+            !apr_cstr_casecmp(next_elt->key, key)) {
 
             /* Found an existing entry with the same key, so overwrite it */
 
@@ -531,7 +723,7 @@ APR_DECLARE(void) apr_table_set(apr_table_t *t, const char *key,
             /* Remove any other instances of this key */
             for (next_elt++; next_elt <= end_elt; next_elt++) {
                 if ((checksum == next_elt->key_checksum) &&
-                    !strcasecmp(next_elt->key, key)) {
+                    !apr_cstr_casecmp(next_elt->key, key)) {
                     t->a.nelts--;
                     if (!dst_elt) {
                         dst_elt = next_elt;
@@ -562,11 +754,11 @@ APR_DECLARE(void) apr_table_set(apr_table_t *t, const char *key,
     }
 
 add_new_elt:
-    t->index_last[hash] = t->a.nelts;
     next_elt = (apr_table_entry_t *) table_push(t);
     next_elt->key = apr_pstrdup(t->a.pool, key);
     next_elt->val = apr_pstrdup(t->a.pool, val);
     next_elt->key_checksum = checksum;
+    table_index_added(t, hash, slot);
 }
 
 APR_DECLARE(void) apr_table_setn(apr_table_t *t, const char *key,
@@ -575,23 +767,22 @@ APR_DECLARE(void) apr_table_setn(apr_table_t *t, const char *key,
     apr_table_entry_t *next_elt;
     apr_table_entry_t *end_elt;
     apr_table_entry_t *table_end;
+    table_hindex_t *slot;
     apr_uint32_t checksum;
-    int hash;
+    int hash, first, last;
 
     COMPUTE_KEY_CHECKSUM(key, checksum);
     hash = TABLE_HASH(key);
-    if (!TABLE_INDEX_IS_INITIALIZED(t, hash)) {
-        t->index_first[hash] = t->a.nelts;
-        TABLE_SET_INDEX_INITIALIZED(t, hash);
+    if (!table_lookup(t, key, hash, checksum, &slot, &first, &last)) {
         goto add_new_elt;
     }
-    next_elt = ((apr_table_entry_t *) t->a.elts) + t->index_first[hash];;
-    end_elt = ((apr_table_entry_t *) t->a.elts) + t->index_last[hash];
+    next_elt = ((apr_table_entry_t *) t->a.elts) + first;
+    end_elt = ((apr_table_entry_t *) t->a.elts) + last;
     table_end =((apr_table_entry_t *) t->a.elts) + t->a.nelts;
 
     for (; next_elt <= end_elt; next_elt++) {
 	if ((checksum == next_elt->key_checksum) &&
-            !strcasecmp(next_elt->key, key)) {
+            !apr_cstr_casecmp(next_elt->key, key)) {
 
             /* Found an existing entry with the same key, so overwrite it */
 
@@ -603,7 +794,7 @@ APR_DECLARE(void) apr_table_setn(apr_table_t *t, const char *key,
             /* Remove any other instances of this key */
             for (next_elt++; next_elt <= end_elt; next_elt++) {
                 if ((checksum == next_elt->key_checksum) &&
-                    !strcasecmp(next_elt->key, key)) {
+                    !apr_cstr_casecmp(next_elt->key, key)) {
                     t->a.nelts--;
                     if (!dst_elt) {
                         dst_elt = next_elt;
@@ -634,11 +825,11 @@ APR_DECLARE(void) apr_table_setn(apr_table_t *t, const char *key,
     }
 
 add_new_elt:
-    t->index_last[hash] = t->a.nelts;
     next_elt = (apr_table_entry_t *) table_push(t);
     next_elt->key = (char *)key;
     next_elt->val = (char *)val;
     next_elt->key_checksum = checksum;
+    table_index_added(t, hash, slot);
 }
 
 APR_DECLARE(void) apr_table_unset(apr_table_t *t, const char *key)
@@ -646,21 +837,22 @@ APR_DECLARE(void) apr_table_unset(apr_table_t *t, const char *key)
     apr_table_entry_t *next_elt;
     apr_table_entry_t *end_elt;
     apr_table_entry_t *dst_elt;
+    table_hindex_t *slot;
     apr_uint32_t checksum;
-    int hash;
+    int first, last;
     int must_reindex;
 
-    hash = TABLE_HASH(key);
-    if (!TABLE_INDEX_IS_INITIALIZED(t, hash)) {
+    COMPUTE_KEY_CHECKSUM(key, checksum);
+    if (!table_lookup(t, key, TABLE_HASH(key), checksum,
+                      &slot, &first, &last)) {
         return;
     }
-    COMPUTE_KEY_CHECKSUM(key, checksum);
-    next_elt = ((apr_table_entry_t *) t->a.elts) + t->index_first[hash];
-    end_elt = ((apr_table_entry_t *) t->a.elts) + t->index_last[hash];
+    next_elt = ((apr_table_entry_t *) t->a.elts) + first;
+    end_elt = ((apr_table_entry_t *) t->a.elts) + last;
     must_reindex = 0;
     for (; next_elt <= end_elt; next_elt++) {
 	if ((checksum == next_elt->key_checksum) &&
-            !strcasecmp(next_elt->key, key)) {
+            !apr_cstr_casecmp(next_elt->key, key)) {
 
             /* Found a match: remove this entry, plus any additional
              * matches for the same key that might follow
@@ -671,7 +863,7 @@ APR_DECLARE(void) apr_table_unset(apr_table_t *t, const char *key)
             dst_elt = next_elt;
             for (next_elt++; next_elt <= end_elt; next_elt++) {
                 if ((checksum == next_elt->key_checksum) &&
-                    !strcasecmp(next_elt->key, key)) {
+                    !apr_cstr_casecmp(next_elt->key, key)) {
                     t->a.nelts--;
                 }
                 else {
@@ -700,22 +892,21 @@ APR_DECLARE(void) apr_table_merge(apr_table_t *t, const char *key,
 {
     apr_table_entry_t *next_elt;
     apr_table_entry_t *end_elt;
+    table_hindex_t *slot;
     apr_uint32_t checksum;
-    int hash;
+    int hash, first, last;
 
     COMPUTE_KEY_CHECKSUM(key, checksum);
     hash = TABLE_HASH(key);
-    if (!TABLE_INDEX_IS_INITIALIZED(t, hash)) {
-        t->index_first[hash] = t->a.nelts;
-        TABLE_SET_INDEX_INITIALIZED(t, hash);
+    if (!table_lookup(t, key, hash, checksum, &slot, &first, &last)) {
         goto add_new_elt;
     }
-    next_elt = ((apr_table_entry_t *) t->a.elts) + t->index_first[hash];
-    end_elt = ((apr_table_entry_t *) t->a.elts) + t->index_last[hash];
+    next_elt = ((apr_table_entry_t *) t->a.elts) + first;
+    end_elt = ((apr_table_entry_t *) t->a.elts) + last;
 
     for (; next_elt <= end_elt; next_elt++) {
 	if ((checksum == next_elt->key_checksum) &&
-            !strcasecmp(next_elt->key, key)) {
+            !apr_cstr_casecmp(next_elt->key, key)) {
 
             /* Found an existing entry with the same key, so merge with it */
 	    next_elt->val = apr_pstrcat(t->a.pool, next_elt->val, ", ",
@@ -725,11 +916,11 @@ APR_DECLARE(void) apr_table_merge(apr_table_t *t, const char *key,
     }
 
 add_new_elt:
-    t->index_last[hash] = t->a.nelts;
     next_elt = (apr_table_entry_t *) table_push(t);
     next_elt->key = apr_pstrdup(t->a.pool, key);
     next_elt->val = apr_pstrdup(t->a.pool, val);
     next_elt->key_checksum = checksum;
+    table_index_added(t, hash, slot);
 }
 
 APR_DECLARE(void) apr_table_mergen(apr_table_t *t, const char *key,
@@ -737,8 +928,9 @@ APR_DECLARE(void) apr_table_mergen(apr_table_t *t, const char *key,
 {
     apr_table_entry_t *next_elt;
     apr_table_entry_t *end_elt;
+    table_hindex_t *slot;
     apr_uint32_t checksum;
-    int hash;
+    int hash, first, last;
 
 #if APR_POOL_DEBUG
     {
@@ -760,17 +952,15 @@ APR_DECLARE(void) apr_table_mergen(apr_table_t *t, const char *key,
 
     COMPUTE_KEY_CHECKSUM(key, checksum);
     hash = TABLE_HASH(key);
-    if (!TABLE_INDEX_IS_INITIALIZED(t, hash)) {
-        t->index_first[hash] = t->a.nelts;
-        TABLE_SET_INDEX_INITIALIZED(t, hash);
+    if (!table_lookup(t, key, hash, checksum, &slot, &first, &last)) {
         goto add_new_elt;
     }
-    next_elt = ((apr_table_entry_t *) t->a.elts) + t->index_first[hash];;
-    end_elt = ((apr_table_entry_t *) t->a.elts) + t->index_last[hash];
+    next_elt = ((apr_table_entry_t *) t->a.elts) + first;
+    end_elt = ((apr_table_entry_t *) t->a.elts) + last;
 
     for (; next_elt <= end_elt; next_elt++) {
 	if ((checksum == next_elt->key_checksum) &&
-            !strcasecmp(next_elt->key, key)) {
+            !apr_cstr_casecmp(next_elt->key, key)) {
 
             /* Found an existing entry with the same key, so merge with it */
 	    next_elt->val = apr_pstrcat(t->a.pool, next_elt->val, ", ",
@@ -780,11 +970,11 @@ APR_DECLARE(void) apr_table_mergen(apr_table_t *t, const char *key,
     }
 
 add_new_elt:
-    t->index_last[hash] = t->a.nelts;
     next_elt = (apr_table_entry_t *) table_push(t);
     next_elt->key = (char *)key;
     next_elt->val = (char *)val;
     next_elt->key_checksum = checksum;
+    table_index_added(t, hash, slot);
 }
 
 APR_DECLARE(void) apr_table_add(apr_table_t *t, const char *key,
@@ -795,16 +985,12 @@ APR_DECLARE(void) apr_table_add(apr_table_t *t, const char *key,
     int hash;
 
     hash = TABLE_HASH(key);
-    t->index_last[hash] = t->a.nelts;
-    if (!TABLE_INDEX_IS_INITIALIZED(t, hash)) {
-        t->index_first[hash] = t->a.nelts;
-        TABLE_SET_INDEX_INITIALIZED(t, hash);
-    }
     COMPUTE_KEY_CHECKSUM(key, checksum);
     elts = (apr_table_entry_t *) table_push(t);
     elts->key = apr_pstrdup(t->a.pool, key);
     elts->val = apr_pstrdup(t->a.pool, val);
     elts->key_checksum = checksum;
+    table_index_added(t, hash, NULL);
 }
 
 APR_DECLARE(void) apr_table_addn(apr_table_t *t, const char *key,
@@ -828,16 +1014,12 @@ APR_DECLARE(void) apr_table_addn(apr_table_t *t, const char *key,
 #endif
 
     hash = TABLE_HASH(key);
-    t->index_last[hash] = t->a.nelts;
-    if (!TABLE_INDEX_IS_INITIALIZED(t, hash)) {
-        t->index_first[hash] = t->a.nelts;
-        TABLE_SET_INDEX_INITIALIZED(t, hash);
-    }
     COMPUTE_KEY_CHECKSUM(key, checksum);
     elts = (apr_table_entry_t *) table_push(t);
     elts->key = (char *)key;
     elts->val = (char *)val;
     elts->key_checksum = checksum;
+    table_index_added(t, hash, NULL);
 }
 
 APR_DECLARE(apr_table_t *) apr_table_overlay(apr_pool_t *p,
@@ -868,6 +1050,7 @@ APR_DECLARE(apr_table_t *) apr_table_overlay(apr_pool_t *p,
     res->a.pool = p;
     copy_array_hdr_core(&res->a, &overlay->a);
     apr_array_cat(&res->a, &base->a);
+    res->hindex = NULL;
     table_reindex(res);
     return res;
 }
@@ -970,14 +1153,15 @@ APR_DECLARE(int) apr_table_vdo(apr_table_do_callback_fn_t *comp,
         int rv = 1, i;
         if (argp) {
             /* Scan for entries that match the next key */
-            int hash = TABLE_HASH(argp);
-            if (TABLE_INDEX_IS_INITIALIZED(t, hash)) {
-                apr_uint32_t checksum;
-                COMPUTE_KEY_CHECKSUM(argp, checksum);
-                for (i = t->index_first[hash];
-                     rv && (i <= t->index_last[hash]); ++i) {
+            table_hindex_t *slot;
+            apr_uint32_t checksum;
+            int first, last;
+            COMPUTE_KEY_CHECKSUM(argp, checksum);
+            if (table_lookup(t, argp, TABLE_HASH(argp), checksum,
+                             &slot, &first, &last)) {
+                for (i = first; rv && (i <= last); ++i) {
                     if (elts[i].key && (checksum == elts[i].key_checksum) &&
-                                        !strcasecmp(elts[i].key, argp)) {
+                            !apr_cstr_casecmp(elts[i].key, argp)) {
                         rv = (*comp) (rec, elts[i].key, elts[i].val);
                     }
                 }
@@ -1013,7 +1197,7 @@ static apr_table_entry_t **table_mergesort(apr_pool_t *pool,
 
     /* First pass: sort pairs of elements (blocksize=1) */
     for (i = 0; i + 1 < n; i += 2) {
-        if (strcasecmp(values[i]->key, values[i + 1]->key) > 0) {
+        if (apr_cstr_casecmp(values[i]->key, values[i + 1]->key) > 0) {
             apr_table_entry_t *swap = values[i];
             values[i] = values[i + 1];
             values[i + 1] = swap;
@@ -1063,8 +1247,8 @@ static apr_table_entry_t **table_mergesort(apr_pool_t *pool,
                     }
                     break;
                 }
-                if (strcasecmp(values[block1_start]->key,
-                               values[block2_start]->key) > 0) {
+                if (apr_cstr_casecmp(values[block1_start]->key,
+                                     values[block2_start]->key) > 0) {
                     *dst++ = values[block2_start++];
                 }
                 else {
@@ -1138,12 +1322,12 @@ APR_DECLARE(void) apr_table_compress(apr_table_t *t, unsigned flags)
     last = sort_next++;
     while (sort_next < sort_end) {
         if (((*sort_next)->key_checksum == (*last)->key_checksum) &&
-            !strcasecmp((*sort_next)->key, (*last)->key)) {
+            !apr_cstr_casecmp((*sort_next)->key, (*last)->key)) {
             apr_table_entry_t **dup_last = sort_next + 1;
             dups_found = 1;
             while ((dup_last < sort_end) &&
                    ((*dup_last)->key_checksum == (*last)->key_checksum) &&
-                   !strcasecmp((*dup_last)->key, (*last)->key)) {
+                   !apr_cstr_casecmp((*dup_last)->key, (*last)->key)) {
                 dup_last++;
             }
             dup_last--; /* Elements from last through dup_last, inclusive,
@@ -1215,19 +1399,23 @@ static void apr_table_cat(apr_table_t *t, const apr_table_t *s)
         memcpy(t->index_first,s->index_first,sizeof(int) * TABLE_HASH_SIZE);
         memcpy(t->index_last, s->index_last, sizeof(int) * TABLE_HASH_SIZE);
         t->index_initialized = s->index_initialized;
-        return;
     }
-
-    for (idx = 0; idx < TABLE_HASH_SIZE; ++idx) {
-        if (TABLE_INDEX_IS_INITIALIZED(s, idx)) {
-            t->index_last[idx] = s->index_last[idx] + n;
-            if (!TABLE_INDEX_IS_INITIALIZED(t, idx)) {
-                t->index_first[idx] = s->index_first[idx] + n;
+    else {
+        for (idx = 0; idx < TABLE_HASH_SIZE; ++idx) {
+            if (TABLE_INDEX_IS_INITIALIZED(s, idx)) {
+                t->index_last[idx] = s->index_last[idx] + n;
+                if (!TABLE_INDEX_IS_INITIALIZED(t, idx)) {
+                    t->index_first[idx] = s->index_first[idx] + n;
+                }
             }
         }
+
+        t->index_initialized |= s->index_initialized;
     }
 
-    t->index_initialized |= s->index_initialized;
+    if (t->hindex || t->a.nelts > TABLE_HINDEX_MIN) {
+        table_hindex_build(t);
+    }
 }
 
 APR_DECLARE(void) apr_table_overlap(apr_table_t *a, const apr_table_t *b,
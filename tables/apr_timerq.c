@@ -0,0 +1,483 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Hierarchical timing wheel.
+ *
+ * Timers are placed in TIMERQ_WHEELS wheels of TIMERQ_SLOTS slots, the
+ * slots of wheel w being TIMERQ_SLOTS^w ticks wide. A timer goes to the
+ * wheel of the highest group of TIMERQ_BITS bits by which its tick
+ * differs from the current tick, and to the slot of its tick's bits in
+ * that group, so each slot holds a ring of timers that will expire or
+ * move to a lower wheel at once. When the current tick advances, the
+ * slots it went through are emptied and their timers placed again,
+ * either in a lower wheel or in the heap of the expired timers.
+ *
+ * The bitmaps of the non-empty slots allow to skip any number of ticks
+ * in a few operations, and to find the next slot to expire.
+ *
+ * The timers which do not fit in the wheels' span are kept in a min-heap
+ * until they do (or all the timers when the resolution is zero).
+ */
+
+#include "apr_timerq.h"
+#include "apr_ring.h"
+
+#if APR_HAVE_STRING_H
+#include <string.h>
+#endif
+
+#define TIMERQ_BITS   6
+#define TIMERQ_SLOTS  (1 << TIMERQ_BITS)
+#define TIMERQ_MASK   (TIMERQ_SLOTS - 1)
+#define TIMERQ_WHEELS 6
+#define TIMERQ_SPAN_BITS (TIMERQ_BITS * TIMERQ_WHEELS)
+
+#define TIMERQ_HEAP_INITIAL_SIZE 64
+
+/* Where a timer is */
+#define TIMERQ_FREE    0
+#define TIMERQ_WHEEL   1
+#define TIMERQ_HEAP    2
+#define TIMERQ_EXPIRED 3
+
+struct apr_timerq_timer_t {
+    APR_RING_ENTRY(apr_timerq_timer_t) link;
+    apr_time_t when;
+    apr_uint64_t tick;
+    void *data;
+    apr_size_t pos;     /* index in the heap, or wheel slot */
+    int where;
+};
+
+APR_RING_HEAD(timerq_ring, apr_timerq_timer_t);
+
+typedef struct {
+    apr_timerq_timer_t **elts;
+    apr_size_t nelts, nalloc;
+} timerq_heap_t;
+
+struct apr_timerq_t {
+    apr_pool_t *pool;
+    apr_interval_time_t resolution;
+    apr_uint64_t now;
+    apr_size_t count;
+    apr_uint64_t pending[TIMERQ_WHEELS];
+    struct timerq_ring wheel[TIMERQ_WHEELS][TIMERQ_SLOTS];
+    timerq_heap_t heap;
+    timerq_heap_t expired;
+    struct timerq_ring recycled;
+};
+
+static APR_INLINE unsigned int timerq_ctz(apr_uint64_t x)
+{
+#if defined(__GNUC__)
+    return __builtin_ctzll(x);
+#else
+    unsigned int n = 0;
+    while (!(x & 1)) {
+        x >>= 1;
+        n++;
+    }
+    return n;
+#endif
+}
+
+/* Tick of an expiry time, rounded up so that timers never expire early */
+static apr_uint64_t timerq_tick(const apr_timerq_t *tq, apr_time_t when)
+{
+    if (when <= 0) {
+        return 0;
+    }
+    if (!tq->resolution) {
+        return when;
+    }
+    return ((apr_uint64_t)when + tq->resolution - 1) / tq->resolution;
+}
+
+/* Tick of the current time, rounded down */
+static apr_uint64_t timerq_now(const apr_timerq_t *tq, apr_time_t now)
+{
+    if (now <= 0) {
+        return 0;
+    }
+    if (!tq->resolution) {
+        return now;
+    }
+    return (apr_uint64_t)now / tq->resolution;
+}
+
+/*
+ * Binary min-heap by expiry time.
+ */
+
+static APR_INLINE void heap_put(timerq_heap_t *h, apr_size_t i,
+                                apr_timerq_timer_t *t)
+{
+    h->elts[i] = t;
+    t->pos = i;
+}
+
+static void heap_sift_up(timerq_heap_t *h, apr_size_t i,
+                         apr_timerq_timer_t *t)
+{
+    while (i > 0) {
+        apr_size_t parent = (i - 1) / 2;
+        if (h->elts[parent]->when <= t->when) {
+            break;
+        }
+        heap_put(h, i, h->elts[parent]);
+        i = parent;
+    }
+    heap_put(h, i, t);
+}
+
+static void heap_sift_down(timerq_heap_t *h, apr_size_t i,
+                           apr_timerq_timer_t *t)
+{
+    for (;;) {
+        apr_size_t child = 2 * i + 1;
+        if (child >= h->nelts) {
+            break;
+        }
+        if (child + 1 < h->nelts
+                && h->elts[child + 1]->when < h->elts[child]->when) {
+            child++;
+        }
+        if (t->when <= h->elts[child]->when) {
+            break;
+        }
+        heap_put(h, i, h->elts[child]);
+        i = child;
+    }
+    heap_put(h, i, t);
+}
+
+static apr_status_t heap_push(apr_timerq_t *tq, timerq_heap_t *h,
+                              apr_timerq_timer_t *t)
+{
+    if (h->nelts == h->nalloc) {
+        apr_size_t nalloc = h->nalloc ? h->nalloc * 2
+                                      : TIMERQ_HEAP_INITIAL_SIZE;
+        apr_timerq_timer_t **elts = apr_palloc(tq->pool,
+                                               nalloc * sizeof(*elts));
+        if (!elts) {
+            return APR_ENOMEM;
+        }
+        if (h->nelts) {
+            memcpy(elts, h->elts, h->nelts * sizeof(*elts));
+        }
+        h->elts = elts;
+        h->nalloc = nalloc;
+    }
+    heap_sift_up(h, h->nelts++, t);
+    return APR_SUCCESS;
+}
+
+static void heap_remove(timerq_heap_t *h, apr_size_t i)
+{
+    apr_timerq_timer_t *last = h->elts[--h->nelts];
+
+    if (i < h->nelts) {
+        if (i > 0 && last->when < h->elts[(i - 1) / 2]->when) {
+            heap_sift_up(h, i, last);
+        }
+        else {
+            heap_sift_down(h, i, last);
+        }
+    }
+}
+
+/*
+ * Timing wheel.
+ */
+
+static apr_status_t timerq_insert(apr_timerq_t *tq, apr_timerq_timer_t *t)
+{
+    apr_uint64_t diff;
+    unsigned int w, slot;
+
+    if (t->tick <= tq->now) {
+        t->where = TIMERQ_EXPIRED;
+        return heap_push(tq, &tq->expired, t);
+    }
+
+    diff = t->tick ^ tq->now;
+    if (!tq->resolution || (diff >> TIMERQ_SPAN_BITS)) {
+        t->where = TIMERQ_HEAP;
+        return heap_push(tq, &tq->heap, t);
+    }
+
+    for (w = 0; diff >> ((w + 1) * TIMERQ_BITS); w++)
+        ;
+    slot = (unsigned int)(t->tick >> (w * TIMERQ_BITS)) & TIMERQ_MASK;
+    APR_RING_INSERT_TAIL(&tq->wheel[w][slot], t, apr_timerq_timer_t, link);
+    tq->pending[w] |= APR_UINT64_C(1) << slot;
+    t->pos = w * TIMERQ_SLOTS + slot;
+    t->where = TIMERQ_WHEEL;
+    return APR_SUCCESS;
+}
+
+static void timerq_detach(apr_timerq_t *tq, apr_timerq_timer_t *t)
+{
+    switch (t->where) {
+    case TIMERQ_WHEEL: {
+        apr_size_t w = t->pos / TIMERQ_SLOTS, slot = t->pos % TIMERQ_SLOTS;
+        APR_RING_REMOVE(t, link);
+        if (APR_RING_EMPTY(&tq->wheel[w][slot], apr_timerq_timer_t, link)) {
+            tq->pending[w] &= ~(APR_UINT64_C(1) << slot);
+        }
+        break;
+    }
+    case TIMERQ_HEAP:
+        heap_remove(&tq->heap, t->pos);
+        break;
+    case TIMERQ_EXPIRED:
+        heap_remove(&tq->expired, t->pos);
+        break;
+    }
+    t->where = TIMERQ_FREE;
+}
+
+static apr_status_t timerq_advance(apr_timerq_t *tq, apr_uint64_t now)
+{
+    struct timerq_ring todo;
+    apr_timerq_timer_t *t;
+    apr_status_t rv = APR_SUCCESS;
+    unsigned int w;
+
+    if (now <= tq->now) {
+        return APR_SUCCESS;
+    }
+
+    /* Collect the slots between the current tick (excluded) and now
+     * (included) in each wheel, all of them if the wheel turned over.
+     */
+    APR_RING_INIT(&todo, apr_timerq_timer_t, link);
+    for (w = 0; w < TIMERQ_WHEELS; w++) {
+        apr_uint64_t from = tq->now >> (w * TIMERQ_BITS);
+        apr_uint64_t elapsed = (now >> (w * TIMERQ_BITS)) - from;
+        apr_uint64_t mask, pending;
+
+        if (!elapsed) {
+            break;
+        }
+        if (elapsed >= TIMERQ_SLOTS) {
+            mask = ~APR_UINT64_C(0);
+        }
+        else {
+            unsigned int first = (unsigned int)(from + 1) & TIMERQ_MASK;
+            mask = (APR_UINT64_C(1) << elapsed) - 1;
+            if (first) {
+                mask = (mask << first) | (mask >> (TIMERQ_SLOTS - first));
+            }
+        }
+
+        pending = tq->pending[w] & mask;
+        tq->pending[w] &= ~mask;
+        while (pending) {
+            unsigned int slot = timerq_ctz(pending);
+            APR_RING_CONCAT(&todo, &tq->wheel[w][slot],
+                            apr_timerq_timer_t, link);
+            pending &= pending - 1;
+        }
+    }
+    tq->now = now;
+
+    while (!APR_RING_EMPTY(&todo, apr_timerq_timer_t, link)) {
+        t = APR_RING_FIRST(&todo);
+        APR_RING_REMOVE(t, link);
+        if ((rv = timerq_insert(tq, t)) != APR_SUCCESS) {
+            break;
+        }
+    }
+
+    /* Bring the timers of the heap in range */
+    while (rv == APR_SUCCESS && tq->heap.nelts) {
+        t = tq->heap.elts[0];
+        if (t->tick > now && (!tq->resolution
+                              || ((t->tick ^ now) >> TIMERQ_SPAN_BITS))) {
+            break;
+        }
+        heap_remove(&tq->heap, 0);
+        rv = timerq_insert(tq, t);
+    }
+
+    return rv;
+}
+
+APR_DECLARE(apr_status_t) apr_timerq_create(apr_timerq_t **tq,
+                                            apr_interval_time_t resolution,
+                                            apr_pool_t *p)
+{
+    apr_timerq_t *q;
+    unsigned int w, slot;
+
+    if (resolution < 0) {
+        return APR_EINVAL;
+    }
+
+    q = apr_pcalloc(p, sizeof(*q));
+    q->pool = p;
+    q->resolution = resolution;
+    q->now = timerq_now(q, apr_time_now());
+    for (w = 0; w < TIMERQ_WHEELS; w++) {
+        for (slot = 0; slot < TIMERQ_SLOTS; slot++) {
+            APR_RING_INIT(&q->wheel[w][slot], apr_timerq_timer_t, link);
+        }
+    }
+    APR_RING_INIT(&q->recycled, apr_timerq_timer_t, link);
+
+    *tq = q;
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_timerq_add(apr_timerq_t *tq, apr_time_t when,
+                                         void *data,
+                                         apr_timerq_timer_t **timer)
+{
+    apr_timerq_timer_t *t;
+    apr_status_t rv;
+
+    if (APR_RING_EMPTY(&tq->recycled, apr_timerq_timer_t, link)) {
+        t = apr_palloc(tq->pool, sizeof(*t));
+        if (!t) {
+            return APR_ENOMEM;
+        }
+    }
+    else {
+        t = APR_RING_FIRST(&tq->recycled);
+        APR_RING_REMOVE(t, link);
+    }
+    t->when = when;
+    t->tick = timerq_tick(tq, when);
+    t->data = data;
+
+    rv = timerq_insert(tq, t);
+    if (rv != APR_SUCCESS) {
+        t->where = TIMERQ_FREE;
+        APR_RING_INSERT_TAIL(&tq->recycled, t, apr_timerq_timer_t, link);
+        return rv;
+    }
+    tq->count++;
+
+    if (timer) {
+        *timer = t;
+    }
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_timerq_set(apr_timerq_t *tq,
+                                         apr_timerq_timer_t *timer,
+                                         apr_time_t when)
+{
+    apr_status_t rv;
+
+    if (timer->where == TIMERQ_FREE) {
+        return APR_EINVAL;
+    }
+    timerq_detach(tq, timer);
+    timer->when = when;
+    timer->tick = timerq_tick(tq, when);
+
+    rv = timerq_insert(tq, timer);
+    if (rv != APR_SUCCESS) {
+        timer->where = TIMERQ_FREE;
+        APR_RING_INSERT_TAIL(&tq->recycled, timer, apr_timerq_timer_t, link);
+        tq->count--;
+    }
+    return rv;
+}
+
+APR_DECLARE(apr_status_t) apr_timerq_cancel(apr_timerq_t *tq,
+                                            apr_timerq_timer_t *timer)
+{
+    if (timer->where == TIMERQ_FREE) {
+        return APR_EINVAL;
+    }
+    timerq_detach(tq, timer);
+    APR_RING_INSERT_TAIL(&tq->recycled, timer, apr_timerq_timer_t, link);
+    tq->count--;
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_timerq_pop(apr_timerq_t *tq, apr_time_t now,
+                                         void **data)
+{
+    apr_timerq_timer_t *t;
+    apr_status_t rv;
+
+    rv = timerq_advance(tq, timerq_now(tq, now));
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+    if (!tq->expired.nelts) {
+        return APR_NOTFOUND;
+    }
+
+    t = tq->expired.elts[0];
+    heap_remove(&tq->expired, 0);
+    t->where = TIMERQ_FREE;
+    APR_RING_INSERT_TAIL(&tq->recycled, t, apr_timerq_timer_t, link);
+    tq->count--;
+
+    *data = t->data;
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_interval_time_t) apr_timerq_timeout(apr_timerq_t *tq,
+                                                    apr_time_t now)
+{
+    apr_uint64_t next = 0;
+    apr_time_t when;
+    unsigned int w;
+    int found = 0;
+
+    if (!tq->count) {
+        return -1;
+    }
+    if (tq->expired.nelts) {
+        return 0;
+    }
+
+    /* The timers of a wheel all expire before the ones of the next
+     * wheels, and after the current tick in their own wheel, so the
+     * lowest pending slot of the first non-empty wheel comes first.
+     * That's the start of the slot, timers may expire later in it.
+     */
+    for (w = 0; w < TIMERQ_WHEELS; w++) {
+        if (tq->pending[w]) {
+            unsigned int shift = (w + 1) * TIMERQ_BITS;
+            next = ((tq->now >> shift) << shift)
+                   | ((apr_uint64_t)timerq_ctz(tq->pending[w])
+                      << (w * TIMERQ_BITS));
+            found = 1;
+            break;
+        }
+    }
+    if (tq->heap.nelts && (!found || tq->heap.elts[0]->tick < next)) {
+        next = tq->heap.elts[0]->tick;
+    }
+
+    when = tq->resolution ? (apr_time_t)(next * tq->resolution)
+                          : (apr_time_t)next;
+    return when > now ? when - now : 0;
+}
+
+APR_DECLARE(apr_size_t) apr_timerq_count(const apr_timerq_t *tq)
+{
+    return tq->count;
+}
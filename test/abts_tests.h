@@ -93,7 +93,9 @@ const struct testlist {
     {testskiplist},
     {testsiphash},
     {testjson},
-    {testjose}
+    {testjose},
+    {testtimerq},
+    {testsha1}
 };
 
 #endif /* APR_TEST_INCLUDES */
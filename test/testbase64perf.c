@@ -0,0 +1,167 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr_encode.h"
+#include "apr_pools.h"
+#include "apr_strings.h"
+#include "apr_errno.h"
+#include "apr_general.h"
+#include "apr_getopt.h"
+#include "apr_time.h"
+#include <stdio.h>
+#include <stdlib.h>
+#if APR_HAVE_STRING_H
+#include <string.h>
+#endif
+
+#define DEFAULT_NUM_BYTES (64 * 1024)
+
+static apr_size_t num_bytes = DEFAULT_NUM_BYTES;
+static long num_loops;
+
+static apr_pool_t *pool;
+
+static const char base64[] =
+"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/* A table lookup per sextet, for reference */
+static apr_size_t table_encode(char *dest, const unsigned char *src,
+                               apr_size_t slen)
+{
+    char *bufout = dest;
+    apr_size_t i;
+
+    for (i = 0; i + 2 < slen; i += 3) {
+        *bufout++ = base64[src[i] >> 2];
+        *bufout++ = base64[(src[i] & 0x3) << 4 | src[i + 1] >> 4];
+        *bufout++ = base64[(src[i + 1] & 0xF) << 2 | src[i + 2] >> 6];
+        *bufout++ = base64[src[i + 2] & 0x3F];
+    }
+    if (i < slen) {
+        *bufout++ = base64[src[i] >> 2];
+        if (i + 1 < slen) {
+            *bufout++ = base64[(src[i] & 0x3) << 4 | src[i + 1] >> 4];
+            *bufout++ = base64[(src[i + 1] & 0xF) << 2];
+        }
+        else {
+            *bufout++ = base64[(src[i] & 0x3) << 4];
+            *bufout++ = '=';
+        }
+        *bufout++ = '=';
+    }
+    *bufout = '\0';
+    return bufout - dest;
+}
+
+static void report(const char *name, apr_time_t elapsed, apr_size_t bytes)
+{
+    printf("    %-28s %8" APR_INT64_T_FMT " usec, %8.2f MB/s\n", name,
+           elapsed, (double)bytes * num_loops / (elapsed + 1));
+}
+
+static void test_size(apr_size_t size)
+{
+    unsigned char *src = apr_palloc(pool, size);
+    unsigned char *decoded = apr_palloc(pool, size + 1);
+    char *encoded = apr_palloc(pool, (size + 2) / 3 * 4 + 1);
+    char *check = apr_palloc(pool, (size + 2) / 3 * 4 + 1);
+    apr_size_t i, len = 0, dlen = 0;
+    apr_time_t start, elapsed;
+    long n;
+
+    srand(1);
+    for (i = 0; i < size; i++) {
+        src[i] = (unsigned char)rand();
+    }
+
+    printf("  %" APR_SIZE_T_FMT " bytes, %ld times\n", size, num_loops);
+
+    start = apr_time_now();
+    for (n = 0; n < num_loops; n++) {
+        table_encode(check, src, size);
+    }
+    elapsed = apr_time_now() - start;
+    report("table encode", elapsed, size);
+
+    start = apr_time_now();
+    for (n = 0; n < num_loops; n++) {
+        apr_encode_base64_binary(encoded, src, size, APR_ENCODE_NONE, &len);
+    }
+    elapsed = apr_time_now() - start;
+    report("apr_encode_base64_binary", elapsed, size);
+
+    start = apr_time_now();
+    for (n = 0; n < num_loops; n++) {
+        apr_decode_base64_binary(decoded, encoded, len, APR_ENCODE_NONE,
+                                 &dlen);
+    }
+    elapsed = apr_time_now() - start;
+    report("apr_decode_base64_binary", elapsed, size);
+
+    if (strcmp(check, encoded) || dlen != size
+            || memcmp(src, decoded, size)) {
+        printf("    MISMATCH!\n");
+    }
+}
+
+int main(int argc, const char * const *argv)
+{
+    apr_status_t rv;
+    char errmsg[200];
+    apr_getopt_t *opt;
+    char optchar;
+    const char *optarg;
+
+    printf("APR Base64 Performance Test\n==============\n\n");
+
+    apr_initialize();
+    atexit(apr_terminate);
+
+    if (apr_pool_create(&pool, NULL) != APR_SUCCESS)
+        exit(-1);
+
+    if ((rv = apr_getopt_init(&opt, pool, argc, argv)) != APR_SUCCESS) {
+        fprintf(stderr, "Could not set up to parse options: [%d] %s\n",
+                rv, apr_strerror(rv, errmsg, sizeof errmsg));
+        exit(-1);
+    }
+
+    while ((rv = apr_getopt(opt, "s:", &optchar, &optarg)) == APR_SUCCESS) {
+        if (optchar == 's') {
+            num_bytes = (apr_size_t)atol(optarg);
+        }
+    }
+
+    if (rv != APR_SUCCESS && rv != APR_EOF) {
+        fprintf(stderr, "Could not parse options: [%d] %s\n",
+                rv, apr_strerror(rv, errmsg, sizeof errmsg));
+        exit(-1);
+    }
+    if (num_bytes == 0) {
+        fprintf(stderr, "Invalid number of bytes\n");
+        exit(-1);
+    }
+
+    /* about 256MB of input for each size */
+    num_loops = (long)((256 * 1024 * 1024) / num_bytes);
+    test_size(num_bytes);
+    if (num_bytes > 64) {
+        num_loops = (256 * 1024 * 1024) / 64;
+        test_size(64);
+    }
+
+    return 0;
+}
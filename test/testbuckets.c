@@ -325,6 +325,196 @@ static void test_splitboundary(abts_case *tc, void *data)
     apr_bucket_alloc_destroy(ba);
 }
 
+/* Brigade of the string s cut in chunks of n bytes, and metadata */
+static apr_bucket_brigade *make_chunked_brigade(apr_bucket_alloc_t *ba,
+                                                const char *s, apr_size_t n)
+{
+    apr_bucket_brigade *bb = apr_brigade_create(p, ba);
+    apr_size_t len = strlen(s), off;
+
+    for (off = 0; off < len; off += n) {
+        apr_size_t chunk = len - off < n ? len - off : n;
+        APR_BRIGADE_INSERT_TAIL(bb, apr_bucket_transient_create(s + off,
+                                                                chunk, ba));
+        if (off % 3 == 0) {
+            APR_BRIGADE_INSERT_TAIL(bb, apr_bucket_flush_create(ba));
+        }
+    }
+    return bb;
+}
+
+static void test_match(abts_case *tc, void *data)
+{
+    static const struct {
+        const char *pattern;
+        int case_sensitive;
+    } patterns[] = {
+        { "jumped", 1 }, { "q", 1 }, { "dog", 1 }, { "the lazy dog", 1 },
+        { "BROWN", 0 }, { "ooo", 1 }, { "jumping", 1 }, { "DOGS", 0 },
+        { "aab", 1 }, { "aaab", 1 }
+    };
+    const char *text = "quick brown fox jumped over the lazy dog, aaaaab";
+    apr_size_t len = strlen(text), n;
+    apr_bucket_alloc_t *ba = apr_bucket_alloc_create(p);
+    int i;
+
+    for (i = 0; i < sizeof(patterns) / sizeof(patterns[0]); i++) {
+        const apr_strmatch_pattern *pattern;
+        const char *pos;
+        apr_off_t expected = -1;
+
+        pattern = apr_strmatch_precompile(p, patterns[i].pattern,
+                                          patterns[i].case_sensitive);
+        pos = apr_strmatch(pattern, text, len);
+        if (pos) {
+            expected = pos - text;
+        }
+
+        for (n = 1; n <= len; n++) {
+            apr_brigade_matcher_t *matcher;
+            apr_bucket_brigade *bb;
+            apr_off_t offset = -1, consumed, total = 0;
+            apr_size_t off;
+            apr_status_t rv = APR_INCOMPLETE;
+
+            /* all at once */
+            APR_ASSERT_SUCCESS(tc, "create matcher",
+                               apr_brigade_matcher_create(&matcher, pattern,
+                                                          p));
+            bb = make_chunked_brigade(ba, text, n);
+            rv = apr_brigade_match(matcher, bb, APR_BLOCK_READ, &offset,
+                                   &consumed);
+            if (expected < 0) {
+                ABTS_INT_EQUAL(tc, APR_INCOMPLETE, rv);
+                ABTS_INT_EQUAL(tc, (int)len, (int)consumed);
+            }
+            else {
+                ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+                ABTS_INT_EQUAL(tc, (int)expected, (int)offset);
+                ABTS_INT_EQUAL(tc, (int)(expected + pattern->length),
+                               (int)consumed);
+            }
+            apr_brigade_destroy(bb);
+
+            /* one brigade per chunk */
+            APR_ASSERT_SUCCESS(tc, "create matcher",
+                               apr_brigade_matcher_create(&matcher, pattern,
+                                                          p));
+            rv = APR_INCOMPLETE;
+            offset = -1;
+            for (off = 0; off < len && rv == APR_INCOMPLETE; off += n) {
+                bb = apr_brigade_create(p, ba);
+                APR_BRIGADE_INSERT_TAIL(bb,
+                        apr_bucket_transient_create(text + off,
+                                                    len - off < n ? len - off
+                                                                  : n, ba));
+                rv = apr_brigade_match(matcher, bb, APR_BLOCK_READ, &offset,
+                                       &consumed);
+                total += consumed;
+                apr_brigade_destroy(bb);
+            }
+            if (expected < 0) {
+                ABTS_INT_EQUAL(tc, APR_INCOMPLETE, rv);
+                ABTS_INT_EQUAL(tc, (int)len, (int)total);
+            }
+            else {
+                ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+                ABTS_INT_EQUAL(tc, (int)expected, (int)offset);
+                ABTS_INT_EQUAL(tc, (int)(expected + pattern->length),
+                               (int)total);
+            }
+        }
+    }
+
+    apr_bucket_alloc_destroy(ba);
+}
+
+static void test_match_all(abts_case *tc, void *data)
+{
+    apr_bucket_alloc_t *ba = apr_bucket_alloc_create(p);
+    const apr_strmatch_pattern *pattern;
+    apr_brigade_matcher_t *matcher;
+    apr_bucket_brigade *bb;
+    apr_bucket *e;
+    apr_off_t offset, consumed;
+    static const int expected[] = { 2, 12, 17, 30 };
+    int i;
+
+    pattern = apr_strmatch_precompile(p, "", 1);
+    ABTS_INT_EQUAL(tc, APR_EINVAL,
+                   apr_brigade_matcher_create(&matcher, pattern, p));
+
+    pattern = apr_strmatch_precompile(p, "--sep", 1);
+    APR_ASSERT_SUCCESS(tc, "create matcher",
+                       apr_brigade_matcher_create(&matcher, pattern, p));
+
+    bb = make_chunked_brigade(ba, "a\n--sep\nbbb\n--sep--sep\ncccccc\n--sep--",
+                              4);
+    for (i = 0; i < sizeof(expected) / sizeof(expected[0]); i++) {
+        APR_ASSERT_SUCCESS(tc, "match",
+                           apr_brigade_match(matcher, bb, APR_BLOCK_READ,
+                                             &offset, &consumed));
+        ABTS_INT_EQUAL(tc, expected[i], (int)offset);
+
+        /* consume up to the end of the match */
+        APR_ASSERT_SUCCESS(tc, "partition",
+                           apr_brigade_partition(bb, consumed, &e));
+        while (APR_BRIGADE_FIRST(bb) != e) {
+            apr_bucket_delete(APR_BRIGADE_FIRST(bb));
+        }
+    }
+    ABTS_INT_EQUAL(tc, APR_INCOMPLETE,
+                   apr_brigade_match(matcher, bb, APR_BLOCK_READ, &offset,
+                                     &consumed));
+    ABTS_INT_EQUAL(tc, 2, (int)consumed);
+
+    apr_brigade_destroy(bb);
+    apr_bucket_alloc_destroy(ba);
+}
+
+static void test_encode(abts_case *tc, void *data)
+{
+    apr_bucket_alloc_t *ba = apr_bucket_alloc_create(p);
+    const char *text = "The quick brown fox jumped over the lazy dog";
+    apr_encode_ctx_t *enc, *dec;
+    apr_bucket_brigade *bb;
+    apr_size_t n, len;
+    char *flat;
+
+    APR_ASSERT_SUCCESS(tc, "encoder",
+                       apr_encode_base64_init(&enc, APR_ENCODE_NONE, p));
+    APR_ASSERT_SUCCESS(tc, "decoder",
+                       apr_decode_base64_init(&dec, APR_ENCODE_NONE, p));
+
+    for (n = 1; n < 12; n++) {
+        bb = make_chunked_brigade(ba, text, n);
+        APR_BRIGADE_INSERT_TAIL(bb, apr_bucket_eos_create(ba));
+
+        APR_ASSERT_SUCCESS(tc, "encode brigade",
+                           apr_brigade_encode(bb, enc, APR_BLOCK_READ));
+        ABTS_ASSERT(tc, "eos kept", APR_BUCKET_IS_EOS(APR_BRIGADE_LAST(bb)));
+        APR_ASSERT_SUCCESS(tc, "flatten",
+                           apr_brigade_pflatten(bb, &flat, &len, p));
+        ABTS_STR_EQUAL(tc, apr_pencode_base64(p, text, APR_ENCODE_STRING,
+                                              APR_ENCODE_NONE, NULL),
+                       apr_pstrndup(p, flat, len));
+
+        APR_ASSERT_SUCCESS(tc, "decode brigade",
+                           apr_brigade_encode(bb, dec, APR_BLOCK_READ));
+        APR_ASSERT_SUCCESS(tc, "flatten",
+                           apr_brigade_pflatten(bb, &flat, &len, p));
+        ABTS_STR_EQUAL(tc, text, apr_pstrndup(p, flat, len));
+
+        apr_brigade_destroy(bb);
+    }
+
+    bb = make_chunked_brigade(ba, "Zm9v*Zm9v", 2);
+    ABTS_INT_EQUAL(tc, APR_BADCH, apr_brigade_encode(bb, dec, APR_BLOCK_READ));
+    apr_brigade_destroy(bb);
+
+    apr_bucket_alloc_destroy(ba);
+}
+
 /* Test that bucket E has content EDATA of length ELEN. */
 static void test_bucket_content(abts_case *tc,
                                 apr_bucket *e,
@@ -555,6 +745,137 @@ static void test_truncfile(abts_case *tc, void *data)
     apr_bucket_alloc_destroy(ba);
 }
 
+static void test_adaptivefile(abts_case *tc, void *data)
+{
+    apr_bucket_alloc_t *ba = apr_bucket_alloc_create(p);
+    apr_bucket_brigade *bb = apr_brigade_create(p, ba);
+    char *contents = apr_palloc(p, 300000);
+    apr_size_t len, prev, off, i;
+    const char *str;
+    apr_bucket *e, *c;
+    apr_file_t *f;
+
+    for (i = 0; i < 300000; i++) {
+        contents[i] = 'a' + i % 26;
+    }
+    f = make_test_file(tc, "adaptivefile.bin", "");
+    APR_ASSERT_SUCCESS(tc, "write test file",
+                       apr_file_write_full(f, contents, 300000, NULL));
+
+    e = apr_brigade_insert_file(bb, f, 0, 300000, p);
+    apr_bucket_file_enable_mmap(e, 0);
+    APR_ASSERT_SUCCESS(tc, "set adaptive",
+                       apr_bucket_file_set_adaptive(e, 65536));
+
+    /* Sequential reads grow up to the maximum */
+    prev = 0;
+    for (off = 0; off < 100000; off += len) {
+        e = APR_BRIGADE_FIRST(bb);
+        APR_ASSERT_SUCCESS(tc, "read file",
+                           apr_bucket_read(e, &str, &len, APR_BLOCK_READ));
+        ABTS_ASSERT(tc, "read size shrinks", len >= prev);
+        ABTS_ASSERT(tc, "read size over maximum", len <= 65536);
+        ABTS_ASSERT(tc, "data read differ",
+                    memcmp(str, contents + off, len) == 0);
+        if (off == 0) {
+            ABTS_SIZE_EQUAL(tc, APR_BUCKET_BUFF_SIZE, len);
+        }
+        prev = len;
+        apr_bucket_delete(e);
+    }
+    ABTS_ASSERT(tc, "read size did not grow", prev > APR_BUCKET_BUFF_SIZE);
+
+    /* A read elsewhere in the file starts over */
+    e = APR_BRIGADE_FIRST(bb);
+    APR_ASSERT_SUCCESS(tc, "copy", apr_bucket_copy(e, &c));
+    APR_BUCKET_INSERT_AFTER(e, c);
+    APR_ASSERT_SUCCESS(tc, "split", apr_bucket_split(c, 50000));
+    APR_ASSERT_SUCCESS(tc, "read file",
+                       apr_bucket_read(APR_BUCKET_NEXT(c), &str, &len,
+                                       APR_BLOCK_READ));
+    ABTS_SIZE_EQUAL(tc, APR_BUCKET_BUFF_SIZE, len);
+    ABTS_ASSERT(tc, "data read differ",
+                memcmp(str, contents + off + 50000, len) == 0);
+
+    apr_file_close(f);
+    apr_file_remove("adaptivefile.bin", p);
+    apr_brigade_destroy(bb);
+    apr_bucket_alloc_destroy(ba);
+}
+
+static void test_alloc_freelists(abts_case *tc, void *data)
+{
+    apr_bucket_alloc_t *ba = apr_bucket_alloc_create(p);
+    apr_bucket_alloc_stats_t stats;
+    void *bufs[40], *buf;
+    apr_size_t cached;
+    int i, slot;
+
+    /* A freed buffer is reused by the next allocation of its size */
+    buf = apr_bucket_alloc(APR_BUCKET_BUFF_SIZE, ba);
+    apr_bucket_free(buf);
+    ABTS_PTR_EQUAL(tc, buf, apr_bucket_alloc(APR_BUCKET_BUFF_SIZE, ba));
+    apr_bucket_free(buf);
+
+    apr_bucket_alloc_stats_get(ba, &stats);
+    ABTS_SIZE_EQUAL(tc, 128 * 1024, stats.max_free);
+    for (slot = 1; slot < APR_BUCKET_ALLOC_STATS_SLOTS - 1; slot++) {
+        if (stats.misses[slot]) {
+            break;
+        }
+    }
+    ABTS_ASSERT(tc, "no free list used",
+                slot < APR_BUCKET_ALLOC_STATS_SLOTS - 1);
+    ABTS_ASSERT(tc, "free list too small",
+                stats.node_size[slot] >= APR_BUCKET_BUFF_SIZE);
+    ABTS_INT_EQUAL(tc, 1, (int)stats.misses[slot]);
+    ABTS_INT_EQUAL(tc, 1, (int)stats.hits[slot]);
+    ABTS_SIZE_EQUAL(tc, 1, stats.free_nodes[slot]);
+
+    /* The free lists are capped */
+    for (i = 0; i < 40; i++) {
+        bufs[i] = apr_bucket_alloc(APR_BUCKET_BUFF_SIZE, ba);
+    }
+    for (i = 0; i < 40; i++) {
+        apr_bucket_free(bufs[i]);
+    }
+    apr_bucket_alloc_stats_get(ba, &stats);
+    cached = 128 * 1024 / stats.node_size[slot];
+    ABTS_SIZE_EQUAL(tc, cached, stats.free_nodes[slot]);
+    ABTS_INT_EQUAL(tc, 40 - (int)cached, (int)stats.overflows[slot]);
+
+    /* The threshold is for all the lists */
+    buf = apr_bucket_alloc(2 * APR_BUCKET_BUFF_SIZE, ba);
+    apr_bucket_free(buf);
+    apr_bucket_alloc_stats_get(ba, &stats);
+    for (i = 1; i < APR_BUCKET_ALLOC_STATS_SLOTS - 1; i++) {
+        if (i != slot && stats.free_nodes[i]) {
+            ABTS_FAIL(tc, "block kept beyond the threshold");
+        }
+    }
+
+    /* Lowering the threshold trims the lists */
+    apr_bucket_alloc_max_free_set(ba, 0);
+    apr_bucket_alloc_stats_get(ba, &stats);
+    ABTS_SIZE_EQUAL(tc, 0, stats.free_nodes[slot]);
+    buf = apr_bucket_alloc(APR_BUCKET_BUFF_SIZE, ba);
+    apr_bucket_free(buf);
+    apr_bucket_alloc_stats_get(ba, &stats);
+    ABTS_SIZE_EQUAL(tc, 0, stats.free_nodes[slot]);
+
+    /* Bigger blocks are never kept */
+    apr_bucket_alloc_max_free_set(ba, 1024 * 1024);
+    buf = apr_bucket_alloc(256 * 1024, ba);
+    apr_bucket_free(buf);
+    apr_bucket_alloc_stats_get(ba, &stats);
+    ABTS_INT_EQUAL(tc, 1,
+                   (int)stats.misses[APR_BUCKET_ALLOC_STATS_SLOTS - 1]);
+    ABTS_SIZE_EQUAL(tc, 0,
+                    stats.free_nodes[APR_BUCKET_ALLOC_STATS_SLOTS - 1]);
+
+    apr_bucket_alloc_destroy(ba);
+}
+
 static const char hello[] = "hello, world";
 
 static void test_partition(abts_case *tc, void *data)
@@ -657,6 +978,371 @@ static void test_iovec(abts_case *tc, void *data)
     apr_bucket_alloc_destroy(ba);
 }
 
+static apr_status_t make_socket_pair(apr_socket_t **client,
+                                     apr_socket_t **server, int small)
+{
+    apr_socket_t *listener;
+    apr_sockaddr_t *sa;
+    apr_status_t rv;
+
+    rv = apr_sockaddr_info_get(&sa, "127.0.0.1", APR_INET, 0, 0, p);
+    if (rv == APR_SUCCESS)
+        rv = apr_socket_create(&listener, APR_INET, SOCK_STREAM,
+                               APR_PROTO_TCP, p);
+    if (rv == APR_SUCCESS && small)
+        rv = apr_socket_opt_set(listener, APR_SO_RCVBUF, 4096);
+    if (rv == APR_SUCCESS)
+        rv = apr_socket_bind(listener, sa);
+    if (rv == APR_SUCCESS)
+        rv = apr_socket_listen(listener, 1);
+    if (rv == APR_SUCCESS)
+        rv = apr_socket_addr_get(&sa, APR_LOCAL, listener);
+    if (rv == APR_SUCCESS)
+        rv = apr_socket_create(client, APR_INET, SOCK_STREAM,
+                               APR_PROTO_TCP, p);
+    if (rv == APR_SUCCESS)
+        rv = apr_socket_connect(*client, sa);
+    if (rv == APR_SUCCESS)
+        rv = apr_socket_accept(server, listener, p);
+    return rv;
+}
+
+/* Read what's available from the socket, or up to len bytes if it's
+ * blocking */
+static apr_size_t drain_socket(apr_socket_t *sock, char *buf, apr_size_t len)
+{
+    apr_size_t total = 0, n;
+
+    while (total < len) {
+        n = len - total;
+        if (apr_socket_recv(sock, buf + total, &n) != APR_SUCCESS) {
+            break;
+        }
+        total += n;
+    }
+    return total;
+}
+
+static void test_send_brigade(abts_case *tc, apr_int32_t flags)
+{
+    apr_bucket_alloc_t *ba = apr_bucket_alloc_create(p);
+    apr_bucket_brigade *bb = apr_brigade_create(p, ba);
+    apr_socket_t *client, *server;
+    apr_file_t *f, *small;
+    char *expected, *buf, *contents;
+    apr_size_t i, len, total = 0;
+    apr_off_t sent = 0, n;
+    apr_status_t rv;
+
+    rv = make_socket_pair(&client, &server, 1);
+    if (rv != APR_SUCCESS) {
+        ABTS_NOT_IMPL(tc, "loopback TCP sockets");
+        return;
+    }
+
+    contents = apr_palloc(p, 100000 + 1);
+    for (i = 0; i < 100000; i++) {
+        contents[i] = 'a' + i % 26;
+    }
+    contents[100000] = '\0';
+    apr_file_close(make_test_file(tc, "sendbrigade.bin", contents));
+    APR_ASSERT_SUCCESS(tc, "open sendfile-enabled file",
+                       apr_file_open(&f, "sendbrigade.bin",
+                                     APR_FOPEN_READ
+                                     | APR_FOPEN_SENDFILE_ENABLED,
+                                     APR_FPROT_OS_DEFAULT, p));
+    small = make_test_file(tc, "sendbrigade-small.bin", "small file");
+
+    /* headers, a file, trailers, a small file and another file part */
+    APR_BRIGADE_INSERT_TAIL(bb, apr_bucket_immortal_create("HEAD ", 5, ba));
+    APR_BRIGADE_INSERT_TAIL(bb, apr_bucket_flush_create(ba));
+    apr_brigade_puts(bb, NULL, NULL, "headers\n");
+    apr_brigade_insert_file(bb, f, 10, 80000, p);
+    APR_BRIGADE_INSERT_TAIL(bb, apr_bucket_transient_create(" TRAIL", 6, ba));
+    apr_brigade_insert_file(bb, small, 0, 10, p);
+    apr_brigade_insert_file(bb, f, 0, 20000, p);
+    APR_BRIGADE_INSERT_TAIL(bb, apr_bucket_eos_create(ba));
+    expected = apr_pstrcat(p, "HEAD headers\n",
+                           apr_pstrndup(p, contents + 10, 80000),
+                           " TRAIL", "small file",
+                           apr_pstrndup(p, contents, 20000), NULL);
+    len = strlen(expected);
+    buf = apr_palloc(p, len);
+
+    /* Small buffers and non-blocking sockets for partial writes (the
+     * receive buffer is set on the listener) */
+    apr_socket_opt_set(client, APR_SO_SNDBUF, 4096);
+    apr_socket_timeout_set(client, 0);
+    apr_socket_timeout_set(server, 0);
+    do {
+        rv = apr_brigade_send(client, bb, flags, &n);
+        ABTS_ASSERT(tc, "apr_brigade_send failed",
+                    rv == APR_SUCCESS || APR_STATUS_IS_EAGAIN(rv));
+        sent += n;
+        total += drain_socket(server, buf + total, len - total);
+    } while (APR_STATUS_IS_EAGAIN(rv));
+
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_ASSERT(tc, "brigade not empty", APR_BRIGADE_EMPTY(bb));
+    ABTS_INT_EQUAL(tc, (int)len, (int)sent);
+
+    apr_socket_timeout_set(server, apr_time_from_sec(10));
+    total += drain_socket(server, buf + total, len - total);
+    ABTS_INT_EQUAL(tc, (int)len, (int)total);
+    ABTS_ASSERT(tc, "data received differs", memcmp(buf, expected, len) == 0);
+
+    apr_socket_close(client);
+    apr_socket_close(server);
+    apr_file_close(f);
+    apr_file_close(small);
+    apr_file_remove("sendbrigade.bin", p);
+    apr_file_remove("sendbrigade-small.bin", p);
+    apr_brigade_destroy(bb);
+    apr_bucket_alloc_destroy(ba);
+}
+
+static void test_send(abts_case *tc, void *data)
+{
+    test_send_brigade(tc, 0);
+    test_send_brigade(tc, APR_BRIGADE_SEND_NO_SENDFILE);
+}
+
+static char *make_contents(apr_size_t len)
+{
+    char *contents = apr_palloc(p, len);
+    apr_size_t i;
+
+    for (i = 0; i < len; i++) {
+        contents[i] = 'a' + i % 26;
+    }
+    return contents;
+}
+
+static void test_splice_socket(abts_case *tc, void *data)
+{
+    apr_bucket_alloc_t *ba = apr_bucket_alloc_create(p);
+    apr_bucket_brigade *bb = apr_brigade_create(p, ba);
+    apr_socket_t *up_client, *up_server, *down_client, *down_server;
+    apr_file_t *pipe_in, *pipe_out;
+    apr_size_t len, total, n;
+    char *contents, *buf, *flat;
+    apr_bucket *e;
+    apr_off_t sent;
+    apr_status_t rv;
+
+    if (make_socket_pair(&up_client, &up_server, 0) != APR_SUCCESS
+            || make_socket_pair(&down_client, &down_server, 0)
+               != APR_SUCCESS) {
+        ABTS_NOT_IMPL(tc, "loopback TCP sockets");
+        return;
+    }
+    APR_ASSERT_SUCCESS(tc, "create pipe",
+                       apr_file_pipe_create(&pipe_in, &pipe_out, p));
+
+    /* Data to be inspected are read from the pipe */
+    n = 10;
+    APR_ASSERT_SUCCESS(tc, "send", apr_socket_send(up_client, "inspect me",
+                                                   &n));
+    APR_ASSERT_SUCCESS(tc, "splice socket",
+                       apr_brigade_splice_socket(bb, up_server, pipe_in,
+                                                 pipe_out, 10, &len));
+    ABTS_SIZE_EQUAL(tc, 10, len);
+    APR_ASSERT_SUCCESS(tc, "flatten",
+                       apr_brigade_pflatten(bb, &flat, &len, p));
+    ABTS_SIZE_EQUAL(tc, 10, len);
+    ABTS_ASSERT(tc, "inspected data differ", memcmp(flat, "inspect me",
+                                                    10) == 0);
+    apr_brigade_cleanup(bb);
+
+    /* Data destroyed unread are discarded from the pipe */
+    n = 10;
+    APR_ASSERT_SUCCESS(tc, "send", apr_socket_send(up_client, "discard me",
+                                                   &n));
+    APR_ASSERT_SUCCESS(tc, "splice socket",
+                       apr_brigade_splice_socket(bb, up_server, pipe_in,
+                                                 pipe_out, 10, &len));
+    ABTS_SIZE_EQUAL(tc, 10, len);
+    apr_brigade_cleanup(bb);
+    n = 7;
+    APR_ASSERT_SUCCESS(tc, "send", apr_socket_send(up_client, "keep me",
+                                                   &n));
+    APR_ASSERT_SUCCESS(tc, "splice socket",
+                       apr_brigade_splice_socket(bb, up_server, pipe_in,
+                                                 pipe_out, 7, &len));
+    ABTS_SIZE_EQUAL(tc, 7, len);
+    APR_ASSERT_SUCCESS(tc, "partition",
+                       apr_brigade_partition(bb, 4, &e));
+    APR_ASSERT_SUCCESS(tc, "flatten",
+                       apr_brigade_pflatten(bb, &flat, &len, p));
+    ABTS_SIZE_EQUAL(tc, 7, len);
+    ABTS_ASSERT(tc, "kept data differ", memcmp(flat, "keep me", 7) == 0);
+    apr_brigade_cleanup(bb);
+
+    /* Data to be forwarded are moved from socket to socket */
+    contents = make_contents(50000);
+    n = 50000;
+    APR_ASSERT_SUCCESS(tc, "send", apr_socket_send(up_client, contents, &n));
+    ABTS_SIZE_EQUAL(tc, 50000, n);
+    apr_socket_close(up_client);
+
+    total = 0;
+    while ((rv = apr_brigade_splice_socket(bb, up_server, pipe_in, pipe_out,
+                                           65536, &len)) == APR_SUCCESS) {
+        total += len;
+    }
+    ABTS_INT_EQUAL(tc, APR_EOF, rv);
+    ABTS_SIZE_EQUAL(tc, 50000, total);
+
+    APR_ASSERT_SUCCESS(tc, "send brigade",
+                       apr_brigade_send(down_client, bb, 0, &sent));
+    ABTS_INT_EQUAL(tc, 50000, (int)sent);
+    ABTS_ASSERT(tc, "brigade not empty", APR_BRIGADE_EMPTY(bb));
+
+    buf = apr_palloc(p, 50000);
+    apr_socket_timeout_set(down_server, apr_time_from_sec(10));
+    total = drain_socket(down_server, buf, 50000);
+    ABTS_SIZE_EQUAL(tc, 50000, total);
+    ABTS_ASSERT(tc, "data received differs",
+                memcmp(buf, contents, 50000) == 0);
+
+    apr_socket_close(up_server);
+    apr_socket_close(down_client);
+    apr_socket_close(down_server);
+    apr_file_close(pipe_in);
+    apr_file_close(pipe_out);
+    apr_brigade_destroy(bb);
+    apr_bucket_alloc_destroy(ba);
+}
+
+static void test_send_pipe(abts_case *tc, void *data)
+{
+    static const apr_int32_t flags[] = { 0, APR_BRIGADE_SEND_NO_SPLICE };
+    apr_bucket_alloc_t *ba = apr_bucket_alloc_create(p);
+    apr_bucket_brigade *bb = apr_brigade_create(p, ba);
+    apr_socket_t *client, *server;
+    apr_file_t *pipe_in, *pipe_out;
+    char *contents, *buf;
+    apr_size_t total;
+    apr_off_t sent;
+    apr_status_t rv;
+    int i;
+
+    if (make_socket_pair(&client, &server, 0) != APR_SUCCESS) {
+        ABTS_NOT_IMPL(tc, "loopback TCP sockets");
+        return;
+    }
+    apr_socket_timeout_set(server, apr_time_from_sec(10));
+    contents = make_contents(30000);
+    buf = apr_palloc(p, 30002);
+
+    for (i = 0; i < sizeof(flags) / sizeof(flags[0]); i++) {
+        APR_ASSERT_SUCCESS(tc, "create pipe",
+                           apr_file_pipe_create(&pipe_in, &pipe_out, p));
+        APR_ASSERT_SUCCESS(tc, "write pipe",
+                           apr_file_write_full(pipe_out, contents, 30000,
+                                               NULL));
+        apr_file_close(pipe_out);
+
+        APR_BRIGADE_INSERT_TAIL(bb, apr_bucket_immortal_create("<", 1, ba));
+        APR_BRIGADE_INSERT_TAIL(bb, apr_bucket_pipe_create(pipe_in, ba));
+        APR_BRIGADE_INSERT_TAIL(bb, apr_bucket_immortal_create(">", 1, ba));
+        APR_ASSERT_SUCCESS(tc, "send brigade",
+                           apr_brigade_send(client, bb, flags[i], &sent));
+        ABTS_INT_EQUAL(tc, 30002, (int)sent);
+        ABTS_ASSERT(tc, "brigade not empty", APR_BRIGADE_EMPTY(bb));
+
+        total = drain_socket(server, buf, 30002);
+        ABTS_SIZE_EQUAL(tc, 30002, total);
+        ABTS_ASSERT(tc, "data received differs",
+                    buf[0] == '<' && buf[30001] == '>'
+                    && memcmp(buf + 1, contents, 30000) == 0);
+    }
+
+    /* A non-blocking socket is not blocked on an empty pipe */
+    APR_ASSERT_SUCCESS(tc, "create pipe",
+                       apr_file_pipe_create(&pipe_in, &pipe_out, p));
+    APR_BRIGADE_INSERT_TAIL(bb, apr_bucket_pipe_create(pipe_in, ba));
+    apr_socket_timeout_set(client, 0);
+    rv = apr_brigade_send(client, bb, 0, &sent);
+    ABTS_ASSERT(tc, "empty pipe not EAGAIN", APR_STATUS_IS_EAGAIN(rv));
+    ABTS_INT_EQUAL(tc, 0, (int)sent);
+    APR_ASSERT_SUCCESS(tc, "write pipe",
+                       apr_file_write_full(pipe_out, contents, 100, NULL));
+    apr_file_close(pipe_out);
+    apr_socket_timeout_set(client, -1);
+    APR_ASSERT_SUCCESS(tc, "send brigade",
+                       apr_brigade_send(client, bb, 0, &sent));
+    ABTS_INT_EQUAL(tc, 100, (int)sent);
+    total = drain_socket(server, buf, 100);
+    ABTS_SIZE_EQUAL(tc, 100, total);
+    ABTS_ASSERT(tc, "data received differs", memcmp(buf, contents, 100) == 0);
+
+    apr_socket_close(client);
+    apr_socket_close(server);
+    apr_brigade_destroy(bb);
+    apr_bucket_alloc_destroy(ba);
+}
+
+static void test_socket_budget(abts_case *tc, void *data)
+{
+    apr_bucket_alloc_t *ba = apr_bucket_alloc_create(p);
+    apr_bucket_brigade *bb = apr_brigade_create(p, ba);
+    apr_socket_t *client, *server;
+    apr_bucket *e;
+    const char *str;
+    char *contents, *flat;
+    apr_size_t len, n;
+    int count;
+
+    if (make_socket_pair(&client, &server, 0) != APR_SUCCESS) {
+        ABTS_NOT_IMPL(tc, "loopback TCP sockets");
+        return;
+    }
+    contents = make_contents(50000);
+    n = 50000;
+    APR_ASSERT_SUCCESS(tc, "send", apr_socket_send(client, contents, &n));
+    ABTS_SIZE_EQUAL(tc, 50000, n);
+    apr_socket_close(client);
+
+    e = apr_bucket_socket_create(server, ba);
+    APR_ASSERT_SUCCESS(tc, "set budget",
+                       apr_bucket_socket_set_read_budget(e, 32768));
+    APR_BRIGADE_INSERT_TAIL(bb, e);
+
+    /* The first read returns one buffer, the rest of the budget is
+     * chained as HEAP buckets before the SOCKET bucket. */
+    APR_ASSERT_SUCCESS(tc, "read socket",
+                       apr_bucket_read(e, &str, &len, APR_BLOCK_READ));
+    ABTS_ASSERT(tc, "first bucket is not HEAP", APR_BUCKET_IS_HEAP(e));
+    ABTS_SIZE_EQUAL(tc, APR_BUCKET_BUFF_SIZE, len);
+    ABTS_INT_EQUAL(tc, APR_EINVAL,
+                   apr_bucket_socket_set_read_budget(e, 32768));
+    ABTS_ASSERT(tc, "first buffer differs", memcmp(str, contents, len) == 0);
+    n = 0;
+    count = 0;
+    for (e = APR_BRIGADE_FIRST(bb); APR_BUCKET_IS_HEAP(e);
+         e = APR_BUCKET_NEXT(e)) {
+        n += e->length;
+        count++;
+    }
+    ABTS_ASSERT(tc, "no SOCKET bucket after the budget",
+                APR_BUCKET_IS_SOCKET(e));
+    ABTS_ASSERT(tc, "read over budget", n <= 32768);
+    ABTS_ASSERT(tc, "chained buckets do not match the data read",
+                count == (int)((n + APR_BUCKET_BUFF_SIZE - 1)
+                               / APR_BUCKET_BUFF_SIZE));
+
+    /* The budget is kept until EOF */
+    APR_ASSERT_SUCCESS(tc, "flatten",
+                       apr_brigade_pflatten(bb, &flat, &len, p));
+    ABTS_SIZE_EQUAL(tc, 50000, len);
+    ABTS_ASSERT(tc, "data read differ", memcmp(flat, contents, len) == 0);
+
+    apr_socket_close(server);
+    apr_brigade_destroy(bb);
+    apr_bucket_alloc_destroy(ba);
+}
+
 abts_suite *testbuckets(abts_suite *suite)
 {
     suite = ADD_SUITE(suite);
@@ -670,14 +1356,23 @@ abts_suite *testbuckets(abts_suite *suite)
     abts_run_test(suite, test_splitline_exactly, NULL);
     abts_run_test(suite, test_splitline_eos, NULL);
     abts_run_test(suite, test_splitboundary, NULL);
+    abts_run_test(suite, test_match, NULL);
+    abts_run_test(suite, test_match_all, NULL);
+    abts_run_test(suite, test_encode, NULL);
     abts_run_test(suite, test_splits, NULL);
     abts_run_test(suite, test_insertfile, NULL);
     abts_run_test(suite, test_manyfile, NULL);
+    abts_run_test(suite, test_adaptivefile, NULL);
+    abts_run_test(suite, test_alloc_freelists, NULL);
     abts_run_test(suite, test_truncfile, NULL);
     abts_run_test(suite, test_partition, NULL);
     abts_run_test(suite, test_write_split, NULL);
     abts_run_test(suite, test_write_putstrs, NULL);
     abts_run_test(suite, test_iovec, NULL);
+    abts_run_test(suite, test_send, NULL);
+    abts_run_test(suite, test_splice_socket, NULL);
+    abts_run_test(suite, test_send_pipe, NULL);
+    abts_run_test(suite, test_socket_budget, NULL);
 
     return suite;
 }
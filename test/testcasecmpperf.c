@@ -0,0 +1,206 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr_cstr.h"
+#include "apr_tables.h"
+#include "apr_pools.h"
+#include "apr_strings.h"
+#include "apr_errno.h"
+#include "apr_general.h"
+#include "apr_getopt.h"
+#include "apr_lib.h"
+#include "apr_time.h"
+#include <stdio.h>
+#include <stdlib.h>
+#if APR_HAVE_STRING_H
+#include <string.h>
+#endif
+#if APR_HAVE_STRINGS_H
+#include <strings.h>
+#endif
+
+#define DEFAULT_NUM_LOOPS 100000
+
+static long num_loops = DEFAULT_NUM_LOOPS;
+
+static apr_pool_t *pool;
+
+/* The request headers of a browser, most frequent first */
+static const char *header_names[] = {
+    "Host", "User-Agent", "Accept", "Accept-Language", "Accept-Encoding",
+    "Connection", "Referer", "Cookie", "Upgrade-Insecure-Requests",
+    "Cache-Control", "If-Modified-Since", "If-None-Match", "Content-Type",
+    "Content-Length", "Origin", "Sec-Fetch-Dest", "Sec-Fetch-Mode",
+    "Sec-Fetch-Site", "Sec-Fetch-User", "Sec-Ch-Ua", "Sec-Ch-Ua-Mobile",
+    "Sec-Ch-Ua-Platform", "Pragma", "DNT", "X-Requested-With",
+    "X-Forwarded-For", "X-Forwarded-Proto", "X-Forwarded-Host",
+    "X-Real-IP", "Authorization", "Range", "TE"
+};
+#define NUM_HEADERS (sizeof(header_names) / sizeof(header_names[0]))
+
+typedef int (*casecmp_fn_t)(const char *s1, const char *s2);
+
+/* A byte at a time, for reference */
+static int bytewise_casecmp(const char *s1, const char *s2)
+{
+    const unsigned char *u1 = (const unsigned char *)s1;
+    const unsigned char *u2 = (const unsigned char *)s2;
+    for (;;) {
+        const int c2 = apr_tolower(*u2++);
+        const int cmp = apr_tolower(*u1++) - c2;
+        if (cmp || !c2)
+            return cmp;
+    }
+}
+
+static int libc_casecmp(const char *s1, const char *s2)
+{
+    return strcasecmp(s1, s2);
+}
+
+static void test_casecmp(const char *name, casecmp_fn_t casecmp,
+                         const char **s1, const char **s2)
+{
+    apr_time_t time_start, time_stop;
+    long i, j, matches = 0;
+
+    printf("    %-20s", name);
+    time_start = apr_time_now();
+    for (i = 0; i < num_loops; i++) {
+        for (j = 0; j < NUM_HEADERS; j++) {
+            matches += !casecmp(s1[j], s2[j]);
+        }
+    }
+    time_stop = apr_time_now();
+
+    printf("%10" APR_INT64_T_FMT " usec, %8.2f ns/cmp (%ld matches)\n",
+           (time_stop - time_start),
+           (double)(time_stop - time_start) * 1000.0
+           / ((double)num_loops * NUM_HEADERS),
+           matches);
+}
+
+static void test_funcs(const char *title, const char **s1, const char **s2)
+{
+    printf("%s\n", title);
+    test_casecmp("byte at a time", bytewise_casecmp, s1, s2);
+    test_casecmp("strcasecmp", libc_casecmp, s1, s2);
+    test_casecmp("apr_cstr_casecmp", apr_cstr_casecmp, s1, s2);
+    printf("\n");
+}
+
+static void test_table(int nelts)
+{
+    apr_table_t *t = apr_table_make(pool, nelts);
+    const char **keys = apr_palloc(pool, NUM_HEADERS * sizeof(*keys));
+    apr_time_t time_start, time_stop;
+    long i, j, found = 0;
+
+    for (j = 0; j < nelts; j++) {
+        apr_table_setn(t, j < NUM_HEADERS ? header_names[j]
+                                          : apr_psprintf(pool, "X-Custom-%ld",
+                                                         j),
+                       "value");
+    }
+    for (j = 0; j < NUM_HEADERS; j++) {
+        /* lookups with the lowercase names of HTTP/2 */
+        char *key = apr_pstrdup(pool, header_names[j]);
+        for (i = 0; key[i]; i++) {
+            key[i] = apr_tolower(key[i]);
+        }
+        keys[j] = key;
+    }
+
+    printf("    %3d entries         ", nelts);
+    time_start = apr_time_now();
+    for (i = 0; i < num_loops; i++) {
+        for (j = 0; j < NUM_HEADERS; j++) {
+            found += apr_table_get(t, keys[j]) != NULL;
+        }
+    }
+    time_stop = apr_time_now();
+
+    printf("%10" APR_INT64_T_FMT " usec, %8.2f ns/get (%ld found)\n",
+           (time_stop - time_start),
+           (double)(time_stop - time_start) * 1000.0
+           / ((double)num_loops * NUM_HEADERS),
+           found);
+}
+
+int main(int argc, const char * const *argv)
+{
+    apr_status_t rv;
+    char errmsg[200];
+    apr_getopt_t *opt;
+    char optchar;
+    const char *optarg;
+    const char **lower, **upper, **other;
+    int j;
+
+    printf("APR Case-Insensitive Comparison Performance Test\n"
+           "==============\n\n");
+
+    apr_initialize();
+    atexit(apr_terminate);
+
+    if (apr_pool_create(&pool, NULL) != APR_SUCCESS)
+        exit(-1);
+
+    if ((rv = apr_getopt_init(&opt, pool, argc, argv)) != APR_SUCCESS) {
+        fprintf(stderr, "Could not set up to parse options: [%d] %s\n",
+                rv, apr_strerror(rv, errmsg, sizeof errmsg));
+        exit(-1);
+    }
+
+    while ((rv = apr_getopt(opt, "l:", &optchar, &optarg)) == APR_SUCCESS) {
+        if (optchar == 'l') {
+            num_loops = atol(optarg);
+        }
+    }
+
+    if (rv != APR_SUCCESS && rv != APR_EOF) {
+        fprintf(stderr, "Could not parse options: [%d] %s\n",
+                rv, apr_strerror(rv, errmsg, sizeof errmsg));
+        exit(-1);
+    }
+
+    lower = apr_palloc(pool, NUM_HEADERS * sizeof(*lower));
+    upper = apr_palloc(pool, NUM_HEADERS * sizeof(*upper));
+    other = apr_palloc(pool, NUM_HEADERS * sizeof(*other));
+    for (j = 0; j < NUM_HEADERS; j++) {
+        char *l = apr_pstrdup(pool, header_names[j]);
+        char *u = apr_pstrdup(pool, header_names[j]);
+        int i;
+        for (i = 0; l[i]; i++) {
+            l[i] = apr_tolower(l[i]);
+            u[i] = apr_toupper(u[i]);
+        }
+        lower[j] = l;
+        upper[j] = u;
+        /* the next one, often sharing a prefix (Accept, Accept-Language) */
+        other[j] = header_names[(j + 1) % NUM_HEADERS];
+    }
+
+    test_funcs("Equal names, different case", lower, upper);
+    test_funcs("Different names", header_names, other);
+
+    printf("apr_table_get() of lowercase names\n");
+    test_table(8);
+    test_table(NUM_HEADERS);
+    test_table(64);
+
+    return 0;
+}
@@ -2721,6 +2721,106 @@ static void test_crypto_thread_random(abts_case *tc, void *data)
 
     apr_pool_destroy(pool);
 }
+
+static void test_crypto_thread_random_reinit(abts_case *tc, void *data)
+{
+    static unsigned char zerobytes[16];
+    unsigned char randbytes[2][16];
+    int flags = APR_CRYPTO_PRNG_PER_THREAD;
+    apr_pool_t *pool = NULL;
+    apr_status_t rv;
+    int i;
+
+    /* The CPRNG of this thread must be renewed by a new init */
+    for (i = 0; i < 2; ++i) {
+        rv = apr_pool_create(&pool, NULL);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+        rv = apr_crypto_prng_init(pool, NULL, APR_CRYPTO_CIPHER_AUTO, 0,
+                                  NULL, flags);
+        ABTS_ASSERT(tc, "apr_crypto_prng_init failed", rv == APR_SUCCESS);
+
+        rv = apr_crypto_random_thread_bytes(randbytes[i], 16);
+        ABTS_ASSERT(tc, "apr_crypto_random_thread_bytes failed",
+                    rv == APR_SUCCESS);
+        ABTS_ASSERT(tc, "generated zero bytes",
+                    memcmp(randbytes[i], zerobytes, 16) != 0);
+
+        apr_pool_destroy(pool);
+
+        rv = apr_crypto_random_thread_bytes(zerobytes, 16);
+        ABTS_ASSERT(tc, "apr_crypto_random_thread_bytes without init",
+                    rv == APR_EINIT);
+    }
+    ABTS_ASSERT(tc, "generated same random bytes after reinit",
+                memcmp(randbytes[0], randbytes[1], 16) != 0);
+}
+
+#if APR_HAS_FORK
+static void test_crypto_fork_thread_random(abts_case *tc, void *data)
+{
+    unsigned char randbytes[1024];
+    apr_pool_t *pool = NULL;
+    apr_file_t *pread = NULL;
+    apr_file_t *pwrite = NULL;
+    apr_size_t nbytes;
+    apr_proc_t proc;
+    apr_status_t rv;
+
+    rv = apr_pool_create(&pool, NULL);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    rv = apr_crypto_prng_init(pool, NULL, APR_CRYPTO_CIPHER_AUTO, 0, NULL,
+                              APR_CRYPTO_PRNG_PER_THREAD);
+    ABTS_ASSERT(tc, "apr_crypto_prng_init failed", rv == APR_SUCCESS);
+
+    /* Fill the buffer of this thread's CPRNG before forking */
+    rv = apr_crypto_random_thread_bytes(randbytes, 16);
+    ABTS_ASSERT(tc, "apr_crypto_random_thread_bytes failed",
+                rv == APR_SUCCESS);
+
+    rv = apr_file_pipe_create(&pread, &pwrite, pool);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    rv = apr_proc_fork(&proc, pool);
+    if (rv == APR_INCHILD) {
+        apr_file_close(pread);
+        rv = apr_crypto_random_thread_bytes(randbytes, 1024);
+        if (rv == APR_SUCCESS) {
+            apr_file_write_full(pwrite, randbytes, 1024, &nbytes);
+        }
+        apr_file_close(pwrite);
+
+        exit(rv != APR_SUCCESS);
+    }
+    else if (rv == APR_INPARENT) {
+        int exitcode;
+        apr_exit_why_e why;
+        unsigned char childbytes[1024];
+
+        apr_file_close(pwrite);
+        rv = apr_file_read_full(pread, childbytes, 1024, &nbytes);
+        ABTS_INT_EQUAL(tc, (int)nbytes, 1024);
+        apr_file_close(pread);
+
+        apr_proc_wait(&proc, &exitcode, &why, APR_WAIT);
+        if (why != APR_PROC_EXIT || exitcode != 0) {
+            ABTS_FAIL(tc, "apr_crypto_random_thread_bytes failed in child");
+        }
+
+        rv = apr_crypto_random_thread_bytes(randbytes, 1024);
+        ABTS_ASSERT(tc, "apr_crypto_random_thread_bytes failed in parent",
+                    rv == APR_SUCCESS);
+        ABTS_ASSERT(tc, "parent and child generated same random bytes",
+                    memcmp(randbytes, childbytes, 1024) != 0);
+    }
+    else {
+        ABTS_FAIL(tc, "apr_proc_fork failed");
+    }
+
+    apr_pool_destroy(pool);
+}
+#endif
 #endif /* APR_HAS_THREADS */
 #endif /* APU_HAVE_CRYPTO_PRNG */
 
@@ -2820,6 +2920,10 @@ abts_suite *testcrypto(abts_suite *suite)
 #endif
 #if APR_HAS_THREADS
     abts_run_test(suite, test_crypto_thread_random, NULL);
+    abts_run_test(suite, test_crypto_thread_random_reinit, NULL);
+#if APR_HAS_FORK
+    abts_run_test(suite, test_crypto_fork_thread_random, NULL);
+#endif
 #endif
 #endif
 
@@ -1101,6 +1101,258 @@ static void test_decode_errors(abts_case * tc, void *data)
     ABTS_SIZE_EQUAL(tc, 2, len);
 }
 
+static void ref_encode_base64(char *dest, const unsigned char *src,
+                              apr_size_t slen, int flags)
+{
+    const char *base = (flags & APR_ENCODE_BASE64URL)
+        ? "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_"
+        : "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    apr_size_t i;
+
+    for (i = 0; i < slen; i += 3) {
+        unsigned long v = (unsigned long)src[i] << 16;
+        if (i + 1 < slen)
+            v |= src[i + 1] << 8;
+        if (i + 2 < slen)
+            v |= src[i + 2];
+        *dest++ = base[(v >> 18) & 0x3F];
+        *dest++ = base[(v >> 12) & 0x3F];
+        if (i + 1 < slen)
+            *dest++ = base[(v >> 6) & 0x3F];
+        else if (!(flags & APR_ENCODE_NOPADDING))
+            *dest++ = '=';
+        if (i + 2 < slen)
+            *dest++ = base[v & 0x3F];
+        else if (!(flags & APR_ENCODE_NOPADDING))
+            *dest++ = '=';
+    }
+    *dest = '\0';
+}
+
+static void test_base64_lengths(abts_case * tc, void *data)
+{
+    static const int flags[] = {
+        APR_ENCODE_NONE, APR_ENCODE_NOPADDING, APR_ENCODE_BASE64URL,
+        APR_ENCODE_BASE64URL | APR_ENCODE_NOPADDING
+    };
+    apr_pool_t *pool;
+    unsigned char src[300];
+    char target[410];
+    apr_size_t slen, len, dlen;
+    int f;
+
+    apr_pool_create(&pool, NULL);
+
+    srand(42);
+    for (slen = 0; slen < sizeof(src); slen++) {
+        src[slen] = (unsigned char)rand();
+    }
+
+    for (f = 0; f < 4; f++) {
+        for (slen = 0; slen <= sizeof(src); slen++) {
+            const char *dest;
+            const unsigned char *udest;
+
+            ref_encode_base64(target, src, slen, flags[f]);
+            dest = apr_pencode_base64_binary(pool, src, slen, flags[f], &len);
+            ABTS_STR_EQUAL(tc, target, dest);
+            ABTS_SIZE_EQUAL(tc, strlen(target), len);
+
+            udest = apr_pdecode_base64_binary(pool, dest, len, flags[f],
+                                              &dlen);
+            ABTS_PTR_NOTNULL(tc, udest);
+            ABTS_SIZE_EQUAL(tc, slen, dlen);
+            ABTS_ASSERT(tc, "base64 round trip",
+                        udest && !memcmp(src, udest, slen));
+        }
+    }
+
+    /* an invalid character anywhere stops the decoding there */
+    ref_encode_base64(target, src, sizeof(src), APR_ENCODE_NOPADDING);
+    for (slen = 0; slen < 200; slen++) {
+        char *dest = apr_pstrdup(pool, target);
+        unsigned char *udest = apr_palloc(pool, sizeof(src));
+        unsigned char *uprefix = apr_palloc(pool, sizeof(src));
+        apr_status_t rv, rv_prefix;
+
+        dest[slen] = '*';
+        rv = apr_decode_base64_binary(udest, dest, APR_ENCODE_STRING,
+                                      APR_ENCODE_NONE, &dlen);
+        ABTS_INT_EQUAL(tc, slen % 4 == 1 ? APR_EINCOMPLETE : APR_BADCH, rv);
+        rv = apr_decode_base64_binary(NULL, dest, APR_ENCODE_STRING,
+                                      APR_ENCODE_NONE, &dlen);
+        ABTS_INT_EQUAL(tc, slen % 4 == 1 ? APR_EINCOMPLETE : APR_BADCH, rv);
+
+        rv_prefix = apr_decode_base64_binary(uprefix, dest, slen,
+                                             APR_ENCODE_NONE, &len);
+        rv = apr_decode_base64_binary(udest, dest, APR_ENCODE_STRING,
+                                      APR_ENCODE_RELAXED, &dlen);
+        ABTS_INT_EQUAL(tc, rv_prefix, rv);
+        ABTS_SIZE_EQUAL(tc, len, dlen);
+        ABTS_ASSERT(tc, "relaxed base64 prefix",
+                    !memcmp(uprefix, udest, dlen));
+    }
+
+    apr_pool_destroy(pool);
+}
+
+/* Feed the context with pieces of random lengths */
+static apr_status_t stream(apr_encode_ctx_t *ctx, apr_pool_t *pool,
+                           const void *src, apr_size_t slen,
+                           char **dest, apr_size_t *dlen)
+{
+    const char *in = src;
+    apr_size_t max, fmax, len, n, i = 0;
+    apr_status_t rv = APR_SUCCESS, rv_final;
+    char *out;
+
+    apr_encode_update(ctx, NULL, src, slen, &max);
+    apr_encode_final(ctx, NULL, &fmax);
+    out = *dest = apr_palloc(pool, max + fmax);
+
+    while (i < slen && rv == APR_SUCCESS) {
+        n = rand() % 40;
+        if (n > slen - i) {
+            n = slen - i;
+        }
+        rv = apr_encode_update(ctx, out, in + i, n, &len);
+        out += len;
+        i += n;
+    }
+    rv_final = apr_encode_final(ctx, out, &len);
+    out += len;
+
+    *dlen = out - *dest;
+    return (rv != APR_SUCCESS) ? rv : rv_final;
+}
+
+static void test_encode_stream(abts_case * tc, void *data)
+{
+    static const struct {
+        apr_status_t (*init)(apr_encode_ctx_t **ctx, int flags,
+                             apr_pool_t *p);
+        apr_status_t (*encode)(char *dest, const unsigned char *src,
+                               apr_ssize_t slen, int flags, apr_size_t *len);
+        apr_status_t (*decode_init)(apr_encode_ctx_t **ctx, int flags,
+                                    apr_pool_t *p);
+        int flags;
+        int decode_flags;
+    } encodings[] = {
+        { apr_encode_base64_init, apr_encode_base64_binary,
+          apr_decode_base64_init, APR_ENCODE_NONE, APR_ENCODE_NONE },
+        { apr_encode_base64_init, apr_encode_base64_binary,
+          apr_decode_base64_init, APR_ENCODE_BASE64URL, APR_ENCODE_NONE },
+        { apr_encode_base64_init, apr_encode_base64_binary,
+          apr_decode_base64_init, APR_ENCODE_URL, APR_ENCODE_NONE },
+        { apr_encode_base32_init, apr_encode_base32_binary,
+          apr_decode_base32_init, APR_ENCODE_NONE, APR_ENCODE_NONE },
+        { apr_encode_base32_init, apr_encode_base32_binary,
+          apr_decode_base32_init, APR_ENCODE_BASE32HEX | APR_ENCODE_NOPADDING,
+          APR_ENCODE_BASE32HEX },
+        { apr_encode_base16_init, apr_encode_base16_binary,
+          apr_decode_base16_init, APR_ENCODE_NONE, APR_ENCODE_NONE },
+        { apr_encode_base16_init, apr_encode_base16_binary,
+          apr_decode_base16_init, APR_ENCODE_COLON, APR_ENCODE_COLON }
+    };
+    apr_pool_t *pool;
+    unsigned char src[200];
+    apr_size_t slen, len, dlen;
+    int i;
+
+    apr_pool_create(&pool, NULL);
+
+    srand(7);
+    for (slen = 0; slen < sizeof(src); slen++) {
+        src[slen] = (unsigned char)rand();
+    }
+
+    for (i = 0; i < sizeof(encodings) / sizeof(encodings[0]); i++) {
+        apr_encode_ctx_t *enc, *dec;
+
+        encodings[i].init(&enc, encodings[i].flags, pool);
+        encodings[i].decode_init(&dec, encodings[i].decode_flags, pool);
+
+        for (slen = 0; slen <= sizeof(src); slen++) {
+            char *target, *dest, *udest;
+            apr_status_t rv;
+
+            encodings[i].encode(NULL, src, slen, encodings[i].flags, &len);
+            target = apr_palloc(pool, len);
+            encodings[i].encode(target, src, slen, encodings[i].flags, &len);
+
+            rv = stream(enc, pool, src, slen, &dest, &dlen);
+            ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+            ABTS_SIZE_EQUAL(tc, len, dlen);
+            ABTS_ASSERT(tc, apr_psprintf(pool, "stream encoding %d of %"
+                                         APR_SIZE_T_FMT " bytes", i, slen),
+                        !memcmp(target, dest, len));
+
+            rv = stream(dec, pool, target, len, &udest, &dlen);
+            ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+            ABTS_SIZE_EQUAL(tc, slen, dlen);
+            ABTS_ASSERT(tc, apr_psprintf(pool, "stream decoding %d of %"
+                                         APR_SIZE_T_FMT " bytes", i, slen),
+                        !memcmp(src, udest, slen));
+        }
+    }
+
+    apr_pool_destroy(pool);
+}
+
+static void test_decode_stream_errors(abts_case * tc, void *data)
+{
+    apr_pool_t *pool;
+    apr_encode_ctx_t *ctx;
+    char *dest;
+    apr_size_t len;
+    apr_status_t rv;
+
+    apr_pool_create(&pool, NULL);
+
+    apr_decode_base64_init(&ctx, APR_ENCODE_NONE, pool);
+    rv = stream(ctx, pool, "Zm9v*Zm9v", 9, &dest, &len);
+    ABTS_INT_EQUAL(tc, APR_BADCH, rv);
+    rv = stream(ctx, pool, "Zg==Zg==", 8, &dest, &len);
+    ABTS_INT_EQUAL(tc, APR_BADCH, rv);
+    rv = stream(ctx, pool, "Zg===", 5, &dest, &len);
+    ABTS_INT_EQUAL(tc, APR_BADCH, rv);
+    rv = stream(ctx, pool, "Zg=", 3, &dest, &len);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_SIZE_EQUAL(tc, 1, len);
+    ABTS_INT_EQUAL(tc, 'f', dest[0]);
+    rv = stream(ctx, pool, "Zm9vY", 5, &dest, &len);
+    ABTS_INT_EQUAL(tc, APR_EINCOMPLETE, rv);
+
+    apr_decode_base64_init(&ctx, APR_ENCODE_RELAXED, pool);
+    rv = stream(ctx, pool, "Zm9v*Zm9v", 9, &dest, &len);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_SIZE_EQUAL(tc, 3, len);
+    rv = stream(ctx, pool, "Zg==Zm9v", 8, &dest, &len);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_SIZE_EQUAL(tc, 1, len);
+
+    apr_decode_base32_init(&ctx, APR_ENCODE_NONE, pool);
+    rv = stream(ctx, pool, "MZXW6===", 8, &dest, &len);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_SIZE_EQUAL(tc, 3, len);
+    rv = stream(ctx, pool, "MZX", 3, &dest, &len);
+    ABTS_INT_EQUAL(tc, APR_EINCOMPLETE, rv);
+
+    apr_decode_base16_init(&ctx, APR_ENCODE_NONE, pool);
+    rv = stream(ctx, pool, "ABC", 3, &dest, &len);
+    ABTS_INT_EQUAL(tc, APR_EINCOMPLETE, rv);
+    rv = stream(ctx, pool, "AB:CD", 5, &dest, &len);
+    ABTS_INT_EQUAL(tc, APR_BADCH, rv);
+
+    apr_decode_base16_init(&ctx, APR_ENCODE_COLON, pool);
+    rv = stream(ctx, pool, "AB:CD", 5, &dest, &len);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_SIZE_EQUAL(tc, 2, len);
+    ABTS_INT_EQUAL(tc, 0xCD, (unsigned char)dest[1]);
+
+    apr_pool_destroy(pool);
+}
+
 abts_suite *testencode(abts_suite * suite)
 {
     suite = ADD_SUITE(suite);
@@ -1109,6 +1361,7 @@ abts_suite *testencode(abts_suite * suite)
     abts_run_test(suite, test_encode_base64_binary, NULL);
     abts_run_test(suite, test_decode_base64, NULL);
     abts_run_test(suite, test_decode_base64_binary, NULL);
+    abts_run_test(suite, test_base64_lengths, NULL);
     abts_run_test(suite, test_encode_base32, NULL);
     abts_run_test(suite, test_encode_base32_binary, NULL);
     abts_run_test(suite, test_decode_base32, NULL);
@@ -1119,6 +1372,8 @@ abts_suite *testencode(abts_suite * suite)
     abts_run_test(suite, test_decode_base16_binary, NULL);
     abts_run_test(suite, test_encode_errors, NULL);
     abts_run_test(suite, test_decode_errors, NULL);
+    abts_run_test(suite, test_encode_stream, NULL);
+    abts_run_test(suite, test_decode_stream_errors, NULL);
 
     return suite;
 }
@@ -370,11 +370,90 @@ static void test_escape(abts_case *tc, void *data)
     apr_pool_destroy(pool);
 }
 
+static void check_run(abts_case *tc, apr_pool_t *pool, const char *name,
+                      const char *dest, const char *target,
+                      apr_size_t len)
+{
+    ABTS_ASSERT(tc,
+                apr_psprintf(pool, "%s escaped (%s) does not match expected "
+                             "output (%s)", name, dest, target),
+                (strcmp(dest, target) == 0));
+    ABTS_ASSERT(tc,
+            apr_psprintf(pool, "%s size mismatch (%" APR_SIZE_T_FMT "!=%"
+                         APR_SIZE_T_FMT ")", name, len, strlen(target) + 1),
+            (len == strlen(target) + 1));
+}
+
+/* A character to escape anywhere in runs of characters left as is */
+static void test_escape_runs(abts_case *tc, void *data)
+{
+    apr_pool_t *pool;
+    char head[80], tail[80];
+    const char *src, *dest;
+    char *buf;
+    apr_size_t k, len;
+
+    apr_pool_create(&pool, NULL);
+
+    for (k = 0; k < sizeof(head); k++) {
+        memset(head, 'x', k);
+        head[k] = '\0';
+        memset(tail, 'y', sizeof(tail) - k - 1);
+        tail[sizeof(tail) - k - 1] = '\0';
+
+        src = apr_pstrcat(pool, head, "\"\xc3\xa9", tail, NULL);
+        dest = apr_pescape_json(pool, src, APR_ESCAPE_STRING, 0);
+        apr_escape_json(NULL, src, strlen(src), 0, &len);
+        check_run(tc, pool, "json", dest,
+                  apr_pstrcat(pool, head, "\\\"\xc3\xa9", tail, NULL), len);
+
+        src = apr_pstrcat(pool, head, "<\xe9", tail, NULL);
+        dest = apr_pescape_entity(pool, src, 0);
+        apr_escape_entity(NULL, src, strlen(src), 0, &len);
+        check_run(tc, pool, "entity", dest,
+                  apr_pstrcat(pool, head, "&lt;\xe9", tail, NULL), len);
+
+        src = apr_pstrcat(pool, head, "&", tail, NULL);
+        dest = apr_pescape_entity(pool, src, 1);
+        apr_escape_entity(NULL, src, strlen(src), 1, &len);
+        check_run(tc, pool, "entity to ascii", dest,
+                  apr_pstrcat(pool, head, "&amp;", tail, NULL), len);
+
+        src = apr_pstrcat(pool, head, "\t", tail, NULL);
+        dest = apr_pescape_echo(pool, src, 0);
+        apr_escape_echo(NULL, src, strlen(src), 0, &len);
+        check_run(tc, pool, "echo", dest,
+                  apr_pstrcat(pool, head, "\\t", tail, NULL), len);
+
+        src = apr_pstrcat(pool, head, " /", tail, NULL);
+        dest = apr_pescape_urlencoded(pool, src);
+        apr_escape_urlencoded(NULL, src, strlen(src), &len);
+        check_run(tc, pool, "urlencoded", dest,
+                  apr_pstrcat(pool, head, "+%2f", tail, NULL), len);
+
+        src = apr_pstrcat(pool, head, "%41+", tail, NULL);
+        dest = apr_punescape_url(pool, src, NULL, NULL, 1);
+        apr_unescape_url(NULL, src, strlen(src), NULL, NULL, 1, &len);
+        check_run(tc, pool, "unescape url", dest,
+                  apr_pstrcat(pool, head, "A ", tail, NULL), len);
+
+        /* in place, the runs overlap once an escape was decoded */
+        src = apr_pstrcat(pool, "%41", head, "%41", tail, NULL);
+        buf = apr_pstrdup(pool, src);
+        apr_unescape_url(buf, buf, APR_ESCAPE_STRING, NULL, NULL, 0, &len);
+        check_run(tc, pool, "unescape url in place", buf,
+                  apr_pstrcat(pool, "A", head, "A", tail, NULL), len);
+    }
+
+    apr_pool_destroy(pool);
+}
+
 abts_suite *testescape(abts_suite *suite)
 {
     suite = ADD_SUITE(suite);
 
     abts_run_test(suite, test_escape, NULL);
+    abts_run_test(suite, test_escape_runs, NULL);
 
     return suite;
 }
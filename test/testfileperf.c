@@ -0,0 +1,170 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Serves a file through FILE buckets, the way a server reads a static
+ * file to write it out, with the different read strategies.
+ */
+
+#include "apr_buckets.h"
+#include "apr_file_io.h"
+#include "apr_pools.h"
+#include "apr_errno.h"
+#include "apr_general.h"
+#include "apr_getopt.h"
+#include "apr_time.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define DEFAULT_FILE_SIZE (64 * 1024 * 1024)
+#define NUM_PASSES 4
+#define FNAME "data/testfileperf.bin"
+
+static apr_size_t file_size = DEFAULT_FILE_SIZE;
+
+static apr_pool_t *pool;
+
+static void make_file(void)
+{
+    char buf[8192];
+    apr_file_t *f;
+    apr_size_t i, n;
+
+    for (i = 0; i < sizeof(buf); i++) {
+        buf[i] = (char)rand();
+    }
+    if (apr_file_open(&f, FNAME, APR_FOPEN_WRITE | APR_FOPEN_CREATE
+                                 | APR_FOPEN_TRUNCATE,
+                      APR_FPROT_OS_DEFAULT, pool) != APR_SUCCESS) {
+        fprintf(stderr, "Could not create " FNAME "\n");
+        exit(-1);
+    }
+    for (i = 0; i < file_size; i += n) {
+        n = file_size - i < sizeof(buf) ? file_size - i : sizeof(buf);
+        if (apr_file_write_full(f, buf, n, NULL) != APR_SUCCESS) {
+            fprintf(stderr, "Could not write " FNAME "\n");
+            exit(-1);
+        }
+    }
+    apr_file_close(f);
+}
+
+static void serve(const char *name, int mmap, apr_size_t buf_size,
+                  apr_size_t max_size)
+{
+    apr_bucket_alloc_t *ba;
+    apr_bucket_brigade *bb;
+    apr_pool_t *subpool;
+    apr_time_t start, elapsed;
+    apr_size_t reads = 0, total = 0, len;
+    const char *str;
+    unsigned char sum = 0;
+    apr_file_t *f;
+    apr_bucket *e;
+    int i;
+
+    apr_pool_create(&subpool, pool);
+    ba = apr_bucket_alloc_create(subpool);
+    bb = apr_brigade_create(subpool, ba);
+    if (apr_file_open(&f, FNAME, APR_FOPEN_READ, APR_FPROT_OS_DEFAULT,
+                      subpool) != APR_SUCCESS) {
+        fprintf(stderr, "Could not open " FNAME "\n");
+        exit(-1);
+    }
+
+    start = apr_time_now();
+    for (i = 0; i < NUM_PASSES; i++) {
+        e = apr_brigade_insert_file(bb, f, 0, file_size, subpool);
+        apr_bucket_file_enable_mmap(e, mmap);
+        apr_bucket_file_set_buf_size(e, buf_size);
+        apr_bucket_file_set_adaptive(e, max_size);
+        while (!APR_BRIGADE_EMPTY(bb)) {
+            e = APR_BRIGADE_FIRST(bb);
+            if (apr_bucket_read(e, &str, &len, APR_BLOCK_READ)
+                    != APR_SUCCESS) {
+                fprintf(stderr, "%s: read failed\n", name);
+                exit(-1);
+            }
+            if (len) {
+                /* touch the data like a writer would */
+                sum += str[0] + str[len - 1];
+            }
+            total += len;
+            reads++;
+            apr_bucket_delete(e);
+        }
+    }
+    elapsed = apr_time_now() - start;
+
+    printf("    %-28s %8" APR_INT64_T_FMT " usec, %8.2f MB/s, "
+           "%8" APR_SIZE_T_FMT " reads [%02x]\n", name, elapsed,
+           (double)total / (elapsed + 1), reads, sum);
+
+    apr_pool_destroy(subpool);
+}
+
+int main(int argc, const char * const *argv)
+{
+    apr_status_t rv;
+    char errmsg[200];
+    apr_getopt_t *opt;
+    char optchar;
+    const char *optarg;
+
+    printf("APR File Bucket Performance Test\n==============\n\n");
+
+    apr_initialize();
+    atexit(apr_terminate);
+
+    if (apr_pool_create(&pool, NULL) != APR_SUCCESS)
+        exit(-1);
+
+    if ((rv = apr_getopt_init(&opt, pool, argc, argv)) != APR_SUCCESS) {
+        fprintf(stderr, "Could not set up to parse options: [%d] %s\n",
+                rv, apr_strerror(rv, errmsg, sizeof errmsg));
+        exit(-1);
+    }
+
+    while ((rv = apr_getopt(opt, "n:", &optchar, &optarg)) == APR_SUCCESS) {
+        if (optchar == 'n') {
+            file_size = (apr_size_t)atol(optarg);
+        }
+    }
+
+    if (rv != APR_SUCCESS && rv != APR_EOF) {
+        fprintf(stderr, "Could not parse options: [%d] %s\n",
+                rv, apr_strerror(rv, errmsg, sizeof errmsg));
+        exit(-1);
+    }
+    if (file_size < 64 * 1024) {
+        fprintf(stderr, "Invalid file size\n");
+        exit(-1);
+    }
+
+    make_file();
+    printf("Serving a %" APR_SIZE_T_FMT " bytes file %d times per test\n\n",
+           file_size, NUM_PASSES);
+
+    serve("mmap", 1, 0, 0);
+    serve("read 8KB", 0, 0, 0);
+    serve("read 64KB", 0, 64 * 1024, 0);
+    serve("read 1MB", 0, 1024 * 1024, 0);
+    serve("adaptive 8KB..256KB", 0, 0, 256 * 1024);
+    serve("adaptive 8KB..1MB", 0, 0, 1024 * 1024);
+
+    apr_file_remove(FNAME, pool);
+
+    return 0;
+}
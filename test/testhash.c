@@ -76,11 +76,25 @@ static void sum_hash(apr_pool_t *p, apr_hash_t *h, int *pcount, int *keySum, int
     *pcount=count;
 }
 
+/* The tests are run for each implementation, given by data */
+static apr_uint32_t hash_flags[] = {
+    0,
+    APR_HASH_OPEN_ADDRESSING,
+    APR_HASH_FAST_HASH,
+    APR_HASH_SIPHASH,
+    APR_HASH_OPEN_ADDRESSING | APR_HASH_FAST_HASH
+};
+
+static apr_hash_t *make_hash(void *data)
+{
+    return apr_hash_make_ex(p, NULL, *(apr_uint32_t *)data);
+}
+
 static void hash_make(abts_case *tc, void *data)
 {
     apr_hash_t *h = NULL;
 
-    h = apr_hash_make(p);
+    h = make_hash(data);
     ABTS_PTR_NOTNULL(tc, h);
 }
 
@@ -89,7 +103,7 @@ static void hash_set(abts_case *tc, void *data)
     apr_hash_t *h = NULL;
     char *result = NULL;
 
-    h = apr_hash_make(p);
+    h = make_hash(data);
     ABTS_PTR_NOTNULL(tc, h);
 
     apr_hash_set(h, "key", APR_HASH_KEY_STRING, "value");
@@ -102,7 +116,7 @@ static void hash_get_or_set(abts_case *tc, void *data)
     apr_hash_t *h = NULL;
     char *result = NULL;
 
-    h = apr_hash_make(p);
+    h = make_hash(data);
     ABTS_PTR_NOTNULL(tc, h);
 
     result = apr_hash_get_or_set(h, "key", APR_HASH_KEY_STRING, "value");
@@ -130,7 +144,7 @@ static void hash_reset(abts_case *tc, void *data)
     apr_hash_t *h = NULL;
     char *result = NULL;
 
-    h = apr_hash_make(p);
+    h = make_hash(data);
     ABTS_PTR_NOTNULL(tc, h);
 
     apr_hash_set(h, "key", APR_HASH_KEY_STRING, "value");
@@ -147,7 +161,7 @@ static void same_value(abts_case *tc, void *data)
     apr_hash_t *h = NULL;
     char *result = NULL;
 
-    h = apr_hash_make(p);
+    h = make_hash(data);
     ABTS_PTR_NOTNULL(tc, h);
 
     apr_hash_set(h, "same1", APR_HASH_KEY_STRING, "same");
@@ -174,7 +188,7 @@ static void same_value_custom(abts_case *tc, void *data)
     apr_hash_t *h = NULL;
     char *result = NULL;
 
-    h = apr_hash_make_custom(p, hash_custom);
+    h = apr_hash_make_ex(p, hash_custom, *(apr_uint32_t *)data);
     ABTS_PTR_NOTNULL(tc, h);
 
     apr_hash_set(h, "same1", 5, "same");
@@ -191,7 +205,7 @@ static void key_space(abts_case *tc, void *data)
     apr_hash_t *h = NULL;
     char *result = NULL;
 
-    h = apr_hash_make(p);
+    h = make_hash(data);
     ABTS_PTR_NOTNULL(tc, h);
 
     apr_hash_set(h, "key with space", APR_HASH_KEY_STRING, "value");
@@ -204,7 +218,7 @@ static void hash_clear(abts_case *tc, void *data)
     apr_hash_t *h;
     int i, *e;
 
-    h = apr_hash_make(p);
+    h = make_hash(data);
     ABTS_PTR_NOTNULL(tc, h);
 
     for (i = 1; i <= 10; i++) {
@@ -226,7 +240,7 @@ static void hash_traverse(abts_case *tc, void *data)
     apr_hash_t *h;
     char StrArray[MAX_DEPTH][MAX_LTH];
 
-    h = apr_hash_make(p);
+    h = make_hash(data);
     ABTS_PTR_NOTNULL(tc, h);
 
     apr_hash_set(h, "OVERWRITE", APR_HASH_KEY_STRING, "should not see this");
@@ -261,7 +275,7 @@ static void summation_test(abts_case *tc, void *data)
     int sumKeys, sumVal, trySumKey, trySumVal;
     int i, j, *val, *key;
 
-    h =apr_hash_make(p);
+    h = make_hash(data);
     ABTS_PTR_NOTNULL(tc, h);
 
     sumKeys = 0;
@@ -291,7 +305,7 @@ static void delete_key(abts_case *tc, void *data)
     apr_hash_t *h = NULL;
     char *result = NULL;
 
-    h = apr_hash_make(p);
+    h = make_hash(data);
     ABTS_PTR_NOTNULL(tc, h);
 
     apr_hash_set(h, "key", APR_HASH_KEY_STRING, "value");
@@ -317,7 +331,7 @@ static void hash_count_0(abts_case *tc, void *data)
     apr_hash_t *h = NULL;
     int count;
 
-    h = apr_hash_make(p);
+    h = make_hash(data);
     ABTS_PTR_NOTNULL(tc, h);
 
     count = apr_hash_count(h);
@@ -329,7 +343,7 @@ static void hash_count_1(abts_case *tc, void *data)
     apr_hash_t *h = NULL;
     int count;
 
-    h = apr_hash_make(p);
+    h = make_hash(data);
     ABTS_PTR_NOTNULL(tc, h);
 
     apr_hash_set(h, "key", APR_HASH_KEY_STRING, "value");
@@ -343,7 +357,7 @@ static void hash_count_5(abts_case *tc, void *data)
     apr_hash_t *h = NULL;
     int count;
 
-    h = apr_hash_make(p);
+    h = make_hash(data);
     ABTS_PTR_NOTNULL(tc, h);
 
     apr_hash_set(h, "key1", APR_HASH_KEY_STRING, "value1");
@@ -364,8 +378,8 @@ static void overlay_empty(abts_case *tc, void *data)
     int count;
     char StrArray[MAX_DEPTH][MAX_LTH];
 
-    base = apr_hash_make(p);
-    overlay = apr_hash_make(p);
+    base = make_hash(data);
+    overlay = make_hash(data);
     ABTS_PTR_NOTNULL(tc, base);
     ABTS_PTR_NOTNULL(tc, overlay);
 
@@ -398,8 +412,8 @@ static void overlay_2unique(abts_case *tc, void *data)
     int count;
     char StrArray[MAX_DEPTH][MAX_LTH];
 
-    base = apr_hash_make(p);
-    overlay = apr_hash_make(p);
+    base = make_hash(data);
+    overlay = make_hash(data);
     ABTS_PTR_NOTNULL(tc, base);
     ABTS_PTR_NOTNULL(tc, overlay);
 
@@ -442,7 +456,7 @@ static void overlay_same(abts_case *tc, void *data)
     int count;
     char StrArray[MAX_DEPTH][MAX_LTH];
 
-    base = apr_hash_make(p);
+    base = make_hash(data);
     ABTS_PTR_NOTNULL(tc, base);
 
     apr_hash_set(base, "base1", APR_HASH_KEY_STRING, "value1");
@@ -473,8 +487,8 @@ static void overlay_fetch(abts_case *tc, void *data)
     apr_hash_t *result = NULL;
     int count;
 
-    base = apr_hash_make(p);
-    overlay = apr_hash_make(p);
+    base = make_hash(data);
+    overlay = make_hash(data);
     ABTS_PTR_NOTNULL(tc, base);
     ABTS_PTR_NOTNULL(tc, overlay);
 
@@ -539,31 +553,207 @@ static void overlay_fetch(abts_case *tc, void *data)
                        apr_hash_get(overlay, "overlay5", APR_HASH_KEY_STRING));
 }
 
+static void *merge_null(apr_pool_t *pool, const void *key, apr_ssize_t klen,
+                        const void *h1_val, const void *h2_val,
+                        const void *data)
+{
+    return NULL;
+}
+
+static void merge_null_value(abts_case *tc, void *data)
+{
+    apr_hash_t *base, *overlay, *result;
+
+    base = make_hash(data);
+    overlay = make_hash(data);
+
+    apr_hash_set(base, "key1", APR_HASH_KEY_STRING, "base1");
+    apr_hash_set(base, "key2", APR_HASH_KEY_STRING, "base2");
+    apr_hash_set(overlay, "key2", APR_HASH_KEY_STRING, "overlay2");
+    apr_hash_set(overlay, "key3", APR_HASH_KEY_STRING, "overlay3");
+
+    /* A NULL merged value is stored, the key is not removed */
+    result = apr_hash_merge(p, overlay, base, merge_null, NULL);
+    ABTS_INT_EQUAL(tc, 3, apr_hash_count(result));
+    ABTS_STR_EQUAL(tc, "base1",
+                       apr_hash_get(result, "key1", APR_HASH_KEY_STRING));
+    ABTS_PTR_EQUAL(tc, NULL,
+                       apr_hash_get(result, "key2", APR_HASH_KEY_STRING));
+    ABTS_STR_EQUAL(tc, "overlay3",
+                       apr_hash_get(result, "key3", APR_HASH_KEY_STRING));
+}
+
+/* Compare against a chained table, with many deletions to exercise the
+ * tombstones and rehashes.
+ */
+static void hash_open_addressing(abts_case *tc, void *data)
+{
+    apr_hash_t *h, *ref, *copy;
+    apr_hash_index_t *hi;
+    apr_uint32_t seed = 12345;
+    int *keys, i, k, count;
+    char *seen;
+
+#define NUM_KEYS 5000
+    keys = apr_palloc(p, NUM_KEYS * sizeof(int));
+    for (i = 0; i < NUM_KEYS; i++) {
+        keys[i] = i;
+    }
+
+    h = apr_hash_make_ex(p, NULL, APR_HASH_OPEN_ADDRESSING);
+    ref = apr_hash_make(p);
+    for (i = 0; i < 20 * NUM_KEYS; i++) {
+        seed = seed * 1103515245 + 12345;
+        k = (seed >> 8) % NUM_KEYS;
+        if (seed & 0x10000) {
+            apr_hash_set(h, &keys[k], sizeof(int), &keys[k]);
+            apr_hash_set(ref, &keys[k], sizeof(int), &keys[k]);
+        }
+        else {
+            apr_hash_set(h, &keys[k], sizeof(int), NULL);
+            apr_hash_set(ref, &keys[k], sizeof(int), NULL);
+        }
+    }
+    ABTS_INT_EQUAL(tc, apr_hash_count(ref), apr_hash_count(h));
+    for (i = 0; i < NUM_KEYS; i++) {
+        if (apr_hash_get(h, &keys[i], sizeof(int))
+                != apr_hash_get(ref, &keys[i], sizeof(int))) {
+            ABTS_FAIL(tc, "lookup mismatch");
+            break;
+        }
+    }
+
+    copy = apr_hash_copy(p, h);
+    ABTS_INT_EQUAL(tc, apr_hash_count(h), apr_hash_count(copy));
+
+    /* delete the current entry while iterating */
+    count = 0;
+    for (hi = apr_hash_first(p, h); hi; hi = apr_hash_next(hi)) {
+        const int *key = apr_hash_this_key(hi);
+        if (*key % 2) {
+            apr_hash_set(h, key, sizeof(int), NULL);
+        }
+        count++;
+    }
+    ABTS_INT_EQUAL(tc, apr_hash_count(copy), count);
+    for (i = 0; i < NUM_KEYS; i++) {
+        void *val = apr_hash_get(h, &keys[i], sizeof(int));
+        if (i % 2 ? val != NULL
+                  : val != apr_hash_get(ref, &keys[i], sizeof(int))) {
+            ABTS_FAIL(tc, "lookup mismatch after deletions");
+            break;
+        }
+    }
+    /* the copy is independent */
+    ABTS_INT_EQUAL(tc, apr_hash_count(ref), apr_hash_count(copy));
+
+    /* add as many entries while iterating, growing the table: the entries
+     * present are still seen once */
+    h = apr_hash_make_ex(p, NULL, APR_HASH_OPEN_ADDRESSING);
+    for (i = 0; i < NUM_KEYS / 2; i++) {
+        apr_hash_set(h, &keys[i], sizeof(int), &keys[i]);
+    }
+    seen = apr_pcalloc(p, NUM_KEYS / 2);
+    count = 0;
+    for (hi = apr_hash_first(p, h); hi; hi = apr_hash_next(hi)) {
+        const int *key = apr_hash_this_key(hi);
+        if (*key < NUM_KEYS / 2) {
+            if (seen[*key]++) {
+                ABTS_FAIL(tc, "entry seen twice");
+                break;
+            }
+            apr_hash_set(h, &keys[NUM_KEYS / 2 + *key], sizeof(int),
+                         &keys[NUM_KEYS / 2 + *key]);
+            count++;
+        }
+    }
+    ABTS_INT_EQUAL(tc, NUM_KEYS / 2, count);
+    ABTS_INT_EQUAL(tc, NUM_KEYS, apr_hash_count(h));
+
+    apr_hash_clear(copy);
+    ABTS_INT_EQUAL(tc, 0, apr_hash_count(copy));
+    ABTS_PTR_EQUAL(tc, NULL, apr_hash_first(p, copy));
+    apr_hash_set(copy, "key", APR_HASH_KEY_STRING, "value");
+    ABTS_STR_EQUAL(tc, "value", apr_hash_get(copy, "key", APR_HASH_KEY_STRING));
+#undef NUM_KEYS
+}
+
+/* Keys of all the lengths handled differently by the hash functions,
+ * differing by a single byte.
+ */
+static void hash_key_lengths(abts_case *tc, void *data)
+{
+    apr_hash_t *h, *copy;
+    char buf[130], *keys[130];
+    int i;
+
+    h = make_hash(data);
+    memset(buf, 'a', sizeof(buf));
+    for (i = 0; i < 130; i++) {
+        keys[i] = apr_pstrndup(p, buf, i);
+        apr_hash_set(h, keys[i], APR_HASH_KEY_STRING, keys[i]);
+        if (i) {
+            char *key = apr_pstrndup(p, buf, i);
+            key[i - 1] = 'b';
+            apr_hash_set(h, key, i, key);
+        }
+    }
+    ABTS_INT_EQUAL(tc, 259, apr_hash_count(h));
+
+    copy = apr_hash_copy(p, h);
+    for (i = 0; i < 130; i++) {
+        ABTS_STR_EQUAL(tc, keys[i], apr_hash_get(h, keys[i], i));
+        ABTS_STR_EQUAL(tc, keys[i], apr_hash_get(copy, keys[i],
+                                                 APR_HASH_KEY_STRING));
+        if (i) {
+            const char *val;
+            buf[i - 1] = 'b';
+            val = apr_hash_get(h, buf, i);
+            ABTS_PTR_NOTNULL(tc, val);
+            if (val) {
+                ABTS_INT_EQUAL(tc, 0, memcmp(val, buf, i));
+            }
+            buf[i - 1] = 'a';
+        }
+    }
+}
+
 abts_suite *testhash(abts_suite *suite)
 {
+    apr_size_t i;
+
     suite = ADD_SUITE(suite)
 
-    abts_run_test(suite, hash_make, NULL);
-    abts_run_test(suite, hash_set, NULL);
-    abts_run_test(suite, hash_get_or_set, NULL);
-    abts_run_test(suite, hash_reset, NULL);
-    abts_run_test(suite, same_value, NULL);
-    abts_run_test(suite, same_value_custom, NULL);
-    abts_run_test(suite, key_space, NULL);
-    abts_run_test(suite, delete_key, NULL);
-
-    abts_run_test(suite, hash_count_0, NULL);
-    abts_run_test(suite, hash_count_1, NULL);
-    abts_run_test(suite, hash_count_5, NULL);
-
-    abts_run_test(suite, hash_clear, NULL);
-    abts_run_test(suite, hash_traverse, NULL);
-    abts_run_test(suite, summation_test, NULL);
-
-    abts_run_test(suite, overlay_empty, NULL);
-    abts_run_test(suite, overlay_2unique, NULL);
-    abts_run_test(suite, overlay_same, NULL);
-    abts_run_test(suite, overlay_fetch, NULL);
+    for (i = 0; i < sizeof(hash_flags) / sizeof(hash_flags[0]); i++) {
+        void *flags = &hash_flags[i];
+
+        abts_run_test(suite, hash_make, flags);
+        abts_run_test(suite, hash_set, flags);
+        abts_run_test(suite, hash_get_or_set, flags);
+        abts_run_test(suite, hash_reset, flags);
+        abts_run_test(suite, same_value, flags);
+        abts_run_test(suite, same_value_custom, flags);
+        abts_run_test(suite, key_space, flags);
+        abts_run_test(suite, delete_key, flags);
+
+        abts_run_test(suite, hash_count_0, flags);
+        abts_run_test(suite, hash_count_1, flags);
+        abts_run_test(suite, hash_count_5, flags);
+
+        abts_run_test(suite, hash_clear, flags);
+        abts_run_test(suite, hash_traverse, flags);
+        abts_run_test(suite, summation_test, flags);
+
+        abts_run_test(suite, overlay_empty, flags);
+        abts_run_test(suite, overlay_2unique, flags);
+        abts_run_test(suite, overlay_same, flags);
+        abts_run_test(suite, overlay_fetch, flags);
+        abts_run_test(suite, merge_null_value, flags);
+
+        abts_run_test(suite, hash_key_lengths, flags);
+    }
+
+    abts_run_test(suite, hash_open_addressing, NULL);
 
     return suite;
 }
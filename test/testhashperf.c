@@ -0,0 +1,226 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr_hash.h"
+#include "apr_siphash.h"
+#include "apr_pools.h"
+#include "apr_strings.h"
+#include "apr_errno.h"
+#include "apr_general.h"
+#include "apr_getopt.h"
+#include "apr_time.h"
+#include <stdio.h>
+#include <stdlib.h>
+#if APR_HAVE_STRING_H
+#include <string.h>
+#endif
+
+#define DEFAULT_NUM_KEYS  1000
+#define DEFAULT_NUM_LOOPS 1000
+
+static long num_keys = DEFAULT_NUM_KEYS;
+static long num_loops = DEFAULT_NUM_LOOPS;
+
+static apr_pool_t *pool;
+
+static const char *header_names[] = {
+    "Host", "User-Agent", "Accept", "Accept-Language", "Accept-Encoding",
+    "Connection", "Cookie", "Cache-Control", "Content-Type",
+    "Content-Length", "If-Modified-Since", "If-None-Match", "Referer",
+    "X-Forwarded-For", "X-Forwarded-Proto", "Upgrade-Insecure-Requests"
+};
+#define NUM_HEADER_NAMES (sizeof(header_names) / sizeof(header_names[0]))
+
+/* Short keys, like the names of the headers of a request */
+static const char **make_header_keys(void)
+{
+    const char **keys = apr_palloc(pool, num_keys * sizeof(*keys));
+    long i;
+
+    for (i = 0; i < num_keys; i++) {
+        keys[i] = apr_psprintf(pool, "%s-%ld",
+                               header_names[i % NUM_HEADER_NAMES], i);
+    }
+    return keys;
+}
+
+/* Long keys, like the URLs of a cache */
+static const char **make_url_keys(void)
+{
+    const char **keys = apr_palloc(pool, num_keys * sizeof(*keys));
+    long i;
+
+    for (i = 0; i < num_keys; i++) {
+        keys[i] = apr_psprintf(pool, "https://www.example.com/static/assets/"
+                               "images/gallery/%ld/thumbnail.jpg?width=%ld"
+                               "&height=%ld&format=webp", i, i % 1024,
+                               i % 768);
+    }
+    return keys;
+}
+
+static void test_hash(const char *name, const char **keys,
+                      apr_hashfunc_t hash_func, apr_uint32_t flags)
+{
+    apr_pool_t *p;
+    apr_hash_t *h = NULL;
+    apr_time_t time_start, time_set, time_stop;
+    long i, j, found = 0;
+
+    apr_pool_create(&p, pool);
+    printf("    %-10s %-8s", name,
+           flags & APR_HASH_OPEN_ADDRESSING ? "open" : "chained");
+
+    time_start = apr_time_now();
+    for (j = 0; j < num_loops / 10 + 1; j++) {
+        apr_pool_clear(p);
+        h = apr_hash_make_ex(p, hash_func, flags);
+        for (i = 0; i < num_keys; i++) {
+            apr_hash_set(h, keys[i], APR_HASH_KEY_STRING, keys[i]);
+        }
+    }
+    time_set = apr_time_now();
+    for (j = 0; j < num_loops; j++) {
+        for (i = 0; i < num_keys; i++) {
+            found += apr_hash_get(h, keys[i], APR_HASH_KEY_STRING) != NULL;
+        }
+    }
+    time_stop = apr_time_now();
+
+    printf("%12.0f sets/sec, %12.0f gets/sec%s\n",
+           (double)num_keys * (num_loops / 10 + 1) * APR_USEC_PER_SEC
+           / (double)(time_set - time_start + 1),
+           (double)num_keys * num_loops * APR_USEC_PER_SEC
+           / (double)(time_stop - time_set + 1),
+           found == num_keys * num_loops ? "" : " (missing keys!)");
+
+    apr_pool_destroy(p);
+}
+
+static void test_keys(const char **keys)
+{
+    static const struct {
+        const char *name;
+        apr_hashfunc_t hash_func;
+        apr_uint32_t flags;
+    } funcs[] = {
+        { "default", NULL, 0 },
+        { "fast", NULL, APR_HASH_FAST_HASH },
+        { "siphash", NULL, APR_HASH_SIPHASH },
+        { "siphash13", apr_siphash13_hashfunc, 0 }
+    };
+    int i;
+
+    for (i = 0; i < sizeof(funcs) / sizeof(funcs[0]); i++) {
+        test_hash(funcs[i].name, keys, funcs[i].hash_func, funcs[i].flags);
+        test_hash(funcs[i].name, keys, funcs[i].hash_func,
+                  funcs[i].flags | APR_HASH_OPEN_ADDRESSING);
+    }
+}
+
+static void test_siphash_batch(const char **keys)
+{
+    static const unsigned char key[APR_SIPHASH_KSIZE] = "0123456789abcdef";
+    apr_uint64_t *out = apr_palloc(pool, num_keys * sizeof(*out));
+    apr_size_t *lens = apr_palloc(pool, num_keys * sizeof(*lens));
+    apr_time_t time_start, time_one, time_stop;
+    apr_uint64_t sum = 0;
+    long i, j;
+
+    for (i = 0; i < num_keys; i++) {
+        lens[i] = strlen(keys[i]);
+    }
+
+    time_start = apr_time_now();
+    for (j = 0; j < num_loops; j++) {
+        for (i = 0; i < num_keys; i++) {
+            out[i] = apr_siphash13(keys[i], lens[i], key);
+        }
+        sum += out[j % num_keys];
+    }
+    time_one = apr_time_now();
+    for (j = 0; j < num_loops; j++) {
+        apr_siphash13_batch(out, (const void * const *)keys, lens,
+                            num_keys, key);
+        sum -= out[j % num_keys];
+    }
+    time_stop = apr_time_now();
+
+    printf("    siphash13 %12.0f hashes/sec one by one, "
+           "%12.0f hashes/sec by batch%s\n",
+           (double)num_keys * num_loops * APR_USEC_PER_SEC
+           / (double)(time_one - time_start + 1),
+           (double)num_keys * num_loops * APR_USEC_PER_SEC
+           / (double)(time_stop - time_one + 1),
+           sum ? " (mismatch!)" : "");
+}
+
+int main(int argc, const char * const *argv)
+{
+    apr_status_t rv;
+    char errmsg[200];
+    apr_getopt_t *opt;
+    char optchar;
+    const char *optarg;
+    const char **keys;
+
+    printf("APR Hash Performance Test\n==============\n\n");
+
+    apr_initialize();
+    atexit(apr_terminate);
+
+    if (apr_pool_create(&pool, NULL) != APR_SUCCESS)
+        exit(-1);
+
+    if ((rv = apr_getopt_init(&opt, pool, argc, argv)) != APR_SUCCESS) {
+        fprintf(stderr, "Could not set up to parse options: [%d] %s\n",
+                rv, apr_strerror(rv, errmsg, sizeof errmsg));
+        exit(-1);
+    }
+
+    while ((rv = apr_getopt(opt, "k:l:", &optchar, &optarg)) == APR_SUCCESS) {
+        if (optchar == 'k') {
+            num_keys = atol(optarg);
+        }
+        else if (optchar == 'l') {
+            num_loops = atol(optarg);
+        }
+    }
+
+    if (rv != APR_SUCCESS && rv != APR_EOF) {
+        fprintf(stderr, "Could not parse options: [%d] %s\n",
+                rv, apr_strerror(rv, errmsg, sizeof errmsg));
+        exit(-1);
+    }
+    if (num_keys <= 0 || num_loops <= 0) {
+        fprintf(stderr, "Invalid number of keys or loops\n");
+        exit(-1);
+    }
+
+    printf("Header-like keys (%ld keys, %ld lookups each)\n",
+           num_keys, num_loops);
+    keys = make_header_keys();
+    test_keys(keys);
+    test_siphash_batch(keys);
+
+    printf("\nURL keys (%ld keys, %ld lookups each)\n",
+           num_keys, num_loops);
+    keys = make_url_keys();
+    test_keys(keys);
+    test_siphash_batch(keys);
+
+    return 0;
+}
@@ -0,0 +1,279 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr_thread_proc.h"
+#include "apr_thread_mutex.h"
+#include "apr_allocator.h"
+#include "apr_pools.h"
+#include "apr_errno.h"
+#include "apr_general.h"
+#include "apr_getopt.h"
+#include "apr_time.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#if !APR_HAS_THREADS
+int main(void)
+{
+    printf("This program won't work on this platform because there is no "
+           "support for threads.\n");
+    return 0;
+}
+#else /* !APR_HAS_THREADS */
+
+#define DEFAULT_MAX_COUNTER 100000
+#define DEFAULT_CACHE_SIZE  (256 * 1024)
+#define MAX_THREADS 8
+#define MAX_CLEANUPS 100000
+
+static long max_counter = DEFAULT_MAX_COUNTER;
+static apr_size_t cache_size = DEFAULT_CACHE_SIZE;
+
+static apr_pool_t *pool;
+static apr_thread_mutex_t *start_lock;
+
+/* What a worker thread typically does: create a (request) subpool off a
+ * shared (connection/child) pool, fill a few nodes and destroy it.
+ */
+static void * APR_THREAD_FUNC pool_func(apr_thread_t *thd, void *data)
+{
+    apr_pool_t *parent = data, *p;
+    long i;
+
+    apr_thread_mutex_lock(start_lock);
+    apr_thread_mutex_unlock(start_lock);
+
+    for (i = 0; i < max_counter; i++) {
+        if (apr_pool_create(&p, parent) != APR_SUCCESS) {
+            apr_thread_exit(thd, APR_ENOMEM);
+        }
+        apr_palloc(p, 1024);
+        apr_palloc(p, 8192);
+        apr_palloc(p, 16384);
+        apr_pool_destroy(p);
+    }
+
+    apr_thread_exit(thd, APR_SUCCESS);
+    return NULL;
+}
+
+static apr_status_t test_pools(int num_threads, int cached)
+{
+    apr_thread_t *t[MAX_THREADS];
+    apr_status_t s[MAX_THREADS];
+    apr_allocator_t *allocator;
+    apr_thread_mutex_t *mutex;
+    apr_pool_t *parent;
+    apr_time_t time_start, time_stop;
+    apr_status_t rv;
+    int i;
+
+    if ((rv = apr_allocator_create(&allocator)) != APR_SUCCESS) {
+        return rv;
+    }
+    if ((rv = apr_pool_create_ex(&parent, pool, NULL,
+                                 allocator)) != APR_SUCCESS) {
+        apr_allocator_destroy(allocator);
+        return rv;
+    }
+    apr_allocator_owner_set(allocator, parent);
+    if ((rv = apr_thread_mutex_create(&mutex, APR_THREAD_MUTEX_DEFAULT,
+                                      parent)) != APR_SUCCESS) {
+        apr_pool_destroy(parent);
+        return rv;
+    }
+    apr_allocator_mutex_set(allocator, mutex);
+
+    printf("    %d threads, %-16s", num_threads,
+           cached ? "thread cache" : "no cache");
+    if (cached) {
+        rv = apr_allocator_thread_cache_set(allocator, cache_size);
+        if (rv != APR_SUCCESS) {
+            apr_pool_destroy(parent);
+            return rv;
+        }
+    }
+
+    apr_thread_mutex_lock(start_lock);
+    for (i = 0; i < num_threads; ++i) {
+        s[i] = apr_thread_create(&t[i], NULL, pool_func, parent, pool);
+        if (s[i] != APR_SUCCESS) {
+            apr_thread_mutex_unlock(start_lock);
+            printf("Failed!\n");
+            return s[i];
+        }
+    }
+
+    time_start = apr_time_now();
+    apr_thread_mutex_unlock(start_lock);
+
+    for (i = 0; i < num_threads; ++i) {
+        apr_thread_join(&s[i], t[i]);
+    }
+
+    time_stop = apr_time_now();
+    printf("%10" APR_INT64_T_FMT " usec, %10.0f pools/sec\n",
+           (time_stop - time_start),
+           (double)max_counter * num_threads * APR_USEC_PER_SEC
+           / (double)(time_stop - time_start + 1));
+
+    apr_pool_destroy(parent);
+
+    for (i = 0; i < num_threads; ++i) {
+        if (s[i] != APR_SUCCESS) {
+            return s[i];
+        }
+    }
+
+    return APR_SUCCESS;
+}
+
+static apr_status_t noop_cleanup(void *data)
+{
+    return APR_SUCCESS;
+}
+
+/* Register num cleanups and kill them, oldest first (which is the worst
+ * case for apr_pool_cleanup_kill() since the newest are searched first).
+ */
+static apr_status_t test_cleanups(long num, int by_handle)
+{
+    apr_pool_t *p;
+    apr_pool_cleanup_t **handles;
+    apr_time_t time_start, time_stop;
+    apr_status_t rv;
+    long i;
+
+    if ((rv = apr_pool_create(&p, pool)) != APR_SUCCESS) {
+        return rv;
+    }
+    handles = apr_palloc(p, num * sizeof(*handles));
+    printf("    %7ld cleanups, %-16s", num, by_handle ? "by handle" : "by data");
+
+    time_start = apr_time_now();
+    if (by_handle) {
+        for (i = 0; i < num; i++) {
+            handles[i] = apr_pool_cleanup_register_ex(p, &handles[i],
+                                                      noop_cleanup,
+                                                      apr_pool_cleanup_null);
+        }
+        for (i = 0; i < num; i++) {
+            apr_pool_cleanup_kill_ex(p, handles[i]);
+        }
+    }
+    else {
+        for (i = 0; i < num; i++) {
+            apr_pool_cleanup_register(p, &handles[i], noop_cleanup,
+                                      apr_pool_cleanup_null);
+        }
+        for (i = 0; i < num; i++) {
+            apr_pool_cleanup_kill(p, &handles[i], noop_cleanup);
+        }
+    }
+    time_stop = apr_time_now();
+
+    printf("%10" APR_INT64_T_FMT " usec\n", (time_stop - time_start));
+
+    apr_pool_destroy(p);
+    return APR_SUCCESS;
+}
+
+int main(int argc, const char * const *argv)
+{
+    apr_status_t rv;
+    char errmsg[200];
+    apr_getopt_t *opt;
+    char optchar;
+    const char *optarg;
+    long num;
+    int i;
+
+    printf("APR Pool Performance Test\n==============\n\n");
+
+    apr_initialize();
+    atexit(apr_terminate);
+
+    if (apr_pool_create(&pool, NULL) != APR_SUCCESS)
+        exit(-1);
+
+    if ((rv = apr_getopt_init(&opt, pool, argc, argv)) != APR_SUCCESS) {
+        fprintf(stderr, "Could not set up to parse options: [%d] %s\n",
+                rv, apr_strerror(rv, errmsg, sizeof errmsg));
+        exit(-1);
+    }
+
+    while ((rv = apr_getopt(opt, "c:s:", &optchar, &optarg)) == APR_SUCCESS) {
+        if (optchar == 'c') {
+            max_counter = atol(optarg);
+        }
+        else if (optchar == 's') {
+            cache_size = (apr_size_t)atol(optarg);
+        }
+    }
+
+    if (rv != APR_SUCCESS && rv != APR_EOF) {
+        fprintf(stderr, "Could not parse options: [%d] %s\n",
+                rv, apr_strerror(rv, errmsg, sizeof errmsg));
+        exit(-1);
+    }
+
+    if ((rv = apr_thread_mutex_create(&start_lock, APR_THREAD_MUTEX_DEFAULT,
+                                      pool)) != APR_SUCCESS) {
+        fprintf(stderr, "Could not create mutex: [%d] %s\n",
+                rv, apr_strerror(rv, errmsg, sizeof errmsg));
+        exit(-1);
+    }
+
+    printf("Contended subpool create/destroy (%ld per thread)\n",
+           max_counter);
+    for (i = 1; i <= MAX_THREADS; i *= 2) {
+        if ((rv = test_pools(i, 0)) != APR_SUCCESS) {
+            fprintf(stderr, "pools test failed : [%d] %s\n",
+                    rv, apr_strerror(rv, errmsg, sizeof errmsg));
+            exit(-2);
+        }
+        rv = test_pools(i, 1);
+        if (rv == APR_ENOTIMPL) {
+            printf("not implemented\n");
+        }
+        else if (rv != APR_SUCCESS) {
+            fprintf(stderr, "pools test (thread cache) failed : [%d] %s\n",
+                    rv, apr_strerror(rv, errmsg, sizeof errmsg));
+            exit(-3);
+        }
+    }
+
+    printf("\nCleanup register/kill\n");
+    for (num = 1000; num <= MAX_CLEANUPS; num *= 10) {
+        rv = APR_SUCCESS;
+        /* quadratic, too slow beyond */
+        if (num <= MAX_CLEANUPS / 10) {
+            rv = test_cleanups(num, 0);
+        }
+        if (rv == APR_SUCCESS) {
+            rv = test_cleanups(num, 1);
+        }
+        if (rv != APR_SUCCESS) {
+            fprintf(stderr, "cleanups test failed : [%d] %s\n",
+                    rv, apr_strerror(rv, errmsg, sizeof errmsg));
+            exit(-4);
+        }
+    }
+
+    return 0;
+}
+
+#endif /* !APR_HAS_THREADS */
@@ -17,6 +17,9 @@
 
 #include "apr_general.h"
 #include "apr_pools.h"
+#include "apr_allocator.h"
+#include "apr_strings.h"
+#include "apr_thread_proc.h"
 #include "apr_errno.h"
 #include "apr_file_io.h"
 #include <string.h>
@@ -176,6 +179,346 @@ static void test_tags(abts_case *tc, void *data)
     ABTS_STR_EQUAL(tc, "main pool", apr_pool_get_tag(pmain));
 }
 
+static void test_pfree(abts_case *tc, void *data)
+{
+    apr_pool_t *p;
+    apr_status_t rv;
+    char *a, *b, *c;
+    int i;
+
+    rv = apr_pool_create_ex2(&p, pmain, NULL, NULL, APR_POOL_FSLAB);
+    APR_ASSERT_SUCCESS(tc, "create slab pool", rv);
+
+    a = apr_palloc(p, 40);
+    b = apr_palloc(p, 100);
+    ABTS_PTR_NOTNULL(tc, a);
+    ABTS_PTR_NOTNULL(tc, b);
+    apr_pfree(p, a, 40);
+    apr_pfree(p, b, 100);
+
+    /* same size classes (8 bytes steps) reuse the released blocks */
+#if !APR_POOL_DEBUG
+    c = apr_palloc(p, 35);
+    ABTS_PTR_EQUAL(tc, a, c);
+    c = apr_palloc(p, 97);
+    ABTS_PTR_EQUAL(tc, b, c);
+#endif
+
+    /* big blocks are not recycled, but can be "released" anyway */
+    c = apr_palloc(p, 4096);
+    apr_pfree(p, c, 4096);
+
+    for (i = 0; i < 10000; i++) {
+        c = apr_pstrdup(p, "a short lived string");
+        ABTS_STR_EQUAL(tc, "a short lived string", c);
+        apr_pfree(p, c, strlen(c) + 1);
+    }
+
+    /* still usable after clear */
+    apr_pool_clear(p);
+    a = apr_pcalloc(p, 64);
+    ABTS_PTR_NOTNULL(tc, a);
+    apr_pfree(p, a, 64);
+
+    apr_pool_destroy(p);
+
+    /* no-op for regular pools */
+    a = apr_palloc(pmain, 64);
+    apr_pfree(pmain, a, 64);
+}
+
+static apr_status_t count_cleanup(void *data)
+{
+    (*(int *)data)++;
+    return APR_SUCCESS;
+}
+
+#define NUM_CLEANUPS 100000
+
+static void test_cleanup_handles(abts_case *tc, void *data)
+{
+    apr_pool_t *p;
+    apr_pool_cleanup_t **handles;
+    apr_status_t rv;
+    int i, count = 0;
+
+    rv = apr_pool_create(&p, pmain);
+    APR_ASSERT_SUCCESS(tc, "create pool", rv);
+    handles = apr_palloc(pmain, NUM_CLEANUPS * sizeof(*handles));
+
+    for (i = 0; i < NUM_CLEANUPS; i++) {
+        handles[i] = apr_pool_cleanup_register_ex(p, &count, count_cleanup,
+                                                  apr_pool_cleanup_null);
+        ABTS_PTR_NOTNULL(tc, handles[i]);
+    }
+
+    /* kill the oldest half first, the worst case when searching by data */
+    for (i = 0; i < NUM_CLEANUPS / 2; i++) {
+        apr_pool_cleanup_kill_ex(p, handles[i]);
+    }
+    ABTS_INT_EQUAL(tc, 0, count);
+
+    rv = apr_pool_cleanup_run_ex(p, handles[NUM_CLEANUPS - 1]);
+    APR_ASSERT_SUCCESS(tc, "run cleanup", rv);
+    ABTS_INT_EQUAL(tc, 1, count);
+
+    /* no-op for a cleanup already killed */
+    apr_pool_cleanup_kill_ex(p, handles[NUM_CLEANUPS - 1]);
+    rv = apr_pool_cleanup_run_ex(p, handles[NUM_CLEANUPS - 1]);
+    APR_ASSERT_SUCCESS(tc, "run cleanup again", rv);
+    ABTS_INT_EQUAL(tc, 1, count);
+
+    /* mixed with the search by data */
+    apr_pool_cleanup_kill(p, &count, count_cleanup);
+
+    apr_pool_destroy(p);
+    ABTS_INT_EQUAL(tc, NUM_CLEANUPS / 2 - 1, count);
+}
+
+static int stats_walker(apr_pool_t *pool, int depth,
+                        const apr_pool_stats_t *stats, void *baton)
+{
+    int *count = baton;
+
+    count[depth]++;
+    return 0;
+}
+
+static void test_stats(abts_case *tc, void *data)
+{
+    apr_allocator_t *allocator;
+    apr_allocator_stats_t astats;
+    apr_pool_stats_t pstats;
+    apr_pool_t *p, *sub, *subsub;
+    apr_size_t size, i, nfree;
+    int count[3] = { 0, 0, 0 };
+    apr_status_t rv;
+
+    rv = apr_allocator_create(&allocator);
+    APR_ASSERT_SUCCESS(tc, "create allocator", rv);
+    rv = apr_pool_create_ex(&p, NULL, NULL, allocator);
+    APR_ASSERT_SUCCESS(tc, "create pool", rv);
+    apr_allocator_owner_set(allocator, p);
+
+    apr_pool_stats_get(p, &pstats);
+    ABTS_INT_EQUAL(tc, 0, (int)pstats.children);
+    /* debug pools don't use the allocator, nor nodes for themselves */
+#if !APR_POOL_DEBUG
+    ABTS_INT_EQUAL(tc, 1, (int)pstats.nodes);
+    ABTS_ASSERT(tc, "pool fits", pstats.used > 0 && pstats.used <= pstats.size);
+#endif
+
+    rv = apr_pool_create(&sub, p);
+    APR_ASSERT_SUCCESS(tc, "create subpool", rv);
+    for (size = 64; size < 64 * 1024; size *= 2) {
+        apr_palloc(sub, size);
+    }
+    apr_pool_stats_get(sub, &pstats);
+    ABTS_ASSERT(tc, "subpool grew", pstats.nodes > 1);
+    ABTS_ASSERT(tc, "subpool used", pstats.used >= 64 * 1024 - 64);
+    ABTS_ASSERT(tc, "subpool peak", pstats.peak == pstats.size);
+    size = pstats.size;
+
+#if !APR_POOL_DEBUG
+    apr_allocator_stats_get(allocator, &astats);
+    ABTS_ASSERT(tc, "allocator total", astats.total >= size);
+    ABTS_ASSERT(tc, "allocator peak", astats.peak >= astats.total);
+    ABTS_ASSERT(tc, "allocator in use",
+                astats.in_use + astats.free + astats.cached == astats.total);
+#endif
+
+    rv = apr_pool_create(&subsub, sub);
+    APR_ASSERT_SUCCESS(tc, "create subsubpool", rv);
+    apr_pool_stats_walk(p, stats_walker, count);
+    ABTS_INT_EQUAL(tc, 1, count[0]);
+    ABTS_INT_EQUAL(tc, 1, count[1]);
+    ABTS_INT_EQUAL(tc, 1, count[2]);
+
+    apr_pool_clear(sub);
+    apr_pool_stats_get(sub, &pstats);
+    ABTS_INT_EQUAL(tc, 0, (int)pstats.children);
+#if !APR_POOL_DEBUG
+    ABTS_INT_EQUAL(tc, 1, (int)pstats.nodes);
+    ABTS_ASSERT(tc, "subpool peak kept", pstats.peak == size);
+    ABTS_ASSERT(tc, "subpool shrunk", pstats.size < size);
+
+    /* the nodes given back are now free in the allocator */
+    apr_allocator_stats_get(allocator, &astats);
+    for (nfree = 0, i = 0; i < APR_ALLOCATOR_STATS_SLOTS; i++) {
+        nfree += astats.free_nodes[i];
+    }
+    ABTS_ASSERT(tc, "free nodes", nfree > 0 && astats.free > 0);
+    ABTS_ASSERT(tc, "allocator in use",
+                astats.in_use + astats.free + astats.cached == astats.total);
+#endif
+
+    apr_pool_destroy(p);
+}
+
+static void test_arenas(abts_case *tc, void *data)
+{
+    apr_allocator_t *allocator;
+    apr_pool_t *p, *sub;
+    apr_size_t size;
+    apr_status_t rv;
+    char *mem;
+    int i;
+
+    rv = apr_allocator_create(&allocator);
+    APR_ASSERT_SUCCESS(tc, "create allocator", rv);
+
+    rv = apr_allocator_hugepages_set(allocator, 1);
+    if (rv == APR_ENOTIMPL) {
+        ABTS_NOT_IMPL(tc, "allocator huge pages");
+        apr_allocator_destroy(allocator);
+        return;
+    }
+    APR_ASSERT_SUCCESS(tc, "enable huge pages", rv);
+    rv = apr_allocator_numa_node_set(allocator, 100000);
+    ABTS_INT_EQUAL(tc, APR_EINVAL, rv);
+    rv = apr_allocator_numa_node_set(allocator, 0);
+    ABTS_ASSERT(tc, "bind to NUMA node 0",
+                rv == APR_SUCCESS || rv == APR_ENOTIMPL);
+
+    rv = apr_pool_create_ex(&p, NULL, NULL, allocator);
+    APR_ASSERT_SUCCESS(tc, "create pool", rv);
+    apr_allocator_owner_set(allocator, p);
+
+#if !APR_POOL_DEBUG
+    /* debug pools don't allocate from the allocator */
+    rv = apr_allocator_hugepages_set(allocator, 0);
+    ABTS_INT_EQUAL(tc, APR_EBUSY, rv);
+#endif
+
+    for (i = 0; i < 100; i++) {
+        rv = apr_pool_create(&sub, p);
+        APR_ASSERT_SUCCESS(tc, "create subpool", rv);
+        for (size = 64; size < 256 * 1024; size *= 2) {
+            memset(apr_palloc(sub, size), 'x', size);
+        }
+        apr_pool_destroy(sub);
+    }
+
+    /* bigger than an arena */
+    size = 3 * 1024 * 1024;
+    mem = apr_palloc(p, size);
+    ABTS_PTR_NOTNULL(tc, mem);
+    memset(mem, 'x', size);
+
+    apr_pool_destroy(p);
+}
+
+#if APR_HAS_THREADS
+#define CACHE_THREADS 4
+#define CACHE_LOOPS   1000
+
+static apr_status_t churn_pools(apr_pool_t *parent)
+{
+    apr_pool_t *p;
+    apr_size_t size;
+    int i;
+
+    for (i = 0; i < CACHE_LOOPS; i++) {
+        if (apr_pool_create(&p, parent) != APR_SUCCESS) {
+            return APR_ENOMEM;
+        }
+        /* grow over several nodes of different sizes */
+        for (size = 64; size < 64 * 1024; size *= 2) {
+            memset(apr_palloc(p, size), 'x', size);
+        }
+        apr_pool_destroy(p);
+    }
+    return APR_SUCCESS;
+}
+
+static void * APR_THREAD_FUNC thread_cache_func(apr_thread_t *thd, void *data)
+{
+    apr_thread_exit(thd, churn_pools(data));
+    return NULL;
+}
+
+/* Allocators created and destroyed by a long-lived thread, whose caches
+ * outlive them */
+static void * APR_THREAD_FUNC thread_cache_allocators_func(apr_thread_t *thd,
+                                                          void *data)
+{
+    apr_allocator_t *allocator;
+    apr_pool_t *p;
+    apr_size_t size;
+    apr_status_t rv = APR_SUCCESS;
+    int i;
+
+    for (i = 0; i < CACHE_LOOPS && rv == APR_SUCCESS; i++) {
+        if ((rv = apr_allocator_create(&allocator)) != APR_SUCCESS) {
+            break;
+        }
+        apr_allocator_thread_cache_set(allocator, 256 * 1024);
+        if ((rv = apr_pool_create_ex(&p, NULL, NULL,
+                                     allocator)) != APR_SUCCESS) {
+            apr_allocator_destroy(allocator);
+            break;
+        }
+        apr_allocator_owner_set(allocator, p);
+        for (size = 64; size < 64 * 1024; size *= 2) {
+            memset(apr_palloc(p, size), 'x', size);
+        }
+        apr_pool_destroy(p);
+    }
+    apr_thread_exit(thd, rv);
+    return NULL;
+}
+
+static void test_thread_cache(abts_case *tc, void *data)
+{
+    apr_allocator_t *allocator;
+    apr_thread_mutex_t *mutex;
+    apr_pool_t *p;
+    apr_thread_t *t[CACHE_THREADS];
+    apr_status_t rv, retval;
+    int i;
+
+    rv = apr_allocator_create(&allocator);
+    APR_ASSERT_SUCCESS(tc, "create allocator", rv);
+    rv = apr_pool_create_ex(&p, NULL, NULL, allocator);
+    APR_ASSERT_SUCCESS(tc, "create pool", rv);
+    apr_allocator_owner_set(allocator, p);
+    rv = apr_thread_mutex_create(&mutex, APR_THREAD_MUTEX_DEFAULT, p);
+    APR_ASSERT_SUCCESS(tc, "create mutex", rv);
+    apr_allocator_mutex_set(allocator, mutex);
+
+    rv = apr_allocator_thread_cache_set(allocator, 256 * 1024);
+    if (rv == APR_ENOTIMPL) {
+        ABTS_NOT_IMPL(tc, "allocator thread cache");
+        apr_pool_destroy(p);
+        return;
+    }
+    APR_ASSERT_SUCCESS(tc, "enable thread cache", rv);
+
+    for (i = 0; i < CACHE_THREADS; i++) {
+        rv = apr_thread_create(&t[i], NULL, thread_cache_func, p, p);
+        APR_ASSERT_SUCCESS(tc, "create thread", rv);
+    }
+    for (i = 0; i < CACHE_THREADS; i++) {
+        rv = apr_thread_join(&retval, t[i]);
+        APR_ASSERT_SUCCESS(tc, "join thread", rv);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, retval);
+    }
+
+    /* Not an APR thread, hence no cache, but must still work */
+    rv = churn_pools(p);
+    APR_ASSERT_SUCCESS(tc, "churn pools without cache", rv);
+
+    rv = apr_thread_create(&t[0], NULL, thread_cache_allocators_func,
+                           NULL, p);
+    APR_ASSERT_SUCCESS(tc, "create thread", rv);
+    rv = apr_thread_join(&retval, t[0]);
+    APR_ASSERT_SUCCESS(tc, "join thread", rv);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, retval);
+
+    apr_pool_destroy(p);
+}
+#endif /* APR_HAS_THREADS */
+
 abts_suite *testpool(abts_suite *suite)
 {
     suite = ADD_SUITE(suite)
@@ -188,6 +531,13 @@ abts_suite *testpool(abts_suite *suite)
     abts_run_test(suite, calloc_bytes, NULL);
     abts_run_test(suite, test_cleanups, NULL);
     abts_run_test(suite, test_tags, NULL);
+    abts_run_test(suite, test_pfree, NULL);
+    abts_run_test(suite, test_cleanup_handles, NULL);
+    abts_run_test(suite, test_stats, NULL);
+    abts_run_test(suite, test_arenas, NULL);
+#if APR_HAS_THREADS
+    abts_run_test(suite, test_thread_cache, NULL);
+#endif
 
     return suite;
 }
@@ -0,0 +1,175 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apu.h"
+#include "apr_crypto.h"
+#include "apr_pools.h"
+#include "apr_errno.h"
+#include "apr_general.h"
+#include "apr_getopt.h"
+#include "apr_thread_proc.h"
+#include "apr_time.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#if APU_HAVE_CRYPTO && APU_HAVE_CRYPTO_PRNG && APR_HAS_THREADS
+
+#define DEFAULT_NUM_OPS 1000000
+#define MAX_THREADS 16
+
+static long num_ops = DEFAULT_NUM_OPS;
+
+static apr_pool_t *pool;
+
+typedef apr_status_t (*random_fn_t)(void *buf, apr_size_t len);
+
+typedef struct {
+    random_fn_t fn;
+    apr_size_t len;
+    long ops;
+    apr_status_t rv;
+} worker_t;
+
+static void *APR_THREAD_FUNC worker(apr_thread_t *thd, void *data)
+{
+    worker_t *w = data;
+    unsigned char buf[256];
+    long i;
+
+    for (i = 0; i < w->ops; i++) {
+        w->rv = w->fn(buf, w->len);
+        if (w->rv != APR_SUCCESS) {
+            break;
+        }
+    }
+    apr_thread_exit(thd, APR_SUCCESS);
+    return NULL;
+}
+
+static void run(const char *name, random_fn_t fn, apr_size_t len,
+                int nthreads)
+{
+    apr_thread_t *threads[MAX_THREADS];
+    worker_t workers[MAX_THREADS];
+    apr_status_t rv, ret;
+    apr_time_t start, elapsed;
+    int i;
+
+    start = apr_time_now();
+    for (i = 0; i < nthreads; i++) {
+        workers[i].fn = fn;
+        workers[i].len = len;
+        workers[i].ops = num_ops / nthreads;
+        workers[i].rv = APR_SUCCESS;
+        rv = apr_thread_create(&threads[i], NULL, worker, &workers[i], pool);
+        if (rv != APR_SUCCESS) {
+            fprintf(stderr, "apr_thread_create failed\n");
+            exit(-1);
+        }
+    }
+    for (i = 0; i < nthreads; i++) {
+        apr_thread_join(&ret, threads[i]);
+        if (workers[i].rv != APR_SUCCESS) {
+            fprintf(stderr, "%s failed\n", name);
+            exit(-1);
+        }
+    }
+    elapsed = apr_time_now() - start;
+
+    printf("    %-32s %2d threads %8" APR_INT64_T_FMT " usec, "
+           "%10.0f ops/s\n", name, nthreads, elapsed,
+           (double)(num_ops / nthreads) * nthreads * APR_USEC_PER_SEC
+           / (elapsed + 1));
+}
+
+static void test_size(apr_size_t len)
+{
+    int n;
+
+    printf("  %" APR_SIZE_T_FMT " bytes requests\n", len);
+    for (n = 1; n <= 8; n *= 2) {
+        run("apr_crypto_random_bytes", apr_crypto_random_bytes, len, n);
+    }
+    for (n = 1; n <= 8; n *= 2) {
+        run("apr_crypto_random_thread_bytes",
+            apr_crypto_random_thread_bytes, len, n);
+    }
+}
+
+int main(int argc, const char * const *argv)
+{
+    apr_status_t rv;
+    char errmsg[200];
+    apr_getopt_t *opt;
+    char optchar;
+    const char *optarg;
+
+    printf("APR CPRNG Performance Test\n==============\n\n");
+
+    apr_initialize();
+    atexit(apr_terminate);
+
+    if (apr_pool_create(&pool, NULL) != APR_SUCCESS)
+        exit(-1);
+
+    if ((rv = apr_getopt_init(&opt, pool, argc, argv)) != APR_SUCCESS) {
+        fprintf(stderr, "Could not set up to parse options: [%d] %s\n",
+                rv, apr_strerror(rv, errmsg, sizeof errmsg));
+        exit(-1);
+    }
+
+    while ((rv = apr_getopt(opt, "n:", &optchar, &optarg)) == APR_SUCCESS) {
+        if (optchar == 'n') {
+            num_ops = atol(optarg);
+        }
+    }
+
+    if (rv != APR_SUCCESS && rv != APR_EOF) {
+        fprintf(stderr, "Could not parse options: [%d] %s\n",
+                rv, apr_strerror(rv, errmsg, sizeof errmsg));
+        exit(-1);
+    }
+    if (num_ops < MAX_THREADS) {
+        fprintf(stderr, "Invalid number of operations\n");
+        exit(-1);
+    }
+
+    rv = apr_crypto_prng_init(pool, NULL, APR_CRYPTO_CIPHER_AUTO, 0, NULL,
+                              APR_CRYPTO_PRNG_PER_THREAD);
+    if (rv != APR_SUCCESS) {
+        fprintf(stderr, "Could not initialize the CPRNG: [%d] %s\n",
+                rv, apr_strerror(rv, errmsg, sizeof errmsg));
+        exit(-1);
+    }
+
+    printf("Generating %ld random requests per test\n\n", num_ops);
+
+    test_size(16);
+    test_size(32);
+    test_size(256);
+
+    return 0;
+}
+
+#else /* !(APU_HAVE_CRYPTO && APU_HAVE_CRYPTO_PRNG && APR_HAS_THREADS) */
+
+int main(void)
+{
+    printf("This test requires APR crypto PRNG and thread support.\n");
+    return 0;
+}
+
+#endif
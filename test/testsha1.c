@@ -0,0 +1,196 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr_sha1.h"
+#include "apr_general.h"
+#include "apr_strings.h"
+
+#include "abts.h"
+#include "testutil.h"
+
+#define NUM_LENGTHS 300
+
+static struct {
+    const char *string;
+    const char *digest;
+} sha1sums[] =
+{
+    {"",
+     "\xda\x39\xa3\xee\x5e\x6b\x4b\x0d\x32\x55"
+     "\xbf\xef\x95\x60\x18\x90\xaf\xd8\x07\x09"},
+    {"abc",
+     "\xa9\x99\x3e\x36\x47\x06\x81\x6a\xba\x3e"
+     "\x25\x71\x78\x50\xc2\x6c\x9c\xd0\xd8\x9d"},
+    {"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+     "\x84\x98\x3e\x44\x1c\x3b\xd2\x6e\xba\xae"
+     "\x4a\xa1\xf9\x51\x29\xe5\xe5\x46\x70\xf1"}
+};
+
+static unsigned char *make_buffer(apr_size_t len)
+{
+    unsigned char *buf = apr_palloc(p, len);
+    apr_size_t i;
+
+    for (i = 0; i < len; i++) {
+        buf[i] = (unsigned char)(i * 7 + 1);
+    }
+    return buf;
+}
+
+static void sha1(unsigned char digest[APR_SHA1_DIGESTSIZE],
+                 const unsigned char *data, apr_size_t len)
+{
+    apr_sha1_ctx_t context;
+
+    apr_sha1_init(&context);
+    apr_sha1_update_binary(&context, data, (unsigned int)len);
+    apr_sha1_final(digest, &context);
+}
+
+static void test_sha1_vectors(abts_case *tc, void *data)
+{
+    unsigned char digest[APR_SHA1_DIGESTSIZE];
+    apr_sha1_ctx_t context;
+    char *million;
+    int i;
+
+    for (i = 0; i < sizeof(sha1sums) / sizeof(sha1sums[0]); i++) {
+        apr_sha1_init(&context);
+        apr_sha1_update(&context, sha1sums[i].string,
+                        (unsigned int)strlen(sha1sums[i].string));
+        apr_sha1_final(digest, &context);
+        ABTS_ASSERT(tc, sha1sums[i].string,
+                    memcmp(digest, sha1sums[i].digest,
+                           APR_SHA1_DIGESTSIZE) == 0);
+    }
+
+    million = apr_palloc(p, 1000000);
+    memset(million, 'a', 1000000);
+    apr_sha1_init(&context);
+    for (i = 0; i < 1000000; i += 997) {
+        apr_sha1_update(&context, million + i,
+                        i + 997 < 1000000 ? 997 : 1000000 - i);
+    }
+    apr_sha1_final(digest, &context);
+    ABTS_ASSERT(tc, "a million 'a'",
+                memcmp(digest, "\x34\xaa\x97\x3c\xd4\xc4\xda\xa4\xf6\x1e"
+                               "\xeb\x2b\xdb\xad\x27\x31\x65\x34\x01\x6f",
+                       APR_SHA1_DIGESTSIZE) == 0);
+}
+
+static void test_sha1_lengths(abts_case *tc, void *data)
+{
+    /* the digest of the digests of the (unaligned) messages of 0 to
+     * NUM_LENGTHS - 1 bytes, covering the paddings on one or two blocks */
+    const char *expected =
+        "\x34\x09\x22\x91\xed\xfe\x04\x08\x2c\x01"
+        "\xc7\xb7\x43\xa7\x92\x18\x1c\x69\xd7\xe0";
+    unsigned char *buf = make_buffer(NUM_LENGTHS + 1);
+    unsigned char digest[APR_SHA1_DIGESTSIZE];
+    apr_sha1_ctx_t context;
+    apr_size_t len;
+
+    apr_sha1_init(&context);
+    for (len = 0; len < NUM_LENGTHS; len++) {
+        sha1(digest, buf + 1, len);
+        apr_sha1_update_binary(&context, digest, APR_SHA1_DIGESTSIZE);
+    }
+    apr_sha1_final(digest, &context);
+    ABTS_ASSERT(tc, "digest of the digests",
+                memcmp(digest, expected, APR_SHA1_DIGESTSIZE) == 0);
+}
+
+static void test_sha1_split(abts_case *tc, void *data)
+{
+    static const apr_size_t chunks[] = { 1, 7, 63, 64, 65, 130 };
+    unsigned char *buf = make_buffer(NUM_LENGTHS);
+    unsigned char expected[APR_SHA1_DIGESTSIZE];
+    unsigned char digest[APR_SHA1_DIGESTSIZE];
+    apr_sha1_ctx_t context;
+    apr_size_t len, off, n;
+    int i;
+
+    for (len = 0; len < NUM_LENGTHS; len += 13) {
+        sha1(expected, buf, len);
+        for (i = 0; i < sizeof(chunks) / sizeof(chunks[0]); i++) {
+            apr_sha1_init(&context);
+            for (off = 0; off < len; off += n) {
+                n = len - off < chunks[i] ? len - off : chunks[i];
+                apr_sha1_update_binary(&context, buf + off, (unsigned int)n);
+            }
+            apr_sha1_final(digest, &context);
+            ABTS_ASSERT(tc, apr_psprintf(p, "%" APR_SIZE_T_FMT " bytes by %"
+                                         APR_SIZE_T_FMT, len, chunks[i]),
+                        memcmp(digest, expected, APR_SHA1_DIGESTSIZE) == 0);
+        }
+    }
+}
+
+static void test_sha1_multi(abts_case *tc, void *data)
+{
+    static const apr_size_t counts[] = { 0, 1, 2, 3, 4, 5, 9, NUM_LENGTHS };
+    unsigned char *buf = make_buffer(NUM_LENGTHS * 64 + 1);
+    unsigned char (*digests)[APR_SHA1_DIGESTSIZE];
+    unsigned char expected[APR_SHA1_DIGESTSIZE];
+    const unsigned char **inputs;
+    apr_size_t *lens;
+    apr_size_t i;
+    int j;
+
+    inputs = apr_palloc(p, NUM_LENGTHS * sizeof(*inputs));
+    lens = apr_palloc(p, NUM_LENGTHS * sizeof(*lens));
+    digests = apr_palloc(p, NUM_LENGTHS * sizeof(*digests));
+
+    /* different lengths, so the lanes finish at different blocks, and a
+     * long message every 37 */
+    for (i = 0; i < NUM_LENGTHS; i++) {
+        inputs[i] = buf + i % 5;
+        lens[i] = i % 37 ? (i * 11) % 150 : i * 64;
+    }
+    for (j = 0; j < sizeof(counts) / sizeof(counts[0]); j++) {
+        memset(digests, 0, NUM_LENGTHS * sizeof(*digests));
+        apr_sha1_multi(digests, inputs, lens, counts[j]);
+        for (i = 0; i < counts[j]; i++) {
+            sha1(expected, inputs[i], lens[i]);
+            ABTS_ASSERT(tc, apr_psprintf(p, "message %" APR_SIZE_T_FMT
+                                         " of %" APR_SIZE_T_FMT, i,
+                                         counts[j]),
+                        memcmp(digests[i], expected,
+                               APR_SHA1_DIGESTSIZE) == 0);
+        }
+    }
+}
+
+static void test_sha1_base64(abts_case *tc, void *data)
+{
+    char out[APR_SHA1PW_IDLEN + 29];
+
+    apr_sha1_base64("abc", 3, out);
+    ABTS_STR_EQUAL(tc, "{SHA}qZk+NkcGgWq6PiVxeFDCbJzQ2J0=", out);
+}
+
+abts_suite *testsha1(abts_suite *suite)
+{
+    suite = ADD_SUITE(suite);
+
+    abts_run_test(suite, test_sha1_vectors, NULL);
+    abts_run_test(suite, test_sha1_lengths, NULL);
+    abts_run_test(suite, test_sha1_split, NULL);
+    abts_run_test(suite, test_sha1_multi, NULL);
+    abts_run_test(suite, test_sha1_base64, NULL);
+
+    return suite;
+}
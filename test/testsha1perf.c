@@ -0,0 +1,179 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr_sha1.h"
+#include "apr_md5.h"
+#include "apr_pools.h"
+#include "apr_errno.h"
+#include "apr_general.h"
+#include "apr_getopt.h"
+#include "apr_time.h"
+#include <stdio.h>
+#include <stdlib.h>
+#if APR_HAVE_STRING_H
+#include <string.h>
+#endif
+
+#define DEFAULT_NUM_BYTES (64 * 1024 * 1024)
+#define NUM_MESSAGES 1024
+
+static apr_size_t num_bytes = DEFAULT_NUM_BYTES;
+
+static apr_pool_t *pool;
+
+static unsigned char *make_data(apr_size_t len)
+{
+    unsigned char *data = apr_palloc(pool, len);
+    apr_size_t i;
+
+    srand(1);
+    for (i = 0; i < len; i++) {
+        data[i] = (unsigned char)rand();
+    }
+    return data;
+}
+
+static void report(const char *name, apr_size_t len, apr_size_t count,
+                   apr_time_t elapsed, unsigned char first)
+{
+    printf("    %-24s %8" APR_INT64_T_FMT " usec, %8.2f MB/s, "
+           "%8.1f ns/hash [%02x]\n", name, elapsed,
+           (double)len * count / (elapsed + 1),
+           (double)elapsed * 1000.0 / count, first);
+}
+
+static void test_size(const unsigned char *data, apr_size_t len)
+{
+    unsigned char sha1[APR_SHA1_DIGESTSIZE], md5[APR_MD5_DIGESTSIZE];
+    apr_size_t i, count = num_bytes / len;
+    apr_sha1_ctx_t context;
+    apr_time_t start, elapsed;
+
+    printf("  %" APR_SIZE_T_FMT " bytes messages\n", len);
+
+    start = apr_time_now();
+    for (i = 0; i < count; i++) {
+        apr_sha1_init(&context);
+        apr_sha1_update_binary(&context, data, (unsigned int)len);
+        apr_sha1_final(sha1, &context);
+    }
+    elapsed = apr_time_now() - start;
+    report("apr_sha1", len, count, elapsed, sha1[0]);
+
+    start = apr_time_now();
+    for (i = 0; i < count; i++) {
+        apr_md5(md5, data, len);
+    }
+    elapsed = apr_time_now() - start;
+    report("apr_md5", len, count, elapsed, md5[0]);
+}
+
+static void test_multi(const unsigned char *data, apr_size_t len)
+{
+    unsigned char (*digests)[APR_SHA1_DIGESTSIZE];
+    const unsigned char **inputs;
+    apr_size_t *lens;
+    apr_size_t i, j, loops = num_bytes / (len * NUM_MESSAGES) + 1;
+    apr_sha1_ctx_t context;
+    apr_time_t start, elapsed;
+
+    digests = apr_palloc(pool, NUM_MESSAGES * sizeof(*digests));
+    inputs = apr_palloc(pool, NUM_MESSAGES * sizeof(*inputs));
+    lens = apr_palloc(pool, NUM_MESSAGES * sizeof(*lens));
+    for (i = 0; i < NUM_MESSAGES; i++) {
+        inputs[i] = data + i;
+        lens[i] = len;
+    }
+
+    printf("  %d messages of %" APR_SIZE_T_FMT " bytes\n", NUM_MESSAGES,
+           len);
+
+    start = apr_time_now();
+    for (j = 0; j < loops; j++) {
+        for (i = 0; i < NUM_MESSAGES; i++) {
+            apr_sha1_init(&context);
+            apr_sha1_update_binary(&context, inputs[i], (unsigned int)len);
+            apr_sha1_final(digests[i], &context);
+        }
+    }
+    elapsed = apr_time_now() - start;
+    report("apr_sha1 one by one", len, loops * NUM_MESSAGES, elapsed,
+           digests[NUM_MESSAGES - 1][0]);
+
+    start = apr_time_now();
+    for (j = 0; j < loops; j++) {
+        apr_sha1_multi(digests, inputs, lens, NUM_MESSAGES);
+    }
+    elapsed = apr_time_now() - start;
+    report("apr_sha1_multi", len, loops * NUM_MESSAGES, elapsed,
+           digests[NUM_MESSAGES - 1][0]);
+}
+
+int main(int argc, const char * const *argv)
+{
+    apr_status_t rv;
+    char errmsg[200];
+    apr_getopt_t *opt;
+    char optchar;
+    const char *optarg;
+    const unsigned char *data;
+
+    printf("APR SHA1 Performance Test\n==============\n\n");
+
+    apr_initialize();
+    atexit(apr_terminate);
+
+    if (apr_pool_create(&pool, NULL) != APR_SUCCESS)
+        exit(-1);
+
+    if ((rv = apr_getopt_init(&opt, pool, argc, argv)) != APR_SUCCESS) {
+        fprintf(stderr, "Could not set up to parse options: [%d] %s\n",
+                rv, apr_strerror(rv, errmsg, sizeof errmsg));
+        exit(-1);
+    }
+
+    while ((rv = apr_getopt(opt, "n:", &optchar, &optarg)) == APR_SUCCESS) {
+        if (optchar == 'n') {
+            num_bytes = (apr_size_t)atol(optarg);
+        }
+    }
+
+    if (rv != APR_SUCCESS && rv != APR_EOF) {
+        fprintf(stderr, "Could not parse options: [%d] %s\n",
+                rv, apr_strerror(rv, errmsg, sizeof errmsg));
+        exit(-1);
+    }
+    if (num_bytes < 64 * 1024) {
+        fprintf(stderr, "Invalid number of bytes\n");
+        exit(-1);
+    }
+
+    data = make_data(64 * 1024 + NUM_MESSAGES);
+    printf("Hashing %" APR_SIZE_T_FMT " bytes per test\n\n", num_bytes);
+
+    printf("Single messages\n");
+    test_size(data, 16);
+    test_size(data, 64);
+    test_size(data, 1024);
+    test_size(data, 64 * 1024);
+
+    printf("\nBatches of messages\n");
+    test_multi(data, 8);
+    test_multi(data, 32);
+    test_multi(data, 200);
+
+    return 0;
+}
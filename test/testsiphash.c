@@ -18,6 +18,8 @@
 #include <stdlib.h>
 
 #include "apr_siphash.h"
+#include "apr_hash.h"
+#include "apr_strings.h"
 
 #include "abts.h"
 #include "testutil.h"
@@ -138,11 +140,117 @@ static void test_siphash_vectors(abts_case *tc, void *data)
     ABTS_ASSERT(tc, "SipHash-2-4 test vectors", test_vectors());
 }
 
+static void test_siphash13_vectors(abts_case *tc, void *data)
+{
+    static const struct {
+        int len;
+        apr_uint64_t hash;
+    } vectors13[] = {
+        {  0, APR_UINT64_C(0xabac0158050fc4dc) },
+        {  1, APR_UINT64_C(0xc9f49bf37d57ca93) },
+        {  7, APR_UINT64_C(0xd3927d989bb11140) },
+        {  8, APR_UINT64_C(0x369095118d299a8e) },
+        { 15, APR_UINT64_C(0xd320d86d2a519956) },
+        { 16, APR_UINT64_C(0xcc4fdd1a7d908b66) },
+        { 63, APR_UINT64_C(0x9d199062b7bbb3a8) }
+    };
+    u8 in[MAXLEN], k[16];
+    int i;
+
+    for (i = 0; i < 16; ++i) k[i] = i;
+    for (i = 0; i < MAXLEN; ++i) in[i] = i;
+
+    for (i = 0; i < sizeof(vectors13) / sizeof(vectors13[0]); ++i) {
+        ABTS_ASSERT(tc, apr_psprintf(p, "SipHash-1-3 of %d bytes",
+                                     vectors13[i].len),
+                    apr_siphash13(in, vectors13[i].len, k)
+                    == vectors13[i].hash);
+    }
+}
+
+#define BATCH_SIZE 77
+
+static void test_siphash_batch(abts_case *tc, void *data)
+{
+    static const unsigned int rounds[][2] = { {1, 3}, {2, 4}, {3, 5} };
+    apr_uint64_t out[BATCH_SIZE];
+    const void *srcs[BATCH_SIZE];
+    apr_size_t lens[BATCH_SIZE];
+    u8 in[4 * MAXLEN], k[16];
+    apr_size_t n, i;
+    int r;
+
+    for (i = 0; i < 16; ++i) k[i] = (u8)(i * 13 + 5);
+    for (i = 0; i < sizeof(in); ++i) in[i] = (u8)i;
+
+    /* messages of different lengths, so a pair ends at different words */
+    for (i = 0; i < BATCH_SIZE; ++i) {
+        srcs[i] = in + i % 3;
+        lens[i] = i % 11 ? i : 3 * MAXLEN + i % 7;
+    }
+    for (r = 0; r < sizeof(rounds) / sizeof(rounds[0]); ++r) {
+        for (n = 0; n <= BATCH_SIZE; n += n < 6 ? 1 : 17) {
+            memset(out, 0, sizeof(out));
+            if (rounds[r][0] == 1 && rounds[r][1] == 3) {
+                apr_siphash13_batch(out, srcs, lens, n, k);
+            }
+            else if (rounds[r][0] == 2 && rounds[r][1] == 4) {
+                apr_siphash24_batch(out, srcs, lens, n, k);
+            }
+            else {
+                apr_siphash_batch(out, srcs, lens, n, k,
+                                  rounds[r][0], rounds[r][1]);
+            }
+            for (i = 0; i < n; ++i) {
+                ABTS_ASSERT(tc, apr_psprintf(p, "SipHash-%u-%u of message %"
+                                             APR_SIZE_T_FMT " of %"
+                                             APR_SIZE_T_FMT, rounds[r][0],
+                                             rounds[r][1], i, n),
+                            out[i] == apr_siphash(srcs[i], lens[i], k,
+                                                  rounds[r][0],
+                                                  rounds[r][1]));
+            }
+        }
+    }
+}
+
+static void test_siphash13_hashfunc(abts_case *tc, void *data)
+{
+    apr_hash_t *h = apr_hash_make_custom(p, apr_siphash13_hashfunc);
+    apr_ssize_t klen = APR_HASH_KEY_STRING;
+    unsigned int hash;
+    char *key;
+    int i, found = 0;
+
+    hash = apr_siphash13_hashfunc("Content-Length", &klen);
+    ABTS_INT_EQUAL(tc, 14, (int)klen);
+    ABTS_ASSERT(tc, "same hash with the length",
+                apr_siphash13_hashfunc("Content-Length", &klen) == hash);
+    klen = 7;
+    ABTS_ASSERT(tc, "same hash for the same key",
+                apr_siphash13_hashfunc("Content", &klen)
+                == apr_siphash13_hashfunc("Content-Length", &klen));
+
+    for (i = 0; i < 1000; ++i) {
+        key = apr_psprintf(p, "key%d", i);
+        apr_hash_set(h, key, APR_HASH_KEY_STRING, key);
+    }
+    ABTS_INT_EQUAL(tc, 1000, apr_hash_count(h));
+    for (i = 0; i < 1000; ++i) {
+        key = apr_psprintf(p, "key%d", i);
+        found += apr_hash_get(h, key, APR_HASH_KEY_STRING) != NULL;
+    }
+    ABTS_INT_EQUAL(tc, 1000, found);
+}
+
 abts_suite *testsiphash(abts_suite *suite)
 {
     suite = ADD_SUITE(suite);
 
     abts_run_test(suite, test_siphash_vectors, NULL);
+    abts_run_test(suite, test_siphash13_vectors, NULL);
+    abts_run_test(suite, test_siphash_batch, NULL);
+    abts_run_test(suite, test_siphash13_hashfunc, NULL);
 
     return suite;
 }
@@ -520,6 +520,109 @@ static void skiplist_test(abts_case *tc, void *data) {
 }
 
 
+typedef struct timeout_elem {
+    int when;
+    int seq;
+} timeout_elem;
+
+static int timer_comp(void *a, void *b)
+{
+    int wa = ((timeout_elem *)a)->when, wb = ((timeout_elem *)b)->when;
+    return (wa < wb) ? -1 : (wa > wb);
+}
+
+/* Timers-like usage: add (almost) monotonically with the last added node
+ * as finger, and pop from the head.
+ */
+static void skiplist_finger_pool(abts_case *tc, apr_pool_t *pool)
+{
+    apr_skiplist *sl;
+    apr_skiplistnode *finger = NULL, *n;
+    timeout_elem *timers, *t, *prev, key;
+    apr_uint32_t seed = 12345;
+    int i, count = 0, popped = 0;
+
+#define NUM_TIMERS 20000
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_skiplist_init(&sl, pool));
+    apr_skiplist_set_compare(sl, timer_comp, timer_comp);
+    timers = apr_palloc(p, NUM_TIMERS * sizeof(timeout_elem));
+    for (i = 0; i < NUM_TIMERS; i++) {
+        seed = seed * 1103515245 + 12345;
+        t = &timers[i];
+        /* mostly increasing, with jitter and duplicates */
+        t->when = i / 4 + (int)((seed >> 16) % 8);
+        t->seq = i;
+        if ((seed >> 8) % 16 == 0) {
+            /* an unrelated finger */
+            finger = apr_skiplist_getlist(sl);
+        }
+        finger = apr_skiplist_add_finger(sl, t, finger);
+        ABTS_PTR_NOTNULL(tc, finger);
+        ABTS_PTR_EQUAL(tc, t, apr_skiplist_element(finger));
+        count++;
+        if ((seed >> 24) % 4 == 0) {
+            t = apr_skiplist_peek(sl);
+            if (t == apr_skiplist_element(finger)) {
+                finger = NULL;
+            }
+            ABTS_PTR_EQUAL(tc, t, apr_skiplist_pop(sl, NULL));
+            count--;
+            popped++;
+        }
+    }
+    ABTS_SIZE_EQUAL(tc, count, apr_skiplist_size(sl));
+    ABTS_SIZE_EQUAL(tc, count, skiplist_get_size(tc, sl));
+
+    /* sorted, and duplicates in insertion order */
+    prev = NULL;
+    for (n = apr_skiplist_getlist(sl); n; apr_skiplist_next(sl, &n)) {
+        t = apr_skiplist_element(n);
+        if (prev && (prev->when > t->when
+                     || (prev->when == t->when && prev->seq > t->seq))) {
+            ABTS_FAIL(tc, "skiplist not ordered");
+            break;
+        }
+        prev = t;
+    }
+
+    /* finger searches, forward or backward */
+    n = apr_skiplist_getlist(sl);
+    for (i = popped; i < NUM_TIMERS; i += 97) {
+        t = apr_skiplist_find_finger(sl, &timers[i], n, &n);
+        ABTS_PTR_NOTNULL(tc, t);
+        if (!t) {
+            break;
+        }
+        ABTS_INT_EQUAL(tc, timers[i].when, t->when);
+        ABTS_PTR_EQUAL(tc, t, apr_skiplist_element(n));
+    }
+    key.when = -1;
+    ABTS_PTR_EQUAL(tc, NULL, apr_skiplist_find_finger(sl, &key, n, NULL));
+    key.when = NUM_TIMERS;
+    ABTS_PTR_EQUAL(tc, NULL, apr_skiplist_find_finger(sl, &key, n, NULL));
+
+    /* no duplicates with insert */
+    n = apr_skiplist_getlist(sl);
+    t = apr_skiplist_element(n);
+    ABTS_PTR_EQUAL(tc, NULL, apr_skiplist_insert_finger(sl, t, n));
+    ABTS_PTR_EQUAL(tc, NULL, apr_skiplist_insert_finger(sl,
+                                                 &timers[NUM_TIMERS - 1], n));
+    key.when = NUM_TIMERS;
+    n = apr_skiplist_insert_finger(sl, &key, n);
+    ABTS_PTR_NOTNULL(tc, n);
+    ABTS_SIZE_EQUAL(tc, count + 1, apr_skiplist_size(sl));
+
+    apr_skiplist_destroy(sl, NULL);
+#undef NUM_TIMERS
+}
+
+static void skiplist_finger(abts_case *tc, void *data)
+{
+    skiplist_finger_pool(tc, ptmp);
+    skiplist_finger_pool(tc, NULL);
+    apr_pool_clear(ptmp);
+}
+
 abts_suite *testskiplist(abts_suite *suite)
 {
     suite = ADD_SUITE(suite)
@@ -536,6 +639,7 @@ abts_suite *testskiplist(abts_suite *suite)
     abts_run_test(suite, skiplist_size, NULL);
     abts_run_test(suite, skiplist_remove, NULL);
     abts_run_test(suite, skiplist_random_loop, NULL);
+    abts_run_test(suite, skiplist_finger, NULL);
 
     abts_run_test(suite, skiplist_test, NULL);
 
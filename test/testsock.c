@@ -269,6 +269,49 @@ static void test_recv(abts_case *tc, void *data)
     APR_ASSERT_SUCCESS(tc, "Problem closing socket", rv);
 }
 
+static void test_recvv(abts_case *tc, void *data)
+{
+    apr_status_t rv;
+    apr_socket_t *sock;
+    apr_socket_t *sock2;
+    apr_proc_t proc;
+    apr_size_t length;
+    char head[5], middle[3], tail[STRLEN];
+    struct iovec vec[3];
+
+    sock = setup_socket(tc);
+    if (!sock) return;
+
+    launch_child(tc, &proc, "write", p);
+
+    rv = apr_socket_accept(&sock2, sock, p);
+    APR_ASSERT_SUCCESS(tc, "Problem with receiving connection", rv);
+
+    memset(tail, 0, STRLEN);
+    vec[0].iov_base = head;
+    vec[0].iov_len = sizeof(head);
+    vec[1].iov_base = middle;
+    vec[1].iov_len = sizeof(middle);
+    vec[2].iov_base = tail;
+    vec[2].iov_len = STRLEN - 1;
+
+    /* Wait for all the data to be there, to get them in one read */
+    ABTS_SIZE_EQUAL(tc, strlen(DATASTR), wait_child(tc, &proc));
+    rv = apr_socket_recvv(sock2, vec, 3, &length);
+    APR_ASSERT_SUCCESS(tc, "Problem receiving data", rv);
+
+    /* Make sure that the data were spread over the buffers */
+    ABTS_SIZE_EQUAL(tc, strlen(DATASTR), length);
+    ABTS_ASSERT(tc, "head", memcmp(head, DATASTR, 5) == 0);
+    ABTS_ASSERT(tc, "middle", memcmp(middle, DATASTR + 5, 3) == 0);
+    ABTS_STR_EQUAL(tc, DATASTR + 8, tail);
+
+    rv = apr_socket_close(sock2);
+    APR_ASSERT_SUCCESS(tc, "Problem closing connected socket", rv);
+    rv = apr_socket_close(sock);
+    APR_ASSERT_SUCCESS(tc, "Problem closing socket", rv);
+}
+
 static void test_atreadeof(abts_case *tc, void *data)
 {
     apr_status_t rv;
@@ -744,6 +787,7 @@ abts_suite *testsock(abts_suite *suite)
     abts_run_test(suite, test_create_bind_listen, NULL);
     abts_run_test(suite, test_send, NULL);
     abts_run_test(suite, test_recv, NULL);
+    abts_run_test(suite, test_recvv, NULL);
     abts_run_test(suite, test_atreadeof, NULL);
     abts_run_test(suite, test_timeout, NULL);
     abts_run_test(suite, test_print_addr, NULL);
@@ -760,6 +804,7 @@ abts_suite *testsock(abts_suite *suite)
     abts_run_test(suite, test_create_bind_listen, NULL);
     abts_run_test(suite, test_send, NULL);
     abts_run_test(suite, test_recv, NULL);
+    abts_run_test(suite, test_recvv, NULL);
     abts_run_test(suite, test_timeout, NULL);
     abts_run_test(suite, test_wait, NULL);
 #endif
@@ -408,6 +408,79 @@ static void pstrcat(abts_case *tc, void *data)
                    "abcdefghij12345");
 }
 
+static int ref_casecmpn(const char *s1, const char *s2, apr_size_t n)
+{
+    const unsigned char *u1 = (const unsigned char *)s1;
+    const unsigned char *u2 = (const unsigned char *)s2;
+
+    for (; n; n--, u1++, u2++) {
+        int c1 = (*u1 >= 'A' && *u1 <= 'Z') ? *u1 + 0x20 : *u1;
+        int c2 = (*u2 >= 'A' && *u2 <= 'Z') ? *u2 + 0x20 : *u2;
+        if (c1 != c2 || !c1) {
+            return c1 - c2;
+        }
+    }
+    return 0;
+}
+
+static void string_casecmp(abts_case *tc, void *data)
+{
+    /* the case folding boundaries, and non-ASCII */
+    static const char chars[] = "aAzZ@[`{09-\xc0\xe0";
+    apr_uint32_t seed = 12345;
+    char *buf, *s1, *s2;
+    apr_size_t len, n;
+    int i, j;
+
+    ABTS_INT_EQUAL(tc, 0, apr_cstr_casecmp("Content-Type", "content-type"));
+    ABTS_TRUE(tc, apr_cstr_casecmp("Content-Type", "Content-Typf") < 0);
+    ABTS_TRUE(tc, apr_cstr_casecmp("Content-Type", "Content-Typ") > 0);
+    ABTS_TRUE(tc, apr_cstr_casecmp("a[", "A{") < 0);
+    ABTS_INT_EQUAL(tc, 0, apr_cstr_casecmpn("X-Forwarded-For",
+                                            "x-forwarded-host", 12));
+    ABTS_TRUE(tc, apr_cstr_casecmpn("X-Forwarded-For",
+                                    "x-forwarded-host", 13) < 0);
+    ABTS_INT_EQUAL(tc, 0, apr_cstr_casecmpn("", "", 100));
+
+    /* The strings end close to a page boundary (4K or more) to check that
+     * the blocks processed at once don't cross it.
+     */
+    buf = apr_palloc(p, 3 * 4096);
+    buf = (char *)(((apr_uintptr_t)buf + 4095) & ~(apr_uintptr_t)4095);
+    for (i = 0; i < 20000; i++) {
+        seed = seed * 1103515245 + 12345;
+        len = (seed >> 8) % 70;
+        s1 = buf + 4096 - len - 1 - (seed >> 20) % 20;
+        s2 = buf + 2 * 4096 - len - 1 - (seed >> 24) % 20;
+        for (j = 0; j < (int)len; j++) {
+            seed = seed * 1103515245 + 12345;
+            s1[j] = chars[(seed >> 8) % (sizeof(chars) - 1)];
+            /* mostly case variants */
+            if ((seed >> 16) % 64) {
+                s2[j] = (s1[j] >= 'a' && s1[j] <= 'z') ? s1[j] - 0x20 :
+                        (s1[j] >= 'A' && s1[j] <= 'Z') ? s1[j] + 0x20 : s1[j];
+            }
+            else {
+                s2[j] = chars[(seed >> 24) % (sizeof(chars) - 1)];
+            }
+        }
+        s1[len] = '\0';
+        s2[len - (len && (seed & 0x10000))] = '\0';
+        n = (seed >> 4) % 80;
+
+        if (apr_cstr_casecmp(s1, s2) != ref_casecmpn(s1, s2, len + 1)) {
+            ABTS_FAIL(tc, apr_psprintf(p, "apr_cstr_casecmp(\"%s\", \"%s\")",
+                                       s1, s2));
+            break;
+        }
+        if (apr_cstr_casecmpn(s1, s2, n) != ref_casecmpn(s1, s2, n)) {
+            ABTS_FAIL(tc, apr_psprintf(p, "apr_cstr_casecmpn(\"%s\", \"%s\", "
+                                       "%" APR_SIZE_T_FMT ")", s1, s2, n));
+            break;
+        }
+    }
+}
+
 abts_suite *teststr(abts_suite *suite)
 {
     suite = ADD_SUITE(suite)
@@ -427,6 +500,7 @@ abts_suite *teststr(abts_suite *suite)
     abts_run_test(suite, snprintf_overflow, NULL);
     abts_run_test(suite, skip_prefix, NULL);
     abts_run_test(suite, pstrcat, NULL);
+    abts_run_test(suite, string_casecmp, NULL);
 
     return suite;
 }
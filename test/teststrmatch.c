@@ -18,6 +18,7 @@
 
 #include "apr.h"
 #include "apr_general.h"
+#include "apr_lib.h"
 #include "apr_strmatch.h"
 #if APR_HAVE_STDLIB_H
 #include <stdlib.h>
@@ -81,11 +82,208 @@ static void test_str(abts_case *tc, void *data)
     ABTS_PTR_EQUAL(tc, input6 + 35, match);
 }
 
+/* Naive search, for reference */
+static const char *ref_strmatch(const char *pat, const char *s,
+                                apr_size_t slen, int case_sensitive)
+{
+    apr_size_t plen = strlen(pat), i, j;
+
+    for (i = 0; i + plen <= slen; i++) {
+        for (j = 0; j < plen; j++) {
+            if (case_sensitive ? s[i + j] != pat[j]
+                               : apr_tolower(s[i + j]) != apr_tolower(pat[j])) {
+                break;
+            }
+        }
+        if (j == plen) {
+            return s + i;
+        }
+    }
+    return NULL;
+}
+
+static void test_str_positions(abts_case *tc, void *data)
+{
+    char buf[128], pat[48];
+    apr_size_t plen, off, slen;
+    int cs;
+
+    /* Patterns of all lengths at all the offsets of the blocks, with
+     * near misses before them (same first and last characters).
+     */
+    for (plen = 1; plen < sizeof(pat); plen++) {
+        for (off = 0; off + plen <= sizeof(buf); off++) {
+            memset(buf, 'x', sizeof(buf));
+            memset(pat, 'b', plen);
+            pat[0] = 'a';
+            pat[plen - 1] = 'c';
+            pat[plen] = '\0';
+            if (plen > 2 && off >= plen) {
+                memcpy(buf + off - plen, pat, plen);
+                buf[off - plen + plen / 2] = 'B' + 1;
+            }
+            memcpy(buf + off, pat, plen);
+            buf[off + plen / 2] = apr_toupper(buf[off + plen / 2]);
+            for (cs = 0; cs <= 1; cs++) {
+                const apr_strmatch_pattern *pattern;
+                const apr_strmatch_multi_pattern *multi;
+                const char *pats[1];
+                pats[0] = pat;
+                pattern = apr_strmatch_precompile(p, pat, cs);
+                multi = apr_strmatch_multi_precompile(p, pats, 1, cs);
+                for (slen = off + plen - 1; slen <= sizeof(buf);
+                     slen += sizeof(buf) - off - plen + 1) {
+                    const char *ref = ref_strmatch(pat, buf, slen, cs);
+                    ABTS_PTR_EQUAL(tc, ref, apr_strmatch(pattern, buf, slen));
+                    ABTS_PTR_EQUAL(tc, ref,
+                                   apr_strmatch_multi(multi, buf, slen, NULL));
+                }
+            }
+        }
+    }
+}
+
+static void test_multi(abts_case *tc, void *data)
+{
+    static const char * const patterns[] = { "he", "she", "his", "hers" };
+    static const char * const blocklist[] = {
+        "/etc/passwd", "<script", "union select", "../", "cmd.exe",
+        "/bin/sh", "%00", "javascript:", "select", "onerror="
+    };
+    static const char * const with_empty[] = { "abc", "" };
+    const apr_strmatch_multi_pattern *multi;
+    const char *input = "ushers";
+    const char *match;
+    const char *bigs[1];
+    char *big;
+    apr_size_t i;
+    int id = -1;
+
+    ABTS_PTR_EQUAL(tc, NULL, apr_strmatch_multi_precompile(p, NULL, -1, 1));
+
+    multi = apr_strmatch_multi_precompile(p, patterns, 4, 1);
+    ABTS_PTR_NOTNULL(tc, multi);
+
+    /* "she" and "he" end first, the longest wins */
+    match = apr_strmatch_multi(multi, input, strlen(input), &id);
+    ABTS_PTR_EQUAL(tc, input + 1, match);
+    ABTS_INT_EQUAL(tc, 1, id);
+    match = apr_strmatch_multi(multi, match + 1, strlen(match + 1), &id);
+    ABTS_PTR_EQUAL(tc, input + 2, match);
+    ABTS_INT_EQUAL(tc, 0, id);
+    match = apr_strmatch_multi(multi, match + 1, strlen(match + 1), &id);
+    ABTS_PTR_EQUAL(tc, NULL, match);
+
+    input = "this is it";
+    match = apr_strmatch_multi(multi, input, strlen(input), &id);
+    ABTS_PTR_EQUAL(tc, input + 1, match);
+    ABTS_INT_EQUAL(tc, 2, id);
+    match = apr_strmatch_multi(multi, input, 3, &id);
+    ABTS_PTR_EQUAL(tc, NULL, match);
+    input = "SHE";
+    ABTS_PTR_EQUAL(tc, NULL, apr_strmatch_multi(multi, input, 3, NULL));
+
+    multi = apr_strmatch_multi_precompile(p, blocklist, 10, 0);
+    ABTS_PTR_NOTNULL(tc, multi);
+    input = "GET /index.php?id=1 UNION SELECT password FROM users";
+    match = apr_strmatch_multi(multi, input, strlen(input), &id);
+    ABTS_PTR_EQUAL(tc, input + 20, match);
+    ABTS_INT_EQUAL(tc, 2, id);
+    input = "GET /index.php?id=1 UNION  SELECT password FROM users";
+    match = apr_strmatch_multi(multi, input, strlen(input), &id);
+    ABTS_PTR_EQUAL(tc, input + 27, match);
+    ABTS_INT_EQUAL(tc, 8, id);
+    input = "GET /static/../../etc/passwd\200 HTTP/1.1";
+    match = apr_strmatch_multi(multi, input, strlen(input), &id);
+    ABTS_PTR_EQUAL(tc, input + 12, match);
+    ABTS_INT_EQUAL(tc, 3, id);
+    input = "GET /static/app.js HTTP/1.1";
+    ABTS_PTR_EQUAL(tc, NULL,
+                   apr_strmatch_multi(multi, input, strlen(input), NULL));
+
+    /* Too many states for the 256 classes of the DFA */
+    big = apr_palloc(p, APR_UINT32_MAX / 256 + 2);
+    for (i = 0; i <= APR_UINT32_MAX / 256; i++) {
+        big[i] = (char)(i % 255 + 1);
+    }
+    big[i] = '\0';
+    bigs[0] = big;
+    ABTS_PTR_EQUAL(tc, NULL, apr_strmatch_multi_precompile(p, bigs, 1, 1));
+
+    multi = apr_strmatch_multi_precompile(p, with_empty, 2, 1);
+    input = "abc";
+    match = apr_strmatch_multi(multi, input, strlen(input), &id);
+    ABTS_PTR_EQUAL(tc, input, match);
+    ABTS_INT_EQUAL(tc, 1, id);
+
+    multi = apr_strmatch_multi_precompile(p, NULL, 0, 1);
+    ABTS_PTR_NOTNULL(tc, multi);
+    ABTS_PTR_EQUAL(tc, NULL, apr_strmatch_multi(multi, input, 3, NULL));
+}
+
+static void test_multi_random(abts_case *tc, void *data)
+{
+    char buf[256];
+    const char *patterns[16];
+    int round, i, j, cs;
+
+    srand(42);
+    for (round = 0; round < 200; round++) {
+        int npatterns = 1 + rand() % 16;
+        for (i = 0; i < npatterns; i++) {
+            char *pat = apr_palloc(p, 6);
+            int plen = 1 + rand() % 5;
+            for (j = 0; j < plen; j++) {
+                pat[j] = "abcAB"[rand() % 5];
+            }
+            pat[plen] = '\0';
+            patterns[i] = pat;
+        }
+        for (j = 0; j < sizeof(buf); j++) {
+            buf[j] = "abcdAB"[rand() % 6];
+        }
+        for (cs = 0; cs <= 1; cs++) {
+            const apr_strmatch_multi_pattern *multi;
+            const char *expected = NULL, *match;
+            apr_size_t expected_len = 0;
+            int id = -1;
+
+            /* the one that ends first, then the longest */
+            for (i = 0; i < npatterns; i++) {
+                const char *m = ref_strmatch(patterns[i], buf, sizeof(buf),
+                                             cs);
+                apr_size_t len = strlen(patterns[i]);
+                if (m && (!expected || m + len < expected + expected_len
+                          || (m + len == expected + expected_len
+                              && len > expected_len))) {
+                    expected = m;
+                    expected_len = len;
+                }
+            }
+
+            multi = apr_strmatch_multi_precompile(p, patterns, npatterns, cs);
+            ABTS_PTR_NOTNULL(tc, multi);
+            match = apr_strmatch_multi(multi, buf, sizeof(buf), &id);
+            ABTS_PTR_EQUAL(tc, expected, match);
+            if (match) {
+                ABTS_INT_EQUAL(tc, (int)expected_len,
+                               (int)strlen(patterns[id]));
+                ABTS_PTR_EQUAL(tc, match,
+                               ref_strmatch(patterns[id], match,
+                                            expected_len, cs));
+            }
+        }
+    }
+}
+
 abts_suite *teststrmatch(abts_suite *suite)
 {
     suite = ADD_SUITE(suite);
 
     abts_run_test(suite, test_str, NULL);
+    abts_run_test(suite, test_str_positions, NULL);
+    abts_run_test(suite, test_multi, NULL);
+    abts_run_test(suite, test_multi_random, NULL);
 
     return suite;
 }
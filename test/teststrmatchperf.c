@@ -0,0 +1,271 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr_strmatch.h"
+#include "apr_pools.h"
+#include "apr_strings.h"
+#include "apr_errno.h"
+#include "apr_general.h"
+#include "apr_getopt.h"
+#include "apr_lib.h"
+#include "apr_time.h"
+#include <stdio.h>
+#include <stdlib.h>
+#if APR_HAVE_STRING_H
+#include <string.h>
+#endif
+
+#define DEFAULT_TEXT_SIZE (64 * 1024)
+#define DEFAULT_NUM_LOOPS 1000
+
+static apr_size_t text_size = DEFAULT_TEXT_SIZE;
+static long num_loops = DEFAULT_NUM_LOOPS;
+
+static apr_pool_t *pool;
+
+/* The Boyer-Moore-Horspool implementation of apr_strmatch, for reference */
+typedef struct {
+    const char *pattern;
+    apr_size_t length;
+    apr_size_t shift[256];
+    int case_sensitive;
+} bmh_pattern_t;
+
+static bmh_pattern_t *bmh_precompile(const char *s, int case_sensitive)
+{
+    bmh_pattern_t *bmh = apr_palloc(pool, sizeof(*bmh));
+    apr_size_t i;
+
+    bmh->pattern = s;
+    bmh->length = strlen(s);
+    bmh->case_sensitive = case_sensitive;
+    for (i = 0; i < 256; i++) {
+        bmh->shift[i] = bmh->length;
+    }
+    for (i = 0; i + 1 < bmh->length; i++) {
+        unsigned char c = case_sensitive ? s[i] : apr_tolower(s[i]);
+        bmh->shift[c] = bmh->length - i - 1;
+    }
+    return bmh;
+}
+
+static const char *bmh_match(const bmh_pattern_t *bmh, const char *s,
+                             apr_size_t slen)
+{
+    const char *s_end = s + slen;
+    const char *s_next = s + bmh->length - 1;
+    const char *p_start = bmh->pattern;
+    const char *p_end = p_start + bmh->length - 1;
+
+    while (s_next < s_end) {
+        const char *s_tmp = s_next;
+        const char *p_tmp = p_end;
+        if (bmh->case_sensitive) {
+            while (*s_tmp == *p_tmp) {
+                p_tmp--;
+                if (p_tmp < p_start) {
+                    return s_tmp;
+                }
+                s_tmp--;
+            }
+            s_next += bmh->shift[*(const unsigned char *)s_next];
+        }
+        else {
+            while (apr_tolower(*s_tmp) == apr_tolower(*p_tmp)) {
+                p_tmp--;
+                if (p_tmp < p_start) {
+                    return s_tmp;
+                }
+                s_tmp--;
+            }
+            s_next += bmh->shift[(unsigned char)apr_tolower(*s_next)];
+        }
+    }
+    return NULL;
+}
+
+static const char *words[] = {
+    "the", "content", "of", "a", "request", "body", "with", "some", "text",
+    "and", "html", "<div", "class=", "\"main\">", "</div>", "form-data;",
+    "name=", "boundary", "application/json", "{\"id\":", "12345,", "value",
+    "Lorem", "ipsum", "dolor", "sit", "amet,", "consectetur", "adipiscing"
+};
+#define NUM_WORDS (sizeof(words) / sizeof(words[0]))
+
+static char *make_text(void)
+{
+    char *text = apr_palloc(pool, text_size + 1);
+    apr_size_t len = 0;
+
+    srand(1);
+    while (len < text_size) {
+        const char *w = words[rand() % NUM_WORDS];
+        apr_size_t wlen = strlen(w);
+        if (len + wlen + 1 > text_size) {
+            wlen = text_size - len - 1;
+        }
+        memcpy(text + len, w, wlen);
+        len += wlen;
+        text[len++] = ' ';
+    }
+    text[text_size] = '\0';
+    return text;
+}
+
+static void report(const char *name, apr_time_t elapsed, int found)
+{
+    printf("    %-28s %8" APR_INT64_T_FMT " usec, %8.2f MB/s%s\n", name,
+           elapsed, (double)text_size * num_loops / (elapsed + 1),
+           found ? "" : " (not found)");
+}
+
+static void test_pattern(const char *text, const char *pat,
+                         int case_sensitive)
+{
+    const apr_strmatch_pattern *pattern;
+    const bmh_pattern_t *bmh;
+    const char *m1 = NULL, *m2 = NULL;
+    apr_time_t start, bmh_time, simd_time;
+    long i;
+
+    bmh = bmh_precompile(pat, case_sensitive);
+    pattern = apr_strmatch_precompile(pool, pat, case_sensitive);
+
+    start = apr_time_now();
+    for (i = 0; i < num_loops; i++) {
+        m1 = bmh_match(bmh, text, text_size);
+    }
+    bmh_time = apr_time_now() - start;
+
+    start = apr_time_now();
+    for (i = 0; i < num_loops; i++) {
+        m2 = apr_strmatch(pattern, text, text_size);
+    }
+    simd_time = apr_time_now() - start;
+
+    printf("  \"%s\" (%s)%s\n", pat,
+           case_sensitive ? "case sensitive" : "case insensitive",
+           m1 == m2 ? "" : " MISMATCH!");
+    report("Boyer-Moore-Horspool", bmh_time, m1 != NULL);
+    report("apr_strmatch", simd_time, m2 != NULL);
+}
+
+static void test_multi(const char *text, const char * const *patterns,
+                       int npatterns)
+{
+    const apr_strmatch_multi_pattern *multi;
+    const apr_strmatch_pattern **singles;
+    const char *m = NULL, *best = NULL;
+    apr_time_t start, singles_time, multi_time;
+    long i;
+    int j;
+
+    singles = apr_palloc(pool, npatterns * sizeof(*singles));
+    for (j = 0; j < npatterns; j++) {
+        singles[j] = apr_strmatch_precompile(pool, patterns[j], 0);
+    }
+    multi = apr_strmatch_multi_precompile(pool, patterns, npatterns, 0);
+
+    start = apr_time_now();
+    for (i = 0; i < num_loops; i++) {
+        best = NULL;
+        for (j = 0; j < npatterns; j++) {
+            m = apr_strmatch(singles[j], text, text_size);
+            if (m && (!best || m < best)) {
+                best = m;
+            }
+        }
+    }
+    singles_time = apr_time_now() - start;
+
+    start = apr_time_now();
+    for (i = 0; i < num_loops; i++) {
+        m = apr_strmatch_multi(multi, text, text_size, NULL);
+    }
+    multi_time = apr_time_now() - start;
+
+    printf("  %d patterns (case insensitive)\n", npatterns);
+    report("apr_strmatch per pattern", singles_time, best != NULL);
+    report("apr_strmatch_multi", multi_time, m != NULL);
+}
+
+int main(int argc, const char * const *argv)
+{
+    apr_status_t rv;
+    char errmsg[200];
+    apr_getopt_t *opt;
+    char optchar;
+    const char *optarg;
+    const char *text;
+    const char **blocklist;
+    int i;
+
+    printf("APR String Matching Performance Test\n==============\n\n");
+
+    apr_initialize();
+    atexit(apr_terminate);
+
+    if (apr_pool_create(&pool, NULL) != APR_SUCCESS)
+        exit(-1);
+
+    if ((rv = apr_getopt_init(&opt, pool, argc, argv)) != APR_SUCCESS) {
+        fprintf(stderr, "Could not set up to parse options: [%d] %s\n",
+                rv, apr_strerror(rv, errmsg, sizeof errmsg));
+        exit(-1);
+    }
+
+    while ((rv = apr_getopt(opt, "s:l:", &optchar, &optarg)) == APR_SUCCESS) {
+        if (optchar == 's') {
+            text_size = (apr_size_t)atol(optarg);
+        }
+        else if (optchar == 'l') {
+            num_loops = atol(optarg);
+        }
+    }
+
+    if (rv != APR_SUCCESS && rv != APR_EOF) {
+        fprintf(stderr, "Could not parse options: [%d] %s\n",
+                rv, apr_strerror(rv, errmsg, sizeof errmsg));
+        exit(-1);
+    }
+    if (text_size < 2 || num_loops <= 0) {
+        fprintf(stderr, "Invalid text size or number of loops\n");
+        exit(-1);
+    }
+
+    text = make_text();
+    printf("Searching %" APR_SIZE_T_FMT " bytes of text %ld times\n\n",
+           text_size, num_loops);
+
+    printf("Single pattern\n");
+    test_pattern(text, "Q", 1);
+    test_pattern(text, "</form>", 1);
+    test_pattern(text, "</form>", 0);
+    test_pattern(text, "Content-Disposition", 1);
+    test_pattern(text, "Content-Disposition", 0);
+    test_pattern(text, "--------------------------boundary1234567890", 1);
+
+    printf("\nMultiple patterns\n");
+    blocklist = apr_palloc(pool, 100 * sizeof(*blocklist));
+    for (i = 0; i < 100; i++) {
+        blocklist[i] = apr_psprintf(pool, "blocked-%d.example", i);
+    }
+    test_multi(text, blocklist, 4);
+    test_multi(text, blocklist, 16);
+    test_multi(text, blocklist, 100);
+
+    return 0;
+}
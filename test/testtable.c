@@ -222,6 +222,119 @@ static void table_overlap3(abts_case *tc, void *data)
 
 }
 
+/* Linear lookup, to check the indexes against */
+static const char *scan_get(const apr_table_t *t, const char *key)
+{
+    const apr_array_header_t *arr = apr_table_elts(t);
+    const apr_table_entry_t *elts = (const apr_table_entry_t *)arr->elts;
+    int i;
+
+    for (i = 0; i < arr->nelts; i++) {
+        if (!strcasecmp(elts[i].key, key)) {
+            return elts[i].val;
+        }
+    }
+    return NULL;
+}
+
+static int count_do(void *rec, const char *key, const char *val)
+{
+    (*(int *)rec)++;
+    return 1;
+}
+
+/* Tables large enough to be hash indexed, with keys sharing their first
+ * characters and duplicates.
+ */
+static void table_large(abts_case *tc, void *data)
+{
+    apr_table_t *t, *t2;
+    apr_uint32_t seed = 12345;
+    char key[32];
+    const char *val;
+    int i, k, count;
+
+    t = apr_table_make(p, 1);
+    for (i = 0; i < 20000; i++) {
+        seed = seed * 1103515245 + 12345;
+        k = (seed >> 8) % 300;
+        apr_snprintf(key, sizeof(key), (seed & 0x100000) ? "X-Header-%d"
+                                                         : "x-HEADER-%d", k);
+        switch ((seed >> 16) % 8) {
+        case 0:
+            apr_table_unset(t, key);
+            break;
+        case 1:
+            apr_table_merge(t, key, "m");
+            break;
+        case 2:
+        case 3:
+            apr_table_add(t, key, apr_itoa(p, i));
+            break;
+        default:
+            apr_table_set(t, key, apr_itoa(p, i));
+            break;
+        }
+        if ((seed >> 24) == 0) {
+            apr_table_compress(t, APR_OVERLAP_TABLES_MERGE);
+        }
+    }
+    ABTS_ASSERT(tc, "not enough entries", apr_table_elts(t)->nelts > 100);
+
+    t2 = apr_table_copy(p, t);
+    for (k = 0; k < 300; k++) {
+        apr_snprintf(key, sizeof(key), "X-HEADER-%d", k);
+        val = scan_get(t, key);
+        if (apr_table_get(t, key) != val) {
+            ABTS_FAIL(tc, "lookup mismatch");
+            break;
+        }
+        if (apr_table_get(t2, key) != val) {
+            ABTS_FAIL(tc, "lookup mismatch in copy");
+            break;
+        }
+    }
+
+    /* duplicates are still found in order */
+    apr_table_add(t, "X-Header-1000", "1");
+    apr_table_add(t, "X-Header-1001", "a");
+    apr_table_add(t, "x-header-1000", "2");
+    apr_table_add(t, "X-HEADER-1000", "3");
+    ABTS_STR_EQUAL(tc, "1", apr_table_get(t, "X-Header-1000"));
+    ABTS_STR_EQUAL(tc, "1,2,3", apr_table_getm(p, t, "X-Header-1000"));
+    count = 0;
+    apr_table_do(count_do, &count, t, "x-header-1000", NULL);
+    ABTS_INT_EQUAL(tc, 3, count);
+    apr_table_set(t, "X-Header-1000", "4");
+    ABTS_STR_EQUAL(tc, "4", apr_table_getm(p, t, "X-Header-1000"));
+    ABTS_STR_EQUAL(tc, "a", apr_table_get(t, "X-Header-1001"));
+    apr_table_unset(t, "X-Header-1000");
+    ABTS_PTR_EQUAL(tc, NULL, apr_table_get(t, "X-Header-1000"));
+    ABTS_STR_EQUAL(tc, "a", apr_table_get(t, "X-Header-1001"));
+
+    /* the copy is independent */
+    ABTS_PTR_EQUAL(tc, NULL, apr_table_get(t2, "X-Header-1001"));
+
+    t2 = apr_table_overlay(p, t, t2);
+    apr_table_overlap(t2, t, APR_OVERLAP_TABLES_ADD);
+    for (k = 0; k < 300; k++) {
+        apr_snprintf(key, sizeof(key), "X-Header-%d", k);
+        if (apr_table_get(t2, key) != scan_get(t2, key)) {
+            ABTS_FAIL(tc, "lookup mismatch in overlay");
+            break;
+        }
+    }
+
+    apr_table_clear(t);
+    ABTS_PTR_EQUAL(tc, NULL, apr_table_get(t, "X-Header-1001"));
+    for (k = 0; k < 100; k++) {
+        apr_snprintf(key, sizeof(key), "X-Header-%d", k);
+        apr_table_set(t, key, "v");
+    }
+    ABTS_INT_EQUAL(tc, 100, apr_table_elts(t)->nelts);
+    ABTS_STR_EQUAL(tc, "v", apr_table_get(t, "x-header-99"));
+}
+
 abts_suite *testtable(abts_suite *suite)
 {
     suite = ADD_SUITE(suite)
@@ -239,6 +352,7 @@ abts_suite *testtable(abts_suite *suite)
     abts_run_test(suite, table_overlap, NULL);
     abts_run_test(suite, table_overlap2, NULL);
     abts_run_test(suite, table_overlap3, NULL);
+    abts_run_test(suite, table_large, NULL);
 
     return suite;
 }
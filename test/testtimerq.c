@@ -0,0 +1,287 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "testutil.h"
+#include "apr.h"
+#include "apr_general.h"
+#include "apr_pools.h"
+#include "apr_time.h"
+#include "apr_timerq.h"
+#if APR_HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+
+typedef struct {
+    apr_time_t when;
+    apr_timerq_timer_t *timer;
+    int cancelled;
+    int expired;
+} test_timer_t;
+
+/* Resolutions of the timing wheel, zero for the min-heap */
+static apr_interval_time_t resolutions[] = { 1000, 1, 0 };
+
+static apr_timerq_t *make_timerq(abts_case *tc, apr_pool_t *pool,
+                                 apr_interval_time_t resolution)
+{
+    apr_timerq_t *tq = NULL;
+
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_timerq_create(&tq, resolution, pool));
+    ABTS_PTR_NOTNULL(tc, tq);
+    ABTS_SIZE_EQUAL(tc, 0, apr_timerq_count(tq));
+    return tq;
+}
+
+static void timerq_create(abts_case *tc, void *data)
+{
+    apr_timerq_t *tq = NULL;
+
+    ABTS_INT_EQUAL(tc, APR_EINVAL, apr_timerq_create(&tq, -1, p));
+    tq = make_timerq(tc, p, 1000);
+    ABTS_TRUE(tc, apr_timerq_timeout(tq, apr_time_now()) == -1);
+}
+
+static void timerq_order(abts_case *tc, void *data)
+{
+    apr_interval_time_t res = *(apr_interval_time_t *)data;
+    apr_timerq_t *tq = make_timerq(tc, p, res);
+    apr_time_t now = apr_time_now();
+    static const int delays[] = { 50000, 10000, 30000, 20000, 40000,
+                                  10000 };
+    test_timer_t timers[sizeof(delays) / sizeof(delays[0])];
+    test_timer_t *t, *prev = NULL;
+    apr_interval_time_t timeout;
+    void *elt;
+    int i;
+
+    for (i = 0; i < sizeof(delays) / sizeof(delays[0]); i++) {
+        timers[i].when = now + delays[i];
+        ABTS_INT_EQUAL(tc, APR_SUCCESS,
+                       apr_timerq_add(tq, timers[i].when, &timers[i], NULL));
+    }
+    ABTS_SIZE_EQUAL(tc, 6, apr_timerq_count(tq));
+
+    /* Nothing expired yet */
+    ABTS_INT_EQUAL(tc, APR_NOTFOUND, apr_timerq_pop(tq, now, &elt));
+    timeout = apr_timerq_timeout(tq, now);
+    ABTS_TRUE(tc, timeout >= 0 && timeout <= 10000 + res);
+
+    /* The three first ones */
+    now += 25000;
+    for (i = 0; i < 3; i++) {
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_timerq_pop(tq, now, &elt));
+        t = elt;
+        ABTS_TRUE(tc, t->when <= now);
+        ABTS_TRUE(tc, !prev || prev->when <= t->when);
+        prev = t;
+    }
+    ABTS_INT_EQUAL(tc, APR_NOTFOUND, apr_timerq_pop(tq, now, &elt));
+    ABTS_SIZE_EQUAL(tc, 3, apr_timerq_count(tq));
+    timeout = apr_timerq_timeout(tq, now);
+    ABTS_TRUE(tc, timeout >= 0 && timeout <= 5000 + res);
+
+    /* The rest */
+    now += 100000;
+    for (i = 0; i < 3; i++) {
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_timerq_pop(tq, now, &elt));
+        t = elt;
+        ABTS_TRUE(tc, prev->when <= t->when);
+        prev = t;
+    }
+    ABTS_PTR_EQUAL(tc, &timers[0], prev);
+    ABTS_INT_EQUAL(tc, APR_NOTFOUND, apr_timerq_pop(tq, now, &elt));
+    ABTS_SIZE_EQUAL(tc, 0, apr_timerq_count(tq));
+    ABTS_TRUE(tc, apr_timerq_timeout(tq, now) == -1);
+}
+
+static void timerq_cancel(abts_case *tc, void *data)
+{
+    apr_interval_time_t res = *(apr_interval_time_t *)data;
+    apr_timerq_t *tq = make_timerq(tc, p, res);
+    apr_time_t now = apr_time_now();
+    test_timer_t t1, t2, t3;
+    void *elt;
+
+    t1.when = now + 1000;
+    t2.when = now + 2000;
+    t3.when = now + 3000;
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_timerq_add(tq, t1.when, &t1,
+                                                   &t1.timer));
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_timerq_add(tq, t2.when, &t2,
+                                                   &t2.timer));
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_timerq_add(tq, t3.when, &t3,
+                                                   &t3.timer));
+
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_timerq_cancel(tq, t1.timer));
+    ABTS_INT_EQUAL(tc, APR_EINVAL, apr_timerq_cancel(tq, t1.timer));
+    ABTS_INT_EQUAL(tc, APR_EINVAL, apr_timerq_set(tq, t1.timer, now));
+    ABTS_SIZE_EQUAL(tc, 2, apr_timerq_count(tq));
+
+    /* Postpone t2 after t3 */
+    t2.when = now + 4000;
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_timerq_set(tq, t2.timer, t2.when));
+    ABTS_SIZE_EQUAL(tc, 2, apr_timerq_count(tq));
+
+    ABTS_INT_EQUAL(tc, APR_NOTFOUND, apr_timerq_pop(tq, now + 2500, &elt));
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_timerq_pop(tq, now + 5000, &elt));
+    ABTS_PTR_EQUAL(tc, &t3, elt);
+
+    /* Move t2 to the past, then cancel it while expired */
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_timerq_set(tq, t2.timer, now));
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_timerq_cancel(tq, t2.timer));
+    ABTS_INT_EQUAL(tc, APR_NOTFOUND, apr_timerq_pop(tq, now + 5000, &elt));
+    ABTS_SIZE_EQUAL(tc, 0, apr_timerq_count(tq));
+}
+
+/* Run the timers like an event loop would, waiting for the timeouts */
+static void run_timers(abts_case *tc, apr_timerq_t *tq,
+                       apr_interval_time_t res, apr_time_t now,
+                       apr_size_t count)
+{
+    apr_interval_time_t timeout;
+    apr_time_t last = 0;
+    apr_size_t expired = 0;
+    int loops = 0;
+    void *elt;
+
+    while ((timeout = apr_timerq_timeout(tq, now)) >= 0) {
+        now += timeout;
+        while (apr_timerq_pop(tq, now, &elt) == APR_SUCCESS) {
+            test_timer_t *t = elt;
+            /* in order, never early and at most one tick late */
+            ABTS_TRUE(tc, last <= t->when);
+            ABTS_TRUE(tc, t->when <= now);
+            ABTS_TRUE(tc, now - t->when <= (res ? res : 1));
+            ABTS_INT_EQUAL(tc, 0, t->cancelled);
+            ABTS_INT_EQUAL(tc, 0, t->expired);
+            t->expired = 1;
+            last = t->when;
+            expired++;
+        }
+        /* Far timers should not cost more than a few wakeups */
+        if (++loops > 8 * (int)count + 64) {
+            break;
+        }
+    }
+    ABTS_SIZE_EQUAL(tc, count, expired);
+    ABTS_SIZE_EQUAL(tc, 0, apr_timerq_count(tq));
+}
+
+static void timerq_far(abts_case *tc, void *data)
+{
+    apr_interval_time_t res = *(apr_interval_time_t *)data;
+    apr_timerq_t *tq = make_timerq(tc, p, res);
+    apr_time_t now = apr_time_now();
+    static const apr_interval_time_t delays[] = {
+        APR_USEC_PER_SEC * 86400 * 365 * 2,     /* beyond the wheels */
+        APR_USEC_PER_SEC * 86400,
+        APR_USEC_PER_SEC * 3600,
+        APR_USEC_PER_SEC * 60,
+        APR_USEC_PER_SEC,
+        APR_USEC_PER_SEC * 86400 * 365 * 2 + 1,
+        APR_USEC_PER_SEC * 60 + 1,
+        1
+    };
+    test_timer_t timers[sizeof(delays) / sizeof(delays[0])];
+    int i;
+
+    for (i = 0; i < sizeof(delays) / sizeof(delays[0]); i++) {
+        timers[i].when = now + delays[i];
+        timers[i].cancelled = timers[i].expired = 0;
+        ABTS_INT_EQUAL(tc, APR_SUCCESS,
+                       apr_timerq_add(tq, timers[i].when, &timers[i], NULL));
+    }
+    run_timers(tc, tq, res, now, sizeof(delays) / sizeof(delays[0]));
+}
+
+static void timerq_random(abts_case *tc, void *data)
+{
+    apr_interval_time_t res = *(apr_interval_time_t *)data;
+    apr_timerq_t *tq;
+    apr_pool_t *pool;
+    apr_time_t now = apr_time_now(), last = 0;
+    test_timer_t *timers;
+    apr_size_t expired = 0, cancelled = 0;
+    const int n = 20000;
+    void *elt;
+    int i;
+
+    apr_pool_create(&pool, p);
+    tq = make_timerq(tc, pool, res);
+    timers = apr_pcalloc(pool, n * sizeof(*timers));
+    srand((unsigned int)(now & 0xffffffff));
+
+    /* Connection timeouts, some of them refreshed or cancelled */
+    for (i = 0; i < n; i++) {
+        test_timer_t *t = &timers[i];
+        t->when = now + (apr_time_t)(rand() % 10000) * 1000 + rand() % 1000;
+        ABTS_INT_EQUAL(tc, APR_SUCCESS,
+                       apr_timerq_add(tq, t->when, t, &t->timer));
+        if (i && rand() % 4 == 0) {
+            t = &timers[rand() % i];
+            if (t->cancelled) {
+                continue;
+            }
+            if (rand() % 2) {
+                t->when = now + (apr_time_t)(rand() % 20000) * 1000;
+                ABTS_INT_EQUAL(tc, APR_SUCCESS,
+                               apr_timerq_set(tq, t->timer, t->when));
+            }
+            else {
+                ABTS_INT_EQUAL(tc, APR_SUCCESS,
+                               apr_timerq_cancel(tq, t->timer));
+                t->cancelled = 1;
+                cancelled++;
+            }
+        }
+    }
+    ABTS_SIZE_EQUAL(tc, n - cancelled, apr_timerq_count(tq));
+
+    /* Time goes on by random steps */
+    while (apr_timerq_count(tq)) {
+        now += rand() % 50000;
+        while (apr_timerq_pop(tq, now, &elt) == APR_SUCCESS) {
+            test_timer_t *t = elt;
+            ABTS_TRUE(tc, last <= t->when);
+            ABTS_TRUE(tc, t->when <= now);
+            ABTS_INT_EQUAL(tc, 0, t->cancelled);
+            ABTS_INT_EQUAL(tc, 0, t->expired);
+            t->expired = 1;
+            last = t->when;
+            expired++;
+        }
+    }
+    ABTS_SIZE_EQUAL(tc, n, expired + cancelled);
+
+    apr_pool_destroy(pool);
+}
+
+abts_suite *testtimerq(abts_suite *suite)
+{
+    int i;
+
+    suite = ADD_SUITE(suite)
+
+    abts_run_test(suite, timerq_create, NULL);
+    for (i = 0; i < sizeof(resolutions) / sizeof(resolutions[0]); i++) {
+        abts_run_test(suite, timerq_order, &resolutions[i]);
+        abts_run_test(suite, timerq_cancel, &resolutions[i]);
+        abts_run_test(suite, timerq_far, &resolutions[i]);
+        abts_run_test(suite, timerq_random, &resolutions[i]);
+    }
+
+    return suite;
+}
@@ -136,5 +136,7 @@ abts_suite *testskiplist(abts_suite *suite);
 abts_suite *testsiphash(abts_suite *suite);
 abts_suite *testjson(abts_suite *suite);
 abts_suite *testjose(abts_suite *suite);
+abts_suite *testtimerq(abts_suite *suite);
+abts_suite *testsha1(abts_suite *suite);
 
 #endif /* APR_TEST_INCLUDES */
@@ -17,6 +17,7 @@
 #include "testutil.h"
 #include "apr_general.h"
 #include "apr_uuid.h"
+#include "apr_time.h"
 
 static void test_uuid_parse(abts_case *tc, void *data)
 {
@@ -45,12 +46,118 @@ static void test_gen2(abts_case *tc, void *data)
              memcmp(&uuid, &uuid2, sizeof(uuid)) != 0);
 }
 
+static int uuid_version(const apr_uuid_t *uuid)
+{
+    return uuid->data[6] >> 4;
+}
+
+static int uuid_variant(const apr_uuid_t *uuid)
+{
+    return uuid->data[8] >> 6;
+}
+
+static void test_uuid_v4(abts_case *tc, void *data)
+{
+    apr_uuid_t uuids[100];
+    apr_status_t rv;
+    int i;
+
+    for (i = 0; i < 100; i++) {
+        rv = apr_uuid_get_ex(&uuids[i], APR_UUID_V4);
+        if (rv == APR_ENOTIMPL) {
+            ABTS_NOT_IMPL(tc, "apr_uuid_get_ex");
+            return;
+        }
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        ABTS_INT_EQUAL(tc, 4, uuid_version(&uuids[i]));
+        ABTS_INT_EQUAL(tc, 2, uuid_variant(&uuids[i]));
+        if (i) {
+            ABTS_ASSERT(tc, "generated the same UUID twice",
+                        memcmp(&uuids[i], &uuids[i - 1], 16) != 0);
+        }
+    }
+}
+
+static void test_uuid_v7(abts_case *tc, void *data)
+{
+    apr_uuid_t uuids[1000];
+    apr_uint64_t ms, now;
+    apr_status_t rv;
+    int i, j;
+
+    now = apr_time_as_msec(apr_time_now());
+    for (i = 0; i < 1000; i++) {
+        rv = apr_uuid_get_ex(&uuids[i], APR_UUID_V7);
+        if (rv == APR_ENOTIMPL) {
+            ABTS_NOT_IMPL(tc, "apr_uuid_get_ex");
+            return;
+        }
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        ABTS_INT_EQUAL(tc, 7, uuid_version(&uuids[i]));
+        ABTS_INT_EQUAL(tc, 2, uuid_variant(&uuids[i]));
+        if (i) {
+            ABTS_ASSERT(tc, "UUIDs not in increasing order",
+                        memcmp(&uuids[i], &uuids[i - 1], 16) > 0);
+        }
+    }
+
+    /* the timestamp is the time of generation (with some slack) */
+    for (ms = 0, j = 0; j < 6; j++) {
+        ms = (ms << 8) | uuids[0].data[j];
+    }
+    ABTS_ASSERT(tc, "unexpected timestamp", ms + 1000 > now
+                                            && ms < now + 1000);
+}
+
+static void test_uuid_bulk(abts_case *tc, void *data)
+{
+    static const apr_size_t counts[] = { 0, 1, 10, 17, 500 };
+    apr_uuid_t uuids[500];
+    apr_status_t rv;
+    apr_size_t i;
+    int j;
+
+    for (j = 0; j < sizeof(counts) / sizeof(counts[0]); j++) {
+        rv = apr_uuid_get_bulk(uuids, counts[j], APR_UUID_V7);
+        if (rv == APR_ENOTIMPL) {
+            ABTS_NOT_IMPL(tc, "apr_uuid_get_bulk");
+            return;
+        }
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        for (i = 0; i < counts[j]; i++) {
+            ABTS_INT_EQUAL(tc, 7, uuid_version(&uuids[i]));
+            ABTS_INT_EQUAL(tc, 2, uuid_variant(&uuids[i]));
+            if (i) {
+                ABTS_ASSERT(tc, "UUIDs not in increasing order",
+                            memcmp(&uuids[i], &uuids[i - 1], 16) > 0);
+            }
+        }
+
+        rv = apr_uuid_get_bulk(uuids, counts[j], APR_UUID_V4);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        for (i = 0; i < counts[j]; i++) {
+            ABTS_INT_EQUAL(tc, 4, uuid_version(&uuids[i]));
+            ABTS_INT_EQUAL(tc, 2, uuid_variant(&uuids[i]));
+            if (i) {
+                ABTS_ASSERT(tc, "generated the same UUID twice",
+                            memcmp(&uuids[i], &uuids[i - 1], 16) != 0);
+            }
+        }
+    }
+
+    rv = apr_uuid_get_bulk(uuids, 1, 1);
+    ABTS_INT_EQUAL(tc, APR_ENOTIMPL, rv);
+}
+
 abts_suite *testuuid(abts_suite *suite)
 {
     suite = ADD_SUITE(suite);
 
     abts_run_test(suite, test_uuid_parse, NULL);
     abts_run_test(suite, test_gen2, NULL);
+    abts_run_test(suite, test_uuid_v4, NULL);
+    abts_run_test(suite, test_uuid_v7, NULL);
+    abts_run_test(suite, test_uuid_bulk, NULL);
 
     return suite;
 }
@@ -20,6 +20,7 @@
 #include "apr_signal.h"
 #include "apr_random.h"
 #include "apr_crypto.h"
+#include "apr_uuid.h"
 
 /* Heavy on no'ops, here's what we want to pass if there is APR_NO_FILE
  * requested for a specific child handle;
@@ -244,6 +245,7 @@ APR_DECLARE(apr_status_t) apr_proc_fork(apr_proc_t *proc, apr_pool_t *pool)
         apr_crypto_prng_after_fork(NULL, APR_CRYPTO_FORK_INCHILD);
 #endif
         apr_random_after_fork(proc);
+        apr_uuid_after_fork();
 
         return APR_INCHILD;
     }
@@ -47,8 +47,9 @@ APR_DECLARE(apr_status_t) apr_threadattr_create(apr_threadattr_t **new,
 {
     apr_status_t stat;
 
-    (*new) = apr_palloc(pool, sizeof(apr_threadattr_t));
+    (*new) = apr_pcalloc(pool, sizeof(apr_threadattr_t));
     (*new)->pool = pool;
+    (*new)->numa_node = -1;
     stat = pthread_attr_init(&(*new)->attr);
 
     if (stat == 0) {
@@ -148,6 +149,20 @@ APR_DECLARE(apr_status_t) apr_threadattr_max_free_set(apr_threadattr_t *attr,
     return APR_SUCCESS;
 }
 
+APR_DECLARE(apr_status_t) apr_threadattr_hugepages_set(apr_threadattr_t *attr,
+                                                       int on)
+{
+    attr->hugepages = (on != 0);
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_threadattr_numa_node_set(apr_threadattr_t *attr,
+                                                       int node)
+{
+    attr->numa_node = node < 0 ? -1 : node;
+    return APR_SUCCESS;
+}
+
 #if APR_HAS_THREAD_LOCAL
 static APR_THREAD_LOCAL apr_thread_t *current_thread = NULL;
 #endif
@@ -177,6 +192,7 @@ static apr_status_t alloc_thread(apr_thread_t **new,
 {
     apr_status_t stat;
     apr_abortfunc_t abort_fn = apr_pool_abort_get(pool);
+    apr_allocator_t *allocator = NULL;
     apr_pool_t *p;
 
     /* The thread can be detached anytime (from the creation or later with
@@ -184,12 +200,38 @@ static apr_status_t alloc_thread(apr_thread_t **new,
      * depend on a parent pool which could be destroyed before the thread
      * exits. The allocator needs no mutex obviously since the pool should
      * not be used nor create children pools outside the thread. Passing
-     * NULL allocator will create one like that.
+     * NULL allocator will create one like that, unless its memory has to
+     * be set up before use.
      */
-    stat = apr_pool_create_unmanaged_ex(&p, abort_fn, NULL);
+    if (attr && (attr->hugepages || attr->numa_node >= 0)) {
+        stat = apr_allocator_create(&allocator);
+        if (stat != APR_SUCCESS) {
+            return stat;
+        }
+        /* These are hints, ignore them where not supported */
+        stat = APR_SUCCESS;
+        if (attr->hugepages) {
+            stat = apr_allocator_hugepages_set(allocator, 1);
+        }
+        if ((stat == APR_SUCCESS || APR_STATUS_IS_ENOTIMPL(stat))
+                && attr->numa_node >= 0) {
+            stat = apr_allocator_numa_node_set(allocator, attr->numa_node);
+        }
+        if (stat != APR_SUCCESS && !APR_STATUS_IS_ENOTIMPL(stat)) {
+            apr_allocator_destroy(allocator);
+            return stat;
+        }
+    }
+    stat = apr_pool_create_unmanaged_ex(&p, abort_fn, allocator);
     if (stat != APR_SUCCESS) {
+        if (allocator) {
+            apr_allocator_destroy(allocator);
+        }
         return stat;
     }
+    if (allocator) {
+        apr_allocator_owner_set(allocator, p);
+    }
     if (attr && attr->max_free) {
         apr_allocator_max_free_set(apr_pool_allocator_get(p), attr->max_free);
     }
@@ -19,6 +19,7 @@
 #include <assert.h>
 #include "apr_thread_pool.h"
 #include "apr_ring.h"
+#include "apr_timerq.h"
 #include "apr_thread_cond.h"
 #include "apr_portable.h"
 
@@ -33,6 +34,7 @@ typedef struct apr_thread_pool_task
     apr_thread_start_t func;
     void *param;
     void *owner;
+    apr_timerq_timer_t *timer;
     union
     {
         apr_byte_t priority;
@@ -71,6 +73,7 @@ struct apr_thread_pool
     volatile apr_size_t thd_timed_out;
     struct apr_thread_pool_tasks *tasks;
     struct apr_thread_pool_tasks *scheduled_tasks;
+    apr_timerq_t *scheduled_timers;
     struct apr_thread_list *busy_thds;
     struct apr_thread_list *idle_thds;
     struct apr_thread_list *dead_thds;
@@ -140,6 +143,13 @@ static apr_status_t thread_pool_construct(apr_thread_pool_t **tp,
         goto CATCH_ENOMEM;
     }
     APR_RING_INIT(me->scheduled_tasks, apr_thread_pool_task, link);
+    /* Scheduled tasks are ordered by a timer queue with a resolution of
+     * one microsecond, thus run at their exact time as before.
+     */
+    rv = apr_timerq_create(&me->scheduled_timers, 1, me->pool);
+    if (APR_SUCCESS != rv) {
+        goto CATCH_ENOMEM;
+    }
     me->recycled_tasks = apr_palloc(me->pool, sizeof(*me->recycled_tasks));
     if (!me->recycled_tasks) {
         goto CATCH_ENOMEM;
@@ -182,21 +192,17 @@ static apr_status_t thread_pool_construct(apr_thread_pool_t **tp,
 static apr_thread_pool_task_t *pop_task(apr_thread_pool_t * me)
 {
     apr_thread_pool_task_t *task = NULL;
+    void *data;
     int seg;
 
-    /* check for scheduled tasks */
-    if (me->scheduled_task_cnt > 0) {
-        task = APR_RING_FIRST(me->scheduled_tasks);
-        assert(task != NULL);
-        assert(task !=
-               APR_RING_SENTINEL(me->scheduled_tasks, apr_thread_pool_task,
-                                 link));
-        /* if it's time */
-        if (task->dispatch.time <= apr_time_now()) {
-            --me->scheduled_task_cnt;
-            APR_RING_REMOVE(task, link);
-            return task;
-        }
+    /* check for scheduled tasks, if it's time */
+    if (me->scheduled_task_cnt > 0
+        && apr_timerq_pop(me->scheduled_timers, apr_time_now(),
+                          &data) == APR_SUCCESS) {
+        task = data;
+        --me->scheduled_task_cnt;
+        APR_RING_REMOVE(task, link);
+        return task;
     }
     /* check for normal tasks if we're not returning a scheduled task */
     if (me->task_cnt == 0) {
@@ -222,14 +228,7 @@ static apr_thread_pool_task_t *pop_task(apr_thread_pool_t * me)
 
 static apr_interval_time_t waiting_time(apr_thread_pool_t * me)
 {
-    apr_thread_pool_task_t *task = NULL;
-
-    task = APR_RING_FIRST(me->scheduled_tasks);
-    assert(task != NULL);
-    assert(task !=
-           APR_RING_SENTINEL(me->scheduled_tasks, apr_thread_pool_task,
-                             link));
-    return task->dispatch.time - apr_time_now();
+    return apr_timerq_timeout(me->scheduled_timers, apr_time_now());
 }
 
 /*
@@ -540,15 +539,14 @@ static apr_thread_pool_task_t *add_if_empty(apr_thread_pool_t * me,
 }
 
 /*
-*   schedule a task to run in "time" microseconds. Find the spot in the ring where
-*   the time fits. Adjust the short_time so the thread wakes up when the time is reached.
+*   schedule a task to run in "time" microseconds. The timer queue orders the
+*   scheduled tasks, the ring only tracks them for apr_thread_pool_tasks_cancel().
 */
 static apr_status_t schedule_task(apr_thread_pool_t *me,
                                   apr_thread_start_t func, void *param,
                                   void *owner, apr_interval_time_t time)
 {
     apr_thread_pool_task_t *t;
-    apr_thread_pool_task_t *t_loc;
     apr_thread_t *thd;
     apr_status_t rv = APR_SUCCESS;
 
@@ -569,26 +567,18 @@ static apr_status_t schedule_task(apr_thread_pool_t *me,
         apr_thread_mutex_unlock(me->lock);
         return APR_ENOMEM;
     }
-    t_loc = APR_RING_FIRST(me->scheduled_tasks);
-    while (NULL != t_loc) {
-        /* if the time is less than the entry insert ahead of it */
-        if (t->dispatch.time < t_loc->dispatch.time) {
-            ++me->scheduled_task_cnt;
-            APR_RING_INSERT_BEFORE(t_loc, t, link);
-            break;
-        }
-        else {
-            t_loc = APR_RING_NEXT(t_loc, link);
-            if (t_loc ==
-                APR_RING_SENTINEL(me->scheduled_tasks, apr_thread_pool_task,
-                                  link)) {
-                ++me->scheduled_task_cnt;
-                APR_RING_INSERT_TAIL(me->scheduled_tasks, t,
-                                     apr_thread_pool_task, link);
-                break;
-            }
-        }
+    if (time <= 0) {
+        t->dispatch.time = apr_time_now();
+    }
+    rv = apr_timerq_add(me->scheduled_timers, t->dispatch.time, t, &t->timer);
+    if (APR_SUCCESS != rv) {
+        APR_RING_INSERT_TAIL(me->recycled_tasks, t, apr_thread_pool_task,
+                             link);
+        apr_thread_mutex_unlock(me->lock);
+        return rv;
     }
+    ++me->scheduled_task_cnt;
+    APR_RING_INSERT_TAIL(me->scheduled_tasks, t, apr_thread_pool_task, link);
     /* there should be at least one thread for scheduled tasks */
     if (0 == me->thd_cnt) {
         rv = apr_thread_create(&thd, NULL, thread_pool_func, me, me->pool);
@@ -710,6 +700,7 @@ static apr_status_t remove_scheduled_tasks(apr_thread_pool_t *me,
         /* if this is the owner remove it */
         if (!owner || t_loc->owner == owner) {
             --me->scheduled_task_cnt;
+            apr_timerq_cancel(me->scheduled_timers, t_loc->timer);
             APR_RING_REMOVE(t_loc, link);
         }
         t_loc = next;